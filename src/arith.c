@@ -55,11 +55,7 @@
 void
 internalTime_to_integer64(TimeInternal internal, Integer64 *bigint)
 {
-	int64_t scaledNanoseconds;
-	scaledNanoseconds   = internal.seconds * 1000000000 + internal.nanoseconds;
-	scaledNanoseconds <<= 16;
-	bigint->msb = (scaledNanoseconds >> 32) & 0xffffffff;
-	bigint->lsb = scaledNanoseconds & 0xffffffff;
+	scaled_to_integer64(internalTime_to_scaled(&internal), bigint);
 }
 
 void 
@@ -88,6 +84,68 @@ integer64_to_internalTime(Integer64 bigint, TimeInternal * internal)
 }
 
 
+/*
+ * TimeScaled conversions. The servo works on scaled intervals, so the
+ * fractional nanoseconds of correctionField survive until the result
+ * is rounded once into a TimeInternal. Apart from that rounding and the
+ * range check in subTimeScaled, none of these normalise, branch or divide.
+ */
+TimeScaled
+integer64_to_scaled(const Integer64 *bigint)
+{
+	return (TimeScaled)(((uint64_t)(UInteger32)bigint->msb << 32) | bigint->lsb);
+}
+
+void
+scaled_to_integer64(TimeScaled scaled, Integer64 *bigint)
+{
+	bigint->msb = (Integer32)((uint64_t)scaled >> 32);
+	bigint->lsb = (UInteger32)scaled;
+}
+
+TimeScaled
+internalTime_to_scaled(const TimeInternal *internal)
+{
+	return ((int64_t)internal->seconds * 1000000000 + internal->nanoseconds) * TIME_SCALED_NS;
+}
+
+void
+scaled_to_internalTime(TimeScaled scaled, TimeInternal *internal)
+{
+	/* round to nearest: arithmetic shift floors negative values as well */
+	int64_t nanoseconds = (scaled + TIME_SCALED_NS / 2) >> 16;
+
+	/* C99 division truncates, so both parts get the same sign */
+	internal->seconds = nanoseconds / 1000000000;
+	internal->nanoseconds = nanoseconds % 1000000000;
+}
+
+/*
+ * x - y in scaled units. Absolute timestamps from two clocks can be years
+ * apart (a slave booted at the epoch, a master stuck in 1970), beyond what
+ * a TimeScaled holds: the difference is taken in TimeInternal first and
+ * converted only within TIME_SCALED_MAX_SECONDS. Otherwise *scaled is
+ * saturated at that limit and FALSE is returned - callers needing the
+ * exact value then work in TimeInternal.
+ */
+Boolean
+subTimeScaled(TimeScaled *scaled, const TimeInternal *x, const TimeInternal *y)
+{
+	TimeInternal interval;
+
+	subTime(&interval, x, y);
+
+	if (interval.seconds >= TIME_SCALED_MAX_SECONDS ||
+	    interval.seconds <= -TIME_SCALED_MAX_SECONDS) {
+		*scaled = (interval.seconds < 0 ? -1 : 1) *
+			(TimeScaled)TIME_SCALED_MAX_SECONDS * 1000000000 * TIME_SCALED_NS;
+		return FALSE;
+	}
+
+	*scaled = internalTime_to_scaled(&interval);
+	return TRUE;
+}
+
 void 
 fromInternalTime(const TimeInternal * internal, Timestamp * external)
 {
@@ -84,7 +84,14 @@ void initData(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 	    memcpy(ptpClock->clockIdentity + 3, &pid, 2);
 	}
 
-	ptpClock->numberPorts = NUMBER_PORTS;
+	/* the ports of a boundary clock all have the clock identity of port 1 */
+	if(ptpClock->boundaryClock != NULL) {
+	    if(ptpClock->portIndex > 0)
+		copyClockIdentity(ptpClock->clockIdentity,
+			ptpClock->boundaryClock->ports[0]->clockIdentity);
+	    ptpClock->numberPorts = ptpClock->boundaryClock->numberPorts;
+	} else
+	    ptpClock->numberPorts = NUMBER_PORTS;
 
 	ptpClock->clockQuality.clockAccuracy = 
 		rtOpts->clockQuality.clockAccuracy;
@@ -105,11 +112,11 @@ void initData(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 
 	/*
 	 * PortIdentity Init (portNumber = 1 for an ardinary clock spec
-	 * 7.5.2.3)
+	 * 7.5.2.3, 1..numberPorts for a boundary clock)
 	 */
 	copyClockIdentity(ptpClock->portIdentity.clockIdentity,
 			ptpClock->clockIdentity);
-	ptpClock->portIdentity.portNumber = NUMBER_PORTS;
+	ptpClock->portIdentity.portNumber = NUMBER_PORTS + ptpClock->portIndex;
 
 	/* select the initial rate of delayreqs until we receive the first announce message */
 
@@ -134,6 +141,8 @@ void initData(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 	/*Init other stuff*/
 	ptpClock->number_foreign_records = 0;
   	ptpClock->max_foreign_records = rtOpts->max_foreign_records;
+
+	allDatasetsChanged(ptpClock);
 }
 
 
@@ -172,6 +181,11 @@ void m1(const RunTimeOpts *rtOpts, PtpClock *ptpClock)
 	ptpClock->timePropertiesDS.frequencyTraceable = rtOpts->timeProperties.frequencyTraceable;
 	ptpClock->timePropertiesDS.ptpTimescale = rtOpts->timeProperties.ptpTimescale;
 	ptpClock->timePropertiesDS.timeSource = rtOpts->timeProperties.timeSource;
+
+	datasetChanged(ptpClock, MGMT_CACHE_CURRENT_DS);
+	datasetChanged(ptpClock, MGMT_CACHE_PARENT_DS);
+	datasetChanged(ptpClock, MGMT_CACHE_TIME_PROPERTIES_DS);
+	datasetChanged(ptpClock, MGMT_CACHE_PORT_DS);
 }
 
 
@@ -182,11 +196,56 @@ void p1(PtpClock *ptpClock, const RunTimeOpts *rtOpts)
 	if(ptpClock->portState == PTP_PASSIVE){
 		ptpClock->timePropertiesDS.currentUtcOffsetValid = rtOpts->timeProperties.currentUtcOffsetValid;
 		ptpClock->timePropertiesDS.currentUtcOffset = rtOpts->timeProperties.currentUtcOffset;
+		datasetChanged(ptpClock, MGMT_CACHE_TIME_PROPERTIES_DS);
 	}
 	
 }
 
 
+/*
+ * Boundary clock port that is master while another port is the slave
+ * port: Table 15 (9.3.5) of the spec. The current, parent and time
+ * properties data sets belong to the clock - every port keeps a copy,
+ * so the master ports take them from Ebest like the slave port does.
+ */
+static void
+m3(MsgHeader *header, MsgAnnounce *announce, const RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+	/*Current data set update*/
+	ptpClock->stepsRemoved = announce->stepsRemoved + 1;
+
+	clearTime(&ptpClock->offsetFromMaster);
+	clearTime(&ptpClock->meanPathDelay);
+
+	/*Parent data set*/
+	copyClockIdentity(ptpClock->parentPortIdentity.clockIdentity,
+	       header->sourcePortIdentity.clockIdentity);
+	ptpClock->parentPortIdentity.portNumber = 
+		header->sourcePortIdentity.portNumber;
+	copyClockIdentity(ptpClock->grandmasterIdentity,
+			announce->grandmasterIdentity);
+	ptpClock->grandmasterClockQuality = announce->grandmasterClockQuality;
+	ptpClock->grandmasterPriority1 = announce->grandmasterPriority1;
+	ptpClock->grandmasterPriority2 = announce->grandmasterPriority2;
+        ptpClock->logMinDelayReqInterval = rtOpts->subsequent_delayreq;
+
+	/*Time Properties data set*/
+	ptpClock->timePropertiesDS.currentUtcOffset = announce->currentUtcOffset;
+	ptpClock->timePropertiesDS.currentUtcOffsetValid = IS_SET(header->flagField1, UTCV);
+	ptpClock->timePropertiesDS.leap59 = IS_SET(header->flagField1, LI59);
+	ptpClock->timePropertiesDS.leap61 = IS_SET(header->flagField1, LI61);
+	ptpClock->timePropertiesDS.timeTraceable = IS_SET(header->flagField1, TTRA);
+	ptpClock->timePropertiesDS.frequencyTraceable = IS_SET(header->flagField1, FTRA);
+	ptpClock->timePropertiesDS.ptpTimescale = IS_SET(header->flagField1, PTPT);
+	ptpClock->timePropertiesDS.timeSource = announce->timeSource;
+
+	datasetChanged(ptpClock, MGMT_CACHE_CURRENT_DS);
+	datasetChanged(ptpClock, MGMT_CACHE_PARENT_DS);
+	datasetChanged(ptpClock, MGMT_CACHE_TIME_PROPERTIES_DS);
+	datasetChanged(ptpClock, MGMT_CACHE_PORT_DS);
+}
+
+
 /*Local clock is synchronized to Ebest Table 16 (9.3.5) of the spec*/
 void s1(MsgHeader *header,MsgAnnounce *announce,PtpClock *ptpClock, const RunTimeOpts *rtOpts)
 {
@@ -249,12 +308,18 @@ void s1(MsgHeader *header,MsgAnnounce *announce,PtpClock *ptpClock, const RunTim
         ptpClock->timePropertiesDS.ptpTimescale = IS_SET(header->flagField1, PTPT);
         ptpClock->timePropertiesDS.timeSource = announce->timeSource;
 
+	datasetChanged(ptpClock, MGMT_CACHE_CURRENT_DS);
+	datasetChanged(ptpClock, MGMT_CACHE_PARENT_DS);
+	datasetChanged(ptpClock, MGMT_CACHE_TIME_PROPERTIES_DS);
+	datasetChanged(ptpClock, MGMT_CACHE_PORT_DS);
+
 #if defined(MOD_TAI) &&  NTP_API == 4
 	/*
 	 * update kernel TAI offset, but only if timescale is
-	 * PTP not ARB - spec section 7.2
+	 * PTP not ARB - spec section 7.2. The other domain instances
+	 * leave the kernel alone.
 	 */
-        if (ptpClock->timePropertiesDS.ptpTimescale &&
+        if (ptpClock->domainIndex == 0 && ptpClock->timePropertiesDS.ptpTimescale &&
 	    (ptpClock->timePropertiesDS.currentUtcOffsetValid || rtOpts->alwaysRespectUtcOffset) &&
             (ptpClock->timePropertiesDS.currentUtcOffset != previousUtcOffset)) {
 		setKernelUtcOffset(ptpClock->timePropertiesDS.currentUtcOffset);
@@ -359,7 +424,7 @@ copyD0(MsgHeader *header, MsgAnnounce *announce, PtpClock *ptpClock)
 /*Data set comparison bewteen two foreign masters (9.3.4 fig 27)
  * return similar to memcmp() */
 
-static Integer8 
+Integer8 
 bmcDataSetComparison(const MsgHeader *headerA, const MsgAnnounce *announceA,
 		     const MsgHeader *headerB, const MsgAnnounce *announceB,
 		     const PtpClock *ptpClock, const RunTimeOpts * rtOpts)
@@ -496,8 +561,10 @@ bmcStateDecision(MsgHeader *header, MsgAnnounce *announce,
 			displayPortIdentity(&header->sourcePortIdentity,
 					    "New best master selected:");
 			ptpClock->counters.masterChanges++;
-			if (ptpClock->portState == PTP_SLAVE)
+			if (ptpClock->portState == PTP_SLAVE) {
 				displayStatus(ptpClock, "State: ");
+				standbySwitch(rtOpts, ptpClock, &header->sourcePortIdentity);
+			}
 #ifdef PTPD_STATISTICS
 				if(rtOpts->calibrationDelay) {
 					ptpClock->isCalibrated = FALSE;
@@ -544,8 +611,10 @@ bmcStateDecision(MsgHeader *header, MsgAnnounce *announce,
 				displayPortIdentity(&header->sourcePortIdentity,
 						    "New best master selected:");
 				ptpClock->counters.masterChanges++;
-				if(ptpClock->portState == PTP_SLAVE)
+				if(ptpClock->portState == PTP_SLAVE) {
 					displayStatus(ptpClock, "State: ");
+					standbySwitch(rtOpts, ptpClock, &header->sourcePortIdentity);
+				}
 #ifdef PTPD_STATISTICS
 				if(rtOpts->calibrationDelay) {
 					ptpClock->isCalibrated = FALSE;
@@ -568,6 +637,136 @@ bmcStateDecision(MsgHeader *header, MsgAnnounce *announce,
 
 
 
+/* Erbest of another port of the boundary clock, NULL if it has none */
+static ForeignMasterRecord *
+bmcPortBest(const RunTimeOpts *rtOpts, PtpClock *port)
+{
+	Integer16 i,best;
+
+	switch (port->portState) {
+	case PTP_INITIALIZING:
+	case PTP_FAULTY:
+	case PTP_DISABLED:
+		return NULL;
+	default:
+		break;
+	}
+
+	if (!port->number_foreign_records)
+		return NULL;
+
+	for (i=1,best = 0; i<port->number_foreign_records;i++)
+		if ((bmcDataSetComparison(&port->foreign[i].header,
+					  &port->foreign[i].announce,
+					  &port->foreign[best].header,
+					  &port->foreign[best].announce,
+					  port, rtOpts)) < 0)
+			best = i;
+
+	return &port->foreign[best];
+}
+
+/*
+ * State decision for a port of a boundary clock, 9.3.3 fig 26: Ebest is
+ * the best of the Erbest of all ports. Only the port that received Ebest
+ * becomes slave (S1); the other ports are masters announcing Ebest (M3),
+ * or passive if their Erbest is the same grandmaster over a path about
+ * as short (P2) - the "better by topology" case of 9.3.4, which would
+ * otherwise leave two masters of the same grandmaster on the segment.
+ */
+static UInteger8
+bmcBoundaryStateDecision(const RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+	BoundaryClock *bc = ptpClock->boundaryClock;
+	ForeignMasterRecord *erbest = NULL, *ebest = NULL, *record;
+	PtpClock *bestPort = NULL;
+	Boolean newBM;
+	int i;
+
+	if (ptpClock->number_foreign_records)
+		erbest = &ptpClock->foreign[ptpClock->foreign_record_best];
+
+	for (i = 0; i < bc->numberPorts; i++) {
+		record = (bc->ports[i] == ptpClock) ? erbest :
+			bmcPortBest(bc->portOpts[i], bc->ports[i]);
+		if (record == NULL)
+			continue;
+		if (ebest == NULL ||
+		    bmcDataSetComparison(&record->header, &record->announce,
+					 &ebest->header, &ebest->announce,
+					 ptpClock, rtOpts) < 0) {
+			ebest = record;
+			bestPort = bc->ports[i];
+		}
+	}
+
+	/* nothing heard on any port */
+	if (ebest == NULL) {
+		if (ptpClock->portState == PTP_LISTENING)
+			return PTP_LISTENING;
+		m1(rtOpts, ptpClock);
+		return PTP_MASTER;
+	}
+
+	copyD0(&ptpClock->msgTmpHeader,&ptpClock->msgTmp.announce,ptpClock);
+
+	if (ptpClock->clockQuality.clockClass < 128) {
+		if (erbest == NULL ||
+		    bmcDataSetComparison(&ptpClock->msgTmpHeader, &ptpClock->msgTmp.announce,
+					 &erbest->header, &erbest->announce,
+					 ptpClock, rtOpts) < 0) {
+			m1(rtOpts, ptpClock);
+			return PTP_MASTER;
+		}
+		s1(&erbest->header, &erbest->announce, ptpClock, rtOpts);
+		return PTP_PASSIVE;
+	}
+
+	if (bmcDataSetComparison(&ptpClock->msgTmpHeader, &ptpClock->msgTmp.announce,
+				 &ebest->header, &ebest->announce,
+				 ptpClock, rtOpts) < 0) {
+		m1(rtOpts, ptpClock);
+		return PTP_MASTER;
+	}
+
+	if (bestPort != ptpClock) {
+		if (erbest != NULL &&
+		    !memcmp(erbest->announce.grandmasterIdentity,
+			    ebest->announce.grandmasterIdentity, CLOCK_IDENTITY_LENGTH) &&
+		    erbest->announce.stepsRemoved <= ebest->announce.stepsRemoved + 1)
+			return PTP_PASSIVE;
+		m3(&ebest->header, &ebest->announce, rtOpts, ptpClock);
+		return PTP_MASTER;
+	}
+
+	newBM = ((memcmp(ebest->header.sourcePortIdentity.clockIdentity,
+			    ptpClock->parentPortIdentity.clockIdentity,CLOCK_IDENTITY_LENGTH)) ||
+		(ebest->header.sourcePortIdentity.portNumber != ptpClock->parentPortIdentity.portNumber));
+
+	s1(&ebest->header, &ebest->announce, ptpClock, rtOpts);
+	if (newBM) {
+		displayPortIdentity(&ebest->header.sourcePortIdentity,
+				    "New best master selected:");
+		ptpClock->counters.masterChanges++;
+		if(ptpClock->portState == PTP_SLAVE) {
+			displayStatus(ptpClock, "State: ");
+			standbySwitch(rtOpts, ptpClock, &ebest->header.sourcePortIdentity);
+		}
+#ifdef PTPD_STATISTICS
+		if(rtOpts->calibrationDelay) {
+			ptpClock->isCalibrated = FALSE;
+			ptpClock->statsUpdates = 0;
+		}
+#endif /* PTPD_STATISTICS */
+	}
+
+	/* the master ports announce what the slave port has just learned */
+	bcStateChange(ptpClock);
+
+	return PTP_SLAVE;
+}
+
+
 UInteger8 
 bmc(ForeignMasterRecord *foreignMaster,
     const RunTimeOpts *rtOpts, PtpClock *ptpClock)
@@ -576,7 +775,7 @@ bmc(ForeignMasterRecord *foreignMaster,
 
 	DBGV("number_foreign_records : %d \n", ptpClock->number_foreign_records);
 	if (!ptpClock->number_foreign_records)
-		if (ptpClock->portState == PTP_MASTER)	{
+		if (ptpClock->portState == PTP_MASTER && ptpClock->boundaryClock == NULL) {
 			m1(rtOpts,ptpClock);
 			return ptpClock->portState;
 		}
@@ -592,12 +791,65 @@ bmc(ForeignMasterRecord *foreignMaster,
 	DBGV("Best record : %d \n",best);
 	ptpClock->foreign_record_best = best;
 
+	/* the ports of a boundary clock decide on the best master of all ports */
+	if (ptpClock->boundaryClock != NULL && !ptpClock->boundaryClock->redundant)
+		return bmcBoundaryStateDecision(rtOpts, ptpClock);
+
 	return (bmcStateDecision(&foreignMaster[best].header,
 				 &foreignMaster[best].announce,
 				 rtOpts,ptpClock));
 }
 
 
+/*
+ * Rank the foreign masters other than the current parent, best first,
+ * leaving out disqualified ones. Fills up to max record indices into
+ * ranking and returns how many were filled.
+ */
+int
+bmcRankForeign(const RunTimeOpts *rtOpts, const PtpClock *ptpClock,
+	       Integer16 *ranking, int max)
+{
+	Integer16 i;
+	int j, count = 0;
+	const ForeignMasterRecord *record;
+
+	for (i = 0; i < ptpClock->number_foreign_records; i++) {
+		record = &ptpClock->foreign[i];
+
+		if (!memcmp(record->header.sourcePortIdentity.clockIdentity,
+			    ptpClock->parentPortIdentity.clockIdentity,
+			    CLOCK_IDENTITY_LENGTH) &&
+		    record->header.sourcePortIdentity.portNumber ==
+		    ptpClock->parentPortIdentity.portNumber)
+			continue;
+
+		if (record->announce.grandmasterClockQuality.clockClass == 255 ||
+		    record->announce.grandmasterPriority1 == 255)
+			continue;
+
+		/* insertion sort - the table holds at most a handful of records */
+		for (j = count; j > 0; j--) {
+			if (bmcDataSetComparison(&record->header, &record->announce,
+						 &ptpClock->foreign[ranking[j - 1]].header,
+						 &ptpClock->foreign[ranking[j - 1]].announce,
+						 ptpClock, rtOpts) >= 0)
+				break;
+			if (j < max)
+				ranking[j] = ranking[j - 1];
+		}
+
+		if (j < max) {
+			ranking[j] = i;
+			if (count < max)
+				count++;
+		}
+	}
+
+	return count;
+}
+
+
 
 /*
 
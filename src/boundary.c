@@ -0,0 +1,493 @@
+/*-
+ * Copyright (c) 2014 Wojciech Owczarek,
+ *
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+/**
+ * @file   boundary.c
+ *
+ * @brief  Boundary clock: several ports sharing one clock
+ *
+ * Each interface listed in ptpengine:bc_interfaces becomes another port
+ * of the clock, next to ptpengine:interface (port 1). A port is a
+ * complete protocol engine instance with its own sockets, timers,
+ * foreign masters and filters, and its own copy of the run-time options.
+ * All ports share the clock identity and are run from the one main loop:
+ * port 1 blocks in select() for the sockets of every port, the other
+ * ports are polled after it. The BMC decides across the ports (bmc.c):
+ * the port receiving the best master of all ports is the only slave,
+ * the others are masters (or passive), announcing that master.
+ * Process-wide services - control socket, NTP, SNMP, clock page, status
+ * file - stay with port 1.
+ *
+ * The same two-port engine runs a redundant slave (ptpengine:redundant_interface):
+ * both ports are slave only paths to the same GM, each with its own
+ * timestamps, path delay and filters. Both measure, the one with the lower
+ * offset variation (PDV) disciplines the clock. On a switch the servo state
+ * moves to the other path and the difference between the two paths' offsets
+ * is kept as a bias, so that the servo input does not step.
+ */
+
+#include "ptpd.h"
+
+static double
+bcNow(void)
+{
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1E9;
+
+}
+
+/*
+ * Parse the boundary clock port list: interface names separated by commas
+ * or spaces. Returns FALSE on a malformed list.
+ */
+Boolean
+bcParseInterfaces(RunTimeOpts *rtOpts)
+{
+
+	char text[PATH_MAX];
+	char *token, *save = NULL;
+	int i;
+
+	rtOpts->bcPortCount = 0;
+	strncpy(text, rtOpts->bcInterfacesText, sizeof(text) - 1);
+	text[sizeof(text) - 1] = '\0';
+
+	for (token = strtok_r(text, ", \t", &save); token != NULL;
+	     token = strtok_r(NULL, ", \t", &save)) {
+		if (strlen(token) >= IFACE_NAME_LENGTH)
+			return FALSE;
+		if (!strcmp(token, rtOpts->ifaceName))
+			return FALSE;
+		for (i = 0; i < rtOpts->bcPortCount; i++)
+			if (!strcmp(token, rtOpts->bcInterfaces[i]))
+				return FALSE;
+		if (rtOpts->bcPortCount == BC_MAX_PORTS - 1)
+			return FALSE;
+		strncpy(rtOpts->bcInterfaces[rtOpts->bcPortCount++], token,
+			IFACE_NAME_LENGTH - 1);
+	}
+
+	return TRUE;
+
+}
+
+/*
+ * options of another port: the global ones, minus what only port 1 runs.
+ * Also the base for the options of a domain instance (domains.c).
+ */
+void
+bcPortOptions(RunTimeOpts *portOpts, const RunTimeOpts *rtOpts, const char *ifaceName)
+{
+
+	*portOpts = *rtOpts;
+	memset(portOpts->ifaceName, 0, IFACE_NAME_LENGTH);
+	strncpy(portOpts->ifaceName, ifaceName, IFACE_NAME_LENGTH - 1);
+
+	portOpts->ntpShmEnabled = FALSE;
+	portOpts->ntpServerEnabled = FALSE;
+	portOpts->clockPageEnabled = FALSE;
+	portOpts->controlSocketEnabled = FALSE;
+	portOpts->snapshotEnabled = FALSE;
+	portOpts->snmp_enabled = FALSE;
+	portOpts->logStatistics = FALSE;
+#ifdef PTPD_NTPDC
+	portOpts->ntpOptions.enableEngine = FALSE;
+#endif /* PTPD_NTPDC */
+	portOpts->restartSubsystems = 0;
+
+}
+
+/**
+ * Create the other ports of the boundary clock around port 1. Their
+ * sockets are opened when they are initialised from the main loop.
+ */
+Boolean
+bcInit(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	BoundaryClock *bc;
+	PtpClock *port;
+	int i;
+
+	if (rtOpts->bcPortCount == 0)
+		return TRUE;
+
+	if ((bc = (BoundaryClock *)calloc(1, sizeof(BoundaryClock))) == NULL) {
+		PERROR("failed to allocate memory for the boundary clock");
+		return FALSE;
+	}
+
+	bc->clockPort = -1;
+	bc->redundant = rtOpts->bcRedundant;
+	bc->ports[0] = ptpClock;
+	bc->portOpts[0] = rtOpts;
+	bc->numberPorts = 1;
+	ptpClock->boundaryClock = bc;
+	ptpClock->portIndex = 0;
+	timerRegister(ptpClock->itimer);
+
+	for (i = 0; i < rtOpts->bcPortCount; i++) {
+		if ((bc->portOpts[i + 1] = (RunTimeOpts *)malloc(sizeof(RunTimeOpts))) == NULL) {
+			PERROR("failed to allocate memory for boundary clock port options");
+			return FALSE;
+		}
+		bcPortOptions(bc->portOpts[i + 1], rtOpts, rtOpts->bcInterfaces[i]);
+
+		if ((port = createPtpClock(bc->portOpts[i + 1])) == NULL) {
+			free(bc->portOpts[i + 1]);
+			bc->portOpts[i + 1] = NULL;
+			return FALSE;
+		}
+
+		port->boundaryClock = bc;
+		port->portIndex = i + 1;
+		bc->ports[i + 1] = port;
+		bc->numberPorts++;
+		timerRegister(port->itimer);
+	}
+
+	if (bc->redundant)
+		INFO("Redundant slave on %s and %s\n", rtOpts->ifaceName,
+		     rtOpts->bcInterfaces[0]);
+	else
+		INFO("Boundary clock with %d ports\n", bc->numberPorts);
+
+	return TRUE;
+
+}
+
+/* close and free the ports other than port 1 */
+void
+bcShutdown(PtpClock *ptpClock)
+{
+
+	BoundaryClock *bc = ptpClock->boundaryClock;
+	int i;
+
+	if (bc == NULL)
+		return;
+
+	/* the drift saved on exit is the one of the port that had the clock */
+	if (bc->clockPort > 0)
+		ptpClock->servo.observedDrift = bc->ports[bc->clockPort]->servo.observedDrift;
+
+	for (i = 1; i < bc->numberPorts; i++) {
+		netShutdown(&bc->ports[i]->netPath);
+		timerUnregister(bc->ports[i]->itimer);
+		freePtpClock(&bc->ports[i]);
+		free(bc->portOpts[i]);
+	}
+
+	timerUnregister(ptpClock->itimer);
+	ptpClock->boundaryClock = NULL;
+	free(bc);
+
+}
+
+/* the configuration was reloaded - the other ports take the new options */
+void
+bcUpdateOptions(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	BoundaryClock *bc = ptpClock->boundaryClock;
+	int i;
+
+	if (bc == NULL)
+		return;
+
+	for (i = 1; i < bc->numberPorts; i++)
+		bcPortOptions(bc->portOpts[i], rtOpts, rtOpts->bcInterfaces[i - 1]);
+
+}
+
+/* another port of the boundary clock is disciplining the clock */
+Boolean
+bcClockTaken(const PtpClock *ptpClock)
+{
+
+	const BoundaryClock *bc = ptpClock->boundaryClock;
+
+	return bc != NULL && bc->clockPort >= 0 && bc->clockPort != ptpClock->portIndex;
+
+}
+
+/**
+ * The port becomes the slave port. If another port was disciplining the
+ * clock (or holding it over), the clock runs at that port's frequency:
+ * the servo carries on from it, along with the holdover model, instead
+ * of restoring the drift. Returns TRUE if the clock was handed over, or
+ * if it stays with another path of a redundant slave that is still slave.
+ */
+Boolean
+bcTakeClock(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	BoundaryClock *bc = ptpClock->boundaryClock;
+	PtpClock *previous;
+
+	if (bc == NULL)
+		return FALSE;
+
+	if (bc->clockPort < 0 || bc->clockPort == ptpClock->portIndex) {
+		bc->clockPort = ptpClock->portIndex;
+		return FALSE;
+	}
+
+	/* this path only measures until it is selected */
+	if (bc->redundant && bc->ports[bc->clockPort]->portState == PTP_SLAVE)
+		return TRUE;
+
+	previous = bc->ports[bc->clockPort];
+	bc->clockPort = ptpClock->portIndex;
+
+	/* out of holdover at the last holdover frequency */
+	holdoverStop(bc->portOpts[previous->portIndex], previous, TRUE);
+
+	ptpClock->servo.observedDrift = previous->servo.observedDrift;
+	ptpClock->drift_saved = previous->drift_saved;
+	ptpClock->last_saved_drift = previous->last_saved_drift;
+	ptpClock->holdover = previous->holdover;
+
+	if (bc->redundant)
+		NOTICE("Redundant slave: %s takes over the clock from %s at %.3f ppm\n",
+		       bc->portOpts[ptpClock->portIndex]->ifaceName,
+		       bc->portOpts[previous->portIndex]->ifaceName,
+		       ptpClock->servo.observedDrift / 1000.0);
+	else
+		NOTICE("Boundary clock: port %d takes over the clock from port %d at %.3f ppm\n",
+		       ptpClock->portIndex + 1, previous->portIndex + 1,
+		       ptpClock->servo.observedDrift / 1000.0);
+
+	return TRUE;
+
+}
+
+/* the port changed state - the other ports have to run the BMC again */
+void
+bcStateChange(PtpClock *ptpClock)
+{
+
+	BoundaryClock *bc = ptpClock->boundaryClock;
+	int i;
+
+	if (bc == NULL)
+		return;
+
+	/* the paths of a redundant slave decide on their own, from scratch */
+	if (bc->redundant) {
+		memset(&bc->paths[ptpClock->portIndex], 0, sizeof(RedundantPath));
+		return;
+	}
+
+	for (i = 0; i < bc->numberPorts; i++)
+		if (bc->ports[i] != ptpClock)
+			bc->ports[i]->record_update = TRUE;
+
+}
+
+/* the clock moves to another path of a redundant slave, servo and all */
+static void
+bcSwitchPath(BoundaryClock *bc, PtpClock *ptpClock, const char *reason)
+{
+
+	PtpClock *previous = bc->ports[bc->clockPort];
+	RedundantPath *from = &bc->paths[previous->portIndex];
+	RedundantPath *to = &bc->paths[ptpClock->portIndex];
+
+	/* the servo input carries on from where the previous path left it */
+	to->bias = to->mean - from->mean + from->bias;
+
+	ptpClock->servo = previous->servo;
+	ptpClock->drift_saved = previous->drift_saved;
+	ptpClock->last_saved_drift = previous->last_saved_drift;
+	ptpClock->holdover = previous->holdover;
+
+	bc->clockPort = ptpClock->portIndex;
+	bc->lastSwitch = bcNow();
+
+	NOTICE("Redundant slave: switching from %s to %s (%s), path bias %.0f ns\n",
+	       bc->portOpts[previous->portIndex]->ifaceName,
+	       bc->portOpts[ptpClock->portIndex]->ifaceName, reason, to->bias);
+
+}
+
+/* a path without offset samples for this long is considered down */
+static double
+bcStaleTime(const PtpClock *ptpClock)
+{
+
+	return REDUNDANT_STALE_SYNCS * pow(2, ptpClock->logSyncInterval);
+
+}
+
+/*
+ * A redundant path has a new offset sample: switch to it if the path
+ * disciplining the clock went quiet, or if its PDV is sufficiently lower.
+ */
+static void
+bcSelectPath(BoundaryClock *bc, PtpClock *ptpClock)
+{
+
+	RedundantPath *path = &bc->paths[ptpClock->portIndex];
+	RedundantPath *current;
+	double ratio = bc->portOpts[0]->redundantPdvRatio;
+
+	if (bc->clockPort < 0 || bc->clockPort == ptpClock->portIndex)
+		return;
+
+	if (ptpClock->portState != PTP_SLAVE || path->samples < REDUNDANT_MIN_SAMPLES)
+		return;
+
+	current = &bc->paths[bc->clockPort];
+
+	if (bc->ports[bc->clockPort]->portState != PTP_SLAVE ||
+	    path->lastSample - current->lastSample > bcStaleTime(bc->ports[bc->clockPort])) {
+		bcSwitchPath(bc, ptpClock, "no Sync on the selected path");
+		return;
+	}
+
+	if (current->samples < REDUNDANT_MIN_SAMPLES ||
+	    path->lastSample - bc->lastSwitch < REDUNDANT_HOLDOFF)
+		return;
+
+	if (path->variance < ratio * ratio * current->variance)
+		bcSwitchPath(bc, ptpClock, "lower PDV");
+
+}
+
+/**
+ * Feed the servo with a new offset from master. All paths of a redundant
+ * slave measure; only the selected one adjusts the clock, with its bias
+ * taken off the offset.
+ */
+void
+bcUpdateClock(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	BoundaryClock *bc = ptpClock->boundaryClock;
+	RedundantPath *path;
+	TimeInternal bias;
+	double offset, deviation;
+
+	if (bc == NULL || !bc->redundant) {
+		updateClock(rtOpts, ptpClock);
+		return;
+	}
+
+	path = &bc->paths[ptpClock->portIndex];
+	offset = timeInternalToDouble(&ptpClock->offsetFromMaster) * 1E9;
+
+	if (path->samples++ == 0) {
+		path->mean = offset;
+		path->variance = 0;
+	} else {
+		deviation = offset - path->mean;
+		path->mean += deviation / REDUNDANT_PDV_WEIGHT;
+		path->variance += (deviation * deviation - path->variance) /
+			REDUNDANT_PDV_WEIGHT;
+	}
+	path->lastSample = bcNow();
+
+	bcSelectPath(bc, ptpClock);
+
+	if (bcClockTaken(ptpClock))
+		return;
+
+	bias = doubleToTimeInternal(bc->paths[ptpClock->portIndex].bias / 1E9);
+	subTime(&ptpClock->offsetFromMaster, &ptpClock->offsetFromMaster, &bias);
+	datasetChanged(ptpClock, MGMT_CACHE_CURRENT_DS);
+	updateClock(rtOpts, ptpClock);
+
+}
+
+/**
+ * The path disciplining the clock of a redundant slave leaves the slave
+ * state: the best other path still in slave state carries on, if there is
+ * one, instead of the clock going into holdover. Runs before the path
+ * clears its servo.
+ */
+void
+bcPathFailover(PtpClock *ptpClock)
+{
+
+	BoundaryClock *bc = ptpClock->boundaryClock;
+	PtpClock *best = NULL;
+	int i;
+
+	if (bc == NULL || !bc->redundant || bc->clockPort != ptpClock->portIndex)
+		return;
+
+	for (i = 0; i < bc->numberPorts; i++) {
+		if (bc->ports[i] == ptpClock || bc->ports[i]->portState != PTP_SLAVE ||
+		    bc->paths[i].samples == 0)
+			continue;
+		if (best == NULL || bc->paths[i].variance < bc->paths[best->portIndex].variance)
+			best = bc->ports[i];
+	}
+
+	if (best != NULL)
+		bcSwitchPath(bc, best, "path down");
+
+}
+
+/* status file lines for the other ports */
+void
+bcStatus(const PtpClock *ptpClock, FILE *out)
+{
+
+	const BoundaryClock *bc = ptpClock->boundaryClock;
+	char name[16];
+	int i;
+
+	if (bc == NULL)
+		return;
+
+	if (bc->redundant) {
+		for (i = 0; i < bc->numberPorts; i++) {
+			snprintf(name, sizeof(name), "Path %d", i + 1);
+			fprintf(out, "%-19s:  %s, %s, offset %.0f ns, PDV %.0f ns%s\n",
+				name, bc->portOpts[i]->ifaceName,
+				portState_getName(bc->ports[i]->portState),
+				bc->paths[i].mean, sqrt(bc->paths[i].variance),
+				bc->clockPort == i ? " (clock)" : "");
+		}
+		return;
+	}
+
+	for (i = 1; i < bc->numberPorts; i++) {
+		snprintf(name, sizeof(name), "Port %d", i + 1);
+		fprintf(out, "%-19s:  %s, %s%s\n", name, bc->portOpts[i]->ifaceName,
+			portState_getName(bc->ports[i]->portState),
+			bc->clockPort == i ? " (clock)" : "");
+	}
+
+}
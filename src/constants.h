@@ -175,8 +175,12 @@ enum {
 #ifdef PTPD_NTPDC
   NTPD_CHECK_TIMER,
   NTPD_FAILOVER_TIMER,
+  NTPD_REPLY_TIMER,
 #endif
   MASTER_NETREFRESH_TIMER,
+  SNAPSHOT_TIMER,	   /* timer used for saving the warm start state snapshot */
+  HOLDOVER_UPDATE_TIMER,   /* timer used for applying the oscillator model in holdover */
+  PORT_FAULT_TIMER,	   /* timer used for retrying a faulty boundary clock port */
   TIMER_ARRAY_SIZE
 };
 
@@ -248,10 +252,27 @@ enum {
 
 	/* Reserved: 0x6002 - 0xBFFF */
 	/* Implementation-specific identifiers: 0xC000 - 0xDFFF */
+	MM_PTPD_COUNTERS=0xC000,
+	MM_PTPD_SERVO=0xC001,
+	MM_PTPD_SLAVE_STATS=0xC002,
+	MM_PTPD_CLEAR_COUNTERS=0xC003,
+	MM_PTPD_SLAVE_TABLE=0xC004,
+
 	/* Assigned by alternate PTP profile: 0xE000 - 0xFFFE */
 	/* Reserved: 0xFFFF */
 };
 
+/* PTPD_SERVO management TLV flags */
+#define PTPD_SERVO_RUNNING_MAX_OUTPUT	0x01
+#define PTPD_SERVO_STATS_CALCULATED	0x02
+#define PTPD_SERVO_STABLE		0x04
+
+/* PTPD_SLAVE_STATS management TLV flags */
+#define PTPD_STATS_CALCULATED		0x01
+#define PTPD_STATS_OWD_STABLE		0x02
+#define PTPD_STATS_DELAYMS_OUTLIER	0x04
+#define PTPD_STATS_DELAYSM_OUTLIER	0x08
+
 /**
  * \brief MANAGEMENT MESSAGE INITIALIZE (Table 44 in the spec)
  */
@@ -347,6 +368,36 @@ enum {
 	MANAGEMENT,
 };
 
+/* receive queue classes, drained in this order */
+enum {
+	RXQ_TIMING = 0,		/* event messages, Follow_Up, Delay_Resp, Pdelay_Resp_Follow_Up */
+	RXQ_BMC,		/* Announce, Signaling */
+	RXQ_MANAGEMENT,		/* Management and unknown message types */
+	RXQ_CLASSES
+};
+
+/* Datasets whose GET responses are cached, see managementCachedResponse() */
+enum {
+	MGMT_CACHE_DEFAULT_DS = 0,
+	MGMT_CACHE_CURRENT_DS,
+	MGMT_CACHE_PARENT_DS,
+	MGMT_CACHE_TIME_PROPERTIES_DS,
+	MGMT_CACHE_PORT_DS,
+	MGMT_CACHE_ENTRIES
+};
+
+/* Pre-built transmit messages, see msgPatch*() */
+enum {
+	TX_TEMPLATE_SYNC = 0,
+	TX_TEMPLATE_FOLLOW_UP,
+	TX_TEMPLATE_DELAY_REQ,
+	TX_TEMPLATE_DELAY_RESP,
+	TX_TEMPLATES
+};
+
+/* longest message built from a template */
+#define TX_TEMPLATE_LENGTH	DELAY_RESP_LENGTH
+
 /* communication technology */
 enum {
 	PTP_ETHER, PTP_DEFAULT
@@ -409,6 +409,42 @@ typedef struct {
 	#include "def/managementTLV/logMinPdelayReqInterval.def"
 } MMLogMinPdelayReqInterval;
 
+/**
+ * \brief Management TLV PTPd Counters fields (implementation specific)
+ */
+/* Management TLV PTPd Counters Message */
+typedef struct {
+	#define OPERATE( name, size, type ) type name;
+	#include "def/managementTLV/ptpdCounters.def"
+} MMPtpdCounters;
+
+/**
+ * \brief Management TLV PTPd Servo fields (implementation specific)
+ */
+/* Management TLV PTPd Servo Message */
+typedef struct {
+	#define OPERATE( name, size, type ) type name;
+	#include "def/managementTLV/ptpdServo.def"
+} MMPtpdServo;
+
+/**
+ * \brief Management TLV PTPd Slave Statistics fields (implementation specific)
+ */
+/* Management TLV PTPd Slave Statistics Message */
+typedef struct {
+	#define OPERATE( name, size, type ) type name;
+	#include "def/managementTLV/ptpdSlaveStats.def"
+} MMPtpdSlaveStats;
+
+/**
+ * \brief Management TLV PTPd Slave Table fields (implementation specific)
+ */
+/* Management TLV PTPd Slave Table Message */
+typedef struct {
+	#define OPERATE( name, size, type ) type name;
+	#include "def/managementTLV/ptpdSlaveTable.def"
+} MMPtpdSlaveTable;
+
 /**
  * \brief Management TLV Error Status fields (Table 71 of the spec)
  */
@@ -436,10 +472,17 @@ typedef struct {
 	Integer32 nanoseconds;
 } TimeInternal;
 
+/**
+* \brief Time interval in 2^-16 ns units - the correctionField / TimeInterval
+* format (see 5.3.2). Covers +/- 39 hours: delays, offsets and corrections,
+* not absolute time.
+ */
+typedef int64_t TimeScaled;
+
 /**
 * \brief Structure used as a timer
  */
-typedef struct {
+typedef struct IntervalTimer {
 	Integer32 interval;
 	Integer32 left;
 	Boolean expire;
@@ -491,6 +534,7 @@ typedef struct
 	uint32_t signalingMessagesReceived;
 	uint32_t managementMessagesSent;
 	uint32_t managementMessagesReceived;
+	uint32_t managementCacheHits;	/* dataset GET responses served without repacking */
 
 /* not implemented yet */
 #if 0
@@ -513,6 +557,7 @@ typedef struct
 	uint32_t ignoredAnnounce;	  /* ignored Announce messages: acl / security / preference */
 	uint32_t aclTimingDiscardedMessages;	  /* Timing messages discarded by access lists */
 	uint32_t aclManagementDiscardedMessages;	  /* Timing messages discarded by access lists */
+	uint32_t rateLimitDiscardedMessages;	  /* messages over the per-source rate limit */
 
 	/* error counters */
 	uint32_t messageRecvErrors;	  /* message receive errors */
@@ -524,13 +569,72 @@ typedef struct
 	uint32_t sequenceMismatchErrors;  /* mismatched sequence IDs - also increments discarded */
 	uint32_t delayModeMismatchErrors; /* P2P received, E2E expected or vice versa - incremets discarded */
 
-#ifdef PTPD_STATISTICS
+	/* outlier filters - only counted with statistics support, always present for PTPD_COUNTERS */
 	uint32_t delayMSOutliersFound;	  /* Number of outliers found by the delayMS filter */
 	uint32_t delaySMOutliersFound;	  /* Number of outliers found by the delaySM filter */
-#endif /* PTPD_STATISTICS */
 
 } PtpdCounters;
 
+/**
+* \brief Bump allocator for management message decode and encode, reset for every message
+ */
+typedef struct {
+	size_t used;
+	size_t highWater;	/* most memory used by a single message */
+	uint32_t failures;	/* allocations that did not fit */
+	uint64_t memory[MANAGEMENT_ARENA_SIZE / sizeof(uint64_t)];	/* 8-byte aligned */
+} ManagementArena;
+
+/**
+* \brief A packed dataset GET response and the dataset generation it was packed under
+ */
+typedef struct {
+	uint32_t generation;		/* datasetGeneration[] when the TLV was packed */
+	UInteger16 tlvLength;		/* 0: nothing cached yet */
+	Octet tlv[MANAGEMENT_CACHE_TLV_LENGTH];
+} ManagementCacheEntry;
+
+/**
+* \brief Everything the transmit templates are built from - templates are rebuilt when it changes
+ */
+typedef struct {
+	UInteger4 versionNumber;
+	UInteger8 domainNumber;
+	PortIdentity portIdentity;
+	Boolean twoStepFlag;
+	Integer8 logSyncInterval;
+	Integer8 logMinDelayReqInterval;
+	int transport;
+	int ipMode;
+} TxTemplateKey;
+
+/**
+* \brief A received message waiting to be processed
+ */
+typedef struct {
+	Octet buf[PACKET_SIZE];
+	ssize_t length;
+	TimeInternal timeStamp;
+	Integer32 sourceAddr;
+	TimeInternal queuedTime;	/* when the message was queued, for latency metrics */
+} RxQueueEntry;
+
+/**
+* \brief Per-class receive queue (ring buffer) and its metrics
+ */
+typedef struct {
+	RxQueueEntry entries[RXQ_CAPACITY];
+	int head;
+	int depth;
+	/* metrics */
+	int maxDepth;			/* queue depth high-water mark */
+	uint32_t queued;		/* messages queued */
+	uint32_t overflows;		/* messages dropped because the queue was full */
+	uint32_t processed;		/* messages taken off the queue */
+	uint64_t latencyTotal;		/* total queueing latency of processed messages, ns */
+	uint32_t latencyMax;		/* maximum queueing latency, ns */
+} RxQueue;
+
 /**
  * \struct PIservo
  * \brief PI controller model structure
@@ -560,6 +664,190 @@ typedef struct{
 #endif /* PTPD_STATISTICS */
 } PIservo;
 
+/**
+ * \struct Holdover
+ * \brief Local oscillator model and holdover state
+ *
+ * While the servo is locked, the observed drift is averaged over sample
+ * intervals and fitted with a line: drift(t) = frequency + aging * (t - modelTime).
+ * When the GM is lost, the model is extrapolated and applied to the clock.
+ * All times are CLOCK_MONOTONIC seconds.
+ */
+typedef struct {
+    /* model input */
+    double binStart;
+    double binSum;
+    int binCount;
+    double sampleTime[HOLDOVER_MAX_SAMPLES];
+    double sampleDrift[HOLDOVER_MAX_SAMPLES];
+    int sampleHead;
+    int sampleCount;
+    double lastError;		/* time error estimate at the last locked update, ns */
+    /* fitted model */
+    Boolean modelValid;
+    double modelTime;
+    double frequency;		/* ppb at modelTime */
+    double aging;		/* ppb per second */
+    double frequencyError;	/* std dev of the samples around the model, ppb */
+    double agingError;		/* std error of the aging estimate, ppb per second */
+    /* holdover */
+    Boolean active;
+    Boolean expired;		/* holdover timed out - clock free running */
+    double startTime;
+    double elapsed;
+    double initialError;	/* ns */
+    double errorBound;		/* ns */
+    double errorRate;		/* current error bound growth, ppb */
+    double appliedFrequency;	/* ppb */
+} Holdover;
+
+/**
+ * \struct StandbyMaster
+ * \brief Hot standby measurement of a backup master
+ *
+ * Offset and path delay to a non-parent master, measured from its
+ * multicast Syncs and its responses to our own Delay Requests and run
+ * through filters of its own, so that the servo can carry on from warm
+ * values when this master becomes the parent.
+ */
+typedef struct {
+    Boolean inUse;
+    PortIdentity portIdentity;
+    Filter * ofm_filt;
+    Filter * owd_filt;
+    /* two-step Sync waiting for its Follow_Up */
+    Boolean waitingForFollow;
+    UInteger16 syncSequenceId;
+    TimeInternal syncReceiveTime;
+    TimeScaled syncCorrectionField;
+    /* latest measurements */
+    Boolean haveSync;
+    TimeScaled delayMS;
+    TimeScaled delaySM;
+    TimeInternal meanPathDelay;
+    TimeInternal offsetFromMaster;
+    int delaySamples;
+    UInteger32 syncCount;
+    UInteger32 delayRespCount;
+    double lastUpdate;		/* CLOCK_MONOTONIC seconds */
+} StandbyMaster;
+
+/**
+ * \struct MonitorMaster
+ * \brief Passive monitor measurement of one master
+ *
+ * Offset of a master's Syncs against the local clock, with the announced
+ * UTC offset applied but no path delay (the monitor sends no Delay_Req), and its
+ * statistics over the last MONITOR_WINDOW Syncs. All offsets are in ns.
+ */
+typedef struct {
+    Boolean inUse;
+    UInteger8 domainNumber;
+    PortIdentity portIdentity;
+    /* last Announce */
+    MsgHeader announceHeader;
+    MsgAnnounce announce;
+    /* two-step Sync waiting for its Follow_Up */
+    Boolean waitingForFollow;
+    UInteger16 syncSequenceId;
+    TimeInternal syncReceiveTime;
+    TimeScaled syncCorrectionField;
+    Boolean haveSync;
+    UInteger16 lastSyncSequenceId;
+    Integer8 logSyncInterval;
+    /* offset samples */
+    double samples[MONITOR_WINDOW];
+    int sampleHead;
+    int sampleCount;
+    double offset;		/* last sample */
+    double mean;
+    double stdDev;		/* packet delay variation as seen by the monitor */
+    double min;
+    double max;
+    double relativeOffset;	/* mean offset against the domain's best master */
+    Boolean isReference;	/* this is the domain's best master */
+    /* counters */
+    UInteger32 announceCount;
+    UInteger32 syncCount;
+    UInteger32 followUpCount;
+    UInteger32 sequenceErrors;	/* gaps in the Sync sequence */
+    double firstSeen;		/* CLOCK_MONOTONIC seconds */
+    double lastSeen;
+    double lastLogged;
+} MonitorMaster;
+
+/**
+ * \struct SlaveRecord
+ * \brief Master-side record of one slave, built from its DelayReqs
+ *
+ * Slaves are keyed by port identity and source address. Interval and
+ * jitter are smoothed over SLAVE_INTERVAL_WEIGHT DelayReqs, in seconds.
+ */
+typedef struct {
+    Boolean inUse;
+    PortIdentity portIdentity;
+    Integer32 address;		/* network byte order, 0 with Ethernet transport */
+    /* hash chain (or free list) and LRU list links - indexes, -1 if none */
+    int32_t hashNext;
+    int32_t lruPrev;
+    int32_t lruNext;
+    TimeInternal lastReceiveTime;	/* DelayReq receive timestamp */
+    double firstSeen;		/* CLOCK_MONOTONIC seconds */
+    double lastSeen;
+    UInteger16 lastSequenceId;
+    double meanInterval;	/* smoothed DelayReq inter-arrival time */
+    double jitter;		/* smoothed deviation from meanInterval */
+    Boolean flooding;		/* faster than ptpengine:slave_flood_factor allows */
+    /* counters */
+    UInteger32 requests;
+    UInteger32 sequenceGaps;	/* DelayReqs lost between two received ones */
+    UInteger32 sequenceErrors;	/* duplicated, reordered or restarted sequence */
+    UInteger32 floodEvents;
+} SlaveRecord;
+
+/**
+ * \struct SlaveTable
+ * \brief Fixed-size table of slaves seen by a master
+ *
+ * Records have a hash index; when the table is full, the least recently
+ * seen slave is evicted, so memory stays bounded whatever the slave
+ * population.
+ */
+typedef struct {
+    int capacity;
+    int used;			/* records ever taken from the array */
+    int count;			/* records currently tracked */
+    int flooding;		/* tracked records currently flooding */
+    int hashSize;
+    int32_t *buckets;
+    SlaveRecord *records;
+    int32_t freeHead;		/* expired records, chained by hashNext */
+    int32_t lruHead;
+    int32_t lruTail;
+    int timeout;		/* seconds without DelayReq before a slave is dropped */
+    double lastExpiry;
+    /* counters */
+    UInteger32 evicted;
+    UInteger32 expired;
+    UInteger32 floodEvents;
+} SlaveTable;
+
+/**
+ * \struct SlaveTableTotals
+ * \brief Aggregates over the tracked slaves
+ */
+typedef struct {
+    int slaves;
+    int flooding;
+    UInteger32 sequenceGaps;
+    UInteger32 sequenceErrors;
+    double maxRate;		/* DelayReqs per second */
+    double maxJitter;		/* seconds */
+} SlaveTableTotals;
+
+struct BoundaryClock;
+struct DomainInstances;
+
 /**
  * \struct PtpClock
  * \brief Main program data structure
@@ -656,10 +944,26 @@ typedef struct {
 	} msgTmp;
 
 	MsgManagement outgoingManageTmp;
+	/* outgoingManageTmp.tlv - outside the arena, so there is always a TLV to answer with */
+	ManagementTLV outgoingManageTLV;
+	/* all other dynamic memory of msgTmp.manage and outgoingManageTmp */
+	ManagementArena managementArena;
+	/* last dataset GET responses */
+	ManagementCacheEntry managementCache[MGMT_CACHE_ENTRIES];
+	/* bumped by datasetChanged() on every write to the dataset */
+	uint32_t datasetGeneration[MGMT_CACHE_ENTRIES];
 
 	Octet msgObuf[PACKET_SIZE];
 	Octet msgIbuf[PACKET_SIZE];
 
+	/* received messages waiting to be processed, by priority */
+	RxQueue rxQueues[RXQ_CLASSES];
+
+	/* pre-built Sync, Follow_Up, Delay_Req and Delay_Resp messages */
+	Octet txTemplates[TX_TEMPLATES][TX_TEMPLATE_LENGTH];
+	TxTemplateKey txTemplateKey;
+	Boolean txTemplatesValid;
+
 /*
 	20110630: These variables were deprecated in favor of the ones that appear in the stats log (delayMS and delaySM)
 	
@@ -677,12 +981,14 @@ typedef struct {
 	TimeInternal  delay_req_receive_time;
 	MsgHeader		PdelayReqHeader;
 	MsgHeader		delayReqHeader;
-	TimeInternal	pdelayMS;
-	TimeInternal	pdelaySM;
-	TimeInternal	delayMS;
-	TimeInternal	delaySM;
-	TimeInternal  lastSyncCorrectionField;
-	TimeInternal  lastPdelayRespCorrectionField;
+	/* path components and corrections keep the sub-nanosecond part */
+	TimeScaled	pdelayMS;
+	TimeScaled	pdelaySM;
+	TimeScaled	delayMS;
+	TimeScaled	delaySM;
+	Boolean		delayMSOverflow; /* last Sync too far off for delayMS */
+	TimeScaled	lastSyncCorrectionField;
+	TimeScaled	lastPdelayRespCorrectionField;
 
 	Boolean  sentPDelayReq;
 	UInteger16  sentPDelayReqSequenceId;
@@ -698,6 +1004,20 @@ typedef struct {
 	Filter * ofm_filt;
 	Filter * owd_filt;
 
+	StandbyMaster standby[STANDBY_MAX_MASTERS];
+
+	MonitorMaster *monitor;
+	int monitorCapacity;
+
+	SlaveTable *slaveTable;
+
+	/* boundary clock this port belongs to, NULL for an ordinary clock */
+	struct BoundaryClock *boundaryClock;
+	int portIndex; /* position in the boundary clock, port 1 is 0 */
+	/* engines for other domains sharing our sockets, NULL if none */
+	struct DomainInstances *domainInstances;
+	int domainIndex; /* 0 for ptpengine:domain, which disciplines the clock */
+
 	Boolean message_activity;
 
 	IntervalTimer  itimer[TIMER_ARRAY_SIZE];
@@ -744,6 +1064,7 @@ typedef struct {
 
 	/* PI servo model */
 	PIservo servo;
+	Holdover holdover;
 
 	/* "panic mode" support */
 	Boolean panicMode; /* in panic mode - do not update clock or calculate offsets */
@@ -781,6 +1102,23 @@ typedef struct {
 	NTPcontrol ntpControl;
 #endif
 
+	/* NTP SHM refclock output (measurement-only mode) */
+	NtpShm ntpShm;
+
+	/* built-in NTP server */
+	NtpServer ntpServer;
+
+	/* local control and telemetry socket */
+	CtlSocket ctlSocket;
+
+	/* warm start state snapshot, applied once on entering SLAVE state */
+	PtpdSnapshot warmStart;
+	Boolean warmStartPending;
+
+	/* shared memory clock parameter page, NULL if not published */
+	PtpdClockPage *clockPage;
+	char clockPageFile[PATH_MAX]; /* where the page was created - unlinked on shutdown */
+
 } PtpClock;
 
 /**
@@ -861,6 +1199,53 @@ typedef struct {
 
 	int statusFileUpdateInterval;
 
+	Boolean ntpShmEnabled; /* measurement-only mode: post offsets to NTP SHM */
+	int ntpShmUnit; /* NTP SHM refclock unit number */
+
+	Boolean ntpServerEnabled; /* answer NTP client requests from the PTP clock */
+	int ntpServerPort; /* NTP server UDP port */
+	char ntpServerAddress[MAXHOSTNAMELEN]; /* NTP server bind address, empty = any */
+
+	Boolean clockPageEnabled; /* publish the shared memory clock page */
+	char clockPageFile[PATH_MAX]; /* clock page file location */
+
+	Boolean controlSocketEnabled; /* serve local clients on the control socket */
+	char controlSocketFile[PATH_MAX]; /* control socket location */
+
+	Boolean snapshotEnabled; /* save and restore the warm start state snapshot */
+	char snapshotFile[PATH_MAX]; /* state snapshot location */
+	int snapshotInterval; /* state snapshot save interval in seconds */
+	int snapshotMaxAge; /* state snapshot validity in seconds */
+
+	Boolean holdoverEnabled; /* apply the oscillator model when the GM is lost */
+	int holdoverSampleInterval; /* oscillator model sample interval in seconds */
+	int holdoverTimeout; /* maximum holdover duration in seconds, 0 - unlimited */
+
+	int standbyMasters; /* number of backup masters measured in hot standby */
+
+	Boolean monitorMode; /* passive multi-master monitor - never touches the clock */
+	char monitorDomainsText[PATH_MAX]; /* monitored domains as configured */
+	Octet monitorDomains[32]; /* monitored domains, one bit per domain number */
+	int monitorCapacity; /* maximum number of monitored masters */
+	int monitorTimeout; /* seconds without Announce before a master is dropped */
+
+	Boolean slaveTableEnabled; /* track slaves from their DelayReqs when master */
+	int slaveTableSize; /* maximum number of tracked slaves */
+	int slaveTimeout; /* seconds without DelayReq before a slave is dropped */
+	double slaveFloodFactor; /* DelayReq rate over the advertised one that counts as flooding */
+
+	char bcInterfacesText[PATH_MAX]; /* boundary clock ports other than ptpengine:interface */
+	char bcInterfaces[BC_MAX_PORTS - 1][IFACE_NAME_LENGTH];
+	int bcPortCount; /* number of additional boundary clock ports */
+	char redundantInterface[IFACE_NAME_LENGTH]; /* second path to the same GM, slave only */
+	double redundantPdvRatio; /* switch paths when the other one's PDV is below this share */
+	Boolean bcRedundant; /* the second port is a redundant slave path */
+
+	char domainInstancesText[PATH_MAX]; /* domains other than ptpengine:domain */
+	UInteger8 domainInstanceNumbers[DOMAIN_MAX_INSTANCES - 1];
+	Boolean domainInstanceServe[DOMAIN_MAX_INSTANCES - 1]; /* master, not monitor */
+	int domainInstanceCount; /* number of additional domain instances */
+
 	Boolean ignore_daemon_lock;
 	Boolean do_IGMP_refresh;
 	Boolean  nonDaemon;
@@ -953,8 +1338,57 @@ typedef struct {
 	int timingAclOrder;
 	int managementAclOrder;
 
+	/* low priority messages processed per main loop pass */
+	int rxBudgetBmc;
+	int rxBudgetManagement;
+
+	/* kernel / pcap filtering of foreign PTP traffic */
+	Boolean kernelFilter;
+	Boolean kernelFilterParent;
+
+	/* Per-source rate limiting */
+	Boolean rateLimitEnabled;
+	int rateLimitSources;
+	int rateLimitRates[RATELIMIT_CLASSES];
+
 } RunTimeOpts;
 
+/**
+ * \struct RedundantPath
+ * \brief Offset statistics of one path of a redundant slave
+ */
+typedef struct {
+	int samples;
+	double mean;		/* smoothed offset from master, ns */
+	double variance;	/* smoothed variance around it, ns^2 */
+	double bias;		/* subtracted from the offset fed to the servo, ns */
+	double lastSample;	/* monotonic time of the last offset sample */
+} RedundantPath;
+
+/**
+ * \struct BoundaryClock
+ * \brief Ports of a boundary clock, all run from the main loop
+ */
+typedef struct BoundaryClock {
+	int numberPorts;
+	PtpClock *ports[BC_MAX_PORTS];
+	RunTimeOpts *portOpts[BC_MAX_PORTS]; /* port 1 uses the global options */
+	int clockPort; /* port disciplining the clock, -1 if none so far */
+	Boolean redundant; /* two slave paths to the same GM, not a boundary clock */
+	RedundantPath paths[BC_MAX_PORTS];
+	double lastSwitch; /* monotonic time of the last path switch */
+} BoundaryClock;
+
+/**
+ * \struct DomainInstances
+ * \brief Engines for several domains over one set of sockets
+ */
+typedef struct DomainInstances {
+	int count;
+	PtpClock *instances[DOMAIN_MAX_INSTANCES];
+	RunTimeOpts *instanceOpts[DOMAIN_MAX_INSTANCES]; /* ptpengine:domain uses the global options */
+} DomainInstances;
+
 
 
 #endif /*DATATYPES_H_*/
@@ -0,0 +1,213 @@
+/*-
+ * Copyright (c) 2014 Wojciech Owczarek,
+ *
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file   clockpage.c
+ *
+ * @brief  Shared memory clock parameter page (writer side)
+ *
+ * Publishes the servo state to a memory-mapped file after every clock
+ * update. See clockpage.h for the page layout and the client reader.
+ */
+
+#include "../ptpd.h"
+
+#include <sys/mman.h>
+
+/* Work out the lock state to publish from the current port and servo state */
+static uint32_t
+clockPageLockState(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	uint32_t previous = ptpClock->clockPage->lockState;
+
+	if(ptpClock->portState != PTP_SLAVE || ptpClock->panicMode) {
+		if(ptpClock->holdover.active)
+			return PTPD_CLOCKPAGE_HOLDOVER;
+		if(ptpClock->holdover.expired)
+			return PTPD_CLOCKPAGE_FREERUN;
+		if(previous == PTPD_CLOCKPAGE_LOCKED ||
+		    previous == PTPD_CLOCKPAGE_HOLDOVER)
+			return PTPD_CLOCKPAGE_HOLDOVER;
+		return PTPD_CLOCKPAGE_FREERUN;
+	}
+
+	if(ptpClock->offsetFromMaster.seconds || ptpClock->servo.runningMaxOutput)
+		return PTPD_CLOCKPAGE_TRACKING;
+
+#ifdef PTPD_STATISTICS
+	if(rtOpts->servoStabilityDetection && !ptpClock->servo.isStable)
+		return PTPD_CLOCKPAGE_TRACKING;
+#endif /* PTPD_STATISTICS */
+
+	return PTPD_CLOCKPAGE_LOCKED;
+
+}
+
+Boolean
+clockPageInit(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	int fd;
+	void *map;
+
+	if(ptpClock->clockPage != NULL)
+		clockPageShutdown(rtOpts, ptpClock);
+
+	if((fd = open(rtOpts->clockPageFile, O_RDWR | O_CREAT, DEFAULT_FILE_PERMS)) < 0) {
+		PERROR("Could not open clock page file %s", rtOpts->clockPageFile);
+		return FALSE;
+	}
+
+	if(ftruncate(fd, sizeof(PtpdClockPage)) < 0) {
+		PERROR("Could not size clock page file %s", rtOpts->clockPageFile);
+		close(fd);
+		return FALSE;
+	}
+
+	map = mmap(NULL, sizeof(PtpdClockPage), PROT_READ | PROT_WRITE,
+		    MAP_SHARED, fd, 0);
+	/* the mapping stays valid after the descriptor is closed */
+	close(fd);
+
+	if(map == MAP_FAILED) {
+		PERROR("Could not map clock page file %s", rtOpts->clockPageFile);
+		return FALSE;
+	}
+
+	ptpClock->clockPage = (PtpdClockPage*)map;
+	strncpy(ptpClock->clockPageFile, rtOpts->clockPageFile, PATH_MAX);
+
+	/* readers see an odd sequence until the header is complete */
+	ptpClock->clockPage->sequence |= 1;
+	PTPD_CLOCKPAGE_BARRIER();
+	memset((char*)ptpClock->clockPage + offsetof(PtpdClockPage, lockState), 0,
+		sizeof(PtpdClockPage) - offsetof(PtpdClockPage, lockState));
+	ptpClock->clockPage->magic = PTPD_CLOCKPAGE_MAGIC;
+	ptpClock->clockPage->version = PTPD_CLOCKPAGE_VERSION;
+	ptpClock->clockPage->lockState = PTPD_CLOCKPAGE_INVALID;
+	ptpClock->clockPage->errorRatePpb = CLOCKPAGE_ERROR_RATE_PPB;
+	PTPD_CLOCKPAGE_BARRIER();
+	ptpClock->clockPage->sequence++;
+
+	INFO("Publishing clock parameters in %s\n", rtOpts->clockPageFile);
+
+	return TRUE;
+
+}
+
+void
+clockPageShutdown(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	if(ptpClock->clockPage == NULL)
+		return;
+
+	/* leave the page marked invalid for any readers still mapping it */
+	ptpClock->clockPage->sequence++;
+	PTPD_CLOCKPAGE_BARRIER();
+	ptpClock->clockPage->lockState = PTPD_CLOCKPAGE_INVALID;
+	PTPD_CLOCKPAGE_BARRIER();
+	ptpClock->clockPage->sequence++;
+
+	munmap(ptpClock->clockPage, sizeof(PtpdClockPage));
+	ptpClock->clockPage = NULL;
+	unlink(ptpClock->clockPageFile);
+
+}
+
+/**
+ * Refresh the page. With newSample set, the reference timestamp and
+ * the offset / delay / frequency estimates are replaced with the values
+ * from the last servo run; otherwise only the state fields are updated
+ * and the error bound keeps growing from the previous reference.
+ */
+void
+clockPageUpdate(RunTimeOpts *rtOpts, PtpClock *ptpClock, Boolean newSample)
+{
+
+	PtpdClockPage *page = ptpClock->clockPage;
+	TimeInternal now;
+	TimeInternal *delay;
+	double errorBound;
+
+	if(page == NULL)
+		return;
+
+	delay = (ptpClock->delayMechanism == P2P) ?
+		&ptpClock->peerMeanPathDelay : &ptpClock->meanPathDelay;
+
+	if(newSample || ptpClock->holdover.active)
+		getTime(&now);
+
+	page->sequence++;
+	PTPD_CLOCKPAGE_BARRIER();
+
+	if(newSample) {
+		page->refSeconds = now.seconds;
+		page->refNanoseconds = now.nanoseconds;
+		page->offsetNs = ptpClock->offsetFromMaster.seconds * 1000000000LL +
+				    ptpClock->offsetFromMaster.nanoseconds;
+		page->meanPathDelayNs = delay->seconds * 1000000000LL +
+				    delay->nanoseconds;
+		page->frequencyPpb = ptpClock->servo.observedDrift;
+
+		/*
+		 * Worst case: the whole path delay is asymmetric, plus the
+		 * measurement noise - the offset std dev if we have it.
+		 */
+		errorBound = fabs((double)page->meanPathDelayNs);
+#ifdef PTPD_STATISTICS
+		if(ptpClock->slaveStats.statsCalculated)
+			errorBound += 3 * ptpClock->slaveStats.ofmStdDev * 1E9;
+		else
+#endif /* PTPD_STATISTICS */
+			errorBound += fabs((double)page->offsetNs);
+		page->errorBoundNs = errorBound;
+		page->errorRatePpb = ptpClock->servo.runningMaxOutput ?
+			rtOpts->servoMaxPpb : CLOCKPAGE_ERROR_RATE_PPB;
+	} else if(ptpClock->holdover.active) {
+		/* no offset measurements - the holdover model provides the bound */
+		page->refSeconds = now.seconds;
+		page->refNanoseconds = now.nanoseconds;
+		page->offsetNs = 0;
+		page->frequencyPpb = ptpClock->holdover.appliedFrequency;
+		page->errorBoundNs = ptpClock->holdover.errorBound;
+		page->errorRatePpb = ptpClock->holdover.errorRate;
+	}
+
+	page->lockState = clockPageLockState(rtOpts, ptpClock);
+	page->portState = ptpClock->portState;
+	page->stepsRemoved = ptpClock->stepsRemoved;
+	memcpy(page->grandmasterIdentity, ptpClock->grandmasterIdentity,
+		sizeof(page->grandmasterIdentity));
+	page->updateCount++;
+
+	PTPD_CLOCKPAGE_BARRIER();
+	page->sequence++;
+
+}
@@ -0,0 +1,152 @@
+/**
+ * @file   clockpage.h
+ *
+ * @brief  Shared memory clock parameter page layout and client reader
+ *
+ * The clock page is a small memory-mapped file published by ptpd2,
+ * holding the most recent servo state: a CLOCK_REALTIME reference
+ * timestamp, the offset and frequency estimates, an error bound and
+ * the lock state. The daemon updates it with a sequence lock after
+ * every clock update, so local applications can obtain PTP time plus
+ * a confidence bound without a system call or IPC round trip.
+ *
+ * This header is self-contained and can be copied into client
+ * applications: it only depends on the C library. A client maps the
+ * page read-only and uses ptpdClockPageRead() / ptpdClockPageGetTime():
+ *
+ *	int fd = open("/var/run/ptpd2.clockpage", O_RDONLY);
+ *	PtpdClockPage *page = mmap(NULL, sizeof(PtpdClockPage),
+ *				PROT_READ, MAP_SHARED, fd, 0);
+ *	struct timespec ts;
+ *	double bound;
+ *	if(ptpdClockPageGetTime(page, &ts, &bound) == PTPD_CLOCKPAGE_LOCKED)
+ *		...
+ */
+
+#ifndef PTPD_CLOCKPAGE_H_
+#define PTPD_CLOCKPAGE_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#define PTPD_CLOCKPAGE_MAGIC	0x50545043	/* "PTPC" */
+#define PTPD_CLOCKPAGE_VERSION	1
+
+/* Default location - same directory as the lock and status files */
+#define PTPD_CLOCKPAGE_DEFAULT_PATH	"/var/run/ptpd2.clockpage"
+
+/* Lock state as published on the page */
+enum {
+	PTPD_CLOCKPAGE_INVALID = 0,	/* page not (yet) valid or daemon gone */
+	PTPD_CLOCKPAGE_FREERUN,		/* no master - clock not disciplined */
+	PTPD_CLOCKPAGE_TRACKING,	/* slave, servo still converging */
+	PTPD_CLOCKPAGE_LOCKED,		/* slave, servo locked */
+	PTPD_CLOCKPAGE_HOLDOVER		/* was locked, lost the master */
+};
+
+/*
+ * Page layout: fixed-width fields only, 64-bit members naturally aligned
+ * so that 32- and 64-bit readers agree. Any layout change must bump
+ * PTPD_CLOCKPAGE_VERSION.
+ */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t sequence;		/* odd while the writer is updating */
+	uint32_t lockState;
+	int64_t refSeconds;		/* CLOCK_REALTIME when offset was measured */
+	int64_t refNanoseconds;
+	int64_t offsetNs;		/* offset from master (local - master) */
+	int64_t meanPathDelayNs;
+	double frequencyPpb;		/* current frequency adjustment */
+	double errorBoundNs;		/* max. error at the reference time */
+	double errorRatePpb;		/* error bound growth since reference */
+	uint32_t portState;		/* PTP port state */
+	uint32_t stepsRemoved;
+	uint8_t grandmasterIdentity[8];
+	uint32_t updateCount;		/* number of completed updates */
+	uint32_t reserved[7];
+} PtpdClockPage;
+
+/* Full barrier: orders page accesses against the sequence counter */
+#define PTPD_CLOCKPAGE_BARRIER() __sync_synchronize()
+
+/*
+ * Attempts at a consistent snapshot before giving up. An update takes
+ * well under a microsecond, so this only runs out when the writer died
+ * in the middle of one and left the sequence odd.
+ */
+#define PTPD_CLOCKPAGE_READ_RETRIES	100000
+
+/**
+ * Take a consistent snapshot of the page. Returns 0 on success,
+ * -1 if the page is not a valid ptpd2 clock page, -2 if no consistent
+ * snapshot could be taken within PTPD_CLOCKPAGE_READ_RETRIES attempts
+ * (page stuck mid-update - the daemon is probably gone).
+ */
+static inline int
+ptpdClockPageRead(const volatile PtpdClockPage *page, PtpdClockPage *snapshot)
+{
+	uint32_t seq;
+	int retries;
+
+	if(page == NULL || snapshot == NULL)
+		return -1;
+
+	for(retries = 0; ; retries++) {
+		if(retries == PTPD_CLOCKPAGE_READ_RETRIES)
+			return -2;
+		seq = page->sequence;
+		PTPD_CLOCKPAGE_BARRIER();
+		if(seq & 1)
+			continue;
+		*snapshot = *(const PtpdClockPage *)page;
+		PTPD_CLOCKPAGE_BARRIER();
+		if(page->sequence == seq)
+			break;
+	}
+
+	if(snapshot->magic != PTPD_CLOCKPAGE_MAGIC ||
+	    snapshot->version != PTPD_CLOCKPAGE_VERSION)
+		return -1;
+
+	return 0;
+}
+
+/**
+ * Read CLOCK_REALTIME and correct it using the last published offset.
+ * The error bound (in ns) grows with the time elapsed since the
+ * reference timestamp. Returns the lock state (PTPD_CLOCKPAGE_INVALID
+ * if the page can't be used or is stuck mid-update, in which case *ts
+ * is the uncorrected time).
+ */
+static inline int
+ptpdClockPageGetTime(const volatile PtpdClockPage *page, struct timespec *ts,
+		     double *errorBound)
+{
+	PtpdClockPage snap;
+	int64_t now, ref, elapsed;
+
+	if(clock_gettime(CLOCK_REALTIME, ts) != 0)
+		return PTPD_CLOCKPAGE_INVALID;
+
+	if(ptpdClockPageRead(page, &snap) != 0)
+		return PTPD_CLOCKPAGE_INVALID;
+
+	now = (int64_t)ts->tv_sec * 1000000000LL + ts->tv_nsec;
+	ref = snap.refSeconds * 1000000000LL + snap.refNanoseconds;
+	elapsed = now - ref;
+	if(elapsed < 0)
+		elapsed = -elapsed;
+
+	now -= snap.offsetNs;
+	ts->tv_sec = now / 1000000000LL;
+	ts->tv_nsec = now % 1000000000LL;
+
+	if(errorBound != NULL)
+		*errorBound = snap.errorBoundNs + elapsed * snap.errorRatePpb / 1E9;
+
+	return snap.lockState;
+}
+
+#endif /* PTPD_CLOCKPAGE_H_ */
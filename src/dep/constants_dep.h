@@ -93,6 +93,19 @@ if it's POSIX compatible, if you succeed, report it to ptpd-devel@sourceforge.ne
 	    sizeof(struct udphdr))
 #define PACKET_BEGIN_ETHER (ETHER_HDR_LEN)
 
+/* messages held per receive queue class - while a queue is full, its sockets are not read */
+#define RXQ_CAPACITY 64
+
+/*
+ * management message arena: holds one decoded message and its response.
+ * Variable-length fields are capped at PACKET_SIZE, so the worst case
+ * (CLOCK_DESCRIPTION in and out) stays well below this
+ */
+#define MANAGEMENT_ARENA_SIZE 4096
+
+/* largest cached dataset GET response TLV, type and length fields included */
+#define MANAGEMENT_CACHE_TLV_LENGTH 64
+
 #define PTP_EVENT_PORT    319
 #define PTP_GENERAL_PORT  320
 
@@ -120,6 +133,74 @@ if it's POSIX compatible, if you succeed, report it to ptpd-devel@sourceforge.ne
 /* default status file location */
 #define DEFAULT_STATUSFILE DEFAULT_LOCKDIR"/"PTPD_PROGNAME".status"
 
+/* default clock page location */
+#define DEFAULT_CLOCKPAGEFILE DEFAULT_LOCKDIR"/"PTPD_PROGNAME".clockpage"
+#define DEFAULT_CTLSOCKETFILE DEFAULT_LOCKDIR"/"PTPD_PROGNAME".sock"
+#define DEFAULT_SNAPSHOTFILE DEFAULT_LOCKDIR"/"PTPD_PROGNAME".state"
+/* clock page error bound growth when not free running: 15 PPM, like NTP's PHI */
+#define CLOCKPAGE_ERROR_RATE_PPB 15000
+
+/*
+ * holdover: oscillator model history length, minimum history for a usable
+ * model, update interval (seconds) and error bound confidence (sigmas)
+ */
+#define HOLDOVER_MAX_SAMPLES 64
+#define HOLDOVER_MIN_SAMPLES 3
+#define HOLDOVER_UPDATE_INTERVAL 1
+#define HOLDOVER_SIGMA 3.0
+
+/*
+ * hot standby: maximum number of backup masters measured, delay samples
+ * before a backup master is considered warm, and the minimum time
+ * (seconds) without updates before its measurements are considered stale
+ */
+#define STANDBY_MAX_MASTERS 4
+#define STANDBY_MIN_DELAY_SAMPLES 4
+#define STANDBY_MIN_STALE_TIME 30
+
+/* passive monitor: offset statistics window (Syncs) and maximum table size */
+#define MONITOR_WINDOW 64
+#define MONITOR_MAX_CAPACITY 256
+
+/*
+ * master-side slave table: hash buckets per record, smoothing weight of
+ * the DelayReq interval and jitter estimates, DelayReqs before a slave
+ * can be judged as flooding, and the largest sequence jump still counted
+ * as lost DelayReqs rather than a slave restart
+ */
+#define SLAVE_TABLE_HASH_LOAD 2
+#define SLAVE_TABLE_MAX_CAPACITY 65536
+#define SLAVE_INTERVAL_WEIGHT 16
+#define SLAVE_MIN_REQUESTS 8
+#define SLAVE_MAX_SEQUENCE_GAP 1024
+/* a flooding slave must slow down this much further to be cleared */
+#define SLAVE_FLOOD_HYSTERESIS 1.25
+
+/*
+ * boundary clock: maximum number of ports, including ptpengine:interface,
+ * and the interval (seconds) at which a faulty port other than port 1
+ * is re-initialised
+ */
+#define BC_MAX_PORTS 8
+#define BC_FAULT_RETRY_INTERVAL 5
+
+/*
+ * redundant slave: smoothing weight of the per-path offset and PDV
+ * estimates, samples before a path can be selected, Sync intervals
+ * without a sample before a path is considered down, and the minimum
+ * time (seconds) between two switches on PDV alone
+ */
+#define REDUNDANT_PDV_WEIGHT 16
+#define REDUNDANT_MIN_SAMPLES 16
+#define REDUNDANT_STALE_SYNCS 4
+#define REDUNDANT_HOLDOFF 10
+
+/* domain instances: maximum number of domains, including ptpengine:domain */
+#define DOMAIN_MAX_INSTANCES 8
+
+/* timer arrays sharing the tick counter: every engine instance in the process */
+#define TIMER_MAX_SETS 8
+
 /* Highest log level (default) catches all */
 #define LOG_ALL LOG_DEBUGV
 
@@ -159,6 +240,15 @@ enum {
 
 #define NANOSECONDS_MAX 999999999
 
+/* TimeScaled units per nanosecond */
+#define TIME_SCALED_NS 65536
+/*
+ * largest difference of two time values (seconds) taken as TimeScaled:
+ * the type holds +-2^47 ns (about 39 h), and a sum of two differences
+ * has to fit as well
+ */
+#define TIME_SCALED_MAX_SECONDS 65536
+
 // limit operator messages to once every X seconds
 #define OPERATOR_MESSAGES_INTERVAL 300.0
 
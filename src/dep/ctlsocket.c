@@ -0,0 +1,681 @@
+/*-
+ * Copyright (c) 2014 Wojciech Owczarek,
+ *
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file   ctlsocket.c
+ *
+ * @brief  Local control and telemetry over a Unix domain socket
+ *
+ * Local tools connect to a stream socket and send one request per line;
+ * every reply is a single line of name=value pairs, prefixed with what
+ * was asked for:
+ *
+ *	get default|current|parent|timeproperties|port|counters|servo
+ *	get monitor|slaves [first]
+ *	subscribe servo|state|monitor
+ *	unsubscribe servo|state|monitor|all
+ *	help
+ *
+ * Subscribed clients additionally receive a "servo" line after every
+ * clock update, a "state" line on every port state change and, in
+ * monitor mode, a "monitor" line for every measured Sync. The only
+ * multi-line replies are "get monitor": a "monitor" line for up to
+ * CTLSOCKET_MONITOR_LINES masters from monitor slot [first], closed by
+ * a "monitor end" line, and "get slaves": a "slave" line for up to
+ * CTLSOCKET_SLAVE_LINES tracked slaves from table slot [first], closed
+ * by a "slaves end" line. Both end lines give the slot to ask for next,
+ * 0 once everything has been listed, so a reply always fits the output
+ * buffer.
+ *
+ * All sockets are non-blocking and served from the main loop. Output
+ * is queued in a fixed buffer per client and written as the client
+ * reads it: stream lines that do not fit are dropped and counted, and
+ * a client that cannot take a reply is disconnected, so a slow reader
+ * never holds up the daemon.
+ */
+
+#include "../ptpd.h"
+
+#include <sys/un.h>
+
+static int64_t
+ctlSocketNs(const TimeInternal *time)
+{
+	return (int64_t)time->seconds * 1000000000LL + time->nanoseconds;
+}
+
+/* Append to an output line, silently truncating at CTLSOCKET_MAX_LINE */
+static void
+ctlSocketAppend(char *line, int *len, const char *format, ...)
+{
+	va_list ap;
+	int ret;
+
+	if(*len >= CTLSOCKET_MAX_LINE - 1)
+		return;
+
+	va_start(ap, format);
+	ret = vsnprintf(line + *len, CTLSOCKET_MAX_LINE - 1 - *len, format, ap);
+	va_end(ap);
+
+	if(ret > 0)
+		*len += ret;
+	if(*len > CTLSOCKET_MAX_LINE - 2)
+		*len = CTLSOCKET_MAX_LINE - 2;
+}
+
+static void
+ctlSocketAppendClockIdentity(char *line, int *len, const char *name, const ClockIdentity id)
+{
+	ctlSocketAppend(line, len, " %s=%02x%02x%02x%02x%02x%02x%02x%02x", name,
+		(unsigned char)id[0], (unsigned char)id[1], (unsigned char)id[2], (unsigned char)id[3],
+		(unsigned char)id[4], (unsigned char)id[5], (unsigned char)id[6], (unsigned char)id[7]);
+}
+
+static void
+ctlSocketAppendPortIdentity(char *line, int *len, const char *name, const PortIdentity *id)
+{
+	ctlSocketAppendClockIdentity(line, len, name, id->clockIdentity);
+	ctlSocketAppend(line, len, "/%d", id->portNumber);
+}
+
+static void
+ctlSocketClose(CtlSocket *ctl, CtlSocketClient *client)
+{
+	close(client->fd);
+	client->fd = -1;
+	client->inLength = 0;
+	client->outLength = 0;
+	client->subscriptions = 0;
+	(void)ctl;
+}
+
+/* Write out as much queued output as the client takes without blocking */
+static void
+ctlSocketFlush(CtlSocket *ctl, CtlSocketClient *client)
+{
+	ssize_t ret;
+
+	while(client->fd >= 0 && client->outLength > 0) {
+		ret = send(client->fd, client->out, client->outLength, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if(ret < 0) {
+			if(errno == EINTR)
+				continue;
+			if(errno != EAGAIN && errno != EWOULDBLOCK)
+				ctlSocketClose(ctl, client);
+			return;
+		}
+		client->outLength -= ret;
+		memmove(client->out, client->out + ret, client->outLength);
+	}
+}
+
+/*
+ * Queue a line for a client. A stream line that does not fit is dropped,
+ * a reply that does not fit costs the client its connection.
+ */
+static void
+ctlSocketQueue(CtlSocket *ctl, CtlSocketClient *client, char *line, int len, Boolean stream)
+{
+	line[len++] = '\n';
+
+	if(client->outLength + len > CTLSOCKET_OUTBUF) {
+		if(stream) {
+			client->droppedLines++;
+			ctl->droppedLines++;
+		} else {
+			DBG("Control socket client not reading replies - disconnecting\n");
+			ctl->disconnected++;
+			ctlSocketClose(ctl, client);
+		}
+		return;
+	}
+
+	memcpy(client->out + client->outLength, line, len);
+	client->outLength += len;
+}
+
+static void
+ctlSocketGet(const char *what, char *line, int *len, PtpClock *ptpClock)
+{
+
+	PIservo *servo = &ptpClock->servo;
+
+	if(!strcmp(what, "default")) {
+		ctlSocketAppend(line, len, "default");
+		ctlSocketAppendClockIdentity(line, len, "clockIdentity", ptpClock->clockIdentity);
+		ctlSocketAppend(line, len, " numberPorts=%d twoStepFlag=%d slaveOnly=%d"
+			" clockClass=%d clockAccuracy=0x%02x offsetScaledLogVariance=0x%04x"
+			" priority1=%d priority2=%d domainNumber=%d",
+			ptpClock->numberPorts, ptpClock->twoStepFlag, ptpClock->slaveOnly,
+			ptpClock->clockQuality.clockClass, ptpClock->clockQuality.clockAccuracy,
+			ptpClock->clockQuality.offsetScaledLogVariance,
+			ptpClock->priority1, ptpClock->priority2, ptpClock->domainNumber);
+	} else if(!strcmp(what, "current")) {
+		ctlSocketAppend(line, len, "current stepsRemoved=%d offsetFromMaster=%lld meanPathDelay=%lld",
+			ptpClock->stepsRemoved,
+			(long long)ctlSocketNs(&ptpClock->offsetFromMaster),
+			(long long)ctlSocketNs(&ptpClock->meanPathDelay));
+	} else if(!strcmp(what, "parent")) {
+		ctlSocketAppend(line, len, "parent");
+		ctlSocketAppendPortIdentity(line, len, "parentPortIdentity", &ptpClock->parentPortIdentity);
+		ctlSocketAppend(line, len, " parentStats=%d observedParentOffsetScaledLogVariance=0x%04x"
+			" observedParentClockPhaseChangeRate=%d",
+			ptpClock->parentStats, ptpClock->observedParentOffsetScaledLogVariance,
+			ptpClock->observedParentClockPhaseChangeRate);
+		ctlSocketAppendClockIdentity(line, len, "grandmasterIdentity", ptpClock->grandmasterIdentity);
+		ctlSocketAppend(line, len, " grandmasterClockClass=%d grandmasterClockAccuracy=0x%02x"
+			" grandmasterOffsetScaledLogVariance=0x%04x"
+			" grandmasterPriority1=%d grandmasterPriority2=%d",
+			ptpClock->grandmasterClockQuality.clockClass,
+			ptpClock->grandmasterClockQuality.clockAccuracy,
+			ptpClock->grandmasterClockQuality.offsetScaledLogVariance,
+			ptpClock->grandmasterPriority1, ptpClock->grandmasterPriority2);
+	} else if(!strcmp(what, "timeproperties")) {
+		ctlSocketAppend(line, len, "timeproperties");
+		#define OPERATE( name, size, type ) \
+			ctlSocketAppend(line, len, " " #name "=%d", (int)ptpClock->timePropertiesDS.name);
+		#include "../def/derivedData/timePropertiesDS.def"
+	} else if(!strcmp(what, "port")) {
+		ctlSocketAppend(line, len, "port");
+		ctlSocketAppendPortIdentity(line, len, "portIdentity", &ptpClock->portIdentity);
+		ctlSocketAppend(line, len, " portState=%s logMinDelayReqInterval=%d peerMeanPathDelay=%lld"
+			" logAnnounceInterval=%d announceReceiptTimeout=%d logSyncInterval=%d"
+			" delayMechanism=%d logMinPdelayReqInterval=%d versionNumber=%d",
+			portState_getName(ptpClock->portState), ptpClock->logMinDelayReqInterval,
+			(long long)ctlSocketNs(&ptpClock->peerMeanPathDelay),
+			ptpClock->logAnnounceInterval, ptpClock->announceReceiptTimeout,
+			ptpClock->logSyncInterval, ptpClock->delayMechanism,
+			ptpClock->logMinPdelayReqInterval, ptpClock->versionNumber);
+	} else if(!strcmp(what, "counters")) {
+		ctlSocketAppend(line, len, "counters");
+		#define OPERATE( name, size, type ) \
+			ctlSocketAppend(line, len, " " #name "=%u", ptpClock->counters.name);
+		#include "../def/managementTLV/ptpdCounters.def"
+	} else if(!strcmp(what, "servo")) {
+		ctlSocketAppend(line, len, "servo kP=%.6f kI=%.6f input=%d output=%.3f observedDrift=%.3f"
+			" maxOutput=%d runningMaxOutput=%d",
+			servo->kP, servo->kI, servo->input, servo->output, servo->observedDrift,
+			servo->maxOutput, servo->runningMaxOutput);
+#ifdef PTPD_STATISTICS
+		ctlSocketAppend(line, len, " isStable=%d driftMean=%.3f driftStdDev=%.3f",
+			servo->isStable, servo->driftMean, servo->driftStdDev);
+#endif /* PTPD_STATISTICS */
+		ctlSocketAppend(line, len, " holdover=%d holdoverExpired=%d holdoverModelValid=%d"
+			" holdoverFrequency=%.3f holdoverAging=%.6f holdoverElapsed=%.0f"
+			" holdoverErrorBound=%.0f",
+			ptpClock->holdover.active, ptpClock->holdover.expired,
+			ptpClock->holdover.modelValid, ptpClock->holdover.frequency,
+			ptpClock->holdover.aging, ptpClock->holdover.elapsed,
+			ptpClock->holdover.errorBound);
+	} else {
+		ctlSocketAppend(line, len, "error unknown dataset %s", what);
+	}
+
+}
+
+static void
+ctlSocketAppendMonitor(char *line, int *len, const MonitorMaster *master)
+{
+
+	ctlSocketAppend(line, len, "monitor domain=%d", master->domainNumber);
+	ctlSocketAppendPortIdentity(line, len, "port", &master->portIdentity);
+	ctlSocketAppendClockIdentity(line, len, "grandmaster", master->announce.grandmasterIdentity);
+	ctlSocketAppend(line, len, " clockClass=%d priority1=%d priority2=%d stepsRemoved=%d"
+		" offset=%.0f mean=%.0f stdDev=%.0f min=%.0f max=%.0f relative=%.0f reference=%d"
+		" samples=%d announces=%u syncs=%u sequenceErrors=%u",
+		master->announce.grandmasterClockQuality.clockClass,
+		master->announce.grandmasterPriority1, master->announce.grandmasterPriority2,
+		master->announce.stepsRemoved,
+		master->offset, master->mean, master->stdDev, master->min, master->max,
+		master->relativeOffset, master->isReference, master->sampleCount,
+		master->announceCount, master->syncCount, master->sequenceErrors);
+
+}
+
+/* one line per monitored master from slot first, then an end marker */
+static void
+ctlSocketGetMonitor(CtlSocket *ctl, CtlSocketClient *client, PtpClock *ptpClock, int first)
+{
+
+	char line[CTLSOCKET_MAX_LINE];
+	int len, i, count = 0;
+
+	for(i = (first > 0) ? first : 0; i < ptpClock->monitorCapacity && client->fd >= 0; i++) {
+		if(!ptpClock->monitor[i].inUse)
+			continue;
+		if(count == CTLSOCKET_MONITOR_LINES)
+			break;
+		len = 0;
+		ctlSocketAppendMonitor(line, &len, &ptpClock->monitor[i]);
+		ctlSocketQueue(ctl, client, line, len, FALSE);
+		count++;
+	}
+
+	if(client->fd < 0)
+		return;
+
+	len = 0;
+	ctlSocketAppend(line, &len, "monitor end count=%d next=%d", count,
+		(i < ptpClock->monitorCapacity) ? i : 0);
+	ctlSocketQueue(ctl, client, line, len, FALSE);
+
+}
+
+/* one line per tracked slave from slot first, then an end marker */
+static void
+ctlSocketGetSlaves(CtlSocket *ctl, CtlSocketClient *client, PtpClock *ptpClock, int first)
+{
+
+	char line[CTLSOCKET_MAX_LINE];
+	int len, i, count = 0;
+	SlaveTable *table = ptpClock->slaveTable;
+	const SlaveRecord *record;
+	struct timespec ts;
+	struct in_addr in;
+	double now;
+
+	if(table == NULL) {
+		len = 0;
+		ctlSocketAppend(line, &len, "error slave table disabled");
+		ctlSocketQueue(ctl, client, line, len, FALSE);
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = ts.tv_sec + ts.tv_nsec / 1E9;
+
+	for(i = (first > 0) ? first : 0; i < table->used && client->fd >= 0; i++) {
+		record = &table->records[i];
+		if(!record->inUse)
+			continue;
+		if(count == CTLSOCKET_SLAVE_LINES)
+			break;
+		len = 0;
+		in.s_addr = record->address;
+		ctlSocketAppend(line, &len, "slave slot=%d", i);
+		ctlSocketAppendPortIdentity(line, &len, "port", &record->portIdentity);
+		ctlSocketAppend(line, &len, " address=%s requests=%u rate=%.3f jitter=%.0f"
+			" sequenceGaps=%u sequenceErrors=%u flooding=%d floodEvents=%u"
+			" idle=%.0f age=%.0f",
+			inet_ntoa(in), record->requests, slaveRate(record), record->jitter * 1E9,
+			record->sequenceGaps, record->sequenceErrors, record->flooding,
+			record->floodEvents, now - record->lastSeen, now - record->firstSeen);
+		ctlSocketQueue(ctl, client, line, len, FALSE);
+		count++;
+	}
+
+	if(client->fd < 0)
+		return;
+
+	len = 0;
+	ctlSocketAppend(line, &len, "slaves end count=%d next=%d", count,
+		(i < table->used) ? i : 0);
+	ctlSocketQueue(ctl, client, line, len, FALSE);
+
+}
+
+static int
+ctlSocketSubscription(const char *what)
+{
+	if(!strcmp(what, "servo"))
+		return CTLSOCKET_SUB_SERVO;
+	if(!strcmp(what, "state"))
+		return CTLSOCKET_SUB_STATE;
+	if(!strcmp(what, "monitor"))
+		return CTLSOCKET_SUB_MONITOR;
+	if(!strcmp(what, "all"))
+		return CTLSOCKET_SUB_SERVO | CTLSOCKET_SUB_STATE | CTLSOCKET_SUB_MONITOR;
+	return 0;
+}
+
+/* Handle one request line */
+static void
+ctlSocketRequest(CtlSocket *ctl, CtlSocketClient *client, char *request, PtpClock *ptpClock)
+{
+
+	char line[CTLSOCKET_MAX_LINE];
+	int len = 0;
+	char *command, *argument, *save = NULL;
+	int subscription;
+
+	command = strtok_r(request, " \t\r", &save);
+	/* empty lines are ignored */
+	if(command == NULL)
+		return;
+	argument = strtok_r(NULL, " \t\r", &save);
+
+	ctl->requests++;
+
+	if(!strcmp(command, "get") && argument != NULL && !strcmp(argument, "monitor")) {
+		argument = strtok_r(NULL, " \t\r", &save);
+		ctlSocketGetMonitor(ctl, client, ptpClock, argument ? atoi(argument) : 0);
+		return;
+	} else if(!strcmp(command, "get") && argument != NULL && !strcmp(argument, "slaves")) {
+		argument = strtok_r(NULL, " \t\r", &save);
+		ctlSocketGetSlaves(ctl, client, ptpClock, argument ? atoi(argument) : 0);
+		return;
+	} else if(!strcmp(command, "get") && argument != NULL) {
+		ctlSocketGet(argument, line, &len, ptpClock);
+	} else if(!strcmp(command, "subscribe") && argument != NULL &&
+		    (subscription = ctlSocketSubscription(argument)) != 0) {
+		client->subscriptions |= subscription;
+		ctlSocketAppend(line, &len, "ok");
+	} else if(!strcmp(command, "unsubscribe") && argument != NULL &&
+		    (subscription = ctlSocketSubscription(argument)) != 0) {
+		client->subscriptions &= ~subscription;
+		ctlSocketAppend(line, &len, "ok");
+	} else if(!strcmp(command, "help")) {
+		ctlSocketAppend(line, &len, "help get default|current|parent|timeproperties|port|counters|servo;"
+			" get monitor|slaves [first]; subscribe servo|state|monitor; unsubscribe servo|state|monitor|all");
+	} else {
+		ctlSocketAppend(line, &len, "error unknown request %s", command);
+	}
+
+	ctlSocketQueue(ctl, client, line, len, FALSE);
+
+}
+
+/* Read whatever the client sent and answer every complete line */
+static void
+ctlSocketRead(CtlSocket *ctl, CtlSocketClient *client, PtpClock *ptpClock)
+{
+
+	ssize_t ret;
+	char *start, *end;
+
+	ret = recv(client->fd, client->in + client->inLength,
+		    CTLSOCKET_INBUF - client->inLength, MSG_DONTWAIT);
+
+	if(ret == 0 || (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+		ctlSocketClose(ctl, client);
+		return;
+	}
+	if(ret < 0)
+		return;
+
+	client->inLength += ret;
+
+	start = client->in;
+	while(client->fd >= 0 &&
+	    (end = memchr(start, '\n', client->inLength - (start - client->in))) != NULL) {
+		*end = '\0';
+		ctlSocketRequest(ctl, client, start, ptpClock);
+		start = end + 1;
+	}
+
+	if(client->fd < 0)
+		return;
+
+	client->inLength -= start - client->in;
+	memmove(client->in, start, client->inLength);
+
+	/* no newline in a full buffer - not a client we understand */
+	if(client->inLength == CTLSOCKET_INBUF) {
+		DBG("Control socket request too long - disconnecting client\n");
+		ctl->disconnected++;
+		ctlSocketClose(ctl, client);
+	}
+
+}
+
+static void
+ctlSocketAccept(CtlSocket *ctl)
+{
+
+	int fd, i;
+
+	while((fd = accept(ctl->listenFD, NULL, NULL)) >= 0) {
+
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+		for(i = 0; i < CTLSOCKET_MAX_CLIENTS; i++) {
+			if(ctl->clients[i].fd < 0)
+				break;
+		}
+
+		if(i == CTLSOCKET_MAX_CLIENTS) {
+			DBG("Control socket: too many clients, refusing connection\n");
+			ctl->refused++;
+			close(fd);
+			continue;
+		}
+
+		ctl->clients[i].fd = fd;
+		ctl->clients[i].inLength = 0;
+		ctl->clients[i].outLength = 0;
+		ctl->clients[i].subscriptions = 0;
+		ctl->clients[i].droppedLines = 0;
+		ctl->accepted++;
+
+	}
+
+}
+
+Boolean
+ctlSocketInit(RunTimeOpts *rtOpts, CtlSocket *ctl)
+{
+
+	struct sockaddr_un addr;
+	int i;
+
+	for(i = 0; i < CTLSOCKET_MAX_CLIENTS; i++)
+		ctl->clients[i].fd = -1;
+
+	if(strlen(rtOpts->controlSocketFile) >= sizeof(addr.sun_path)) {
+		ERROR("Control socket path too long: %s\n", rtOpts->controlSocketFile);
+		return FALSE;
+	}
+
+	if((ctl->listenFD = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		PERROR("Could not create control socket");
+		return FALSE;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	/* length checked above */
+	memcpy(addr.sun_path, rtOpts->controlSocketFile, strlen(rtOpts->controlSocketFile));
+
+	/* left behind by a previous instance - the lock file keeps two from running */
+	unlink(addr.sun_path);
+
+	if(bind(ctl->listenFD, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+	    listen(ctl->listenFD, CTLSOCKET_MAX_CLIENTS) < 0) {
+		PERROR("Could not bind control socket to %s", addr.sun_path);
+		close(ctl->listenFD);
+		ctl->listenFD = -1;
+		return FALSE;
+	}
+
+	fcntl(ctl->listenFD, F_SETFL, fcntl(ctl->listenFD, F_GETFL, 0) | O_NONBLOCK);
+	fcntl(ctl->listenFD, F_SETFD, FD_CLOEXEC);
+
+	strncpy(ctl->path, addr.sun_path, PATH_MAX);
+
+	INFO("Control socket listening on %s\n", ctl->path);
+
+	return TRUE;
+
+}
+
+void
+ctlSocketShutdown(CtlSocket *ctl)
+{
+
+	int i;
+
+	if(ctl->listenFD < 0)
+		return;
+
+	for(i = 0; i < CTLSOCKET_MAX_CLIENTS; i++) {
+		if(ctl->clients[i].fd >= 0)
+			ctlSocketClose(ctl, &ctl->clients[i]);
+	}
+
+	close(ctl->listenFD);
+	ctl->listenFD = -1;
+	unlink(ctl->path);
+
+	INFO("Control socket closed after %u requests (%u clients, %u refused, %u disconnected, %u stream lines dropped)\n",
+		ctl->requests, ctl->accepted, ctl->refused, ctl->disconnected, ctl->droppedLines);
+
+}
+
+/* Add the control socket and its clients to a select() read set, returns the new nfds */
+int
+ctlSocketFdSet(CtlSocket *ctl, fd_set *readfds, int nfds)
+{
+
+	int i;
+
+	if(ctl->listenFD < 0)
+		return nfds;
+
+	FD_SET(ctl->listenFD, readfds);
+	if(ctl->listenFD >= nfds)
+		nfds = ctl->listenFD + 1;
+
+	for(i = 0; i < CTLSOCKET_MAX_CLIENTS; i++) {
+		if(ctl->clients[i].fd < 0)
+			continue;
+		FD_SET(ctl->clients[i].fd, readfds);
+		if(ctl->clients[i].fd >= nfds)
+			nfds = ctl->clients[i].fd + 1;
+	}
+
+	return nfds;
+
+}
+
+/*
+ * Called from the main loop on every pass: accept clients, answer requests
+ * from readable clients (readfds may be NULL) and push out queued output
+ */
+void
+ctlSocketService(PtpClock *ptpClock, fd_set *readfds)
+{
+
+	CtlSocket *ctl = &ptpClock->ctlSocket;
+	int i;
+
+	if(ctl->listenFD < 0)
+		return;
+
+	if(readfds != NULL && FD_ISSET(ctl->listenFD, readfds))
+		ctlSocketAccept(ctl);
+
+	for(i = 0; i < CTLSOCKET_MAX_CLIENTS; i++) {
+		if(ctl->clients[i].fd < 0)
+			continue;
+		if(readfds != NULL && FD_ISSET(ctl->clients[i].fd, readfds))
+			ctlSocketRead(ctl, &ctl->clients[i], ptpClock);
+		ctlSocketFlush(ctl, &ctl->clients[i]);
+	}
+
+}
+
+/* Queue a stream line for every client subscribed to it */
+static void
+ctlSocketPublish(CtlSocket *ctl, int subscription, char *line, int len)
+{
+
+	int i;
+
+	for(i = 0; i < CTLSOCKET_MAX_CLIENTS; i++) {
+		if(ctl->clients[i].fd >= 0 && (ctl->clients[i].subscriptions & subscription))
+			ctlSocketQueue(ctl, &ctl->clients[i], line, len, TRUE);
+	}
+
+}
+
+/* Stream the outcome of a clock update - called after every servo run */
+void
+ctlSocketServoSample(PtpClock *ptpClock)
+{
+
+	char line[CTLSOCKET_MAX_LINE];
+	int len = 0;
+	TimeInternal now;
+	TimeInternal *delay;
+
+	if(ptpClock->ctlSocket.listenFD < 0)
+		return;
+
+	getTime(&now);
+	delay = (ptpClock->delayMechanism == P2P) ?
+		&ptpClock->peerMeanPathDelay : &ptpClock->meanPathDelay;
+
+	ctlSocketAppend(line, &len, "servo time=%d.%09d offset=%lld delay=%lld observedDrift=%.3f output=%.3f",
+		now.seconds, now.nanoseconds,
+		(long long)ctlSocketNs(&ptpClock->offsetFromMaster),
+		(long long)ctlSocketNs(delay),
+		ptpClock->servo.observedDrift, ptpClock->servo.output);
+
+	ctlSocketPublish(&ptpClock->ctlSocket, CTLSOCKET_SUB_SERVO, line, len);
+
+}
+
+/* Stream a port state change */
+void
+ctlSocketStateChange(PtpClock *ptpClock, UInteger8 previousState)
+{
+
+	char line[CTLSOCKET_MAX_LINE];
+	int len = 0;
+	TimeInternal now;
+
+	if(ptpClock->ctlSocket.listenFD < 0)
+		return;
+
+	getTime(&now);
+
+	ctlSocketAppend(line, &len, "state time=%d.%09d from=%s to=%s",
+		now.seconds, now.nanoseconds,
+		portState_getName(previousState), portState_getName(ptpClock->portState));
+
+	ctlSocketPublish(&ptpClock->ctlSocket, CTLSOCKET_SUB_STATE, line, len);
+
+}
+
+/* Stream a monitored master's measurement - called after every monitored Sync */
+void
+ctlSocketMonitorSample(PtpClock *ptpClock, const MonitorMaster *master)
+{
+
+	char line[CTLSOCKET_MAX_LINE];
+	int len = 0;
+
+	if(ptpClock->ctlSocket.listenFD < 0)
+		return;
+
+	ctlSocketAppendMonitor(line, &len, master);
+	ctlSocketPublish(&ptpClock->ctlSocket, CTLSOCKET_SUB_MONITOR, line, len);
+
+}
@@ -0,0 +1,51 @@
+/**
+ * @file   ctlsocket.h
+ *
+ * @brief  definitions related to the local Unix domain control socket
+ *
+ */
+
+#ifndef PTPD_CTLSOCKET_H_
+#define PTPD_CTLSOCKET_H_
+
+/* Clients connected at the same time - more are refused */
+#define CTLSOCKET_MAX_CLIENTS		8
+/* Longest request line, newline included */
+#define CTLSOCKET_INBUF			256
+/* Output queued per client - a client that lets it fill up loses stream lines */
+#define CTLSOCKET_OUTBUF		16384
+/* Longest single output line */
+#define CTLSOCKET_MAX_LINE		2048
+/* Slave table lines per "get slaves" reply - the rest is paged */
+#define CTLSOCKET_SLAVE_LINES		32
+/* Monitored master lines per "get monitor" reply - the rest is paged */
+#define CTLSOCKET_MONITOR_LINES		32
+
+/* Stream subscriptions */
+#define CTLSOCKET_SUB_SERVO		0x01	/* one line per clock update */
+#define CTLSOCKET_SUB_STATE		0x02	/* one line per port state change */
+#define CTLSOCKET_SUB_MONITOR		0x04	/* one line per monitored Sync */
+
+typedef struct {
+	int fd;				/* -1: slot free */
+	char in[CTLSOCKET_INBUF];
+	size_t inLength;
+	char out[CTLSOCKET_OUTBUF];
+	size_t outLength;
+	uint32_t subscriptions;
+	uint32_t droppedLines;		/* stream lines that did not fit */
+} CtlSocketClient;
+
+typedef struct {
+	int listenFD;
+	char path[PATH_MAX];		/* where the socket was bound - unlinked on shutdown */
+	CtlSocketClient clients[CTLSOCKET_MAX_CLIENTS];
+	/* counters */
+	uint32_t accepted;
+	uint32_t refused;		/* no free client slot */
+	uint32_t requests;
+	uint32_t droppedLines;
+	uint32_t disconnected;		/* reply did not fit, or a request line too long */
+} CtlSocket;
+
+#endif /* PTPD_CTLSOCKET_H_ */
@@ -621,9 +621,24 @@ printf("Note: The use of '-%c' option is deprecated %s- consider using '-%c' (--
 			NOTIFY("Change of %s setting requires "PTPD_PROGNAME" restart\n",key);\
 		} else\
 			DBG("Setting %s changed, restart of subystem %d required\n",key,flag);\
+		if((flag) & (PTPD_RESTART_PROTOCOL | PTPD_RESTART_NETWORK))\
+			appendReinitKey(reinitKeys, reinitKeysLen, key);\
 		restartFlags |= flag;\
 	}
 
+/* Add a setting to the list of changed settings that force PTP_INITIALIZING */
+static void
+appendReinitKey(char *reinitKeys, size_t reinitKeysLen, const char *key)
+{
+	size_t len = strlen(reinitKeys);
+
+	/* already listed - keys can map to more than one flag */
+	if(strstr(reinitKeys, key) != NULL)
+		return;
+
+	snprintf(reinitKeys + len, reinitKeysLen - len, "%s%s", len ? ", " : "", key);
+}
+
 /* concatenate every second vararg argument for string, int pairs and print it */
 static void
 printKeyOptions( int count, ... )
@@ -967,6 +982,34 @@ loadDefaultSettings( RunTimeOpts* rtOpts )
 	rtOpts->statusLog.truncateOnReopen = FALSE;
 	rtOpts->statusLog.unlinkOnClose = TRUE;
 
+	rtOpts->ntpShmEnabled = FALSE;
+
+	rtOpts->holdoverEnabled = FALSE;
+	rtOpts->holdoverSampleInterval = 60;
+	rtOpts->holdoverTimeout = 3600;
+
+	rtOpts->standbyMasters = 0;
+
+	rtOpts->monitorMode = FALSE;
+	rtOpts->monitorCapacity = 64;
+	rtOpts->monitorTimeout = 30;
+
+	rtOpts->ntpShmUnit = 0;
+
+	rtOpts->ntpServerEnabled = FALSE;
+	rtOpts->ntpServerPort = NTPSERVER_DEFAULT_PORT;
+
+	rtOpts->clockPageEnabled = FALSE;
+	strncpy(rtOpts->clockPageFile, DEFAULT_CLOCKPAGEFILE, PATH_MAX);
+
+	rtOpts->controlSocketEnabled = FALSE;
+	strncpy(rtOpts->controlSocketFile, DEFAULT_CTLSOCKETFILE, PATH_MAX);
+
+	rtOpts->snapshotEnabled = FALSE;
+	strncpy(rtOpts->snapshotFile, DEFAULT_SNAPSHOTFILE, PATH_MAX);
+	rtOpts->snapshotInterval = 60;
+	rtOpts->snapshotMaxAge = 3600;
+
 /* Management message support settings */
 	rtOpts->managementEnabled = TRUE;
 	rtOpts->managementSetEnable = FALSE;
@@ -977,6 +1020,27 @@ loadDefaultSettings( RunTimeOpts* rtOpts )
 	rtOpts->managementAclEnabled = FALSE;
 	rtOpts->timingAclOrder = ACL_DENY_PERMIT;
 	rtOpts->managementAclOrder = ACL_DENY_PERMIT;
+
+	rtOpts->kernelFilter = FALSE;
+	rtOpts->kernelFilterParent = FALSE;
+
+	rtOpts->rxBudgetBmc = 8;
+	rtOpts->rxBudgetManagement = 4;
+
+	rtOpts->rateLimitEnabled = FALSE;
+	rtOpts->rateLimitSources = 1024;
+	/* 128 Sync/s + Delay_Req from the same host fit comfortably */
+	rtOpts->rateLimitRates[RATELIMIT_EVENT] = 256;
+	rtOpts->rateLimitRates[RATELIMIT_GENERAL] = 256;
+	rtOpts->rateLimitRates[RATELIMIT_ANNOUNCE] = 16;
+	rtOpts->rateLimitRates[RATELIMIT_MANAGEMENT] = 32;
+
+	rtOpts->slaveTableEnabled = FALSE;
+	rtOpts->slaveTableSize = 1024;
+	rtOpts->slaveTimeout = 60;
+	rtOpts->slaveFloodFactor = 4.0;
+
+	rtOpts->redundantPdvRatio = 0.5;
 }
 
 /* The PtpEnginePreset structure for reference: 
@@ -1113,6 +1177,29 @@ parseConfig ( dictionary* dict, RunTimeOpts *rtOpts )
 	CONFIG_MAP_CHARARRAY("ptpengine:interface",rtOpts->ifaceName,rtOpts->ifaceName,
 	"Network interface to use - eth0, igb0 etc. (required).");
 
+	CONFIG_MAP_CHARARRAY("ptpengine:bc_interfaces",rtOpts->bcInterfacesText,rtOpts->bcInterfacesText,
+		"Boundary clock: additional network interfaces, separated by commas or\n"
+	"	 spaces. Each one becomes another port of this clock, with port 1 on\n"
+	"	 ptpengine:interface. The port receiving the best master becomes the only\n"
+	"	 slave port; the others become masters to their networks. All ports use\n"
+	"	 the ptpengine settings; NTP, SNMP, control socket and status services\n"
+	"	 run on port 1 only. Cannot be used in slave only or monitor mode.\n"
+	"	 Up to 8 ports in total.");
+
+	CONFIG_MAP_CHARARRAY("ptpengine:redundant_interface",rtOpts->redundantInterface,rtOpts->redundantInterface,
+		"Redundant slave: second network interface with a path to the same GM.\n"
+	"	 Both interfaces run as slaves with their own timestamps, path delay and\n"
+	"	 filters; the path with the lower offset variation (PDV) disciplines the\n"
+	"	 clock. When the selected path goes down or degrades, the servo carries\n"
+	"	 on from the other path, offset by the difference between the paths, so\n"
+	"	 the clock sees no step. Requires slave only mode. Cannot be used with\n"
+	"	 boundary clock ports, domain instances or in monitor mode.");
+
+	CONFIG_MAP_DOUBLE_RANGE("ptpengine:redundant_pdv_ratio",rtOpts->redundantPdvRatio,rtOpts->redundantPdvRatio,
+		"Redundant slave: switch to the other path when its offset variation\n"
+	"	 falls below this share of the selected path's. Switches on PDV are at\n"
+	"	 least 10 seconds apart; a path that stops receiving Sync is left at once.", 0.1, 1.0);
+
 	/* Preset option names have to be mapped to defined presets - no free strings here */
 	CONFIG_MAP_SELECTVALUE("ptpengine:preset",rtOpts->selectedPreset,rtOpts->selectedPreset,
 		"PTP engine preset:\n"
@@ -1194,9 +1281,43 @@ parseConfig ( dictionary* dict, RunTimeOpts *rtOpts )
 	CONFIG_MAP_INT_RANGE("ptpengine:domain",rtOpts->domainNumber,rtOpts->domainNumber,
 		"PTP domain number.",0,127);
 
+	CONFIG_MAP_CHARARRAY("ptpengine:domain_instances",rtOpts->domainInstancesText,rtOpts->domainInstancesText,
+		"Additional PTP domains, each run by an engine instance of its own over\n"
+	"	 the sockets of ptpengine:domain: domain numbers separated by commas or\n"
+	"	 spaces, each optionally followed by :monitor (default) or :master.\n"
+	"	 Only ptpengine:domain disciplines the clock - a monitor instance is slave\n"
+	"	 only and never adjusts the clock, a master instance serves its domain.\n"
+	"	 Their state is written to the status file. Disables ptpengine:kernel_filter.\n"
+	"	 Cannot be used with boundary clock ports or in monitor mode.\n"
+	"	 Up to 7 additional domains.");
+
 	CONFIG_MAP_BOOLEAN("ptpengine:slave_only",rtOpts->slaveOnly, ptpPreset.slaveOnly,
 		 "Slave only mode (sets clock class to 255, overriding value from preset).");
 
+	CONFIG_MAP_BOOLEAN("ptpengine:monitor",rtOpts->monitorMode,rtOpts->monitorMode,
+		"Passive monitor mode: the port stays in LISTENING state, never sends\n"
+	"	 timing messages and never adjusts the clock. Every master heard in the\n"
+	"	 monitored domains is tracked: offset of its Syncs against the local clock\n"
+	"	 (without path delay), its standard deviation (PDV) and its offset against\n"
+	"	 the best master of its domain. Results are written to the statistics log,\n"
+	"	 the status file and the control socket. Implies slave only mode and\n"
+	"	 clock:no_adjust.");
+
+	/* the monitor must never become a master */
+	CONFIG_KEY_CONDITIONAL_TRIGGER(rtOpts->monitorMode,rtOpts->slaveOnly,TRUE,rtOpts->slaveOnly);
+
+	CONFIG_MAP_CHARARRAY("ptpengine:monitor_domains",rtOpts->monitorDomainsText,rtOpts->monitorDomainsText,
+		"Domains monitored in monitor mode: domain numbers separated by commas\n"
+	"	 or spaces. Empty - ptpengine:domain only. Monitoring domains other than\n"
+	"	 ptpengine:domain disables ptpengine:kernel_filter.");
+
+	CONFIG_MAP_INT_RANGE("ptpengine:monitor_capacity",rtOpts->monitorCapacity,rtOpts->monitorCapacity,
+		"Maximum number of masters tracked in monitor mode.",1,MONITOR_MAX_CAPACITY);
+
+	CONFIG_MAP_INT_RANGE("ptpengine:monitor_timeout",rtOpts->monitorTimeout,rtOpts->monitorTimeout,
+		"Time (seconds) without an Announce message after which a master is\n"
+	"	 no longer tracked in monitor mode.",1,3600);
+
 	CONFIG_MAP_INT( "ptpengine:inbound_latency",rtOpts->inboundLatency.nanoseconds,rtOpts->inboundLatency.nanoseconds,
 	"Specify latency correction (nanoseconds) for incoming packets.");
 
@@ -1269,6 +1390,21 @@ parseConfig ( dictionary* dict, RunTimeOpts *rtOpts )
 	CONFIG_MAP_INT_RANGE("ptpengine:foreignrecord_capacity",rtOpts->max_foreign_records,rtOpts->max_foreign_records,
 	"Foreign master record size (Maximum number of foreign masters).",5,10);
 
+	CONFIG_MAP_INT_RANGE("ptpengine:standby_masters",rtOpts->standbyMasters,rtOpts->standbyMasters,
+		"Number of backup masters measured in hot standby while in slave state.\n"
+	"	 Offset and path delay to the best foreign masters other than the parent\n"
+	"	 are measured from their Sync messages and their responses to our own\n"
+	"	 Delay Requests, with filters of their own. When one of them becomes the\n"
+	"	 best master, the servo carries on with its warm path delay and filters\n"
+	"	 instead of settling again. Failover within slave state requires\n"
+	"	 ptpengine:announce_receipt_grace_period to be set. Delay measurement of\n"
+	"	 backup masters requires multicast or Ethernet transport. 0 - disabled.",0,STANDBY_MAX_MASTERS);
+
+	/* backup masters only answer our Delay Requests if they can see them */
+	if(rtOpts->standbyMasters && rtOpts->ip_mode != IPMODE_MULTICAST &&
+	    rtOpts->transport != IEEE_802_3 && !IS_QUIET())
+		WARNING("Warning: backup masters are only measured in hot standby with multicast or Ethernet transport (ptpengine:standby_masters)\n");
+
 	CONFIG_MAP_INT_RANGE("ptpengine:ptp_allan_variance",rtOpts->clockQuality.offsetScaledLogVariance,rtOpts->clockQuality.offsetScaledLogVariance,
 	"Specify Allan variance announced in master state.",0,65535);
 
@@ -1575,6 +1711,76 @@ parseConfig ( dictionary* dict, RunTimeOpts *rtOpts )
 	CONFIG_KEY_CONDITIONAL_TRIGGER(rtOpts->transport == IEEE_802_3,rtOpts->timingAclEnabled,FALSE,rtOpts->timingAclEnabled);
 	CONFIG_KEY_CONDITIONAL_TRIGGER(rtOpts->transport == IEEE_802_3,rtOpts->managementAclEnabled,FALSE,rtOpts->managementAclEnabled);
 
+	CONFIG_MAP_BOOLEAN("ptpengine:kernel_filter",rtOpts->kernelFilter,rtOpts->kernelFilter,
+		"Attach a BPF filter to the PTP sockets (or pcap handles) so that messages\n"
+	"	 with a different PTP version or domain number are dropped by the kernel.\n"
+	"	 Such messages are then no longer counted as version or domain mismatches.\n"
+	"	 Socket filters are only supported on Linux.");
+
+	CONFIG_MAP_BOOLEAN("ptpengine:kernel_filter_parent",rtOpts->kernelFilterParent,rtOpts->kernelFilterParent,
+		"In slave state, also drop Sync and Follow_Up messages not sent by the\n"
+	"	 current parent in the kernel filter. The filter is updated on every parent change.\n"
+	"	 Not applied when ptpengine:standby_masters is set.");
+
+	CONFIG_KEY_DEPENDENCY("ptpengine:kernel_filter_parent", "ptpengine:kernel_filter");
+
+	CONFIG_MAP_INT_RANGE("ptpengine:rx_budget_announce",rtOpts->rxBudgetBmc,rtOpts->rxBudgetBmc,
+		"Received messages are queued by priority: timing messages are always\n"
+	"	 processed first. This is the maximum number of queued Announce and\n"
+	"	 Signaling messages processed per main loop pass.", 1, RXQ_CAPACITY);
+
+	CONFIG_MAP_INT_RANGE("ptpengine:rx_budget_management",rtOpts->rxBudgetManagement,rtOpts->rxBudgetManagement,
+		"Maximum number of queued Management messages processed per main loop pass,\n"
+	"	 after timing and Announce messages.", 1, RXQ_CAPACITY);
+
+	CONFIG_MAP_BOOLEAN("ptpengine:rate_limit_enable",rtOpts->rateLimitEnabled,rtOpts->rateLimitEnabled,
+		"Limit the rate of messages accepted from each source IP address, before\n"
+	"	 they are unpacked. Each source gets a separate budget for event, general,\n"
+	"	 Announce / Signaling and Management messages, with bursts of up to one\n"
+	"	 second worth of messages. Only supported when using the IP transport.");
+
+	CONFIG_MAP_INT_RANGE("ptpengine:rate_limit_sources",rtOpts->rateLimitSources,rtOpts->rateLimitSources,
+		"Maximum number of source addresses tracked by the rate limiter. When the\n"
+	"	 table is full, the least recently seen source is forgotten.", 16, 65536);
+
+	CONFIG_MAP_INT_RANGE("ptpengine:rate_limit_event",rtOpts->rateLimitRates[RATELIMIT_EVENT],rtOpts->rateLimitRates[RATELIMIT_EVENT],
+		"Event messages (Sync, Delay_Req, Pdelay_Req, Pdelay_Resp) accepted per second\n"
+	"	 from a single source. 0 = unlimited.", 0, 65536);
+
+	CONFIG_MAP_INT_RANGE("ptpengine:rate_limit_general",rtOpts->rateLimitRates[RATELIMIT_GENERAL],rtOpts->rateLimitRates[RATELIMIT_GENERAL],
+		"Follow_Up, Delay_Resp and Pdelay_Resp_Follow_Up messages accepted per second\n"
+	"	 from a single source. 0 = unlimited.", 0, 65536);
+
+	CONFIG_MAP_INT_RANGE("ptpengine:rate_limit_announce",rtOpts->rateLimitRates[RATELIMIT_ANNOUNCE],rtOpts->rateLimitRates[RATELIMIT_ANNOUNCE],
+		"Announce and Signaling messages accepted per second from a single source.\n"
+	"	 0 = unlimited.", 0, 65536);
+
+	CONFIG_MAP_INT_RANGE("ptpengine:rate_limit_management",rtOpts->rateLimitRates[RATELIMIT_MANAGEMENT],rtOpts->rateLimitRates[RATELIMIT_MANAGEMENT],
+		"Management messages accepted per second from a single source.\n"
+	"	 0 = unlimited.", 0, 65536);
+
+	/* Ethernet mode disables rate limiting */
+	CONFIG_KEY_CONDITIONAL_TRIGGER(rtOpts->transport == IEEE_802_3,rtOpts->rateLimitEnabled,FALSE,rtOpts->rateLimitEnabled);
+
+	CONFIG_MAP_BOOLEAN("ptpengine:slave_table",rtOpts->slaveTableEnabled,rtOpts->slaveTableEnabled,
+		"In master state, keep a table of the slaves seen from their Delay Requests,\n"
+	"	 keyed by port identity and source address: request count and rate,\n"
+	"	 sequence gaps, inter-arrival jitter and last-seen time. Reported in the\n"
+	"	 status file, over the control socket (get slaves) and with the\n"
+	"	 PTPD_SLAVE_TABLE management TLV.");
+
+	CONFIG_MAP_INT_RANGE("ptpengine:slave_table_size",rtOpts->slaveTableSize,rtOpts->slaveTableSize,
+		"Maximum number of slaves tracked in the slave table. When the table is full,\n"
+	"	 the least recently seen slave is forgotten.", 16, SLAVE_TABLE_MAX_CAPACITY);
+
+	CONFIG_MAP_INT_RANGE("ptpengine:slave_timeout",rtOpts->slaveTimeout,rtOpts->slaveTimeout,
+		"Time (seconds) without Delay Requests after which a slave is dropped\n"
+	"	 from the slave table.", 1, 86400);
+
+	CONFIG_MAP_DOUBLE_RANGE("ptpengine:slave_flood_factor",rtOpts->slaveFloodFactor,rtOpts->slaveFloodFactor,
+		"A slave sending Delay Requests this many times faster than the rate\n"
+	"	 advertised with ptpengine:log_delayreq_interval is reported as flooding.", 1.0, 1000.0);
+
 
 
 /* ===== clock section ===== */
@@ -1608,6 +1814,22 @@ parseConfig ( dictionary* dict, RunTimeOpts *rtOpts )
 	CONFIG_MAP_CHARARRAY("clock:drift_file",rtOpts->driftFile,rtOpts->driftFile,
 	"Specify drift file");
 
+	CONFIG_MAP_BOOLEAN("clock:ntp_shm_output",rtOpts->ntpShmEnabled,rtOpts->ntpShmEnabled,
+		"Measurement-only mode: do not adjust the clock, but post every offset\n"
+	"	 sample to the NTP shared memory reference clock segment (SHM mode 1),\n"
+	"	 so that ntpd (refclock type 28) or chrony (refclock SHM) can use PTP\n"
+	"	 as a reference clock. Implies clock:no_adjust.");
+
+	CONFIG_MAP_INT_RANGE("clock:ntp_shm_unit",rtOpts->ntpShmUnit,rtOpts->ntpShmUnit,
+		"NTP SHM reference clock unit number. Units 0 and 1 are only accessible\n"
+	"	 to root, higher units are world-writable.", 0, NTPSHM_MAX_UNIT);
+
+	/* ptpd only measures in SHM output mode: the clock belongs to NTP */
+	CONFIG_KEY_CONDITIONAL_TRIGGER(rtOpts->ntpShmEnabled,rtOpts->noAdjust,TRUE,rtOpts->noAdjust);
+
+	/* the monitor only measures */
+	CONFIG_KEY_CONDITIONAL_TRIGGER(rtOpts->monitorMode,rtOpts->noAdjust,TRUE,rtOpts->noAdjust);
+
 #ifdef HAVE_STRUCT_TIMEX_TICK
 	/* This really is clock specific - different clocks may allow different ranges */
 	CONFIG_MAP_INT_RANGE("clock:max_offset_ppm",rtOpts->servoMaxPpb,rtOpts->servoMaxPpb,
@@ -1618,6 +1840,25 @@ parseConfig ( dictionary* dict, RunTimeOpts *rtOpts )
 	ADJ_FREQ_MAX/1000,ADJ_FREQ_MAX/500);
 #endif /* HAVE_STRUCT_TIMEX_TICK */
 
+	CONFIG_MAP_BOOLEAN("clock:holdover",rtOpts->holdoverEnabled,rtOpts->holdoverEnabled,
+		"Holdover: while locked, learn a frequency and aging model of the local\n"
+	"	 oscillator from the servo's observed drift. When the GM is lost, steer\n"
+	"	 the clock along the model and publish a growing time error bound in\n"
+	"	 the status file, clock page and clock quality (clockAccuracy; clockClass\n"
+	"	 6 and 13 go to holdover classes 7 and 14).");
+
+	CONFIG_MAP_INT_RANGE("clock:holdover_sample_interval",rtOpts->holdoverSampleInterval,rtOpts->holdoverSampleInterval,
+		"Interval (seconds) over which the observed drift is averaged into one\n"
+	"	 sample of the holdover oscillator model. The model is fitted to the\n"
+	"	 last 64 samples.",
+	1,3600);
+
+	CONFIG_MAP_INT_RANGE("clock:holdover_timeout",rtOpts->holdoverTimeout,rtOpts->holdoverTimeout,
+		"Maximum holdover duration in seconds. After this, the clock is left free\n"
+	"	 running at the last holdover frequency and clockClass 7 / 14 degrades\n"
+	"	 to 52 / 58. 0 - unlimited.",
+	0,604800);
+
 	/*
 	 * TimeProperties DS - in future when clock driver API is implemented,
 	 * a slave PTP engine should inform a clock about this, and then that
@@ -1745,6 +1986,47 @@ parseConfig ( dictionary* dict, RunTimeOpts *rtOpts )
 		"Status file update interval in seconds.",
 	1,30);
 
+	/* if clock page file specified, enable publishing the clock page */
+	CONFIG_KEY_TRIGGER("global:clock_page_file",rtOpts->clockPageEnabled,TRUE,rtOpts->clockPageEnabled);
+	CONFIG_MAP_CHARARRAY("global:clock_page_file",rtOpts->clockPageFile,rtOpts->clockPageFile,
+		"Shared memory clock parameter page: a memory-mapped file holding the last\n"
+	"	 offset, frequency, error bound and lock state, updated after every\n"
+	"	 clock update. Setting this enables the clock page.");
+
+	CONFIG_MAP_BOOLEAN("global:clock_page",rtOpts->clockPageEnabled,rtOpts->clockPageEnabled,
+		"Enable / disable publishing the shared memory clock page.");
+
+	/* if control socket file specified, enable the control socket */
+	CONFIG_KEY_TRIGGER("global:control_socket_file",rtOpts->controlSocketEnabled,TRUE,rtOpts->controlSocketEnabled);
+	CONFIG_MAP_CHARARRAY("global:control_socket_file",rtOpts->controlSocketFile,rtOpts->controlSocketFile,
+		"Local control socket: a Unix domain stream socket answering one-line\n"
+	"	 requests for data sets, counters and servo state, and streaming servo\n"
+	"	 samples and port state changes to subscribed clients.\n"
+	"	 Setting this enables the control socket.");
+
+	CONFIG_MAP_BOOLEAN("global:control_socket",rtOpts->controlSocketEnabled,rtOpts->controlSocketEnabled,
+		"Enable / disable the local control socket.");
+
+	/* if state snapshot file specified, enable warm start */
+	CONFIG_KEY_TRIGGER("global:snapshot_file",rtOpts->snapshotEnabled,TRUE,rtOpts->snapshotEnabled);
+	CONFIG_MAP_CHARARRAY("global:snapshot_file",rtOpts->snapshotFile,rtOpts->snapshotFile,
+		"Warm start state snapshot: a binary file holding the servo, path delay\n"
+	"	 and outlier filter state, written at regular intervals and on shutdown.\n"
+	"	 On startup the state is restored if the port synchronises to the same\n"
+	"	 parent and grandmaster. Setting this enables the state snapshot.");
+
+	CONFIG_MAP_BOOLEAN("global:snapshot",rtOpts->snapshotEnabled,rtOpts->snapshotEnabled,
+		"Enable / disable saving and restoring the warm start state snapshot.");
+
+	CONFIG_MAP_INT_RANGE("global:snapshot_interval",rtOpts->snapshotInterval,rtOpts->snapshotInterval,
+		"State snapshot save interval in seconds.",
+	1,86400);
+
+	CONFIG_MAP_INT_RANGE("global:snapshot_max_age",rtOpts->snapshotMaxAge,rtOpts->snapshotMaxAge,
+		"Maximum age of a state snapshot (in seconds) for it to be restored.\n"
+	"	 Older snapshots are ignored and the slave starts cold.",
+	1,604800);
+
 #ifdef RUNTIME_DEBUG
 	CONFIG_MAP_SELECTVALUE("global:debug_level",rtOpts->debug_level,rtOpts->debug_level,
 	"Specify debug level (if compiled with RUNTIME_DEBUG).",
@@ -1865,6 +2147,21 @@ parseConfig ( dictionary* dict, RunTimeOpts *rtOpts )
 #endif /* PTPD_STATISTICS */
 
 
+/* ===== ntpserver section ===== */
+
+	CONFIG_MAP_BOOLEAN("ntpserver:enabled",rtOpts->ntpServerEnabled,rtOpts->ntpServerEnabled,
+		"Run a built-in NTP server answering NTP client (mode 3) requests from the\n"
+	"	 PTP-disciplined clock. Stratum, reference ID, root delay and dispersion\n"
+	"	 are derived from the PTP data sets and servo state. Replies are marked\n"
+	"	 unsynchronised unless ptpd2 is a slave disciplining the clock.");
+
+	CONFIG_MAP_INT_RANGE("ntpserver:port",rtOpts->ntpServerPort,rtOpts->ntpServerPort,
+		"UDP port the NTP server listens on.", 1, 65535);
+
+	CONFIG_MAP_CHARARRAY("ntpserver:bind_address",rtOpts->ntpServerAddress,rtOpts->ntpServerAddress,
+		"IPv4 address (or host name) the NTP server binds to. Leave empty\n"
+	"	 to listen on all addresses.");
+
 #ifdef PTPD_NTPDC
 
 /* ===== ntpengine section ===== */
@@ -1947,6 +2244,72 @@ parseConfig ( dictionary* dict, RunTimeOpts *rtOpts )
 		}
 	}
 
+	/* Check the monitored domain list */
+	if(!monitorParseDomains(rtOpts)) {
+		ERROR("Error while parsing monitored domain list: \"%s\"\n",
+			rtOpts->monitorDomainsText);
+		parseResult = FALSE;
+	} else if(rtOpts->monitorMode && rtOpts->kernelFilter &&
+	    strlen(rtOpts->monitorDomainsText)) {
+		int i;
+		/* the kernel filter only passes ptpengine:domain */
+		for(i = 0; i < 256; i++) {
+			if(i != rtOpts->domainNumber && monitorDomainEnabled(rtOpts, i)) {
+				if(!IS_QUIET())
+					WARNING("Warning: ptpengine:kernel_filter disabled - monitoring domains other than ptpengine:domain\n");
+				rtOpts->kernelFilter = FALSE;
+				break;
+			}
+		}
+	}
+
+	/* Check the domain instance list */
+	if(!domainParseInstances(rtOpts)) {
+		ERROR("Error while parsing domain instance list: \"%s\"\n",
+			rtOpts->domainInstancesText);
+		parseResult = FALSE;
+	} else if(rtOpts->domainInstanceCount) {
+		if(strlen(rtOpts->bcInterfacesText) || rtOpts->monitorMode) {
+			ERROR("Error: ptpengine:domain_instances cannot be used with ptpengine:bc_interfaces or in monitor mode\n");
+			parseResult = FALSE;
+		} else if(rtOpts->kernelFilter) {
+			/* the kernel filter only passes ptpengine:domain */
+			if(!IS_QUIET())
+				WARNING("Warning: ptpengine:kernel_filter disabled - running domain instances\n");
+			rtOpts->kernelFilter = FALSE;
+		}
+	}
+
+	/* Check the boundary clock port list */
+	if(!bcParseInterfaces(rtOpts)) {
+		ERROR("Error while parsing boundary clock interface list: \"%s\"\n",
+			rtOpts->bcInterfacesText);
+		parseResult = FALSE;
+	} else if(rtOpts->bcPortCount && (rtOpts->slaveOnly || rtOpts->monitorMode)) {
+		ERROR("Error: ptpengine:bc_interfaces cannot be used in slave only or monitor mode\n");
+		parseResult = FALSE;
+	}
+
+	/* The redundant slave runs its second path as another port */
+	rtOpts->bcRedundant = FALSE;
+	if(strlen(rtOpts->redundantInterface)) {
+		if(rtOpts->bcPortCount || rtOpts->domainInstanceCount || rtOpts->monitorMode) {
+			ERROR("Error: ptpengine:redundant_interface cannot be used with ptpengine:bc_interfaces, ptpengine:domain_instances or in monitor mode\n");
+			parseResult = FALSE;
+		} else if(!rtOpts->slaveOnly) {
+			ERROR("Error: ptpengine:redundant_interface requires slave only mode\n");
+			parseResult = FALSE;
+		} else if(!strcmp(rtOpts->redundantInterface, rtOpts->ifaceName)) {
+			ERROR("Error: ptpengine:redundant_interface must differ from ptpengine:interface\n");
+			parseResult = FALSE;
+		} else {
+			memcpy(rtOpts->bcInterfaces[0], rtOpts->redundantInterface,
+				IFACE_NAME_LENGTH);
+			rtOpts->bcPortCount = 1;
+			rtOpts->bcRedundant = TRUE;
+		}
+	}
+
 	/* Scale the maxPPM to PPB */
 	rtOpts->servoMaxPpb *= 1000;
 
@@ -2627,11 +2990,13 @@ return TRUE;
 }
 
 /* Compare two configurations and set flags to mark components requiring restart */
-int checkSubsystemRestart(dictionary* newConfig, dictionary* oldConfig)
+int checkSubsystemRestart(dictionary* newConfig, dictionary* oldConfig, char *reinitKeys, size_t reinitKeysLen)
 {
 
 	UInteger32 restartFlags = 0;
 
+	reinitKeys[0] = '\0';
+
 
 
 /* Settings not requiring component restarts are commented out - reduces number of macro calls */
@@ -2643,24 +3008,27 @@ int checkSubsystemRestart(dictionary* newConfig, dictionary* oldConfig)
  */
 
         COMPONENT_RESTART_REQUIRED("ptpengine:interface",     		PTPD_RESTART_NETWORK );
+        COMPONENT_RESTART_REQUIRED("ptpengine:bc_interfaces",  		PTPD_RESTART_DAEMON );
+        COMPONENT_RESTART_REQUIRED("ptpengine:redundant_interface",	PTPD_RESTART_DAEMON );
         COMPONENT_RESTART_REQUIRED("ptpengine:preset",  		PTPD_RESTART_PROTOCOL );
-        COMPONENT_RESTART_REQUIRED("ptpengine:ip_mode",       		PTPD_RESTART_NETWORK );
+        COMPONENT_RESTART_REQUIRED("ptpengine:ip_mode",       		PTPD_RESTART_SOCKETS );
         COMPONENT_RESTART_REQUIRED("ptpengine:transport",     		PTPD_RESTART_NETWORK );
 #ifdef PTPD_PCAP
         COMPONENT_RESTART_REQUIRED("ptpengine:use_libpcap",   		PTPD_RESTART_NETWORK );
 #endif
         COMPONENT_RESTART_REQUIRED("ptpengine:delay_mechanism",        	PTPD_RESTART_PROTOCOL );
         COMPONENT_RESTART_REQUIRED("ptpengine:domain",    		PTPD_RESTART_PROTOCOL );
+        COMPONENT_RESTART_REQUIRED("ptpengine:domain_instances",	PTPD_RESTART_DAEMON );
 //        COMPONENT_RESTART_REQUIRED("ptpengine:inbound_latency",       PTPD_RESTART_NONE );
 //        COMPONENT_RESTART_REQUIRED("ptpengine:outbound_latency",      PTPD_RESTART_NONE );
 //        COMPONENT_RESTART_REQUIRED("ptpengine:offset_shift",      	PTPD_RESTART_NONE );
 
         COMPONENT_RESTART_REQUIRED("ptpengine:pid_as_clock_identity", 	PTPD_RESTART_PROTOCOL );
-        COMPONENT_RESTART_REQUIRED("ptpengine:ptp_slaveonly",           PTPD_RESTART_PROTOCOL );
+        COMPONENT_RESTART_REQUIRED("ptpengine:slave_only",           PTPD_RESTART_PROTOCOL );
         COMPONENT_RESTART_REQUIRED("ptpengine:log_announce_interval",   PTPD_UPDATE_DATASETS );
         COMPONENT_RESTART_REQUIRED("ptpengine:announce_receipt_timeout",        PTPD_UPDATE_DATASETS );
         COMPONENT_RESTART_REQUIRED("ptpengine:log_sync_interval",     	PTPD_UPDATE_DATASETS );
-        COMPONENT_RESTART_REQUIRED("ptpengine:master_igmp_refresh_interval",     	PTPD_RESTART_PROTOCOL );
+        COMPONENT_RESTART_REQUIRED("ptpengine:master_igmp_refresh_interval",     	PTPD_UPDATE_DATASETS );
 //        COMPONENT_RESTART_REQUIRED("ptpengine:log_delayreq_interval_initial",PTPD_RESTART_NONE );
 #ifdef DBG_SIGUSR2_DUMP_COUNTERS
 //        COMPONENT_RESTART_REQUIRED("ptpengine:sigusr2_clears_counters",      	PTPD_RESTART_NONE );
@@ -2669,6 +3037,10 @@ int checkSubsystemRestart(dictionary* newConfig, dictionary* oldConfig)
         COMPONENT_RESTART_REQUIRED("ptpengine:log_delayreq_interval",   PTPD_UPDATE_DATASETS );
         COMPONENT_RESTART_REQUIRED("ptpengine:log_delayreq_override",   PTPD_UPDATE_DATASETS );
         COMPONENT_RESTART_REQUIRED("ptpengine:foreignrecord_capacity", 	PTPD_RESTART_DAEMON );
+        COMPONENT_RESTART_REQUIRED("ptpengine:monitor",		 	PTPD_RESTART_DAEMON );
+        COMPONENT_RESTART_REQUIRED("ptpengine:monitor_capacity", 	PTPD_RESTART_DAEMON );
+//        COMPONENT_RESTART_REQUIRED("ptpengine:monitor_domains", 	PTPD_RESTART_NONE );
+//        COMPONENT_RESTART_REQUIRED("ptpengine:monitor_timeout", 	PTPD_RESTART_NONE );
         COMPONENT_RESTART_REQUIRED("ptpengine:ptp_allan_variance",    	PTPD_UPDATE_DATASETS );
         COMPONENT_RESTART_REQUIRED("ptpengine:ptp_clock_accuracy",    	PTPD_UPDATE_DATASETS );
         COMPONENT_RESTART_REQUIRED("ptpengine:utc_offset",        	PTPD_UPDATE_DATASETS );
@@ -2685,12 +3057,12 @@ int checkSubsystemRestart(dictionary* newConfig, dictionary* oldConfig)
 //        COMPONENT_RESTART_REQUIRED("ptpengine:prefer_utc_offset_valid", PTPD_RESTART_NONE );
 //        COMPONENT_RESTART_REQUIRED("ptpengine:require_utc_offset_valid", PTPD_RESTART_NONE );
 //        COMPONENT_RESTART_REQUIRED("ptpengine:announce_receipt_grace_period", PTPD_RESTART_NONE );
-        COMPONENT_RESTART_REQUIRED("ptpengine:unicast_address",   	PTPD_RESTART_NETWORK );
+        COMPONENT_RESTART_REQUIRED("ptpengine:unicast_address",   	PTPD_RESTART_SOCKETS );
 //        COMPONENT_RESTART_REQUIRED("ptpengine:management_enable",         	PTPD_RESTART_NONE );
 //        COMPONENT_RESTART_REQUIRED("ptpengine:management_set_enable",         	PTPD_RESTART_NONE );
 //        COMPONENT_RESTART_REQUIRED("ptpengine:igmp_refresh",         	PTPD_RESTART_NONE );
-        COMPONENT_RESTART_REQUIRED("ptpengine:multicast_ttl",        		PTPD_RESTART_NETWORK );
-        COMPONENT_RESTART_REQUIRED("ptpengine:ip_dscp",        		PTPD_RESTART_NETWORK );
+        COMPONENT_RESTART_REQUIRED("ptpengine:multicast_ttl",        		PTPD_RESTART_SOCKETS );
+        COMPONENT_RESTART_REQUIRED("ptpengine:ip_dscp",        		PTPD_RESTART_SOCKETS );
 
 #ifdef PTPD_SNMP
         COMPONENT_RESTART_REQUIRED("global:enable_snmp",       	PTPD_RESTART_DAEMON );
@@ -2733,6 +3105,21 @@ int checkSubsystemRestart(dictionary* newConfig, dictionary* oldConfig)
 //        COMPONENT_RESTART_REQUIRED("clock:set_rtc_on_step",  		PTPD_RESTART_NONE );
 #endif /* HAVE_LINUX_RTC_H */
 //        COMPONENT_RESTART_REQUIRED("clock:drift_file",   		PTPD_RESTART_NONE );
+        COMPONENT_RESTART_REQUIRED("clock:ntp_shm_output",   		PTPD_RESTART_NTPSHM );
+        COMPONENT_RESTART_REQUIRED("clock:ntp_shm_unit",   		PTPD_RESTART_NTPSHM );
+        COMPONENT_RESTART_REQUIRED("ntpserver:enabled",   		PTPD_RESTART_NTPSERVER );
+        COMPONENT_RESTART_REQUIRED("ntpserver:port",   			PTPD_RESTART_NTPSERVER );
+        COMPONENT_RESTART_REQUIRED("ntpserver:bind_address",   		PTPD_RESTART_NTPSERVER );
+        COMPONENT_RESTART_REQUIRED("ptpengine:rate_limit_enable",   	PTPD_RESTART_RATELIMIT );
+        COMPONENT_RESTART_REQUIRED("ptpengine:rate_limit_sources",   	PTPD_RESTART_RATELIMIT );
+        COMPONENT_RESTART_REQUIRED("ptpengine:rate_limit_event",   	PTPD_RESTART_RATELIMIT );
+        COMPONENT_RESTART_REQUIRED("ptpengine:rate_limit_general",   	PTPD_RESTART_RATELIMIT );
+        COMPONENT_RESTART_REQUIRED("ptpengine:rate_limit_announce",   	PTPD_RESTART_RATELIMIT );
+        COMPONENT_RESTART_REQUIRED("ptpengine:rate_limit_management",  	PTPD_RESTART_RATELIMIT );
+        COMPONENT_RESTART_REQUIRED("ptpengine:slave_table",		 	PTPD_RESTART_DAEMON );
+        COMPONENT_RESTART_REQUIRED("ptpengine:slave_table_size", 	PTPD_RESTART_DAEMON );
+//        COMPONENT_RESTART_REQUIRED("ptpengine:slave_timeout", 	PTPD_RESTART_NONE );
+//        COMPONENT_RESTART_REQUIRED("ptpengine:slave_flood_factor", 	PTPD_RESTART_NONE );
 //        COMPONENT_RESTART_REQUIRED("clock:drift_handling",       	PTPD_RESTART_NONE );
 //        COMPONENT_RESTART_REQUIRED("clock:max_offset_ppm",       	PTPD_RESTART_NONE );
 //        COMPONENT_RESTART_REQUIRED("servo:owdfilter_stiffness",         PTPD_RESTART_NONE );
@@ -2766,6 +3153,10 @@ int checkSubsystemRestart(dictionary* newConfig, dictionary* oldConfig)
 //        COMPONENT_RESTART_REQUIRED("global:log_file_file_max_files",		PTPD_RESTART_LOGGING );
 //        COMPONENT_RESTART_REQUIRED("global:status_update_interval",			PTPD_RESTART_LOGGING );
 //        COMPONENT_RESTART_REQUIRED("global:status_file",			PTPD_RESTART_LOGGING );
+        COMPONENT_RESTART_REQUIRED("global:clock_page_file",		PTPD_RESTART_CLOCKPAGE );
+        COMPONENT_RESTART_REQUIRED("global:clock_page",			PTPD_RESTART_CLOCKPAGE );
+        COMPONENT_RESTART_REQUIRED("global:control_socket_file",	PTPD_RESTART_CTLSOCKET );
+        COMPONENT_RESTART_REQUIRED("global:control_socket",		PTPD_RESTART_CTLSOCKET );
 //        COMPONENT_RESTART_REQUIRED("global:log_level",		PTPD_RESTART_NONE );
 //        COMPONENT_RESTART_REQUIRED("global:debug_level",		PTPD_RESTART_NONE );
 //        COMPONENT_RESTART_REQUIRED("global:statistics_file",		PTPD_RESTART_LOGGING );
@@ -2802,8 +3193,8 @@ int checkSubsystemRestart(dictionary* newConfig, dictionary* oldConfig)
 	if(SETTING_CHANGED("ptpengine:slave_only") ||
 		SETTING_CHANGED("ptpengine:clock_class")) {
 
-		int clockClass_old = iniparser_getint(oldConfig,"ptpengine:ptp_clockclass",0);
-		int clockClass_new = iniparser_getint(newConfig,"ptpengine:ptp_clockclass",0);
+		int clockClass_old = iniparser_getint(oldConfig,"ptpengine:clock_class",0);
+		int clockClass_new = iniparser_getint(newConfig,"ptpengine:clock_class",0);
 
 		/*
 		 * We're changing from a mode where slave state is possible
@@ -2819,6 +3210,7 @@ int checkSubsystemRestart(dictionary* newConfig, dictionary* oldConfig)
 			}
 			/* We can potentially be running in a different mode now, restart protocol */
 			restartFlags|=PTPD_RESTART_PROTOCOL;
+			appendReinitKey(reinitKeys, reinitKeysLen, "ptpengine:clock_class");
 		}
 	}
 
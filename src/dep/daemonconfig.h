@@ -19,7 +19,7 @@
 #define PTPD_UPDATE_DATASETS	1 << 1
 /* PTP FSM port re-initialisation required (PTP_INITIALIZING) */
 #define PTPD_RESTART_PROTOCOL	1 << 2
-/* Network config changed: PTP_INITIALIZING handles this so far */
+/* Interface or transport changed: PTP_INITIALIZING required (clock identity may change) */
 #define PTPD_RESTART_NETWORK	1 << 3
 /* Logging config changes: log files need closed / reopened */
 #define PTPD_RESTART_LOGGING	1 << 4
@@ -42,6 +42,24 @@
 #define PTPD_RESTART_NTPCONTROL	1 << 11
 #endif /* PTPD_NTPDC */
 
+/* Clock page file changed - re-create the mapping */
+#define PTPD_RESTART_CLOCKPAGE	1 << 12
+
+/* NTP SHM refclock output settings changed - re-attach the segment */
+#define PTPD_RESTART_NTPSHM	1 << 13
+
+/* NTP server settings changed - re-open the server socket */
+#define PTPD_RESTART_NTPSERVER	1 << 14
+
+/* Rate limiter settings changed - re-create the source table */
+#define PTPD_RESTART_RATELIMIT	1 << 15
+
+/* Control socket settings changed - re-create the socket */
+#define PTPD_RESTART_CTLSOCKET	1 << 16
+
+/* Addressing or socket options changed - re-open sockets, keep port state, servo and BMC data */
+#define PTPD_RESTART_SOCKETS	1 << 17
+
 #define LOG2_HELP "(expressed as log 2 i.e. -1=0.5s, 0=1s, 1=2s etc.)"
 
 /* Structure defining a PTP engine preset */
@@ -72,7 +90,7 @@ PtpEnginePreset getPtpPreset(int presetNumber, RunTimeOpts* rtOpts);
 dictionary* parseConfig (dictionary*, RunTimeOpts*);
 int reloadConfig ( RunTimeOpts*, PtpClock* );
 Boolean compareConfig(dictionary* source, dictionary* target);
-int checkSubsystemRestart(dictionary* newConfig, dictionary* oldConfig);
+int checkSubsystemRestart(dictionary* newConfig, dictionary* oldConfig, char *reinitKeys, size_t reinitKeysLen);
 void printConfigHelp();
 void printDefaultConfig();
 void printShortHelp();
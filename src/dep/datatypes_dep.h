@@ -95,6 +95,15 @@ typedef struct {
 	Ipv4AccessList* timingAcl;
 	Ipv4AccessList* managementAcl;
 
+	RateLimiter* rateLimiter;
+
+	/* what the socket / pcap filters currently accept */
+	Boolean filterEnabled;
+	UInteger8 filterDomain;
+	UInteger8 filterVersion;
+	Boolean filterParentEnabled;
+	Octet filterParent[CLOCK_IDENTITY_LENGTH];
+
 } NetPath;
 
 typedef struct {
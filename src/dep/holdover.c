@@ -0,0 +1,380 @@
+/*-
+ * Copyright (c) 2014 Wojciech Owczarek,
+ *
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file   holdover.c
+ *
+ * @brief  Holdover driven by a learned oscillator model
+ *
+ * While the slave is locked, the servo's observed drift is averaged over
+ * sample intervals and a frequency + aging line is fitted to the recent
+ * history. When the GM is lost, the model is extrapolated and applied to
+ * the clock instead of leaving the last servo output in place, and a
+ * time error bound is grown from the model's residuals. The bound is
+ * published on the clock page, the status file and the control socket,
+ * and is reflected in the advertised clock quality.
+ */
+
+#include "../ptpd.h"
+
+/* clockAccuracy enumeration (1588-2008 Table 6): upper bound in ns */
+static const struct {
+	double bound;
+	Enumeration8 accuracy;
+} holdoverAccuracyTable[] = {
+	{ 25,	0x20 }, { 100,	0x21 }, { 250,	0x22 }, { 1E3,	0x23 },
+	{ 2.5E3,0x24 }, { 1E4,	0x25 }, { 2.5E4,0x26 }, { 1E5,	0x27 },
+	{ 2.5E5,0x28 }, { 1E6,	0x29 }, { 2.5E6,0x2A }, { 1E7,	0x2B },
+	{ 2.5E7,0x2C }, { 1E8,	0x2D }, { 2.5E8,0x2E }, { 1E9,	0x2F },
+	{ 1E10,	0x30 }
+};
+
+/* model times are monotonic - immune to clock steps */
+static double
+holdoverNow(void)
+{
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1E9;
+
+}
+
+static Enumeration8
+holdoverAccuracy(double errorBound)
+{
+
+	int i;
+
+	for(i = 0; i < sizeof(holdoverAccuracyTable) / sizeof(holdoverAccuracyTable[0]); i++)
+		if(errorBound <= holdoverAccuracyTable[i].bound)
+			return holdoverAccuracyTable[i].accuracy;
+
+	return 0x31;
+
+}
+
+/*
+ * Advertised clock class: a primary reference (6, 13) goes into holdover
+ * (7, 14), and once out of holdover specification to degradation
+ * alternative A (52, 58). Other classes are left as configured.
+ */
+static UInteger8
+holdoverClockClass(RunTimeOpts *rtOpts, Boolean expired)
+{
+
+	switch(rtOpts->clockQuality.clockClass) {
+	case 6:
+		return expired ? 52 : 7;
+	case 13:
+		return expired ? 58 : 14;
+	default:
+		return rtOpts->clockQuality.clockClass;
+	}
+
+}
+
+/* Change our clock quality, and have the BMC pick it up if it changed */
+static void
+holdoverSetQuality(PtpClock *ptpClock, UInteger8 clockClass, Enumeration8 clockAccuracy)
+{
+
+	if(ptpClock->clockQuality.clockClass == clockClass &&
+	    ptpClock->clockQuality.clockAccuracy == clockAccuracy)
+		return;
+
+	DBG("Holdover: clockClass %d, clockAccuracy 0x%02x\n", clockClass, clockAccuracy);
+	ptpClock->clockQuality.clockClass = clockClass;
+	ptpClock->clockQuality.clockAccuracy = clockAccuracy;
+	ptpClock->record_update = TRUE;
+	datasetChanged(ptpClock, MGMT_CACHE_DEFAULT_DS);
+
+}
+
+/*
+ * Least squares line through the drift history. The aging term is only
+ * used when it is significant (twice its standard error) - otherwise the
+ * model is the mean frequency, which extrapolates better than noise.
+ */
+static void
+holdoverFit(Holdover *holdover)
+{
+
+	int i, n = holdover->sampleCount;
+	double tMean = 0, dMean = 0, stt = 0, std = 0, ssr = 0, sdd = 0;
+	double slope = 0, dt, res;
+
+	if(n < HOLDOVER_MIN_SAMPLES) {
+		holdover->modelValid = FALSE;
+		return;
+	}
+
+	for(i = 0; i < n; i++) {
+		tMean += holdover->sampleTime[i];
+		dMean += holdover->sampleDrift[i];
+	}
+	tMean /= n;
+	dMean /= n;
+
+	for(i = 0; i < n; i++) {
+		dt = holdover->sampleTime[i] - tMean;
+		stt += dt * dt;
+		std += dt * (holdover->sampleDrift[i] - dMean);
+		sdd += (holdover->sampleDrift[i] - dMean) * (holdover->sampleDrift[i] - dMean);
+	}
+
+	if(stt > 0)
+		slope = std / stt;
+
+	for(i = 0; i < n; i++) {
+		res = holdover->sampleDrift[i] - dMean -
+			slope * (holdover->sampleTime[i] - tMean);
+		ssr += res * res;
+	}
+
+	holdover->agingError = (stt > 0) ? sqrt(ssr / (n - 2) / stt) : 0;
+
+	if(fabs(slope) > 2 * holdover->agingError) {
+		holdover->aging = slope;
+		holdover->frequencyError = sqrt(ssr / (n - 2));
+	} else {
+		holdover->aging = 0;
+		holdover->frequencyError = sqrt(sdd / (n - 1));
+	}
+
+	holdover->modelTime = tMean;
+	holdover->frequency = dMean;
+	holdover->modelValid = TRUE;
+
+	DBG("Holdover model: %d samples, frequency %.3f ppb, aging %.6f ppb/s, "
+		"dev %.3f ppb\n", n, holdover->frequency, holdover->aging,
+		holdover->frequencyError);
+
+}
+
+/* Extrapolate the model to now, steer the clock and grow the error bound */
+static void
+holdoverApply(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	Holdover *holdover = &ptpClock->holdover;
+	double now = holdoverNow();
+	double t, frequency;
+
+	t = now - holdover->startTime;
+	frequency = holdover->frequency + holdover->aging * (now - holdover->modelTime);
+
+	if(frequency > rtOpts->servoMaxPpb)
+		frequency = rtOpts->servoMaxPpb;
+	else if(frequency < -rtOpts->servoMaxPpb)
+		frequency = -rtOpts->servoMaxPpb;
+
+	holdover->elapsed = t;
+	holdover->appliedFrequency = frequency;
+	ptpClock->servo.observedDrift = frequency;
+#ifdef HAVE_SYS_TIMEX_H
+	adjFreq_wrapper(rtOpts, ptpClock, -frequency);
+#endif /* HAVE_SYS_TIMEX_H */
+
+	/* ppb * s = ns */
+	holdover->errorRate = HOLDOVER_SIGMA *
+		(holdover->frequencyError + holdover->agingError * t);
+	holdover->errorBound = holdover->initialError + HOLDOVER_SIGMA *
+		(holdover->frequencyError * t + 0.5 * holdover->agingError * t * t);
+
+	holdoverSetQuality(ptpClock, holdoverClockClass(rtOpts, FALSE),
+		holdoverAccuracy(holdover->errorBound));
+
+	clockPageUpdate(rtOpts, ptpClock, FALSE);
+
+}
+
+/**
+ * Feed the model with the outcome of a clock update. Only updates from
+ * a locked servo are used: no offset in seconds, not slewing at the
+ * maximum rate, not in panic mode, and stable if stability detection
+ * is enabled.
+ */
+void
+holdoverFeed(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	Holdover *holdover = &ptpClock->holdover;
+	double now;
+
+	if(!rtOpts->holdoverEnabled || holdover->active)
+		return;
+
+	if(ptpClock->offsetFromMaster.seconds || ptpClock->servo.runningMaxOutput ||
+	    ptpClock->panicMode)
+		return;
+
+#ifdef PTPD_STATISTICS
+	if(rtOpts->servoStabilityDetection && !ptpClock->servo.isStable)
+		return;
+#endif /* PTPD_STATISTICS */
+
+	holdover->lastError = fabs((double)ptpClock->offsetFromMaster.nanoseconds);
+#ifdef PTPD_STATISTICS
+	if(ptpClock->slaveStats.statsCalculated)
+		holdover->lastError += HOLDOVER_SIGMA * ptpClock->slaveStats.ofmStdDev * 1E9;
+#endif /* PTPD_STATISTICS */
+
+	now = holdoverNow();
+
+	if(holdover->binCount == 0)
+		holdover->binStart = now;
+
+	holdover->binSum += ptpClock->servo.observedDrift;
+	holdover->binCount++;
+
+	if(now - holdover->binStart < rtOpts->holdoverSampleInterval)
+		return;
+
+	holdover->sampleTime[holdover->sampleHead] = (holdover->binStart + now) / 2;
+	holdover->sampleDrift[holdover->sampleHead] = holdover->binSum / holdover->binCount;
+	holdover->sampleHead = (holdover->sampleHead + 1) % HOLDOVER_MAX_SAMPLES;
+	if(holdover->sampleCount < HOLDOVER_MAX_SAMPLES)
+		holdover->sampleCount++;
+
+	holdover->binSum = 0;
+	holdover->binCount = 0;
+
+	holdoverFit(holdover);
+
+}
+
+/**
+ * The GM was lost: start applying the model, if we have one.
+ */
+void
+holdoverStart(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	Holdover *holdover = &ptpClock->holdover;
+
+	if(!rtOpts->holdoverEnabled || holdover->active || rtOpts->noAdjust)
+		return;
+
+	/* a partial sample may already include the GM outage */
+	holdover->binSum = 0;
+	holdover->binCount = 0;
+
+	if(!holdover->modelValid) {
+		WARNING("GM lost before the oscillator model was learned - no holdover\n");
+		return;
+	}
+
+#ifdef HAVE_SYS_TIMEX_H
+	holdover->active = TRUE;
+	holdover->expired = FALSE;
+	holdover->startTime = holdoverNow();
+	holdover->initialError = holdover->lastError;
+
+	NOTICE("Entering holdover: frequency %.3f ppm, aging %.3f ppb/h, "
+		"model of %d samples\n", holdover->frequency / 1000.0,
+		holdover->aging * 3600.0, holdover->sampleCount);
+
+	holdoverApply(rtOpts, ptpClock);
+	timerStart(HOLDOVER_UPDATE_TIMER, HOLDOVER_UPDATE_INTERVAL, ptpClock->itimer);
+#else
+	DBG("Holdover not supported without frequency adjustment\n");
+#endif /* HAVE_SYS_TIMEX_H */
+
+}
+
+/**
+ * Periodic holdover update: steer the clock along the model until the
+ * holdover timeout, then leave it free running at the last frequency.
+ */
+void
+holdoverUpdate(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	Holdover *holdover = &ptpClock->holdover;
+
+	/* disabled on reload */
+	if(!rtOpts->holdoverEnabled) {
+		holdoverStop(rtOpts, ptpClock, TRUE);
+		return;
+	}
+
+	if(!holdover->active) {
+		timerStop(HOLDOVER_UPDATE_TIMER, ptpClock->itimer);
+		return;
+	}
+
+	holdoverApply(rtOpts, ptpClock);
+
+	if(rtOpts->holdoverTimeout && holdover->elapsed >= rtOpts->holdoverTimeout) {
+		WARNING("Holdover timeout after %.0f seconds, error bound %.0f ns: "
+			"clock free running at %.3f ppm\n", holdover->elapsed,
+			holdover->errorBound, holdover->appliedFrequency / 1000.0);
+		holdover->active = FALSE;
+		holdover->expired = TRUE;
+		timerStop(HOLDOVER_UPDATE_TIMER, ptpClock->itimer);
+		holdoverSetQuality(ptpClock, holdoverClockClass(rtOpts, TRUE), 0xFE);
+		clockPageUpdate(rtOpts, ptpClock, FALSE);
+	}
+
+}
+
+/**
+ * Leave holdover (or free running after it): we have a master again,
+ * or the port is being re-initialised. The configured clock quality
+ * is restored. With keepFrequency, the servo takes over from the last
+ * holdover frequency rather than from the restored drift.
+ */
+void
+holdoverStop(RunTimeOpts *rtOpts, PtpClock *ptpClock, Boolean keepFrequency)
+{
+
+	Holdover *holdover = &ptpClock->holdover;
+
+	if(holdover->active)
+		NOTICE("Leaving holdover after %.0f seconds, error bound %.0f ns\n",
+			holdover->elapsed, holdover->errorBound);
+
+	if(holdover->active || holdover->expired) {
+		holdoverSetQuality(ptpClock, rtOpts->clockQuality.clockClass,
+			rtOpts->clockQuality.clockAccuracy);
+		ptpClock->clockQuality.offsetScaledLogVariance =
+			rtOpts->clockQuality.offsetScaledLogVariance;
+		if(keepFrequency && !rtOpts->noAdjust) {
+			ptpClock->servo.observedDrift = holdover->appliedFrequency;
+#ifdef HAVE_SYS_TIMEX_H
+			adjFreq_wrapper(rtOpts, ptpClock, -holdover->appliedFrequency);
+#endif /* HAVE_SYS_TIMEX_H */
+		}
+	}
+
+	holdover->active = FALSE;
+	holdover->expired = FALSE;
+	timerStop(HOLDOVER_UPDATE_TIMER, ptpClock->itimer);
+
+}
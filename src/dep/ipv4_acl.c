@@ -174,6 +174,12 @@ static int parseAclEntry(const char* line, AclEntry* acl) {
     } else {
 
 	acl->bitmask = (mask_octets[0] << 24) | (mask_octets[1] << 16) | ( mask_octets[2] << 8) | mask_octets[3];
+	/* the lookup trie matches on prefixes: 255.255.253.0 has no prefix length */
+	if(~acl->bitmask & (~acl->bitmask + 1)) {
+	    ERROR("Non-contiguous netmask in access list entry \"%s\"\n", line);
+	    result=-1;
+	    goto end;
+	}
 	uint32_t tmp = acl->bitmask;
 	int count = 0;
 	for(tmp = acl->bitmask;tmp<<count;count++);
@@ -256,6 +262,85 @@ maskParser(const char* input, AclEntry* output)
 
 }
 
+/* Free a MaskTable structure */
+static void freeMaskTable(MaskTable** table)
+{
+    if(*table == NULL)
+	return;
+
+    if((*table)->entries != NULL) {
+	free((*table)->entries);
+	(*table)->entries = NULL;
+    }
+    if((*table)->nodes != NULL) {
+	free((*table)->nodes);
+	(*table)->nodes = NULL;
+    }
+    free(*table);
+    *table = NULL;
+}
+
+/* Allocate a new trie node, growing the node pool as needed - return -1 on error */
+static int32_t
+newTrieNode(MaskTable* table)
+{
+
+	AclTrieNode* nodes;
+	int maxNodes;
+
+	if(table->numNodes == table->maxNodes) {
+		maxNodes = table->maxNodes ? table->maxNodes * 2 : 64;
+		nodes = (AclTrieNode*)realloc(table->nodes, maxNodes * sizeof(AclTrieNode));
+		if(nodes == NULL)
+			return -1;
+		table->nodes = nodes;
+		table->maxNodes = maxNodes;
+	}
+
+	table->nodes[table->numNodes].child[0] = -1;
+	table->nodes[table->numNodes].child[1] = -1;
+	table->nodes[table->numNodes].entry = -1;
+
+	return table->numNodes++;
+
+}
+
+/*
+ * Compile the table entries into a binary prefix trie: entry i is
+ * attached to the node reached by the first netmask bits of its network.
+ * Duplicate prefixes keep the first entry.
+ */
+static Boolean
+compileMaskTable(MaskTable* table)
+{
+
+	int i, bit;
+	int32_t node, next;
+	AclEntry* entry;
+
+	if(newTrieNode(table) < 0)
+		return FALSE;
+
+	for(i = 0; i < table->numEntries; i++) {
+		entry = &table->entries[i];
+		node = 0;
+		for(bit = 0; bit < entry->netmask; bit++) {
+			next = table->nodes[node].child[(entry->network >> (31 - bit)) & 1];
+			if(next < 0) {
+				if((next = newTrieNode(table)) < 0)
+					return FALSE;
+				table->nodes[node].child[(entry->network >> (31 - bit)) & 1] = next;
+			}
+			node = next;
+		}
+		if(table->nodes[node].entry < 0)
+			table->nodes[node].entry = i;
+	}
+
+	return TRUE;
+
+}
+
 /* Create a maskTable from a text ACL */
 static MaskTable*
 createMaskTable(const char* input)
@@ -266,6 +351,12 @@ createMaskTable(const char* input)
 		ret=(MaskTable*)calloc(1,sizeof(MaskTable));
 		ret->entries = (AclEntry*)calloc(masksFound, sizeof(AclEntry));
 		ret->numEntries = maskParser(input,ret->entries);
+		/* short tables are faster to scan than to walk */
+		if(ret->numEntries >= ACL_TRIE_MIN_ENTRIES && !compileMaskTable(ret)) {
+			ERROR("Could not allocate memory for access list: \"%s\"\n", input);
+			freeMaskTable(&ret);
+			return NULL;
+		}
 		return ret;
 	} else {
 		ERROR("Error while parsing access list: \"%s\"\n", input);
@@ -299,20 +390,6 @@ dumpMaskTable(MaskTable* table)
 
 }
 
-/* Free a MaskTable structure */
-static void freeMaskTable(MaskTable** table)
-{
-    if(*table == NULL)
-	return;
-
-    if((*table)->entries != NULL) {
-	free((*table)->entries);
-	(*table)->entries = NULL;
-    }
-    free(*table);
-    *table = NULL;
-}
-
 /* Destroy an Ipv4AccessList structure */
 void 
 freeIpv4AccessList(Ipv4AccessList** acl)
@@ -344,23 +421,74 @@ createIpv4AccessList(const char* permitList, const char* denyList, int processin
 }
 
 
-/* Match an IP address against a MaskTable */
-static int
-matchAddress(const uint32_t addr, MaskTable* table)
+/* Longest matching prefix by a pass over the entries - for short tables, without a trie */
+static int32_t
+scanMaskTable(const uint32_t addr, MaskTable* table)
 {
 
 	int i;
-	if(table == NULL || table->entries == NULL || table->numEntries==0)
-	    return -1;
-	for(i = 0; i < table->numEntries; i++) {
-		DBGV("addr: %08x, addr & mask: %08x, network: %08x\n",addr, table->entries[i].bitmask & addr, table->entries[i].network);
-		if((table->entries[i].bitmask & addr) == table->entries[i].network) {
-			table->entries[i].hitCount++;
-			return 1;
+	int netmask = -1;
+	int32_t match = -1;
+	const AclEntry* entry = table->entries;
+
+	for(i = 0; i < table->numEntries; i++, entry++) {
+		if((addr & entry->bitmask) == entry->network && entry->netmask > netmask) {
+			netmask = entry->netmask;
+			match = i;
 		}
 	}
 
-	return 0;
+	return match;
+
+}
+
+/* Longest matching prefix by a walk down the trie along the address bits */
+static int32_t
+walkMaskTable(const uint32_t addr, MaskTable* table)
+{
+
+	int bit;
+	int32_t node;
+	int32_t match;
+
+	match = table->nodes[0].entry;
+	for(node = 0, bit = 0; bit < 32; bit++) {
+		node = table->nodes[node].child[(addr >> (31 - bit)) & 1];
+		if(node < 0)
+			break;
+		if(table->nodes[node].entry >= 0)
+			match = table->nodes[node].entry;
+	}
+
+	return match;
+
+}
+
+/*
+ * Match an IP address against a MaskTable: the longest matching prefix
+ * gets the hit, whether the table is scanned or has a trie.
+ */
+static int
+matchAddress(const uint32_t addr, MaskTable* table)
+{
+
+	int32_t match;
+
+	if(table == NULL || table->numEntries==0)
+	    return -1;
+
+	if(table->nodes != NULL)
+		match = walkMaskTable(addr, table);
+	else
+		match = scanMaskTable(addr, table);
+
+	if(match < 0)
+		return 0;
+
+	DBGV("addr: %08x matched network: %08x/%d\n", addr,
+		table->entries[match].network, table->entries[match].netmask);
+	table->entries[match].hitCount++;
+	return 1;
 
 }
 
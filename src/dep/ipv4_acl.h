@@ -23,9 +23,27 @@ typedef struct {
 	uint32_t hitCount;
 } AclEntry;
 
+/*
+ * Mask tables with fewer entries are scanned rather than compiled into a
+ * trie: up to here a pass over the entries is the faster lookup (test/acl_bench)
+ */
+#ifndef ACL_TRIE_MIN_ENTRIES
+#define ACL_TRIE_MIN_ENTRIES 64
+#endif
+
+/* Binary prefix trie node: children and entry are indexes, -1 if none */
+typedef struct {
+	int32_t child[2];
+	int32_t entry;
+} AclTrieNode;
+
 typedef struct {
 	int numEntries;
 	AclEntry* entries;
+	/* entries compiled into a prefix trie, node 0 is the root - NULL for short tables */
+	int numNodes;
+	int maxNodes;
+	AclTrieNode* nodes;
 } MaskTable;
 
 typedef struct {
@@ -164,12 +164,44 @@ packInteger64( void* i, void *buf )
 	packUInteger32(&((Integer64*)i)->lsb, buf + 4);
 }
 
+/*
+ * Management arena: every dynamic allocation made while decoding a
+ * management message and building the response comes from one fixed
+ * buffer in PtpClock, released at once before the next message
+ */
+void*
+managementArenaAlloc(ManagementArena *arena, size_t size)
+{
+	void *ret;
+	/* keep every allocation 8-byte aligned */
+	size_t aligned = (size + 7) & ~(size_t)7;
+
+	/* like malloc(0), a zero size request still returns a usable pointer */
+	if(aligned > sizeof(arena->memory) - arena->used) {
+		arena->failures++;
+		return NULL;
+	}
+
+	ret = (char*)arena->memory + arena->used;
+	arena->used += aligned;
+	if(arena->used > arena->highWater)
+		arena->highWater = arena->used;
+
+	return ret;
+}
+
+void
+managementArenaReset(ManagementArena *arena)
+{
+	arena->used = 0;
+}
+
 /* NOTE: the unpack functions for management messages can probably be refactored into a macro */
 void
 unpackMMSlaveOnly( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
 	int offset = 0;
-	XMALLOC(m->tlv->dataField, sizeof(MMSlaveOnly));
+	XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMSlaveOnly));
 	MMSlaveOnly* data = (MMSlaveOnly*)m->tlv->dataField;
 	/* see src/def/README for a note on this X-macro */
 	#define OPERATE( name, size, type ) \
@@ -203,7 +235,7 @@ void
 unpackMMClockDescription( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
 	int offset = 0;
-	XMALLOC(m->tlv->dataField, sizeof(MMClockDescription));
+	XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMClockDescription));
 	MMClockDescription* data = (MMClockDescription*)m->tlv->dataField;
 	memset(data, 0, sizeof(MMClockDescription));
 	#define OPERATE( name, size, type ) \
@@ -253,7 +285,7 @@ void
 unpackMMUserDescription( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
 	int offset = 0;
-	XMALLOC(m->tlv->dataField, sizeof(MMUserDescription));
+	XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMUserDescription));
 	MMUserDescription* data = (MMUserDescription*)m->tlv->dataField;
 	memset(data, 0, sizeof(MMUserDescription));
 	#define OPERATE( name, size, type ) \
@@ -301,7 +333,7 @@ freeMMUserDescription( MMUserDescription* data)
 void unpackMMInitialize( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
         int offset = 0;
-        XMALLOC(m->tlv->dataField, sizeof(MMInitialize));
+        XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMInitialize));
         MMInitialize* data = (MMInitialize*)m->tlv->dataField;
         #define OPERATE( name, size, type ) \
                 unpack##type( buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset,\
@@ -332,7 +364,7 @@ packMMInitialize( MsgManagement* m, Octet *buf)
 void unpackMMDefaultDataSet( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
         int offset = 0;
-        XMALLOC(m->tlv->dataField, sizeof(MMDefaultDataSet));
+        XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMDefaultDataSet));
         MMDefaultDataSet* data = (MMDefaultDataSet*)m->tlv->dataField;
         #define OPERATE( name, size, type ) \
                 unpack##type( buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset,\
@@ -363,7 +395,7 @@ packMMDefaultDataSet( MsgManagement* m, Octet *buf)
 void unpackMMCurrentDataSet( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
         int offset = 0;
-        XMALLOC(m->tlv->dataField, sizeof(MMCurrentDataSet));
+        XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMCurrentDataSet));
         MMCurrentDataSet* data = (MMCurrentDataSet*)m->tlv->dataField;
         #define OPERATE( name, size, type ) \
                 unpack##type( buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset,\
@@ -394,7 +426,7 @@ packMMCurrentDataSet( MsgManagement* m, Octet *buf)
 void unpackMMParentDataSet( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
         int offset = 0;
-        XMALLOC(m->tlv->dataField, sizeof(MMParentDataSet));
+        XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMParentDataSet));
         MMParentDataSet* data = (MMParentDataSet*)m->tlv->dataField;
         #define OPERATE( name, size, type ) \
                 unpack##type( buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset,\
@@ -425,7 +457,7 @@ packMMParentDataSet( MsgManagement* m, Octet *buf)
 void unpackMMTimePropertiesDataSet( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
         int offset = 0;
-        XMALLOC(m->tlv->dataField, sizeof(MMTimePropertiesDataSet));
+        XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMTimePropertiesDataSet));
         MMTimePropertiesDataSet* data = (MMTimePropertiesDataSet*)m->tlv->dataField;
         #define OPERATE( name, size, type ) \
                 unpack##type( buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset,\
@@ -456,7 +488,7 @@ packMMTimePropertiesDataSet( MsgManagement* m, Octet *buf)
 void unpackMMPortDataSet( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
         int offset = 0;
-        XMALLOC(m->tlv->dataField, sizeof(MMPortDataSet));
+        XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMPortDataSet));
         MMPortDataSet* data = (MMPortDataSet*)m->tlv->dataField;
         #define OPERATE( name, size, type ) \
                 unpack##type( buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset,\
@@ -487,7 +519,7 @@ packMMPortDataSet( MsgManagement* m, Octet *buf)
 void unpackMMPriority1( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
         int offset = 0;
-        XMALLOC(m->tlv->dataField, sizeof(MMPriority1));
+        XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMPriority1));
         MMPriority1* data = (MMPriority1*)m->tlv->dataField;
         #define OPERATE( name, size, type ) \
                 unpack##type( buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset,\
@@ -518,7 +550,7 @@ packMMPriority1( MsgManagement* m, Octet *buf)
 void unpackMMPriority2( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
         int offset = 0;
-        XMALLOC(m->tlv->dataField, sizeof(MMPriority2));
+        XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMPriority2));
         MMPriority2* data = (MMPriority2*)m->tlv->dataField;
         #define OPERATE( name, size, type ) \
                 unpack##type( buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset,\
@@ -549,7 +581,7 @@ packMMPriority2( MsgManagement* m, Octet *buf)
 void unpackMMDomain( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
         int offset = 0;
-        XMALLOC(m->tlv->dataField, sizeof(MMDomain));
+        XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMDomain));
         MMDomain* data = (MMDomain*)m->tlv->dataField;
         #define OPERATE( name, size, type ) \
                 unpack##type( buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset,\
@@ -580,7 +612,7 @@ packMMDomain( MsgManagement* m, Octet *buf)
 void unpackMMLogAnnounceInterval( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
         int offset = 0;
-        XMALLOC(m->tlv->dataField, sizeof(MMLogAnnounceInterval));
+        XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMLogAnnounceInterval));
         MMLogAnnounceInterval* data = (MMLogAnnounceInterval*)m->tlv->dataField;
         #define OPERATE( name, size, type ) \
                 unpack##type( buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset,\
@@ -611,7 +643,7 @@ packMMLogAnnounceInterval( MsgManagement* m, Octet *buf)
 void unpackMMAnnounceReceiptTimeout( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
         int offset = 0;
-        XMALLOC(m->tlv->dataField,sizeof(MMAnnounceReceiptTimeout));
+        XMALLOC_MANAGEMENT(m->tlv->dataField,sizeof(MMAnnounceReceiptTimeout));
         MMAnnounceReceiptTimeout* data = (MMAnnounceReceiptTimeout*)m->tlv->dataField;
         #define OPERATE( name, size, type ) \
                 unpack##type( buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset,\
@@ -642,7 +674,7 @@ packMMAnnounceReceiptTimeout( MsgManagement* m, Octet *buf)
 void unpackMMLogSyncInterval( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
         int offset = 0;
-        XMALLOC(m->tlv->dataField, sizeof(MMLogSyncInterval));
+        XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMLogSyncInterval));
         MMLogSyncInterval* data = (MMLogSyncInterval*)m->tlv->dataField;
         #define OPERATE( name, size, type ) \
                 unpack##type( buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset,\
@@ -673,7 +705,7 @@ packMMLogSyncInterval( MsgManagement* m, Octet *buf)
 void unpackMMVersionNumber( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
         int offset = 0;
-        XMALLOC(m->tlv->dataField, sizeof(MMVersionNumber));
+        XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMVersionNumber));
         MMVersionNumber* data = (MMVersionNumber*)m->tlv->dataField;
         #define OPERATE( name, size, type ) \
                 unpack##type( buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset,\
@@ -704,7 +736,7 @@ packMMVersionNumber( MsgManagement* m, Octet *buf)
 void unpackMMTime( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
         int offset = 0;
-        XMALLOC(m->tlv->dataField, sizeof(MMTime));
+        XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMTime));
         MMTime* data = (MMTime*)m->tlv->dataField;
         #define OPERATE( name, size, type ) \
                 unpack##type( buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset,\
@@ -735,7 +767,7 @@ packMMTime( MsgManagement* m, Octet *buf)
 void unpackMMClockAccuracy( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
         int offset = 0;
-        XMALLOC(m->tlv->dataField, sizeof(MMClockAccuracy));
+        XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMClockAccuracy));
         MMClockAccuracy* data = (MMClockAccuracy*)m->tlv->dataField;
         #define OPERATE( name, size, type ) \
                 unpack##type( buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset,\
@@ -766,7 +798,7 @@ packMMClockAccuracy( MsgManagement* m, Octet *buf)
 void unpackMMUtcProperties( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
         int offset = 0;
-        XMALLOC(m->tlv->dataField, sizeof(MMUtcProperties));
+        XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMUtcProperties));
         MMUtcProperties* data = (MMUtcProperties*)m->tlv->dataField;
         #define OPERATE( name, size, type ) \
                 unpack##type( buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset,\
@@ -797,7 +829,7 @@ packMMUtcProperties( MsgManagement* m, Octet *buf)
 void unpackMMTraceabilityProperties( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
         int offset = 0;
-        XMALLOC(m->tlv->dataField, sizeof(MMTraceabilityProperties));
+        XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMTraceabilityProperties));
         MMTraceabilityProperties* data = (MMTraceabilityProperties*)m->tlv->dataField;
         #define OPERATE( name, size, type ) \
                 unpack##type( buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset,\
@@ -828,7 +860,7 @@ packMMTraceabilityProperties( MsgManagement* m, Octet *buf)
 void unpackMMDelayMechanism( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
         int offset = 0;
-        XMALLOC(m->tlv->dataField, sizeof(MMDelayMechanism));
+        XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMDelayMechanism));
         MMDelayMechanism* data = (MMDelayMechanism*)m->tlv->dataField;
         #define OPERATE( name, size, type ) \
                 unpack##type( buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset,\
@@ -859,7 +891,7 @@ packMMDelayMechanism( MsgManagement* m, Octet *buf)
 void unpackMMLogMinPdelayReqInterval( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
         int offset = 0;
-        XMALLOC(m->tlv->dataField, sizeof(MMLogMinPdelayReqInterval));
+        XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMLogMinPdelayReqInterval));
         MMLogMinPdelayReqInterval* data = (MMLogMinPdelayReqInterval*)m->tlv->dataField;
         #define OPERATE( name, size, type ) \
                 unpack##type( buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset,\
@@ -887,10 +919,70 @@ packMMLogMinPdelayReqInterval( MsgManagement* m, Octet *buf)
         return offset;
 }
 
+UInteger16
+packMMPtpdCounters( MsgManagement* m, Octet *buf)
+{
+        int offset = 0;
+        MMPtpdCounters* data = (MMPtpdCounters*)m->tlv->dataField;
+        #define OPERATE( name, size, type ) \
+                pack##type( &data->name,\
+                            buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset ); \
+                offset = offset + size;
+        #include "../def/managementTLV/ptpdCounters.def"
+
+        /* return length*/
+        return offset;
+}
+
+UInteger16
+packMMPtpdServo( MsgManagement* m, Octet *buf)
+{
+        int offset = 0;
+        MMPtpdServo* data = (MMPtpdServo*)m->tlv->dataField;
+        #define OPERATE( name, size, type ) \
+                pack##type( &data->name,\
+                            buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset ); \
+                offset = offset + size;
+        #include "../def/managementTLV/ptpdServo.def"
+
+        /* return length*/
+        return offset;
+}
+
+UInteger16
+packMMPtpdSlaveStats( MsgManagement* m, Octet *buf)
+{
+        int offset = 0;
+        MMPtpdSlaveStats* data = (MMPtpdSlaveStats*)m->tlv->dataField;
+        #define OPERATE( name, size, type ) \
+                pack##type( &data->name,\
+                            buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset ); \
+                offset = offset + size;
+        #include "../def/managementTLV/ptpdSlaveStats.def"
+
+        /* return length*/
+        return offset;
+}
+
+UInteger16
+packMMPtpdSlaveTable( MsgManagement* m, Octet *buf)
+{
+        int offset = 0;
+        MMPtpdSlaveTable* data = (MMPtpdSlaveTable*)m->tlv->dataField;
+        #define OPERATE( name, size, type ) \
+                pack##type( &data->name,\
+                            buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset ); \
+                offset = offset + size;
+        #include "../def/managementTLV/ptpdSlaveTable.def"
+
+        /* return length*/
+        return offset;
+}
+
 void unpackMMErrorStatus( Octet *buf, MsgManagement* m, PtpClock* ptpClock)
 {
         int offset = 0;
-        XMALLOC(m->tlv->dataField, sizeof(MMErrorStatus));
+        XMALLOC_MANAGEMENT(m->tlv->dataField, sizeof(MMErrorStatus));
         MMErrorStatus* data = (MMErrorStatus*)m->tlv->dataField;
         #define OPERATE( name, size, type ) \
                 unpack##type( buf + MANAGEMENT_LENGTH + TLV_LENGTH + offset,\
@@ -1076,11 +1168,14 @@ unpackPortAddress( Octet *buf, PortAddress *p, PtpClock *ptpClock)
 {
 	unpackEnumeration16( buf, &p->networkProtocol, ptpClock);
 	unpackUInteger16( buf+2, &p->addressLength, ptpClock);
-	if(p->addressLength) {
-		XMALLOC(p->addressField, p->addressLength);
+	p->addressField = NULL;
+	if(p->addressLength > PACKET_SIZE ||
+	    (p->addressLength && !(p->addressField =
+	    managementArenaAlloc(&ptpClock->managementArena, p->addressLength)))) {
+		DBG("Discarding %d octet port address\n", p->addressLength);
+		p->addressLength = 0;
+	} else if(p->addressLength) {
 		memcpy( p->addressField, buf+4, p->addressLength);
-	} else {
-		p->addressField = NULL;
 	}
 }
 
@@ -1097,21 +1192,21 @@ packPortAddress(PortAddress *p, Octet *buf)
 void
 freePortAddress(PortAddress *p)
 {
-	if(p->addressField) {
-		free(p->addressField);
-		p->addressField = NULL;
-	}
+	/* memory belongs to the management arena */
+	p->addressField = NULL;
 }
 
 void
 unpackPTPText( Octet *buf, PTPText *s, PtpClock *ptpClock)
 {
 	unpackUInteger8( buf, &s->lengthField, ptpClock);
-	if(s->lengthField) {
-		XMALLOC(s->textField, s->lengthField);
+	s->textField = NULL;
+	if(s->lengthField && !(s->textField =
+	    managementArenaAlloc(&ptpClock->managementArena, s->lengthField))) {
+		DBG("Discarding %d octet text field\n", s->lengthField);
+		s->lengthField = 0;
+	} else if(s->lengthField) {
 		memcpy( s->textField, buf+1, s->lengthField);
-	} else {
-		s->textField = NULL;
 	}
 }
 
@@ -1127,21 +1222,22 @@ packPTPText(PTPText *s, Octet *buf)
 void
 freePTPText(PTPText *s)
 {
-	if(s->textField) {
-		free(s->textField);
-		s->textField = NULL;
-	}
+	/* memory belongs to the management arena */
+	s->textField = NULL;
 }
 
 void
 unpackPhysicalAddress( Octet *buf, PhysicalAddress *p, PtpClock *ptpClock)
 {
 	unpackUInteger16( buf, &p->addressLength, ptpClock);
-	if(p->addressLength) {
-		XMALLOC(p->addressField, p->addressLength);
+	p->addressField = NULL;
+	if(p->addressLength > PACKET_SIZE ||
+	    (p->addressLength && !(p->addressField =
+	    managementArenaAlloc(&ptpClock->managementArena, p->addressLength)))) {
+		DBG("Discarding %d octet physical address\n", p->addressLength);
+		p->addressLength = 0;
+	} else if(p->addressLength) {
 		memcpy( p->addressField, buf+2, p->addressLength);
-	} else {
-		p->addressField = NULL;
 	}
 }
 
@@ -1157,10 +1253,8 @@ packPhysicalAddress(PhysicalAddress *p, Octet *buf)
 void
 freePhysicalAddress(PhysicalAddress *p)
 {
-	if(p->addressField) {
-		free(p->addressField);
-		p->addressField = NULL;
-	}
+	/* memory belongs to the management arena */
+	p->addressField = NULL;
 }
 
 void
@@ -1207,7 +1301,7 @@ void
 unpackManagementTLV(Octet *buf, MsgManagement *m, PtpClock* ptpClock)
 {
 	int offset = 0;
-	XMALLOC(m->tlv, sizeof(ManagementTLV));
+	XMALLOC_MANAGEMENT(m->tlv, sizeof(ManagementTLV));
 	/* read the management TLV */
 	#define OPERATE( name, size, type ) \
 		unpack##type( buf + MANAGEMENT_LENGTH + offset, &m->tlv->name, ptpClock ); \
@@ -1236,10 +1330,9 @@ freeManagementTLV(MsgManagement *m)
                         } else if(m->tlv->tlvType == TLV_MANAGEMENT_ERROR_STATUS) {
                                 freeMMErrorStatusTLV(m->tlv);
                         }
-                        free(m->tlv->dataField);
 			m->tlv->dataField = NULL;
                 }
-                free(m->tlv);
+		/* memory goes back to the management arena with managementArenaReset() */
 		m->tlv = NULL;
         }
 }
@@ -1591,6 +1684,123 @@ msgPackDelayResp(Octet * buf, MsgHeader * header, Timestamp * receiveTimestamp,
 		flip16(header->sourcePortIdentity.portNumber);
 }
 
+/*
+ * Transmit templates: Sync, Follow_Up, Delay_Req and Delay_Resp are packed
+ * once with the full packers above, and only the per-message fields are
+ * patched in on the hot path. The templates are rebuilt whenever any of
+ * the inputs the packers use changes.
+ */
+
+/* Do the templates still match the datasets they were built from? */
+static inline Boolean
+msgTxTemplatesCurrent(PtpClock * ptpClock)
+{
+	TxTemplateKey *key = &ptpClock->txTemplateKey;
+
+	return ptpClock->txTemplatesValid &&
+	    key->logSyncInterval == ptpClock->logSyncInterval &&
+	    key->logMinDelayReqInterval == ptpClock->logMinDelayReqInterval &&
+	    key->domainNumber == ptpClock->domainNumber &&
+	    key->portIdentity.portNumber == ptpClock->portIdentity.portNumber &&
+	    key->twoStepFlag == ptpClock->twoStepFlag &&
+	    key->versionNumber == ptpClock->versionNumber &&
+	    key->transport == rtOpts.transport &&
+	    key->ipMode == rtOpts.ip_mode &&
+	    !memcmp(key->portIdentity.clockIdentity, ptpClock->portIdentity.clockIdentity,
+		CLOCK_IDENTITY_LENGTH);
+}
+
+static void
+msgTxTemplatesBuild(PtpClock * ptpClock)
+{
+	TxTemplateKey *key = &ptpClock->txTemplateKey;
+	Timestamp zeroTime;
+	MsgHeader request;
+
+	memset(&zeroTime, 0, sizeof(Timestamp));
+	memset(&request, 0, sizeof(MsgHeader));
+	request.domainNumber = ptpClock->domainNumber;
+
+	memset(ptpClock->txTemplates, 0, sizeof(ptpClock->txTemplates));
+	msgPackSync(ptpClock->txTemplates[TX_TEMPLATE_SYNC], &zeroTime, ptpClock);
+	msgPackFollowUp(ptpClock->txTemplates[TX_TEMPLATE_FOLLOW_UP], &zeroTime, ptpClock, 0);
+	msgPackDelayReq(ptpClock->txTemplates[TX_TEMPLATE_DELAY_REQ], &zeroTime, ptpClock);
+	msgPackDelayResp(ptpClock->txTemplates[TX_TEMPLATE_DELAY_RESP], &request, &zeroTime, ptpClock);
+
+	key->versionNumber = ptpClock->versionNumber;
+	key->domainNumber = ptpClock->domainNumber;
+	key->portIdentity = ptpClock->portIdentity;
+	key->twoStepFlag = ptpClock->twoStepFlag;
+	key->logSyncInterval = ptpClock->logSyncInterval;
+	key->logMinDelayReqInterval = ptpClock->logMinDelayReqInterval;
+	key->transport = rtOpts.transport;
+	key->ipMode = rtOpts.ip_mode;
+	ptpClock->txTemplatesValid = TRUE;
+
+	DBG("Transmit templates rebuilt\n");
+}
+
+static inline void
+msgTxTemplatesCheck(PtpClock * ptpClock)
+{
+	if (!msgTxTemplatesCurrent(ptpClock))
+		msgTxTemplatesBuild(ptpClock);
+}
+
+static inline void
+msgPatchTimestamp(Octet * buf, Timestamp * timestamp)
+{
+	*(UInteger16 *) (buf + 34) = flip16(timestamp->secondsField.msb);
+	*(UInteger32 *) (buf + 36) = flip32(timestamp->secondsField.lsb);
+	*(UInteger32 *) (buf + 40) = flip32(timestamp->nanosecondsField);
+}
+
+/* Pack a Sync message from its template - same result as msgPackSync() */
+void
+msgPatchSync(Octet * buf, Timestamp * originTimestamp, PtpClock * ptpClock)
+{
+	msgTxTemplatesCheck(ptpClock);
+	memcpy(buf, ptpClock->txTemplates[TX_TEMPLATE_SYNC], SYNC_LENGTH);
+	*(UInteger16 *) (buf + 30) = flip16(ptpClock->sentSyncSequenceId);
+	msgPatchTimestamp(buf, originTimestamp);
+}
+
+/* Pack a Follow_Up message from its template - same result as msgPackFollowUp() */
+void
+msgPatchFollowUp(Octet * buf, Timestamp * preciseOriginTimestamp, PtpClock * ptpClock, const UInteger16 sequenceId)
+{
+	msgTxTemplatesCheck(ptpClock);
+	memcpy(buf, ptpClock->txTemplates[TX_TEMPLATE_FOLLOW_UP], FOLLOW_UP_LENGTH);
+	*(UInteger16 *) (buf + 30) = flip16(sequenceId);
+	msgPatchTimestamp(buf, preciseOriginTimestamp);
+}
+
+/* Pack a Delay_Req message from its template - same result as msgPackDelayReq() */
+void
+msgPatchDelayReq(Octet * buf, Timestamp * originTimestamp, PtpClock * ptpClock)
+{
+	msgTxTemplatesCheck(ptpClock);
+	memcpy(buf, ptpClock->txTemplates[TX_TEMPLATE_DELAY_REQ], DELAY_REQ_LENGTH);
+	*(UInteger16 *) (buf + 30) = flip16(ptpClock->sentDelayReqSequenceId);
+	msgPatchTimestamp(buf, originTimestamp);
+}
+
+/* Pack a Delay_Resp message from its template - same result as msgPackDelayResp() */
+void
+msgPatchDelayResp(Octet * buf, MsgHeader * header, Timestamp * receiveTimestamp, PtpClock * ptpClock)
+{
+	msgTxTemplatesCheck(ptpClock);
+	memcpy(buf, ptpClock->txTemplates[TX_TEMPLATE_DELAY_RESP], DELAY_RESP_LENGTH);
+	*(UInteger8 *) (buf + 4) = header->domainNumber;
+	*(Integer32 *) (buf + 8) = flip32(header->correctionField.msb);
+	*(Integer32 *) (buf + 12) = flip32(header->correctionField.lsb);
+	*(UInteger16 *) (buf + 30) = flip16(header->sequenceId);
+	msgPatchTimestamp(buf, receiveTimestamp);
+	copyClockIdentity((buf + 44), header->sourcePortIdentity.clockIdentity);
+	*(UInteger16 *) (buf + 52) =
+		flip16(header->sourcePortIdentity.portNumber);
+}
+
 /*pack PdelayResp message into OUT buffer of ptpClock*/
 void 
 msgPackPDelayResp(Octet * buf, MsgHeader * header, Timestamp * requestReceiptTimestamp, PtpClock * ptpClock)
@@ -1929,6 +2139,21 @@ msgPackManagementTLV(Octet *buf, MsgManagement *outgoing, PtpClock *ptpClock)
                                 (MMLogMinPdelayReqInterval*)outgoing->tlv->dataField, ptpClock);
                 #endif /* PTPD_DBG */
                 break;
+        case MM_PTPD_COUNTERS:
+                dataLength = packMMPtpdCounters(outgoing, buf);
+                break;
+        case MM_PTPD_SERVO:
+                dataLength = packMMPtpdServo(outgoing, buf);
+                break;
+        case MM_PTPD_SLAVE_STATS:
+                dataLength = packMMPtpdSlaveStats(outgoing, buf);
+                break;
+        case MM_PTPD_CLEAR_COUNTERS:
+                dataLength = 0;
+                break;
+        case MM_PTPD_SLAVE_TABLE:
+                dataLength = packMMPtpdSlaveTable(outgoing, buf);
+                break;
 	default:
 		DBGV("packing management msg: unsupported id \n");
 	}
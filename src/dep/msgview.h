@@ -0,0 +1,257 @@
+/**
+ * @file   msgview.h
+ *
+ * @brief  zero-copy, bounds-checked accessors for received messages
+ *
+ * The accessors read single fields straight from the receive buffer,
+ * in network byte order, so a handler only pays for the fields it
+ * uses. Field offsets are generated from the src/def message
+ * descriptions (see src/def/README). The header and management
+ * messages are packed from the same descriptions; msg.c packs Sync,
+ * Follow_Up, Delay_Resp and Announce with its own offsets, and
+ * test/msgview_test.c checks the views against those packers.
+ *
+ * A read past the received length returns zero and sets the sticky
+ * error flag of the view: check it once after the reads.
+ */
+
+#ifndef PTPD_MSGVIEW_H_
+#define PTPD_MSGVIEW_H_
+
+/* largest field described in a message .def: the embedded header */
+#define MSGVIEW_MAX_FIELD	HEADER_LENGTH
+
+typedef struct {
+	const Octet *buf;
+	size_t length;
+	Boolean error;
+} MsgView;
+
+/* Message layouts: one byte per octet, so offsetof() gives the wire offset */
+#define OPERATE( name, size, type ) char name[size];
+typedef struct {
+	#include "../def/message/header.def"
+} MsgViewHeaderLayout;
+#define OPERATE( name, size, type ) char name[size];
+typedef struct {
+	#include "../def/message/sync.def"
+} MsgViewSyncLayout;
+#define OPERATE( name, size, type ) char name[size];
+typedef struct {
+	#include "../def/message/followUp.def"
+} MsgViewFollowUpLayout;
+#define OPERATE( name, size, type ) char name[size];
+typedef struct {
+	#include "../def/message/delayResp.def"
+} MsgViewDelayRespLayout;
+#define OPERATE( name, size, type ) char name[size];
+typedef struct {
+	#include "../def/message/announce.def"
+} MsgViewAnnounceLayout;
+#define OPERATE( name, size, type ) char name[size];
+typedef struct {
+	#include "../def/message/management.def"
+} MsgViewManagementLayout;
+
+/* Accessor return types: composites by value, octet strings as pointers into the buffer */
+typedef NibbleUpper MsgViewType_NibbleUpper;
+typedef Enumeration4Lower MsgViewType_Enumeration4Lower;
+typedef UInteger4Lower MsgViewType_UInteger4Lower;
+typedef Octet MsgViewType_Octet;
+typedef UInteger8 MsgViewType_UInteger8;
+typedef Integer8 MsgViewType_Integer8;
+typedef Enumeration8 MsgViewType_Enumeration8;
+typedef UInteger16 MsgViewType_UInteger16;
+typedef Integer16 MsgViewType_Integer16;
+typedef UInteger32 MsgViewType_UInteger32;
+typedef Integer64 MsgViewType_Integer64;
+typedef Timestamp MsgViewType_Timestamp;
+typedef PortIdentity MsgViewType_PortIdentity;
+typedef ClockQuality MsgViewType_ClockQuality;
+typedef const Octet* MsgViewType_ClockIdentity;
+typedef const Octet* MsgViewType_MsgHeader;
+
+static inline void
+msgViewInit(MsgView *view, const Octet *buf, ssize_t length)
+{
+	view->buf = buf;
+	view->length = (length > 0) ? length : 0;
+	view->error = FALSE;
+}
+
+/* Start of a field, or a zero field and the error flag if it is not within the buffer */
+static inline const Octet*
+msgViewField(MsgView *view, size_t offset, size_t size)
+{
+	static const Octet zero[MSGVIEW_MAX_FIELD];
+
+	/* nibble fields are described with a size of 0 or 1, but always occupy an octet */
+	if(offset + (size ? size : 1) > view->length) {
+		view->error = TRUE;
+		return zero;
+	}
+
+	return view->buf + offset;
+}
+
+/* Field readers - multi-octet fields may be unaligned, so go through memcpy */
+static inline UInteger16
+msgViewRead16(const Octet *p)
+{
+	UInteger16 v;
+	memcpy(&v, p, sizeof(v));
+	return flip16(v);
+}
+
+static inline UInteger32
+msgViewRead32(const Octet *p)
+{
+	UInteger32 v;
+	memcpy(&v, p, sizeof(v));
+	return flip32(v);
+}
+
+#define MSGVIEW_READ_OCTET( type ) \
+static inline MsgViewType_##type msgViewRead_##type(const Octet *p) \
+{ \
+	return (type)*p; \
+}
+
+MSGVIEW_READ_OCTET( Octet )
+MSGVIEW_READ_OCTET( UInteger8 )
+MSGVIEW_READ_OCTET( Integer8 )
+MSGVIEW_READ_OCTET( Enumeration8 )
+
+static inline MsgViewType_NibbleUpper
+msgViewRead_NibbleUpper(const Octet *p)
+{
+	return ((UInteger8)*p >> 4) & 0x0F;
+}
+
+static inline MsgViewType_Enumeration4Lower
+msgViewRead_Enumeration4Lower(const Octet *p)
+{
+	return (UInteger8)*p & 0x0F;
+}
+
+static inline MsgViewType_UInteger4Lower
+msgViewRead_UInteger4Lower(const Octet *p)
+{
+	return (UInteger8)*p & 0x0F;
+}
+
+static inline MsgViewType_UInteger16
+msgViewRead_UInteger16(const Octet *p)
+{
+	return msgViewRead16(p);
+}
+
+static inline MsgViewType_Integer16
+msgViewRead_Integer16(const Octet *p)
+{
+	return (Integer16)msgViewRead16(p);
+}
+
+static inline MsgViewType_UInteger32
+msgViewRead_UInteger32(const Octet *p)
+{
+	return msgViewRead32(p);
+}
+
+static inline MsgViewType_Integer64
+msgViewRead_Integer64(const Octet *p)
+{
+	Integer64 v;
+	v.msb = (Integer32)msgViewRead32(p);
+	v.lsb = msgViewRead32(p + 4);
+	return v;
+}
+
+static inline MsgViewType_Timestamp
+msgViewRead_Timestamp(const Octet *p)
+{
+	Timestamp v;
+	v.secondsField.msb = msgViewRead16(p);
+	v.secondsField.lsb = msgViewRead32(p + 2);
+	v.nanosecondsField = msgViewRead32(p + 6);
+	return v;
+}
+
+static inline MsgViewType_PortIdentity
+msgViewRead_PortIdentity(const Octet *p)
+{
+	PortIdentity v;
+	memcpy(v.clockIdentity, p, CLOCK_IDENTITY_LENGTH);
+	v.portNumber = msgViewRead16(p + CLOCK_IDENTITY_LENGTH);
+	return v;
+}
+
+static inline MsgViewType_ClockQuality
+msgViewRead_ClockQuality(const Octet *p)
+{
+	ClockQuality v;
+	v.clockClass = (UInteger8)p[0];
+	v.clockAccuracy = (Enumeration8)p[1];
+	v.offsetScaledLogVariance = msgViewRead16(p + 2);
+	return v;
+}
+
+static inline MsgViewType_ClockIdentity
+msgViewRead_ClockIdentity(const Octet *p)
+{
+	return p;
+}
+
+static inline MsgViewType_MsgHeader
+msgViewRead_MsgHeader(const Octet *p)
+{
+	return p;
+}
+
+/*
+ * Accessors: msgView<Message>_<field>(view), e.g. msgViewHeader_domainNumber(&view)
+ * see src/def/README for a note on these X-macros
+ */
+#define OPERATE( name, size, type ) \
+static inline MsgViewType_##type msgViewHeader_##name(MsgView *view) \
+{ \
+	return msgViewRead_##type(msgViewField(view, offsetof(MsgViewHeaderLayout, name), size)); \
+}
+#include "../def/message/header.def"
+
+#define OPERATE( name, size, type ) \
+static inline MsgViewType_##type msgViewSync_##name(MsgView *view) \
+{ \
+	return msgViewRead_##type(msgViewField(view, offsetof(MsgViewSyncLayout, name), size)); \
+}
+#include "../def/message/sync.def"
+
+#define OPERATE( name, size, type ) \
+static inline MsgViewType_##type msgViewFollowUp_##name(MsgView *view) \
+{ \
+	return msgViewRead_##type(msgViewField(view, offsetof(MsgViewFollowUpLayout, name), size)); \
+}
+#include "../def/message/followUp.def"
+
+#define OPERATE( name, size, type ) \
+static inline MsgViewType_##type msgViewDelayResp_##name(MsgView *view) \
+{ \
+	return msgViewRead_##type(msgViewField(view, offsetof(MsgViewDelayRespLayout, name), size)); \
+}
+#include "../def/message/delayResp.def"
+
+#define OPERATE( name, size, type ) \
+static inline MsgViewType_##type msgViewAnnounce_##name(MsgView *view) \
+{ \
+	return msgViewRead_##type(msgViewField(view, offsetof(MsgViewAnnounceLayout, name), size)); \
+}
+#include "../def/message/announce.def"
+
+#define OPERATE( name, size, type ) \
+static inline MsgViewType_##type msgViewManagement_##name(MsgView *view) \
+{ \
+	return msgViewRead_##type(msgViewField(view, offsetof(MsgViewManagementLayout, name), size)); \
+}
+#include "../def/message/management.def"
+
+#endif /* PTPD_MSGVIEW_H_ */
@@ -85,6 +85,10 @@
 #include <linux/ethtool.h>
 #endif /* SO_TIMESTAMPING */
 
+#ifdef HAVE_LINUX_FILTER_H
+#include <linux/filter.h>
+#endif /* HAVE_LINUX_FILTER_H */
+
 /**
  * shutdown the IPv4 multicast for specific address
  *
@@ -175,10 +179,29 @@ netShutdown(NetPath * netPath)
 
 	freeIpv4AccessList(&netPath->timingAcl);
 	freeIpv4AccessList(&netPath->managementAcl);
+	freeRateLimiter(&netPath->rateLimiter);
 
 	return TRUE;
 }
 
+/*
+ * Use the sockets (and access lists) of another path without owning them:
+ * for domain instances. Never call netShutdown() on such a path.
+ */
+void
+netShare(NetPath * netPath, const NetPath * shared)
+{
+	uint64_t sentPackets = netPath->sentPackets;
+	uint64_t receivedPackets = netPath->receivedPackets;
+	Integer32 lastRecvAddr = netPath->lastRecvAddr;
+
+	*netPath = *shared;
+
+	netPath->sentPackets = sentPackets;
+	netPath->receivedPackets = receivedPackets;
+	netPath->lastRecvAddr = lastRecvAddr;
+}
+
 /* Check if interface ifaceName exists. Return 1 on success, 0 when interface doesn't exists, -1 on failure.
  */
 
@@ -776,6 +799,208 @@ return FALSE;
 }
 
 
+#ifdef PTPD_PCAP
+/* pcap filter expression selecting PTP event or general traffic */
+static const char*
+netPcapFilterBase(RunTimeOpts * rtOpts, Boolean event)
+{
+
+	if (rtOpts->transport == IEEE_802_3)
+		return "ether proto 0x88f7";
+
+	if (rtOpts->ip_mode != IPMODE_MULTICAST)
+		return event ? "udp port 319" : "udp port 320";
+
+	return event ? "host (224.0.1.129 or 224.0.0.107) and udp port 319" :
+		"host (224.0.1.129 or 224.0.0.107) and udp port 320";
+
+}
+
+/* Replace the filter on a pcap handle with the base filter plus the PTP header match */
+static Boolean
+netPcapUpdateFilter(pcap_t * pcap, NetPath * netPath, RunTimeOpts * rtOpts, Boolean event)
+{
+
+	struct bpf_program program;
+	char expr[PATH_MAX];
+	const char *field;
+	int len, base;
+
+	/* PTP header offsets are relative to the UDP header or the Ethernet frame */
+	if (rtOpts->transport == IEEE_802_3) {
+		field = "ether";
+		base = ETHER_HDR_LEN;
+	} else {
+		field = "udp";
+		base = sizeof(struct udphdr);
+	}
+
+	len = snprintf(expr, sizeof(expr), "%s", netPcapFilterBase(rtOpts, event));
+
+	if (netPath->filterEnabled) {
+		len += snprintf(expr + len, sizeof(expr) - len,
+			" and (%s[%d] & 0x0f) == %d and %s[%d] == %d",
+			field, base + 1, netPath->filterVersion,
+			field, base + 4, netPath->filterDomain);
+	}
+
+	if (netPath->filterEnabled && netPath->filterParentEnabled) {
+		len += snprintf(expr + len, sizeof(expr) - len,
+			" and (((%s[%d] & 0x0f) != %d and (%s[%d] & 0x0f) != %d)"
+			" or (%s[%d:4] == 0x%08x and %s[%d:4] == 0x%08x))",
+			field, base, SYNC, field, base, FOLLOW_UP,
+			field, base + 20, ntohl(*(uint32_t*)netPath->filterParent),
+			field, base + 24, ntohl(*(uint32_t*)(netPath->filterParent + 4)));
+	}
+
+	DBG("pcap %s filter: %s\n", event ? "event" : "general", expr);
+
+	if (pcap_compile(pcap, &program, expr, 1, 0) < 0) {
+		pcap_perror(pcap, "ptpd2");
+		return FALSE;
+	}
+	if (pcap_setfilter(pcap, &program) < 0) {
+		pcap_freecode(&program);
+		return FALSE;
+	}
+	pcap_freecode(&program);
+
+	return TRUE;
+
+}
+#endif /* PTPD_PCAP */
+
+#ifdef SO_ATTACH_FILTER
+/*
+ * Classic BPF program accepting only the PTP version and domain we use,
+ * and, with a parent set, only Sync and Follow_Up from the parent.
+ * For UDP sockets, the program sees the packet from the UDP header on.
+ */
+static Boolean
+netAttachSocketFilter(Integer32 sock, NetPath * netPath)
+{
+
+	struct sock_filter code[16];
+	struct sock_fprog program;
+	const int base = sizeof(struct udphdr);
+	int n = 0, accept, drop;
+
+	if (sock < 0)
+		return TRUE;
+
+	accept = netPath->filterParentEnabled ? 13 : 5;
+	drop = accept + 1;
+
+	/* versionPTP is the low nibble of octet 1 */
+	code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_B | BPF_ABS, base + 1);
+	code[n++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0x0f);
+	code[n] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, netPath->filterVersion, 0, drop - n - 1); n++;
+	/* domainNumber is octet 4 */
+	code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_B | BPF_ABS, base + 4);
+	code[n] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, netPath->filterDomain, 0, drop - n - 1); n++;
+
+	if (netPath->filterParentEnabled) {
+		/* messageType is the low nibble of octet 0 */
+		code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_B | BPF_ABS, base);
+		code[n++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0x0f);
+		code[n] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, SYNC, 1, 0); n++;
+		code[n] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, FOLLOW_UP, 0, accept - n - 1); n++;
+		/* sourcePortIdentity.clockIdentity is octets 20-27, loaded in network order */
+		code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, base + 20);
+		code[n] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+			ntohl(*(uint32_t*)netPath->filterParent), 0, drop - n - 1); n++;
+		code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, base + 24);
+		code[n] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+			ntohl(*(uint32_t*)(netPath->filterParent + 4)), accept - n - 1, drop - n - 1); n++;
+	}
+
+	code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0xffffffff);
+	code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0);
+
+	program.len = n;
+	program.filter = code;
+
+	if (setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program)) < 0) {
+		PERROR("failed to attach socket filter");
+		return FALSE;
+	}
+
+	return TRUE;
+
+}
+#endif /* SO_ATTACH_FILTER */
+
+/**
+ * Keep the socket (and pcap) filters in line with the PTP domain, version
+ * and - in slave states, if configured - the current parent, so that
+ * traffic we would discard anyway never reaches userspace. Cheap when
+ * nothing changed: called on every state machine pass.
+ */
+void
+netUpdateFilters(NetPath * netPath, RunTimeOpts * rtOpts, PtpClock * ptpClock)
+{
+
+	/* hot standby needs the Syncs from the backup masters too */
+	Boolean parentEnabled = rtOpts->kernelFilter && rtOpts->kernelFilterParent &&
+		!rtOpts->standbyMasters &&
+		(ptpClock->portState == PTP_SLAVE || ptpClock->portState == PTP_UNCALIBRATED);
+
+	if (netPath->filterEnabled == rtOpts->kernelFilter &&
+	    (!rtOpts->kernelFilter ||
+	    (netPath->filterDomain == ptpClock->domainNumber &&
+	    netPath->filterVersion == ptpClock->versionNumber &&
+	    netPath->filterParentEnabled == parentEnabled &&
+	    (!parentEnabled || !memcmp(netPath->filterParent,
+		ptpClock->parentPortIdentity.clockIdentity, CLOCK_IDENTITY_LENGTH)))))
+		return;
+
+	netPath->filterEnabled = rtOpts->kernelFilter;
+	netPath->filterDomain = ptpClock->domainNumber;
+	netPath->filterVersion = ptpClock->versionNumber;
+	netPath->filterParentEnabled = parentEnabled;
+	memcpy(netPath->filterParent, ptpClock->parentPortIdentity.clockIdentity,
+		CLOCK_IDENTITY_LENGTH);
+
+#ifdef PTPD_PCAP
+	if (netPath->pcapEvent != NULL || netPath->pcapGeneral != NULL) {
+		if ((netPath->pcapEvent != NULL &&
+		    !netPcapUpdateFilter(netPath->pcapEvent, netPath, rtOpts, TRUE)) ||
+		    (netPath->pcapGeneral != NULL &&
+		    !netPcapUpdateFilter(netPath->pcapGeneral, netPath, rtOpts, FALSE)))
+			ERROR("Failed to update pcap filters\n");
+		/* the sockets are only drained in pcap mode */
+		return;
+	}
+#endif /* PTPD_PCAP */
+
+#ifdef SO_ATTACH_FILTER
+	if (!netPath->filterEnabled) {
+		setsockopt(netPath->eventSock, SOL_SOCKET, SO_DETACH_FILTER, NULL, 0);
+		setsockopt(netPath->generalSock, SOL_SOCKET, SO_DETACH_FILTER, NULL, 0);
+		INFO("Socket filters removed\n");
+		return;
+	}
+
+	if (netAttachSocketFilter(netPath->eventSock, netPath) &&
+	    netAttachSocketFilter(netPath->generalSock, netPath)) {
+		if (netPath->filterParentEnabled)
+			INFO("Socket filters: accepting PTPv%d domain %d, Sync / Follow_Up from %02hhx%02hhx%02hhx.%02hhx%02hhx.%02hhx%02hhx%02hhx only\n",
+			    netPath->filterVersion, netPath->filterDomain,
+			    netPath->filterParent[0], netPath->filterParent[1],
+			    netPath->filterParent[2], netPath->filterParent[3],
+			    netPath->filterParent[4], netPath->filterParent[5],
+			    netPath->filterParent[6], netPath->filterParent[7]);
+		else
+			INFO("Socket filters: accepting PTPv%d domain %d only\n",
+			    netPath->filterVersion, netPath->filterDomain);
+	}
+#else
+	if (netPath->filterEnabled)
+		WARNING("Socket filters are not supported on this platform - ptpengine:kernel_filter has no effect\n");
+#endif /* SO_ATTACH_FILTER */
+
+}
+
 /**
  * Init all network transports
  *
@@ -843,7 +1068,7 @@ netInit(NetPath * netPath, RunTimeOpts * rtOpts, PtpClock * ptpClock)
 	if( !netPath->interfaceInfo.hasHwAddress && netPath->interfaceInfo.hasAfAddress ) {
 		uint32_t addr = netPath->interfaceInfo.afAddress.s_addr;
 		memcpy(netPath->interfaceID, &addr, 2);
-		memcpy(netPath->interfaceID + 4, &addr + 2, 2);
+		memcpy(netPath->interfaceID + 4, (Octet*)&addr + 2, 2);
 	/* Initialise interfaceID with hardware address */
 	} else {
 		    memcpy(&netPath->interfaceID, &netPath->interfaceInfo.hwAddress, 
@@ -865,11 +1090,7 @@ netInit(NetPath * netPath, RunTimeOpts * rtOpts, PtpClock * ptpClock)
 			return FALSE;
 		}
 		if (pcap_compile(netPath->pcapEvent, &program, 
-				 ( rtOpts->transport == IEEE_802_3 ) ?
-				    "ether proto 0x88f7":
-				 ( rtOpts->ip_mode != IPMODE_MULTICAST ) ?
-					 "udp port 319" :
-				 "host (224.0.1.129 or 224.0.0.107) and udp port 319" ,
+				 netPcapFilterBase(rtOpts, TRUE),
 				 1, 0) < 0) {
 			PERROR("failed to compile pcap event filter");
 			pcap_perror(netPath->pcapEvent, "ptpd2");
@@ -894,9 +1115,7 @@ netInit(NetPath * netPath, RunTimeOpts * rtOpts, PtpClock * ptpClock)
 		}
 		if (rtOpts->transport != IEEE_802_3) {
 			if (pcap_compile(netPath->pcapGeneral, &program,
-					 ( rtOpts->ip_mode != IPMODE_MULTICAST ) ?
-						 "udp port 320" :
-					 "host (224.0.1.129 or 224.0.0.107) and udp port 320" ,
+					 netPcapFilterBase(rtOpts, FALSE),
 					 1, 0) < 0) {
 				PERROR("failed to compile pcap general filter");
 				pcap_perror(netPath->pcapGeneral, "ptpd2");
@@ -1058,6 +1277,9 @@ netInit(NetPath * netPath, RunTimeOpts * rtOpts, PtpClock * ptpClock)
 	}
 #endif
 
+	/* new sockets - filters will be attached on the next netUpdateFilters() */
+	netPath->filterEnabled = FALSE;
+
 	/* Compile ACLs */
 	if(rtOpts->timingAclEnabled) {
     		freeIpv4AccessList(&netPath->timingAcl);
@@ -1070,17 +1292,53 @@ netInit(NetPath * netPath, RunTimeOpts * rtOpts, PtpClock * ptpClock)
 			rtOpts->managementAclDenyText, rtOpts->managementAclOrder);
 	}
 
+	if(rtOpts->rateLimitEnabled) {
+		freeRateLimiter(&netPath->rateLimiter);
+		netPath->rateLimiter=createRateLimiter(rtOpts->rateLimitSources,
+			rtOpts->rateLimitRates);
+	}
+
 	return TRUE;
 }
 
+/* add the PTP sockets of a path to a select() set, return the new nfds */
+static int
+netFdSet(NetPath *netPath, fd_set *readfds, int nfds)
+{
+	int eventSock = netPath->eventSock;
+	int generalSock = netPath->generalSock;
+
+#ifdef PTPD_PCAP
+	if (netPath->pcapEventSock >= 0) {
+		eventSock = netPath->pcapEventSock;
+		generalSock = netPath->pcapGeneralSock;
+	}
+#endif
+
+	if (eventSock >= 0) {
+		FD_SET(eventSock, readfds);
+		if (eventSock >= nfds)
+			nfds = eventSock + 1;
+	}
+	if (generalSock >= 0) {
+		FD_SET(generalSock, readfds);
+		if (generalSock >= nfds)
+			nfds = generalSock + 1;
+	}
+
+	return nfds;
+}
+
 /*Check if data has been received*/
 int 
 netSelect(TimeInternal * timeout, NetPath * netPath, fd_set *readfds)
 {
-	int ret, nfds;
+	int ret, nfds, i;
 	struct timeval tv, *tv_ptr;
 
 
+	extern PtpClock *G_ptpClock;
+
 #if defined PTPD_SNMP
 	extern RunTimeOpts rtOpts;
 	struct timeval snmp_timer_wait = { 0, 0}; // initialise to avoid unused warnings when SNMP disabled
@@ -1100,30 +1358,34 @@ netSelect(TimeInternal * timeout, NetPath * netPath, fd_set *readfds)
 	}
 
 	FD_ZERO(readfds);
-	nfds = 0;
-#ifdef PTPD_PCAP
-	if (netPath->pcapEventSock >= 0) {
-		FD_SET(netPath->pcapEventSock, readfds);
-		if (netPath->pcapGeneralSock >= 0)
-			FD_SET(netPath->pcapGeneralSock, readfds);
-
-		nfds = netPath->pcapEventSock;
-		if (netPath->pcapEventSock < netPath->pcapGeneralSock)
-			nfds = netPath->pcapGeneralSock;
+	nfds = netFdSet(netPath, readfds, 0);
+
+	/* port 1 of a boundary clock waits for the other ports as well */
+	if (G_ptpClock != NULL && G_ptpClock->boundaryClock != NULL &&
+	    G_ptpClock->portIndex == 0)
+		for (i = 1; i < G_ptpClock->boundaryClock->numberPorts; i++)
+			nfds = netFdSet(&G_ptpClock->boundaryClock->ports[i]->netPath,
+					readfds, nfds);
+
+	/* NTP client requests are served from the main loop */
+	if (G_ptpClock != NULL && G_ptpClock->ntpServer.sockFD >= 0) {
+		FD_SET(G_ptpClock->ntpServer.sockFD, readfds);
+		if (G_ptpClock->ntpServer.sockFD >= nfds)
+			nfds = G_ptpClock->ntpServer.sockFD + 1;
+	}
 
-	} else if (netPath->eventSock >= 0) {
-#endif
-		FD_SET(netPath->eventSock, readfds);
-		if (netPath->generalSock >= 0)
-			FD_SET(netPath->generalSock, readfds);
+	/* so are control socket clients */
+	if (G_ptpClock != NULL)
+		nfds = ctlSocketFdSet(&G_ptpClock->ctlSocket, readfds, nfds);
 
-		nfds = netPath->eventSock;
-		if (netPath->eventSock < netPath->generalSock)
-			nfds = netPath->generalSock;
-#ifdef PTPD_PCAP
+#ifdef PTPD_NTPDC
+	/* NTP control replies are read from the main loop as well */
+	if (G_ptpClock != NULL && G_ptpClock->ntpControl.sockFD >= 0) {
+		FD_SET(G_ptpClock->ntpControl.sockFD, readfds);
+		if (G_ptpClock->ntpControl.sockFD >= nfds)
+			nfds = G_ptpClock->ntpControl.sockFD + 1;
 	}
-#endif
-	nfds++;
+#endif /* PTPD_NTPDC */
 
 #if defined PTPD_SNMP
 if (rtOpts.snmp_enabled) {
@@ -66,15 +66,25 @@
 #define NTP_PORT 123
 
 char *ntpdc_pktdata;
+static int ntpdc_pktdatasize;
+
+static void ntpdRequestComplete(NTPoptions* options, NTPcontrol* control, int res);
+static int NTPDCrequest(NTPoptions* options, NTPcontrol* control, int reqcode, int auth,
+	u_int qitems, size_t qsize, char *qdata);
+static Boolean ntpdStartRequest(NTPoptions* options, NTPcontrol* control, int reqcode, int flags);
 
 Boolean
 ntpInit(NTPoptions* options, NTPcontrol* control)
 {
+	struct IntervalTimer *itimer = control->itimer;
+
 	control->sockFD = -1;
 	if(!options->enableEngine)
 	    return FALSE;
 
 	memset(control, 0, sizeof(*control));
+	control->itimer = itimer;
+	control->sockFD = -1;
 
 	if(!hostLookup(options->hostAddress, &control->serverAddress)) {
                 control->serverAddress = 0;
@@ -86,10 +96,16 @@ ntpInit(NTPoptions* options, NTPcontrol* control)
                 return FALSE;
         }
 
-	/* This will attempt to read the ntpd control flags for the first time */
-	if (ntpdInControl(options, control)) {
-		DBGV("NTPd original flags: %d\n", control->originalFlags);
-	}
+	/*
+	 * The socket is watched by the main loop - nothing here may block. The
+	 * original ntpd flags are captured from the first status reply.
+	 */
+	if (fcntl(control->sockFD, F_SETFL, fcntl(control->sockFD, F_GETFL, 0) | O_NONBLOCK) < 0) {
+                PERROR("failed to set NTP control socket to non-blocking");
+                close(control->sockFD);
+                control->sockFD = -1;
+                return FALSE;
+        }
 
 	return TRUE;
 }
@@ -97,17 +113,40 @@ ntpInit(NTPoptions* options, NTPcontrol* control)
 Boolean
 ntpShutdown(NTPoptions* options, NTPcontrol* control)
 {
-	/* Attempt reverting ntpd flags to the original value */
-	if(control->flagsCaptured) {
-		DBGV("Attempting to revert NTPd flags to %d - result: %d\n", control->originalFlags,
-			ntpdSetFlags(options, control, control->originalFlags)
-		);
+	struct conf_sys_flags sys;
+	int revert;
+
+	if (control->itimer != NULL)
+		timerStop(NTPD_REPLY_TIMER, control->itimer);
+	control->state = NTPCONTROL_IDLE;
+	control->recheckPending = FALSE;
+
+	/*
+	 * Attempt reverting ntpd flags to the original value. This is fire and
+	 * forget: we don't wait for ntpd to acknowledge the change.
+	 */
+	if(control->flagsCaptured && control->sockFD >= 0) {
+		revert = control->originalFlags & (INFO_FLAG_NTP | INFO_FLAG_KERNEL);
+		DBGV("Attempting to revert NTPd flags to %d\n", control->originalFlags);
+		if(revert) {
+			sys.flags = htonl(revert);
+			NTPDCrequest(options, control, REQ_SET_SYS_FLAG, 1, 1,
+				sizeof(struct conf_sys_flags), (char *)&sys);
+		}
+		if(revert != (INFO_FLAG_NTP | INFO_FLAG_KERNEL)) {
+			sys.flags = htonl(~revert & (SYS_FLAG_NTP | SYS_FLAG_KERNEL));
+			NTPDCrequest(options, control, REQ_CLR_SYS_FLAG, 1, 1,
+				sizeof(struct conf_sys_flags), (char *)&sys);
+		}
 	}
 
         if (control->sockFD > 0)
                 close(control->sockFD);
         control->sockFD = -1;
 
+	free(ntpdc_pktdata);
+	ntpdc_pktdata = NULL;
+
 	return TRUE;
 }
 
@@ -162,6 +201,9 @@ int impl_ver = IMPL_XNTPD;
 static int req_pkt_size = REQ_LEN_NOMAC;
 #define	ERR_INCOMPLETE		16
 #define	ERR_TIMEOUT		17
+/* NTPDCresponse(): keep waiting / packet not for us */
+#define	NTPDC_MORE		-2
+#define	NTPDC_IGNORE		-3
 
 static void
 get_systime(
@@ -273,7 +315,7 @@ NTPDCrequest(
 	if (!maclen || (maclen != (16 + sizeof(keyid_t))))
 	 {  
 		ERROR("Error while computing NTP MD5 hash\n");
-		return 1;
+		return -1;
 	}
 
 	return ntpSend(control, (Octet *)&qpkt, reqsize + maclen);
@@ -334,198 +376,91 @@ check1item(
 	return 1;
 }
 
+/*
+ * Validate one response packet and collect its items. Nothing here blocks:
+ * the packet has already been read from the socket by ntpdControlReceive().
+ * Returns NTPDC_MORE while more packets of the response are expected,
+ * NTPDC_IGNORE for packets that do not belong to the pending request,
+ * otherwise INFO_OKAY or the error code returned by ntpd.
+ */
 static int
 NTPDCresponse(
-	NTPoptions* options,
 	NTPcontrol* control,
-	int reqcode,
-	int *ritems,
-	int *rsize,
-	char **rdata,
-	int esize
+	struct resp_pkt *rpkt,
+	int n
 	)
 {
-	struct resp_pkt rpkt;
-	struct timeval tvo;
 	int items;
 	int i;
 	int size;
 	int datasize;
 	char *datap;
 	char *tmp_data;
-	char haveseq[MAXSEQ+1];
-	int firstpkt;
-	int lastseq;
-	int numrecv;
 	int seq;
-	fd_set fds;
-	int n;
 	int pad;
-
-
-        int ntpdc_pktdatasize;
+	int esize = control->respEsize;
 
 	int implcode=(u_char)3;
 
-	static  struct timeval tvout = { DEFTIMEOUT, 0 };   /* time out for reads */
-	static  struct timeval tvsout = { DEFSTIMEOUT, 0 }; /* secondary time out */
-
-//	static char *currenthost = "localhost";
-
-        ntpdc_pktdatasize = INITDATASIZE;
-        ntpdc_pktdata = realloc(ntpdc_pktdata,INITDATASIZE);
-
-	/*
-	 * This is pretty tricky.  We may get between 1 and many packets
-	 * back in response to the request.  We peel the data out of
-	 * each packet and collect it in one long block.  When the last
-	 * packet in the sequence is received we'll know how many we
-	 * should have had.  Note we use one long time out, should reconsider.
-	 */
-	*ritems = 0;
-	*rsize = 0;
-	firstpkt = 1;
-	numrecv = 0;
-
-	lastseq = 999;	/* too big to be a sequence number */
-	memset(haveseq, 0, sizeof(haveseq));
-	FD_ZERO(&fds);
-
-    again:
-	if (firstpkt)
-		tvo = tvout;
-	else
-		tvo = tvsout;
-	
-	FD_SET(control->sockFD, &fds);
-	n = select(control->sockFD+1, &fds, (fd_set *)0, (fd_set *)0, &tvo);
-
-	if (n == -1) {
-	/*	warning("select fails", "", "");*/
-		return -1;
-	}
-	if (n == 0) {
-		/*
-		 * Timed out.  Return what we have
-		 */
-		if (firstpkt) {
-			return ERR_TIMEOUT;
-///timeout?
-		} else {
-/*			(void) fprintf(stderr,
-				       "%s: timed out with incomplete data\n",
-				       currenthost);
-*/
-/*			if (debug) {
-				printf("Received sequence numbers");
-				for (n = 0; n <= MAXSEQ; n++)
-				    if (haveseq[n])
-					printf(" %d,", n);
-				if (lastseq != 999)
-				    printf(" last frame received\n");
-				else
-				    printf(" last frame not received\n");
-			}
-*/
-			return ERR_INCOMPLETE;
-		}
-	}
-
-	n = recv(control->sockFD, (char *)&rpkt, sizeof(rpkt), 0);
-	if (n == -1) {
-	/*	warning("read", "", "");*/
-		return -1;
-	}
-
-
 	/*
 	 * Check for format errors.  Bug proofing.
 	 */
 	if (n < RESP_HEADER_SIZE) {
-/*		if (debug)
-		    printf("Short (%d byte) packet received\n", n);
-*/
-
-		goto again;
+		DBGV("NTPDC Short (%d byte) packet received\n", n);
+		return NTPDC_IGNORE;
 	}
 
-
-
-	if (INFO_VERSION(rpkt.rm_vn_mode) > NTP_VERSION ||
-	    INFO_VERSION(rpkt.rm_vn_mode) < NTP_OLDVERSION) {
-/*		if (debug)
-		    printf("Packet received with version %d\n",
-			   INFO_VERSION(rpkt.rm_vn_mode));
-*/
-
-		goto again;
+	if (INFO_VERSION(rpkt->rm_vn_mode) > NTP_VERSION ||
+	    INFO_VERSION(rpkt->rm_vn_mode) < NTP_OLDVERSION) {
+		DBGV("NTPDC Packet received with version %d\n",
+			   INFO_VERSION(rpkt->rm_vn_mode));
+		return NTPDC_IGNORE;
 	}
 
-	if (INFO_MODE(rpkt.rm_vn_mode) != MODE_PRIVATE) {
-/*		if (debug)
-		    printf("Packet received with mode %d\n",
-			   INFO_MODE(rpkt.rm_vn_mode));
-*/
-
-		goto again;
-
+	if (INFO_MODE(rpkt->rm_vn_mode) != MODE_PRIVATE) {
+		DBGV("NTPDC Packet received with mode %d\n",
+			   INFO_MODE(rpkt->rm_vn_mode));
+		return NTPDC_IGNORE;
 	}
-	if (INFO_IS_AUTH(rpkt.auth_seq)) {
-/*
-		if (debug)
-		    printf("Encrypted packet received\n");
-*/
-		goto again;
+
+	if (INFO_IS_AUTH(rpkt->auth_seq)) {
+		DBGV("NTPDC Encrypted packet received\n");
+		return NTPDC_IGNORE;
 	}
-	if (!ISRESPONSE(rpkt.rm_vn_mode)) {
-/*
-		if (debug)
-		    printf("Received request packet, wanted response\n");
-*/
-		goto again;
+
+	if (!ISRESPONSE(rpkt->rm_vn_mode)) {
+		DBGV("NTPDC Received request packet, wanted response\n");
+		return NTPDC_IGNORE;
 	}
-	if (INFO_MBZ(rpkt.mbz_itemsize) != 0) {
-/*
-		if (debug)
-		    printf("Received packet with nonzero MBZ field!\n");
-*/
-		goto again;
+
+	if (INFO_MBZ(rpkt->mbz_itemsize) != 0) {
+		DBGV("NTPDC Received packet with nonzero MBZ field!\n");
+		return NTPDC_IGNORE;
 	}
 
 	/*
 	 * Check implementation/request.  Could be old data getting to us.
 	 */
-
-	if (rpkt.implementation != implcode || rpkt.request != reqcode) {
-/*
-		if (debug)
-		    printf(
-			    "Received implementation/request of %d/%d, wanted %d/%d",
-			    rpkt.implementation, rpkt.request,
-			    implcode, reqcode);
-*/
-		goto again;
+	if (rpkt->implementation != implcode || rpkt->request != control->pendingRequest) {
+		DBGV("NTPDC Received implementation/request of %d/%d, wanted %d/%d\n",
+			    rpkt->implementation, rpkt->request,
+			    implcode, control->pendingRequest);
+		return NTPDC_IGNORE;
 	}
 
 	/*
 	 * Check the error code.  If non-zero, return it.
 	 */
-	if (INFO_ERR(rpkt.err_nitems) != INFO_OKAY) {
-/*
-		if (debug && ISMORE(rpkt.rm_vn_mode)) {
-			printf("Error code %d received on not-final packet\n",
-			       INFO_ERR(rpkt.err_nitems));
-		}
-*/
-		return (int)INFO_ERR(rpkt.err_nitems);
+	if (INFO_ERR(rpkt->err_nitems) != INFO_OKAY) {
+		return (int)INFO_ERR(rpkt->err_nitems);
 	}
 
 	/*
 	 * Collect items and size.  Make sure they make sense.
 	 */
-	items = INFO_NITEMS(rpkt.err_nitems);
+	items = INFO_NITEMS(rpkt->err_nitems);
 
-	size = INFO_ITEMSIZE(rpkt.mbz_itemsize);
+	size = INFO_ITEMSIZE(rpkt->mbz_itemsize);
 	if (esize > size)
 		pad = esize - size;
 	else 
@@ -533,60 +468,51 @@ NTPDCresponse(
 	datasize = items * size;
 
 	if ((size_t)datasize > (n-RESP_HEADER_SIZE)) {
-/*		if (debug)
-		    printf(
-			    "Received items %d, size %d (total %d), data in packet is %lu\n",
+		DBGV("NTPDC Received items %d, size %d (total %d), data in packet is %lu\n",
 			    items, size, datasize, (u_long)(n-RESP_HEADER_SIZE));
-*/
-		goto again;
-
+		return NTPDC_IGNORE;
 	}
 
 	/*
 	 * If this isn't our first packet, make sure the size matches
 	 * the other ones.
 	 */
-	if (!firstpkt && esize != *rsize) {
-/*		if (debug)
-		    printf("Received itemsize %d, previous %d\n",
-			   size, *rsize);
-*/
-		goto again;
+	if (!control->respFirst && size + pad != control->respSize) {
+		DBGV("NTPDC Received itemsize %d, previous %d\n",
+			   size, control->respSize);
+		return NTPDC_IGNORE;
 	}
+
 	/*
-	 * If we've received this before, +toss it
+	 * If we've received this before, toss it
 	 */
-	seq = INFO_SEQ(rpkt.auth_seq);
-	if (haveseq[seq]) {
-/*		if (debug)
-		    printf("Received duplicate sequence number %d\n", seq);
-*/
-		goto again;
+	seq = INFO_SEQ(rpkt->auth_seq);
+	if (control->respHaveSeq[seq]) {
+		DBGV("NTPDC Received duplicate sequence number %d\n", seq);
+		return NTPDC_IGNORE;
 	}
-	haveseq[seq] = 1;
+	control->respHaveSeq[seq] = 1;
 
 	/*
 	 * If this is the last in the sequence, record that.
 	 */
-	if (!ISMORE(rpkt.rm_vn_mode)) {
-		if (lastseq != 999) {
+	if (!ISMORE(rpkt->rm_vn_mode)) {
+		if (control->respLastSeq != 999) {
 			DBGV("NTPDC Received second end sequence packet\n");
-			goto again;
+			return NTPDC_IGNORE;
 		}
-		lastseq = seq;
+		control->respLastSeq = seq;
 	}
 
-	*rdata = datap = ntpdc_pktdata;
-
 	/*
-	 * So far, so good.  Copy this data into the output array.
+	 * So far, so good.  Append this data to the output array.
 	 */
+	datap = ntpdc_pktdata + control->respItems * control->respSize;
 	if ((datap + datasize + (pad * items)) > (ntpdc_pktdata + ntpdc_pktdatasize)) {
 		int offset = datap - ntpdc_pktdata;
 
 		ntpdc_pktdatasize += INCDATASIZE;
 		ntpdc_pktdata = realloc(ntpdc_pktdata, (size_t)ntpdc_pktdatasize);
-		*rdata = ntpdc_pktdata; /* might have been realloced ! */
 		datap = ntpdc_pktdata + offset;
 	}
 	/* 
@@ -594,7 +520,7 @@ NTPDCresponse(
 	 * items.  This is so we can play nice with older implementations
 	 */
 
-	tmp_data = rpkt.data;
+	tmp_data = rpkt->data;
 	for (i = 0; i < items; i++) {
 		memcpy(datap, tmp_data, (unsigned)size);
 		tmp_data += size;
@@ -602,129 +528,187 @@ NTPDCresponse(
 		datap += size + pad;
 	}
 
-	if (firstpkt) {
-		firstpkt = 0;
-		*rsize = size + pad;
+	if (control->respFirst) {
+		control->respFirst = FALSE;
+		control->respSize = size + pad;
 	}
-	*ritems += items;
+	control->respItems += items;
 
 	/*
 	 * Finally, check the count of received packets.  If we've got them
-	 * all, return
+	 * all, we're done
 	 */
-	++numrecv;
-
-	if (numrecv <= lastseq)
-		goto again;
+	if (++control->respNumRecv <= control->respLastSeq)
+		return NTPDC_MORE;
 
 	return INFO_OKAY;
 }
 
-static int
-NTPDCquery(
-	NTPoptions* options,
-	NTPcontrol* control,
-	int reqcode,
-	int auth,
-	int qitems,
-	int qsize,
-	char *qdata,
-	int *ritems,
-	int *rsize,
-	char **rdata,
- 	int quiet_mask,
-	int esize
-	)
+/* Throw away anything still queued on the socket, i.e. late replies to earlier requests */
+static void
+ntpDrainSocket(NTPcontrol* control)
 {
-	int res;
 	char junk[512];
-	fd_set fds;
-	struct timeval tvzero;
-//	int implcode=(u_char)3;
 
-	/*
-	 * Poll the socket and clear out any pending data
-	 */
-again:
-	do {
-		tvzero.tv_sec = tvzero.tv_usec = 0;
-		FD_ZERO(&fds);
-		FD_SET(control->sockFD, &fds);
-		res = select(control->sockFD+1, &fds, (fd_set *)0, (fd_set *)0, &tvzero);
-
-		if (res == -1) {
-//			INFO("junk cleanup - select fails");
-//			warning("polling select", "", "");
-			return -1;
-		} else if (res > 0)
-
-		    (void) recv(control->sockFD, junk, sizeof junk, 0);
-	} while (res > 0);
+	while(recv(control->sockFD, junk, sizeof junk, MSG_DONTWAIT) > 0);
+}
 
-	/*
-	 * send a request
-	 */
-	res = NTPDCrequest(options, control, reqcode, auth, qitems, qsize, qdata);
-	if (res <= 0) { 
-		return res;
+/*
+ * Send a request and arm the reply timer. The reply is picked up by
+ * ntpdControlReceive() from the main loop, the timeout is handled by
+ * ntpdControlTimeout(). Flags are only used by the set / clear flags requests.
+ */
+static Boolean
+ntpdStartRequest(NTPoptions* options, NTPcontrol* control, int reqcode, int flags)
+{
+	struct conf_sys_flags sys;
+	int res;
+
+	if(ntpdc_pktdata == NULL) {
+		ntpdc_pktdatasize = INITDATASIZE;
+		ntpdc_pktdata = malloc(INITDATASIZE);
 	}
-	/*
-	 * Get the response.  If we got a standard error, print a message
-	 */
-	res = NTPDCresponse(options, control, reqcode, ritems, rsize, rdata, esize);
 
-	/*
-	 * Try to be compatible with older implementations of ntpd.
-	 */
-	if (res == INFO_ERR_FMT && req_pkt_size != 48) {
-		int oldsize;
-
-		oldsize = req_pkt_size;
-
-		switch(req_pkt_size) {
-		case REQ_LEN_NOMAC:
-			req_pkt_size = 160;
-			break;
-		case 160:
-			req_pkt_size = 48;
-			break;
-		}
-		if (impl_ver == IMPL_XNTPD) {
-			DBGV(
-			    "NTPDC ***Warning changing to older implementation\n");
-			return INFO_ERR_IMPL;
-		}
+	ntpDrainSocket(control);
+
+	control->pendingRequest = reqcode;
+	control->pendingFlags = flags;
+	control->respItems = 0;
+	control->respSize = 0;
+	control->respNumRecv = 0;
+	control->respFirst = TRUE;
+	control->respLastSeq = 999;	/* too big to be a sequence number */
+	memset(control->respHaveSeq, 0, sizeof(control->respHaveSeq));
 
-		DBGV(
-		    "NTPDC ***Warning changing the request packet size from %d to %d\n",
-		    oldsize, req_pkt_size);
-		goto again;
+	if(reqcode == REQ_SYS_INFO) {
+		control->respEsize = sizeof(struct info_sys);
+		res = NTPDCrequest(options, control, reqcode, 0, 0, 0, (char *)NULL);
+	} else {
+		sys.flags = htonl(flags);
+		control->respEsize = sizeof(struct conf_sys_flags);
+		res = NTPDCrequest(options, control, reqcode, 1, 1,
+			sizeof(struct conf_sys_flags), (char *)&sys);
+	}
+
+	if(res <= 0) {
+		ntpdRequestComplete(options, control, -1);
+		return FALSE;
 	}
 
-	return res;
+	control->state = NTPCONTROL_WAITING;
+	timerStart(NTPD_REPLY_TIMER, DEFTIMEOUT, control->itimer);
+	return TRUE;
 }
 
-int
-ntpdControlFlags(NTPoptions* options, NTPcontrol* control, int req, int flags)
+/* System info received (or failed): work out if ntpd needs to be told anything */
+static void
+ntpdCheckComplete(NTPoptions* options, NTPcontrol* control, int res)
 {
-	struct conf_sys_flags sys;
-	int items;
-	int itemsize;
-	char *dummy;
-	int res;
+	struct info_sys *is = (struct info_sys *)ntpdc_pktdata;
+
+	if (res == INFO_OKAY) {
+		if (!check1item(control->respItems))
+			res = INFO_ERR_EMPTY;
+		else if (!checkitemsize(control->respSize, sizeof(struct info_sys)) &&
+		    !checkitemsize(control->respSize, v4sizeof(struct info_sys)))
+			res = INFO_ERR_EMPTY;
+	}
+
+	if (res != INFO_OKAY) {
 
-	sys.flags = 0;
-	res = 0;
-	sys.flags = flags;
+	switch (res) {
 
-	sys.flags = htonl(sys.flags);
-	if (res || sys.flags == 0)
-	    return 0;
+	case -1:
+		DBG("Could not connect to NTP daemon\n");
+		break;
 
-	res = NTPDCquery(options, control, req, 1, 1,
-		      sizeof(struct conf_sys_flags), (char *)&sys, &items,
-		      &itemsize, &dummy, 0, sizeof(struct conf_sys_flags));
+	case ERR_TIMEOUT:
 
+		DBG("Timeout while connecting to NTP daemon\n");
+		break;
+
+	case INFO_ERR_AUTH:
+
+		DBG("NTP permission denied: check NTP key id, key and if key is trusted and is a request key\n");
+		break;		
+
+	default:
+	ERROR("NTP protocol error\n");
+
+	}
+		if(!control->checkFailed)
+		WARNING("Could not verify NTP status - will keep checking\n");
+		control->inControl = FALSE;
+		control->checkFailed = TRUE;
+		return;
+	}
+
+	if (is->flags & INFO_FLAG_NTP) DBGV("NTP flag seen: ntp\n");
+	if (is->flags & INFO_FLAG_KERNEL) DBGV("NTP flag seen: kernel\n");
+
+	if(!control->flagsCaptured) {
+		control->originalFlags = is->flags;
+		control->flagsCaptured = TRUE;
+		DBGV("NTPd original flags: %d\n", control->originalFlags);
+	}
+
+	control->inControl = (is->flags & INFO_FLAG_NTP) || (is->flags & INFO_FLAG_KERNEL);
+
+	if(control->checkFailed)
+		NOTIFY("NTPd now available\n");
+	control->checkFailed = FALSE;
+
+	/* NTP is running as expected */
+
+	if(control->inControl == control->isRequired) {
+		control->requestFailed = FALSE;
+		if(!control->quiet) {
+			if(control->isRequired)
+				INFO("NTPd running and is already controlling the clock - OK\n");
+			else
+				INFO("NTPd running and is not controlling the clock - OK\n");
+		}
+		/* nothing left to fail over */
+		if(control->isFailOver && control->inControl)
+			timerStop(NTPD_FAILOVER_TIMER, control->itimer);
+		return;
+	}
+
+	/* NTP is not running as expected - see if we can fail over or fail back */
+
+	/* We can't control NTPD - inform only */
+	if(!options->enableControl) {
+		if(control->isRequired) {
+			INFO("Found NTPd running and not controlling the clock\n");
+			WARNING("Cannot hand over control to NTPd - NTPD control is disabled\n");
+		} else {
+			INFO("Found NTPd running and controlling the clock\n");
+			WARNING("Cannot take over clock control from NTPd - NTPd control is disabled\n");
+		}
+		return;
+	}
+
+	/* We can control NTPd - try to match the desired state */
+
+	/* Attempt handing over clock control TO NTPD */
+	if(control->isRequired) {
+		if(!control->requestFailed) INFO("Found NTPd running and not controlling the clock\n");
+		if(!control->requestFailed) INFO("Attempting to fail over to local NTPd\n");
+		ntpdStartRequest(options, control, REQ_SET_SYS_FLAG, SYS_FLAG_KERNEL | SYS_FLAG_NTP);
+
+	/* Attempt taking clock control back FROM NTPD */
+	} else {
+		if(!control->requestFailed) INFO("Found NTPd running and controlling the clock\n");
+		if(!control->requestFailed) INFO("Attempting to disable local NTPd\n");
+		ntpdStartRequest(options, control, REQ_CLR_SYS_FLAG, SYS_FLAG_KERNEL | SYS_FLAG_NTP);
+	}
+
+}
+
+/* Set / clear flags request acknowledged (or failed) */
+static void
+ntpdFlagsComplete(NTPoptions* options, NTPcontrol* control, int reqcode, int res)
+{
 
 	if (res != INFO_OKAY) {
 
@@ -748,117 +732,139 @@ ntpdControlFlags(NTPoptions* options, NTPcontrol* control, int req, int flags)
 	ERROR("NTP protocol error\n");
 
 	}
+		if(!control->requestFailed) {
+			if(reqcode == REQ_SET_SYS_FLAG)
+				WARNING("Could not fail over to NTP  - Clock may drift! See previous errors\n");
+			else
+				WARNING("Could not disable local NTPd - Clock may be unstable! See previous errors\n");
+		}
+		control->requestFailed = TRUE;
+		return;
 	}
 
-	return res;
+	if(reqcode == REQ_SET_SYS_FLAG) {
+		NOTICE("Succesfully failed over to NTP\n");
+		control->inControl = TRUE;
+		if(control->isFailOver)
+			timerStop(NTPD_FAILOVER_TIMER, control->itimer);
+	} else {
+		NOTICE("Succesfully disabled local NTPd\n");
+		control->inControl = FALSE;
+	}
+	control->requestFailed = FALSE;
 
 }
 
-int
-ntpdSetFlags(NTPoptions* options, NTPcontrol* control, int flags)
+/* Finish the pending request and run any check that was queued behind it */
+static void
+ntpdRequestComplete(NTPoptions* options, NTPcontrol* control, int res)
 {
+	int reqcode = control->pendingRequest;
 
-	int res;
-        ntpdc_pktdata = malloc(INITDATASIZE);
-	res=ntpdControlFlags(options, control, REQ_SET_SYS_FLAG, flags);
-	free(ntpdc_pktdata);
-	return res;
-
-}
+	control->state = NTPCONTROL_IDLE;
+	control->pendingRequest = 0;
+	timerStop(NTPD_REPLY_TIMER, control->itimer);
 
-int
-ntpdClearFlags(NTPoptions* options, NTPcontrol* control, int flags)
-{
+	if(reqcode == REQ_SYS_INFO)
+		ntpdCheckComplete(options, control, res);
+	else
+		ntpdFlagsComplete(options, control, reqcode, res);
 
-	int res;
-        ntpdc_pktdata = malloc(INITDATASIZE);
-	res=ntpdControlFlags(options, control, REQ_CLR_SYS_FLAG, flags);
-	free(ntpdc_pktdata);
-	return res;
+	if(control->state == NTPCONTROL_IDLE && control->recheckPending) {
+		control->recheckPending = FALSE;
+		ntpdStartRequest(options, control, REQ_SYS_INFO, 0);
+	}
 }
 
-
-int
-ntpdInControl(NTPoptions* options, NTPcontrol* control)
+/* Called from the main loop when the control socket is readable */
+void
+ntpdControlReceive(NTPoptions* options, NTPcontrol* control)
 {
-	struct info_sys *is;
-	int items;
-	int itemsize;
+	struct resp_pkt rpkt;
+	int n;
 	int res;
-        ntpdc_pktdata = malloc(INITDATASIZE);
-	res = NTPDCquery(options, control, REQ_SYS_INFO, 0, 0, 0, (char *)NULL,
-		      &items, &itemsize, (void *)&is, 0,
-		      sizeof(struct info_sys));
 
-	if ( res != 0 )
-	    goto end;
+	while((n = recv(control->sockFD, (char *)&rpkt, sizeof(rpkt), MSG_DONTWAIT)) >= 0) {
 
-	if (!check1item(items)) {
-
-	    res=INFO_ERR_EMPTY;
-	    goto end;
-	}
+		if(control->state != NTPCONTROL_WAITING) {
+			DBGV("NTPDC Discarding unsolicited %d byte packet\n", n);
+			continue;
+		}
 
+		res = NTPDCresponse(control, &rpkt, n);
 
-	if (!checkitemsize(itemsize, sizeof(struct info_sys)) &&
-	    !checkitemsize(itemsize, v4sizeof(struct info_sys))) {
-	
-	    res=INFO_ERR_EMPTY;
-	    goto end;
-	}	
+		if(res == NTPDC_IGNORE)
+			continue;
 
-	if (is->flags & INFO_FLAG_NTP) DBGV("NTP flag seen: ntp\n");
-	if (is->flags & INFO_FLAG_KERNEL) DBGV("NTP flag seen: kernel\n");
+		/* more to come - allow the secondary timeout for the rest */
+		if(res == NTPDC_MORE) {
+			timerStart(NTPD_REPLY_TIMER, DEFSTIMEOUT, control->itimer);
+			continue;
+		}
 
-	if(!control->flagsCaptured) {
-		control->originalFlags = is->flags;
+		/*
+		 * Try to be compatible with older implementations of ntpd.
+		 */
+		if (res == INFO_ERR_FMT && req_pkt_size != 48) {
+			int oldsize;
+
+			oldsize = req_pkt_size;
+
+			switch(req_pkt_size) {
+			case REQ_LEN_NOMAC:
+				req_pkt_size = 160;
+				break;
+			case 160:
+				req_pkt_size = 48;
+				break;
+			}
+			if (impl_ver == IMPL_XNTPD) {
+				DBGV(
+				    "NTPDC ***Warning changing to older implementation\n");
+				ntpdRequestComplete(options, control, INFO_ERR_IMPL);
+				continue;
+			}
 
-		control->flagsCaptured = TRUE;
-		res = INFO_YES;
-		goto end;
-	}
+			DBGV(
+			    "NTPDC ***Warning changing the request packet size from %d to %d\n",
+			    oldsize, req_pkt_size);
+			ntpdStartRequest(options, control, control->pendingRequest,
+				control->pendingFlags);
+			continue;
+		}
 
-	if ((is->flags & INFO_FLAG_NTP) || (is->flags & INFO_FLAG_KERNEL))
-	{
-		res=INFO_YES;
-	} else  {
+		ntpdRequestComplete(options, control, res);
 
-		res=INFO_NO;
 	}
 
-	end:
-
-	free(ntpdc_pktdata);
-
-
-	if (res != INFO_YES && res != INFO_NO) {
-
-	switch (res) {
-
-	case -1:
-		DBG("Could not connect to NTP daemon\n");
-		break;
+	if(errno != EAGAIN && errno != EWOULDBLOCK && control->state == NTPCONTROL_WAITING)
+		ntpdRequestComplete(options, control, -1);
 
-	case ERR_TIMEOUT:
+}
 
-		DBG("Timeout while connecting to NTP daemon\n");
-		break;
+/* Called when NTPD_REPLY_TIMER expires: ntpd did not answer in time */
+void
+ntpdControlTimeout(NTPoptions* options, NTPcontrol* control)
+{
 
-	case INFO_ERR_AUTH:
+	timerStop(NTPD_REPLY_TIMER, control->itimer);
 
-		DBG("NTP permission denied: check NTP key id, key and if key is trusted and is a request key\n");
-		break;		
+	if(control->state != NTPCONTROL_WAITING)
+		return;
 
-	default:
-	ERROR("NTP protocol error\n");
+	DBGV("NTPDC Timed out waiting for response to request %d\n", control->pendingRequest);
 
-	}
-	}
-	return res;
+	control->timeouts++;
+	ntpdRequestComplete(options, control,
+		control->respFirst ? ERR_TIMEOUT : ERR_INCOMPLETE);
 
 }
 
-/* This function maintains the desired ntpd state based on NTPcontrol fields */
+/*
+ * This function maintains the desired ntpd state based on NTPcontrol fields.
+ * It only sends the status query and returns - the outcome is handled as the
+ * replies arrive, so it returns FALSE only if the query could not be sent.
+ */
 Boolean ntpdControl(NTPoptions* options, NTPcontrol* control, Boolean quiet)
 {
 
@@ -874,104 +880,15 @@ Boolean ntpdControl(NTPoptions* options, NTPcontrol* control, Boolean quiet)
 		}
 	}
 
-	/* Find out if NTPd is controlling the clock or not */
-
-//	if (!quiet) INFO("Checking local NTPd status\n");
-
-	switch(ntpdInControl(options, control)) {
-
-		case INFO_YES:
-			control->inControl = TRUE;
-			break;
-		case INFO_NO:
-			control->inControl = FALSE;
-			break;
-		default:
-			if(!control->checkFailed)
-			WARNING("Could not verify NTP status - will keep checking\n");
-			control->inControl = FALSE;
-			control->checkFailed = TRUE;
-		return FALSE;
-	}
-
-	if(control->checkFailed)
-		NOTIFY("NTPd now available\n");
-	control->checkFailed = FALSE;
-
-	/* NTP is running as expected */
-
-	if(control->inControl == control->isRequired) {
-		control->requestFailed = FALSE;
-		if(!quiet) {
-			if(control->isRequired)
-				INFO("NTPd running and is already controlling the clock - OK\n");
-			else
-				INFO("NTPd running and is not controlling the clock - OK\n");
-		}
+	/* A request is in flight - check again with the current state once it completes */
+	if(control->state != NTPCONTROL_IDLE) {
+		control->recheckPending = TRUE;
+		control->quiet &= quiet;
 		return TRUE;
+	}
 
-	/* NTP is not running as expected - see if we can fail over or fail back */
-
-	} else  {
-
-		/* We can't control NTPD - inform only */
-		if(!options->enableControl) {
-/*			if(!quiet) {*/
-				if(control->isRequired) {
-					INFO("Found NTPd running and not controlling the clock\n");
-					WARNING("Cannot hand over control to NTPd - NTPD control is disabled\n");
-				} else {
-					INFO("Found NTPd running and controlling the clock\n");
-					WARNING("Cannot take over clock control from NTPd - NTPd control is disabled\n");
-/*				}   */
-			}
-			/* We cannot fail over but there were no errors - still return TRUE */
-			return TRUE;
-		}
-
-		/* We can control NTPd - try to match the desired state */
-
-		/* Attempt handing over clock control TO NTPD */
-
-		if(control->isRequired) {
-			if(!control->requestFailed) INFO("Found NTPd running and not controlling the clock\n");
-			if(!control->requestFailed) INFO("Attempting to fail over to local NTPd\n");
-				switch(ntpdSetFlags(options, control, SYS_FLAG_KERNEL | SYS_FLAG_NTP)) {
-					case INFO_OKAY:
-						NOTICE("Succesfully failed over to NTP\n");
-						control->inControl = TRUE;
-						control->requestFailed = FALSE;
-						return TRUE;
-						break;
-					default:
-						if(!control->requestFailed) WARNING("Could not fail over to NTP  - Clock may drift! See previous errors\n");
-						control->requestFailed = TRUE;
-						return FALSE;
-						break;
-				}
-
-		/* Attempt taking clock control back FROM NTPD */
-
-		} else {
-			if(!control->requestFailed) INFO("Found NTPd running and controlling the clock\n");
-			if(!control->requestFailed) INFO("Attempting to disable local NTPd\n");
-				switch(ntpdClearFlags(options, control, SYS_FLAG_KERNEL | SYS_FLAG_NTP)) {
-					case INFO_OKAY:
-						NOTICE("Succesfully disabled local NTPd\n");
-						control->inControl = FALSE;
-						control->requestFailed = FALSE;
-						return TRUE;
-						break;
-					default:
-						if(!control->requestFailed) WARNING("Could not disable local NTPd - Clock may be unstable! See previous errors\n");
-						control->requestFailed = TRUE;
-						return FALSE;
-						break;
-				}
-			}
-
-		}
-
-return FALSE;
+	/* Find out if NTPd is controlling the clock or not */
+	control->quiet = quiet;
+	return ntpdStartRequest(options, control, REQ_SYS_INFO, 0);
 
 }
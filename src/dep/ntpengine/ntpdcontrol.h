@@ -32,15 +32,36 @@ typedef struct {
 	int originalFlags;
 	Integer32 serverAddress;
 	Integer32 sockFD;
+	/* request in flight - replies are read from the main loop */
+	int state;
+	int pendingRequest;
+	int pendingFlags;
+	Boolean recheckPending;
+	Boolean quiet;
+	uint32_t timeouts;
+	/* response being assembled */
+	int respEsize;
+	int respItems;
+	int respSize;
+	int respNumRecv;
+	int respLastSeq;
+	Boolean respFirst;
+	char respHaveSeq[128];		/* MAXSEQ + 1 */
+	/* PtpClock timers, for NTPD_REPLY_TIMER and NTPD_FAILOVER_TIMER */
+	struct IntervalTimer *itimer;
 } NTPcontrol;
 
+/* NTPcontrol.state */
+enum {
+	NTPCONTROL_IDLE = 0,
+	NTPCONTROL_WAITING
+};
+
 Boolean ntpInit(NTPoptions* options, NTPcontrol* control);
 Boolean ntpShutdown(NTPoptions* options, NTPcontrol* control);
-int ntpdControlFlags(NTPoptions* options, NTPcontrol* control, int req, int flags);
-int ntpdSetFlags(NTPoptions* options, NTPcontrol* control, int flags);
-int ntpdClearFlags(NTPoptions* options, NTPcontrol* control, int flags);
-int ntpdInControl(NTPoptions* options, NTPcontrol* control);
 Boolean ntpdControl(NTPoptions* options, NTPcontrol* control, Boolean quiet);
+void ntpdControlReceive(NTPoptions* options, NTPcontrol* control);
+void ntpdControlTimeout(NTPoptions* options, NTPcontrol* control);
 
 
 #define NTPCONTROL_YES		128
@@ -0,0 +1,427 @@
+/*-
+ * Copyright (c) 2014 Wojciech Owczarek,
+ *
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file   ntpserver.c
+ *
+ * @brief  Built-in (S)NTP server
+ *
+ * Answers NTP client (mode 3) requests from the PTP-disciplined system
+ * clock, so that NTP-only hosts can be served without running a separate
+ * ntpd next to ptpd2. Requests are read and answered in batches from the
+ * main loop; receive timestamps come from the kernel. Stratum, reference
+ * ID, root delay and root dispersion are derived from the current / parent
+ * data sets and the servo state - when ptpd2 is not disciplining the clock
+ * as a slave, replies are marked unsynchronised (LI 3, stratum 16).
+ */
+
+#include "../ptpd.h"
+
+/* TimeInternal to an NTP timestamp in network byte order */
+static void
+ntpServerTimestamp(const TimeInternal *time, uint32_t *sec, uint32_t *frac)
+{
+	*sec = htonl((uint32_t)(time->seconds + NTPSERVER_EPOCH_OFFSET));
+	*frac = htonl((uint32_t)(((uint64_t)time->nanoseconds << 32) / 1000000000ULL));
+}
+
+/* Seconds to the NTP short format (16.16) in network byte order, saturated */
+static uint32_t
+ntpServerShort(double seconds)
+{
+	if(seconds <= 0)
+		return 0;
+	if(seconds >= 65535.0)
+		return htonl(0xffffffff);
+	return htonl((uint32_t)(seconds * 65536.0));
+}
+
+/*
+ * Fill the fields common to all replies in a batch from the current
+ * clock state. Returns the leap indicator to be used.
+ */
+static int
+ntpServerTemplate(RunTimeOpts *rtOpts, PtpClock *ptpClock, const TimeInternal *now, NtpPacket *tmpl)
+{
+
+	TimeInternal *delay;
+	TimeInternal age;
+	double error;
+	uint32_t folded[2];
+	int stratum;
+
+	memset(tmpl, 0, sizeof(NtpPacket));
+	tmpl->precision = NTPSERVER_PRECISION;
+
+	/* we only vouch for the clock while we are disciplining it as a slave */
+	if(ptpClock->portState != PTP_SLAVE || ptpClock->panicMode ||
+	    rtOpts->noAdjust || ptpClock->sync_receive_time.seconds == 0) {
+		tmpl->stratum = NTPSERVER_STRATUM_UNSYNC;
+		tmpl->rootDispersion = ntpServerShort(65535.0);
+		return NTPSERVER_LEAP_NOTINSYNC;
+	}
+
+	/* the grandmaster is the reference clock, every PTP hop counts as a stratum */
+	stratum = (ptpClock->timePropertiesDS.timeTraceable ? 1 : NTPSERVER_STRATUM_UNTRACEABLE) +
+		    ptpClock->stepsRemoved;
+	tmpl->stratum = (stratum > NTPSERVER_STRATUM_MAX) ? NTPSERVER_STRATUM_MAX : stratum;
+
+	/* no IPv4 address to refer to - fold the grandmaster identity instead */
+	memcpy(folded, ptpClock->grandmasterIdentity, sizeof(folded));
+	tmpl->refId = folded[0] ^ folded[1];
+
+	delay = (ptpClock->delayMechanism == P2P) ?
+		&ptpClock->peerMeanPathDelay : &ptpClock->meanPathDelay;
+	tmpl->rootDelay = ntpServerShort(2 * fabs(timeInternalToDouble(delay)));
+
+	/* offset noise if we have it, last offset otherwise, growing since the last update */
+#ifdef PTPD_STATISTICS
+	if(ptpClock->slaveStats.statsCalculated)
+		error = 3 * ptpClock->slaveStats.ofmStdDev;
+	else
+#endif /* PTPD_STATISTICS */
+		error = fabs(timeInternalToDouble(&ptpClock->offsetFromMaster));
+	subTime(&age, now, &ptpClock->sync_receive_time);
+	error += NTPSERVER_PHI * fabs(timeInternalToDouble(&age));
+	tmpl->rootDispersion = ntpServerShort(error);
+
+	ntpServerTimestamp(&ptpClock->sync_receive_time, &tmpl->refTimeSec, &tmpl->refTimeFrac);
+
+	if(ptpClock->timePropertiesDS.leap61)
+		return NTPSERVER_LEAP_ADDSECOND;
+	if(ptpClock->timePropertiesDS.leap59)
+		return NTPSERVER_LEAP_DELSECOND;
+	return NTPSERVER_LEAP_NOWARNING;
+
+}
+
+static void
+ntpServerPrepareRx(NtpServerSlot *slot, struct msghdr *msg)
+{
+	slot->rxVec.iov_base = slot->request;
+	slot->rxVec.iov_len = sizeof(slot->request);
+	memset(msg, 0, sizeof(struct msghdr));
+	msg->msg_name = &slot->client;
+	msg->msg_namelen = sizeof(slot->client);
+	msg->msg_iov = &slot->rxVec;
+	msg->msg_iovlen = 1;
+	msg->msg_control = slot->cmsgBuf.control;
+	msg->msg_controllen = sizeof(slot->cmsgBuf.control);
+}
+
+static void
+ntpServerPrepareTx(NtpServerSlot *slot, struct msghdr *msg)
+{
+	slot->txVec.iov_base = &slot->reply;
+	slot->txVec.iov_len = sizeof(NtpPacket);
+	memset(msg, 0, sizeof(struct msghdr));
+	msg->msg_name = &slot->client;
+	msg->msg_namelen = sizeof(slot->client);
+	msg->msg_iov = &slot->txVec;
+	msg->msg_iovlen = 1;
+}
+
+/* Get the kernel receive timestamp, falling back to the current time */
+static void
+ntpServerRxTime(NtpServer *server, NtpServerSlot *slot, struct msghdr *msg)
+{
+	struct cmsghdr *cmsg;
+	TimeInternal now;
+
+	if(server->kernelTimestamps && !(msg->msg_flags & MSG_CTRUNC)) {
+		for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL;
+		     cmsg = CMSG_NXTHDR(msg, cmsg)) {
+			if (cmsg->cmsg_level != SOL_SOCKET)
+				continue;
+#if defined(SO_TIMESTAMPNS)
+			if(cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+				memcpy(&slot->rxTime, CMSG_DATA(cmsg), sizeof(struct timespec));
+				return;
+			}
+#elif defined(SO_TIMESTAMP)
+			if(cmsg->cmsg_type == SCM_TIMESTAMP) {
+				struct timeval *tv = (struct timeval *)CMSG_DATA(cmsg);
+				slot->rxTime.tv_sec = tv->tv_sec;
+				slot->rxTime.tv_nsec = tv->tv_usec * 1000;
+				return;
+			}
+#endif
+		}
+	}
+
+	getTime(&now);
+	slot->rxTime.tv_sec = now.seconds;
+	slot->rxTime.tv_nsec = now.nanoseconds;
+}
+
+/* Read up to NTPSERVER_BATCH requests, returns the number read */
+static int
+ntpServerRecvBatch(NtpServer *server)
+{
+	int i, n;
+#ifdef HAVE_RECVMMSG
+	struct mmsghdr msgs[NTPSERVER_BATCH];
+
+	for(i = 0; i < NTPSERVER_BATCH; i++) {
+		ntpServerPrepareRx(&server->slots[i], &msgs[i].msg_hdr);
+		msgs[i].msg_len = 0;
+	}
+
+	n = recvmmsg(server->sockFD, msgs, NTPSERVER_BATCH, MSG_DONTWAIT, NULL);
+
+	for(i = 0; i < n; i++) {
+		server->slots[i].length = msgs[i].msg_len;
+		ntpServerRxTime(server, &server->slots[i], &msgs[i].msg_hdr);
+	}
+#else
+	struct msghdr msg;
+	ssize_t ret;
+
+	for(n = 0; n < NTPSERVER_BATCH; n++) {
+		ntpServerPrepareRx(&server->slots[n], &msg);
+		if((ret = recvmsg(server->sockFD, &msg, MSG_DONTWAIT)) < 0)
+			break;
+		server->slots[n].length = ret;
+		ntpServerRxTime(server, &server->slots[n], &msg);
+	}
+	if(n > 0)
+		return n;
+	n = -1;
+#endif /* HAVE_RECVMMSG */
+
+	if(n < 0) {
+		if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			DBG("NTP server: receive error: %s\n", strerror(errno));
+		return 0;
+	}
+
+	return n;
+}
+
+/* Send all replies prepared in the current batch */
+static void
+ntpServerSendBatch(NtpServer *server, int count)
+{
+	int i, queued, sent;
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr msgs[NTPSERVER_BATCH];
+
+	for(i = 0, queued = 0; i < count; i++) {
+		if(!server->slots[i].replied)
+			continue;
+		ntpServerPrepareTx(&server->slots[i], &msgs[queued].msg_hdr);
+		msgs[queued++].msg_len = 0;
+	}
+
+	if(queued == 0)
+		return;
+
+	/* sendmmsg() stops at the first failure - count the rest as errors */
+	if((sent = sendmmsg(server->sockFD, msgs, queued, MSG_DONTWAIT)) < 0)
+		sent = 0;
+#else
+	struct msghdr msg;
+
+	for(i = 0, queued = 0, sent = 0; i < count; i++) {
+		if(!server->slots[i].replied)
+			continue;
+		queued++;
+		ntpServerPrepareTx(&server->slots[i], &msg);
+		if(sendmsg(server->sockFD, &msg, MSG_DONTWAIT) == sizeof(NtpPacket))
+			sent++;
+	}
+#endif /* HAVE_SENDMMSG */
+
+	server->replies += sent;
+	if(sent < queued) {
+		server->sendErrors += queued - sent;
+		DBG("NTP server: failed to send %d of %d replies\n", queued - sent, queued);
+	}
+}
+
+/* Build the reply for one request, returns FALSE if it should not be answered */
+static Boolean
+ntpServerReply(NtpServerSlot *slot, const NtpPacket *tmpl, int leap)
+{
+	const NtpPacket *request = (const NtpPacket *)slot->request;
+	TimeInternal rxTime;
+	int version;
+
+	if(slot->length < (ssize_t)sizeof(NtpPacket))
+		return FALSE;
+
+	version = NTPSERVER_VN(request->livnmode);
+	if(NTPSERVER_MODE(request->livnmode) != NTPSERVER_MODE_CLIENT ||
+	    version < 1 || version > 4)
+		return FALSE;
+
+	slot->reply = *tmpl;
+	slot->reply.livnmode = NTPSERVER_LI_VN_MODE(leap, version, NTPSERVER_MODE_SERVER);
+	slot->reply.poll = request->poll;
+	slot->reply.origTimeSec = request->txTimeSec;
+	slot->reply.origTimeFrac = request->txTimeFrac;
+	rxTime.seconds = slot->rxTime.tv_sec;
+	rxTime.nanoseconds = slot->rxTime.tv_nsec;
+	ntpServerTimestamp(&rxTime, &slot->reply.rxTimeSec, &slot->reply.rxTimeFrac);
+
+	return TRUE;
+}
+
+Boolean
+ntpServerInit(RunTimeOpts *rtOpts, NtpServer *server)
+{
+
+	struct sockaddr_in addr;
+	Integer32 bindAddr;
+	int val = 1;
+
+	ntpServerShutdown(server);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(rtOpts->ntpServerPort);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+	if(strlen(rtOpts->ntpServerAddress)) {
+		if(!hostLookup(rtOpts->ntpServerAddress, &bindAddr)) {
+			ERROR("NTP server: could not resolve bind address %s\n",
+				rtOpts->ntpServerAddress);
+			return FALSE;
+		}
+		addr.sin_addr.s_addr = bindAddr;
+	}
+
+	if((server->sockFD = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0) {
+		PERROR("Could not create NTP server socket");
+		return FALSE;
+	}
+
+	if(setsockopt(server->sockFD, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(int)) < 0)
+		DBG("NTP server: failed to set SO_REUSEADDR\n");
+
+	if(bind(server->sockFD, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		PERROR("Could not bind NTP server socket to %s:%d",
+			inet_ntoa(addr.sin_addr), rtOpts->ntpServerPort);
+		ntpServerShutdown(server);
+		return FALSE;
+	}
+
+	val = NTPSERVER_RCVBUF;
+	if(setsockopt(server->sockFD, SOL_SOCKET, SO_RCVBUF, &val, sizeof(int)) < 0)
+		DBG("NTP server: failed to set receive buffer size to %d\n", val);
+
+	/* kernel receive timestamps - same preference as for PTP event sockets */
+	val = 1;
+	server->kernelTimestamps = FALSE;
+#if defined(SO_TIMESTAMPNS)
+	if(setsockopt(server->sockFD, SOL_SOCKET, SO_TIMESTAMPNS, &val, sizeof(int)) == 0)
+		server->kernelTimestamps = TRUE;
+#elif defined(SO_TIMESTAMP)
+	if(setsockopt(server->sockFD, SOL_SOCKET, SO_TIMESTAMP, &val, sizeof(int)) == 0)
+		server->kernelTimestamps = TRUE;
+#endif
+	if(!server->kernelTimestamps)
+		WARNING("NTP server: kernel timestamps not available - using user space receive timestamps\n");
+
+	if(fcntl(server->sockFD, F_SETFL, fcntl(server->sockFD, F_GETFL, 0) | O_NONBLOCK) < 0) {
+		PERROR("Could not set NTP server socket to non-blocking");
+		ntpServerShutdown(server);
+		return FALSE;
+	}
+
+	server->requests = 0;
+	server->replies = 0;
+	server->invalid = 0;
+	server->sendErrors = 0;
+
+	NOTICE("NTP server listening on %s:%d\n", inet_ntoa(addr.sin_addr),
+		rtOpts->ntpServerPort);
+
+	return TRUE;
+
+}
+
+void
+ntpServerShutdown(NtpServer *server)
+{
+
+	if(server->sockFD < 0)
+		return;
+
+	close(server->sockFD);
+	server->sockFD = -1;
+
+	INFO("NTP server stopped after %u requests (%u replies, %u invalid, %u send errors)\n",
+		server->requests, server->replies, server->invalid, server->sendErrors);
+
+}
+
+/* Called from the main loop when the NTP server socket is readable */
+void
+ntpServerReceive(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	NtpServer *server = &ptpClock->ntpServer;
+	NtpServerSlot *slot;
+	NtpPacket tmpl;
+	TimeInternal now;
+	uint32_t txSec, txFrac;
+	int batch, received, i, leap;
+
+	for(batch = 0; batch < NTPSERVER_MAX_BATCHES; batch++) {
+
+		if((received = ntpServerRecvBatch(server)) <= 0)
+			break;
+
+		server->requests += received;
+
+		getTime(&now);
+		leap = ntpServerTemplate(rtOpts, ptpClock, &now, &tmpl);
+
+		for(i = 0; i < received; i++) {
+			slot = &server->slots[i];
+			if(!(slot->replied = ntpServerReply(slot, &tmpl, leap)))
+				server->invalid++;
+		}
+
+		/* transmit timestamp as late as possible - one for the whole batch */
+		getTime(&now);
+		ntpServerTimestamp(&now, &txSec, &txFrac);
+		for(i = 0; i < received; i++) {
+			server->slots[i].reply.txTimeSec = txSec;
+			server->slots[i].reply.txTimeFrac = txFrac;
+		}
+
+		ntpServerSendBatch(server, received);
+
+		/* socket drained */
+		if(received < NTPSERVER_BATCH)
+			break;
+	}
+
+}
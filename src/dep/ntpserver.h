@@ -0,0 +1,91 @@
+/**
+ * @file   ntpserver.h
+ *
+ * @brief  definitions related to the built-in (S)NTP server
+ *
+ */
+
+#ifndef PTPD_NTPSERVER_H_
+#define PTPD_NTPSERVER_H_
+
+#define NTPSERVER_DEFAULT_PORT		123
+
+/* Seconds between the NTP era 0 epoch (1900) and the Unix epoch */
+#define NTPSERVER_EPOCH_OFFSET		2208988800UL
+
+/* Requests read / replies sent with one recvmmsg() / sendmmsg() call */
+#define NTPSERVER_BATCH			32
+/* Batches served per main loop pass - PTP traffic must not wait behind a flood */
+#define NTPSERVER_MAX_BATCHES		8
+/* Requests may carry extension fields or a MAC - only the header is used */
+#define NTPSERVER_MAX_REQUEST		512
+/* Socket receive buffer, large enough to absorb bursts between main loop passes */
+#define NTPSERVER_RCVBUF		(1024 * 1024)
+
+#define NTPSERVER_MODE_CLIENT		3
+#define NTPSERVER_MODE_SERVER		4
+#define NTPSERVER_LEAP_NOWARNING	0
+#define NTPSERVER_LEAP_ADDSECOND	1
+#define NTPSERVER_LEAP_DELSECOND	2
+#define NTPSERVER_LEAP_NOTINSYNC	3
+#define NTPSERVER_STRATUM_UNSYNC	16
+#define NTPSERVER_STRATUM_MAX		15
+/* Base stratum for a grandmaster whose time is not traceable: the local clock convention */
+#define NTPSERVER_STRATUM_UNTRACEABLE	10
+/* Advertised precision: 2^-20 s (~1 us) */
+#define NTPSERVER_PRECISION		-20
+/* Dispersion growth since the last clock update: NTP's PHI, 15 PPM */
+#define NTPSERVER_PHI			15E-6
+
+#define NTPSERVER_LI_VN_MODE(li, vn, mode) \
+	((uint8_t)((((li) & 3) << 6) | (((vn) & 7) << 3) | ((mode) & 7)))
+#define NTPSERVER_VN(livnmode)		(((livnmode) >> 3) & 7)
+#define NTPSERVER_MODE(livnmode)	((livnmode) & 7)
+
+/* NTP packet header (RFC 5905), all fields in network byte order */
+typedef struct {
+	uint8_t livnmode;
+	uint8_t stratum;
+	int8_t poll;
+	int8_t precision;
+	uint32_t rootDelay;
+	uint32_t rootDispersion;
+	uint32_t refId;
+	uint32_t refTimeSec;
+	uint32_t refTimeFrac;
+	uint32_t origTimeSec;
+	uint32_t origTimeFrac;
+	uint32_t rxTimeSec;
+	uint32_t rxTimeFrac;
+	uint32_t txTimeSec;
+	uint32_t txTimeFrac;
+} NtpPacket;
+
+/* Per-request receive and transmit buffers for one batch */
+typedef struct {
+	char request[NTPSERVER_MAX_REQUEST];
+	ssize_t length;
+	struct timespec rxTime;
+	Boolean replied;
+	NtpPacket reply;
+	struct sockaddr_in client;
+	struct iovec rxVec;
+	struct iovec txVec;
+	union {
+		struct cmsghdr cm;
+		char control[CMSG_SPACE(sizeof(struct timespec))];
+	} cmsgBuf;
+} NtpServerSlot;
+
+typedef struct {
+	int sockFD;
+	Boolean kernelTimestamps;
+	NtpServerSlot slots[NTPSERVER_BATCH];
+	/* counters */
+	uint32_t requests;
+	uint32_t replies;
+	uint32_t invalid;
+	uint32_t sendErrors;
+} NtpServer;
+
+#endif /* PTPD_NTPSERVER_H_ */
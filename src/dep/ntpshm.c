@@ -0,0 +1,151 @@
+/*-
+ * Copyright (c) 2014 Wojciech Owczarek,
+ *
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file   ntpshm.c
+ *
+ * @brief  NTP shared memory reference clock output
+ *
+ * In measurement-only mode ptpd2 does not discipline the clock itself:
+ * every offset sample is posted to the SysV shared memory segment read
+ * by the ntpd SHM refclock driver (type 28) or chrony's SHM refclock,
+ * using the mode 1 (count-protected) protocol.
+ */
+
+#include "../ptpd.h"
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+Boolean
+ntpShmInit(RunTimeOpts *rtOpts, NtpShm *ntpShm)
+{
+
+	int shmId;
+	int perms;
+	void *segment;
+
+	ntpShmShutdown(ntpShm);
+
+	perms = (rtOpts->ntpShmUnit < NTPSHM_PRIVATE_UNITS) ? 0600 : 0666;
+
+	if((shmId = shmget(NTPSHM_KEY_BASE + rtOpts->ntpShmUnit,
+		    sizeof(struct shmTime), IPC_CREAT | perms)) < 0) {
+		PERROR("Could not get NTP SHM segment for unit %d", rtOpts->ntpShmUnit);
+		return FALSE;
+	}
+
+	if((segment = shmat(shmId, NULL, 0)) == (void*)-1) {
+		PERROR("Could not attach NTP SHM segment for unit %d", rtOpts->ntpShmUnit);
+		return FALSE;
+	}
+
+	ntpShm->segment = (volatile struct shmTime*)segment;
+	ntpShm->unit = rtOpts->ntpShmUnit;
+	ntpShm->samplesPosted = 0;
+
+	ntpShm->segment->valid = 0;
+	ntpShm->segment->mode = 1;
+	ntpShm->segment->precision = NTPSHM_PRECISION;
+	ntpShm->segment->nsamples = 0;
+
+	NOTICE("Measurement-only mode: posting offsets to NTP SHM unit %d (key 0x%08x)\n",
+		ntpShm->unit, NTPSHM_KEY_BASE + ntpShm->unit);
+
+	return TRUE;
+
+}
+
+void
+ntpShmShutdown(NtpShm *ntpShm)
+{
+
+	if(ntpShm->segment == NULL)
+		return;
+
+	/* consumer may still be attached: only invalidate and detach, never remove */
+	ntpShm->segment->valid = 0;
+	shmdt((const void*)ntpShm->segment);
+	ntpShm->segment = NULL;
+
+	INFO("Detached from NTP SHM unit %d after %u samples\n",
+		ntpShm->unit, ntpShm->samplesPosted);
+
+}
+
+/**
+ * Post the last offset measurement: the receive timestamp is the local
+ * Sync arrival time, the clock timestamp is the same instant in master time.
+ */
+void
+ntpShmUpdate(NtpShm *ntpShm, PtpClock *ptpClock)
+{
+
+	volatile struct shmTime *shm = ntpShm->segment;
+	TimeInternal masterTime;
+	int leap;
+
+	if(shm == NULL)
+		return;
+
+	subTime(&masterTime, &ptpClock->sync_receive_time, &ptpClock->offsetFromMaster);
+
+	if(ptpClock->portState != PTP_SLAVE)
+		leap = NTPSHM_LEAP_NOTINSYNC;
+	else if(ptpClock->timePropertiesDS.leap61)
+		leap = NTPSHM_LEAP_ADDSECOND;
+	else if(ptpClock->timePropertiesDS.leap59)
+		leap = NTPSHM_LEAP_DELSECOND;
+	else
+		leap = NTPSHM_LEAP_NOWARNING;
+
+	/* mode 1: the reader discards the sample if count changed while reading */
+	shm->valid = 0;
+	shm->count++;
+	__sync_synchronize();
+
+	shm->clockTimeStampSec = masterTime.seconds;
+	shm->clockTimeStampUSec = masterTime.nanoseconds / 1000;
+	shm->clockTimeStampNSec = masterTime.nanoseconds;
+	shm->receiveTimeStampSec = ptpClock->sync_receive_time.seconds;
+	shm->receiveTimeStampUSec = ptpClock->sync_receive_time.nanoseconds / 1000;
+	shm->receiveTimeStampNSec = ptpClock->sync_receive_time.nanoseconds;
+	shm->leap = leap;
+	shm->precision = NTPSHM_PRECISION;
+
+	__sync_synchronize();
+	shm->count++;
+	shm->valid = 1;
+
+	if(ntpShm->samplesPosted++ == 0)
+		INFO("First offset sample posted to NTP SHM unit %d\n", ntpShm->unit);
+
+	DBGV("NTP SHM unit %d: posted offset %ds %dns (count %d)\n", ntpShm->unit,
+		ptpClock->offsetFromMaster.seconds, ptpClock->offsetFromMaster.nanoseconds,
+		shm->count);
+
+}
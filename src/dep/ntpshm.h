@@ -0,0 +1,57 @@
+/**
+ * @file   ntpshm.h
+ *
+ * @brief  definitions related to the NTP shared memory reference clock output
+ *
+ */
+
+#ifndef PTPD_NTPSHM_H_
+#define PTPD_NTPSHM_H_
+
+/* SysV IPC key of SHM unit 0 ("NTP0"), unit n uses NTPSHM_KEY_BASE + n */
+#define NTPSHM_KEY_BASE		0x4e545030
+#define NTPSHM_MAX_UNIT		255
+
+/* Units 0 and 1 are root-only, higher units are world-writable (ntpd convention) */
+#define NTPSHM_PRIVATE_UNITS	2
+
+/* Sample precision advertised to the consumer: 2^-20 s (~1 us) */
+#define NTPSHM_PRECISION	-20
+
+/* leap indicator values, as in ntp.h */
+enum {
+	NTPSHM_LEAP_NOWARNING = 0,
+	NTPSHM_LEAP_ADDSECOND,
+	NTPSHM_LEAP_DELSECOND,
+	NTPSHM_LEAP_NOTINSYNC
+};
+
+/*
+ * The shared memory segment layout used by the ntpd SHM refclock driver
+ * (refclock_shm.c) and chrony - must not be changed.
+ */
+struct shmTime {
+	int    mode; /* 0 - if valid is set, use values, clear valid
+		      * 1 - if valid is set, and count before and after
+		      *     read of values is equal, use values, clear valid */
+	volatile int count;
+	time_t clockTimeStampSec;
+	int    clockTimeStampUSec;
+	time_t receiveTimeStampSec;
+	int    receiveTimeStampUSec;
+	int    leap;
+	int    precision;
+	int    nsamples;
+	volatile int valid;
+	unsigned clockTimeStampNSec;
+	unsigned receiveTimeStampNSec;
+	int    dummy[8];
+};
+
+typedef struct {
+	volatile struct shmTime *segment;
+	int unit;
+	uint32_t samplesPosted;
+} NtpShm;
+
+#endif /* PTPD_NTPSHM_H_ */
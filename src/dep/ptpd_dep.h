@@ -170,6 +170,10 @@ void msgPackSync(Octet * buf,Timestamp*,PtpClock*);
 void msgPackFollowUp(Octet * buf,Timestamp*,PtpClock*, const UInteger16);
 void msgPackDelayReq(Octet * buf,Timestamp *,PtpClock *);
 void msgPackDelayResp(Octet * buf,MsgHeader *,Timestamp *,PtpClock *);
+void msgPatchSync(Octet * buf,Timestamp*,PtpClock*);
+void msgPatchFollowUp(Octet * buf,Timestamp*,PtpClock*, const UInteger16);
+void msgPatchDelayReq(Octet * buf,Timestamp *,PtpClock *);
+void msgPatchDelayResp(Octet * buf,MsgHeader *,Timestamp *,PtpClock *);
 void msgPackPDelayReq(Octet * buf,Timestamp*,PtpClock*);
 void msgPackPDelayResp(Octet * buf,MsgHeader*,Timestamp*,PtpClock*);
 void msgPackPDelayRespFollowUp(Octet * buf,MsgHeader*,Timestamp*,PtpClock*, const UInteger16);
@@ -195,6 +199,8 @@ void copyPortIdentity( PortIdentity * dest, PortIdentity * src);
 
 void unpackMsgManagement(Octet *, MsgManagement*, PtpClock*);
 void packMsgManagement(MsgManagement*, Octet *);
+void* managementArenaAlloc(ManagementArena*, size_t);
+void managementArenaReset(ManagementArena*);
 void unpackManagementTLV(Octet*, MsgManagement*, PtpClock*);
 void packManagementTLV(ManagementTLV*, Octet*);
 void freeManagementTLV(MsgManagement*);
@@ -247,6 +253,10 @@ void unpackMMDelayMechanism( Octet* buf, MsgManagement*, PtpClock* );
 UInteger16 packMMDelayMechanism( MsgManagement*, Octet*);
 void unpackMMLogMinPdelayReqInterval( Octet* buf, MsgManagement*, PtpClock* );
 UInteger16 packMMLogMinPdelayReqInterval( MsgManagement*, Octet*);
+UInteger16 packMMPtpdCounters( MsgManagement*, Octet*);
+UInteger16 packMMPtpdServo( MsgManagement*, Octet*);
+UInteger16 packMMPtpdSlaveStats( MsgManagement*, Octet*);
+UInteger16 packMMPtpdSlaveTable( MsgManagement*, Octet*);
 
 
 void unpackPortAddress( Octet* buf, PortAddress*, PtpClock*);
@@ -283,7 +293,9 @@ UInteger16 msgPackManagementResponse(Octet * buf,MsgHeader*,MsgManagement*,PtpCl
 Boolean testInterface(char* ifaceName, RunTimeOpts* rtOpts);
 Boolean netInit(NetPath*,RunTimeOpts*,PtpClock*);
 Boolean netShutdown(NetPath*);
+void netShare(NetPath*, const NetPath*);
 int netSelect(TimeInternal*,NetPath*,fd_set*);
+void netUpdateFilters(NetPath*,RunTimeOpts*,PtpClock*);
 ssize_t netRecvEvent(Octet*,TimeInternal*,NetPath*,int);
 ssize_t netRecvGeneral(Octet*,NetPath*);
 ssize_t netSendEvent(Octet*,UInteger16,NetPath*,RunTimeOpts*,Integer32,TimeInternal*);
@@ -311,10 +323,10 @@ void snmpShutdown();
  /**\{*/
 
 void initClock(RunTimeOpts*,PtpClock*);
-void updatePeerDelay (Filter*, RunTimeOpts*,PtpClock*,TimeInternal*,Boolean);
-void updateDelay (Filter*, RunTimeOpts*, PtpClock*,TimeInternal*);
+void updatePeerDelay (Filter*, RunTimeOpts*,PtpClock*,TimeScaled,Boolean);
+void updateDelay (Filter*, RunTimeOpts*, PtpClock*,TimeScaled);
 void updateOffset(TimeInternal*,TimeInternal*,
-  Filter*,RunTimeOpts*,PtpClock*,TimeInternal*);
+  Filter*,RunTimeOpts*,PtpClock*,TimeScaled);
 void updateClock(RunTimeOpts*,PtpClock*);
 
 void servo_perform_clock_step(RunTimeOpts * rtOpts, PtpClock * ptpClock);
@@ -327,6 +339,8 @@ void servo_perform_clock_step(RunTimeOpts * rtOpts, PtpClock * ptpClock);
 int logToFile(RunTimeOpts * rtOpts);
 int recordToFile(RunTimeOpts * rtOpts);
 PtpClock * ptpdStartup(int,char**,Integer16*,RunTimeOpts*);
+PtpClock * createPtpClock(RunTimeOpts * rtOpts);
+void freePtpClock(PtpClock ** ptpClock);
 void ptpdShutdown(PtpClock * ptpClock);
 
 void checkSignals(RunTimeOpts * rtOpts, PtpClock * ptpClock);
@@ -357,6 +371,8 @@ void restartLogging(RunTimeOpts* rtOpts);
 void logStatistics(RunTimeOpts *rtOpts, PtpClock *ptpClock);
 void displayStatus(PtpClock *ptpClock, const char *prefixMessage);
 void displayPortIdentity(PortIdentity *port, const char *prefixMessage);
+int snprint_PortIdentity(char *s, int max_len, const PortIdentity *id);
+int snprint_ClockIdentity(char *s, int max_len, const ClockIdentity id);
 Boolean nanoSleep(TimeInternal*);
 void getTime(TimeInternal*);
 void setTime(TimeInternal*);
@@ -398,11 +414,66 @@ void setKernelUtcOffset(int utc_offset);
 
 /** \}*/
 
+/** \name clockpage.c (Unix API dependent)
+ * -Shared memory clock parameter page*/
+ /**\{*/
+Boolean clockPageInit(RunTimeOpts *rtOpts, PtpClock *ptpClock);
+void clockPageShutdown(RunTimeOpts *rtOpts, PtpClock *ptpClock);
+void clockPageUpdate(RunTimeOpts *rtOpts, PtpClock *ptpClock, Boolean newSample);
+/** \}*/
+
+/** \name ntpshm.c (Unix API dependent)
+ * -NTP shared memory reference clock output*/
+ /**\{*/
+Boolean ntpShmInit(RunTimeOpts *rtOpts, NtpShm *ntpShm);
+void ntpShmShutdown(NtpShm *ntpShm);
+void ntpShmUpdate(NtpShm *ntpShm, PtpClock *ptpClock);
+/** \}*/
+
+/** \name ntpserver.c (Unix API dependent)
+ * -Built-in NTP server*/
+ /**\{*/
+Boolean ntpServerInit(RunTimeOpts *rtOpts, NtpServer *server);
+void ntpServerShutdown(NtpServer *server);
+void ntpServerReceive(RunTimeOpts *rtOpts, PtpClock *ptpClock);
+/** \}*/
+
+/** \name holdover.c (Unix API dependent)
+ * -Holdover driven by a learned oscillator model*/
+ /**\{*/
+void holdoverFeed(RunTimeOpts *rtOpts, PtpClock *ptpClock);
+void holdoverStart(RunTimeOpts *rtOpts, PtpClock *ptpClock);
+void holdoverUpdate(RunTimeOpts *rtOpts, PtpClock *ptpClock);
+void holdoverStop(RunTimeOpts *rtOpts, PtpClock *ptpClock, Boolean keepFrequency);
+/** \}*/
+
+/** \name snapshot.c (Unix API dependent)
+ * -Warm start state snapshot*/
+ /**\{*/
+Boolean snapshotLoad(RunTimeOpts *rtOpts, PtpClock *ptpClock);
+void snapshotSave(RunTimeOpts *rtOpts, PtpClock *ptpClock, Boolean quiet);
+void snapshotApply(RunTimeOpts *rtOpts, PtpClock *ptpClock);
+/** \}*/
+
+/** \name ctlsocket.c (Unix API dependent)
+ * -Local control and telemetry socket*/
+ /**\{*/
+Boolean ctlSocketInit(RunTimeOpts *rtOpts, CtlSocket *ctl);
+void ctlSocketShutdown(CtlSocket *ctl);
+int ctlSocketFdSet(CtlSocket *ctl, fd_set *readfds, int nfds);
+void ctlSocketService(PtpClock *ptpClock, fd_set *readfds);
+void ctlSocketServoSample(PtpClock *ptpClock);
+void ctlSocketStateChange(PtpClock *ptpClock, UInteger8 previousState);
+void ctlSocketMonitorSample(PtpClock *ptpClock, const MonitorMaster *master);
+/** \}*/
+
 /** \name timer.c (Unix API dependent)
  * -Handle with timers*/
  /**\{*/
 void initTimer(void);
 void timerUpdate(IntervalTimer*);
+void timerRegister(IntervalTimer*);
+void timerUnregister(IntervalTimer*);
 void timerStop(UInteger16,IntervalTimer*);
 
 //void timerStart(UInteger16,UInteger16,IntervalTimer*);
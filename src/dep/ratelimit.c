@@ -0,0 +1,331 @@
+/*-
+ * Copyright (c) 2014 Wojciech Owczarek,
+ *
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file   ratelimit.c
+ *
+ * @brief  Per-source rate limiting of received messages
+ *
+ * Every source address gets a token bucket per message class, refilled
+ * at the configured rate with a burst of one second worth of messages.
+ * Sources live in a fixed-size table with a hash index; when the table
+ * is full, the least recently seen source is evicted, so memory stays
+ * bounded no matter how many addresses a flood uses.
+ */
+
+#include "../ptpd.h"
+
+static const char* rateLimitClassNames[RATELIMIT_CLASSES] = {
+	"event", "general", "announce", "management"
+};
+
+/* Map a PTP message type to its budget class */
+static int
+rateLimitClass(const uint8_t messageType)
+{
+
+	switch(messageType) {
+		case SYNC:
+		case DELAY_REQ:
+		case PDELAY_REQ:
+		case PDELAY_RESP:
+			return RATELIMIT_EVENT;
+		case FOLLOW_UP:
+		case DELAY_RESP:
+		case PDELAY_RESP_FOLLOW_UP:
+			return RATELIMIT_GENERAL;
+		case ANNOUNCE:
+		case SIGNALING:
+			return RATELIMIT_ANNOUNCE;
+		default:
+			return RATELIMIT_MANAGEMENT;
+	}
+
+}
+
+static uint64_t
+rateLimitNow(void)
+{
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+}
+
+static inline uint32_t
+rateLimitHash(RateLimiter* limiter, const uint32_t addr)
+{
+
+	/* Fibonacci hashing - spreads sequential addresses */
+	return (uint32_t)(addr * 2654435761U) % limiter->hashSize;
+
+}
+
+/* Unlink a source from the LRU list */
+static void
+lruRemove(RateLimiter* limiter, int32_t index)
+{
+
+	RateLimitSource* source = &limiter->sources[index];
+
+	if(source->lruPrev >= 0)
+		limiter->sources[source->lruPrev].lruNext = source->lruNext;
+	else
+		limiter->lruHead = source->lruNext;
+
+	if(source->lruNext >= 0)
+		limiter->sources[source->lruNext].lruPrev = source->lruPrev;
+	else
+		limiter->lruTail = source->lruPrev;
+
+}
+
+/* Make a source the most recently seen one */
+static void
+lruPushHead(RateLimiter* limiter, int32_t index)
+{
+
+	RateLimitSource* source = &limiter->sources[index];
+
+	source->lruPrev = -1;
+	source->lruNext = limiter->lruHead;
+	if(limiter->lruHead >= 0)
+		limiter->sources[limiter->lruHead].lruPrev = index;
+	limiter->lruHead = index;
+	if(limiter->lruTail < 0)
+		limiter->lruTail = index;
+
+}
+
+/* Unlink a source from its hash chain */
+static void
+hashRemove(RateLimiter* limiter, int32_t index)
+{
+
+	int32_t* link = &limiter->buckets[rateLimitHash(limiter, limiter->sources[index].addr)];
+
+	while(*link >= 0) {
+		if(*link == index) {
+			*link = limiter->sources[index].hashNext;
+			return;
+		}
+		link = &limiter->sources[*link].hashNext;
+	}
+
+}
+
+/* Find a source, or start tracking it with full buckets */
+static RateLimitSource*
+rateLimitSource(RateLimiter* limiter, const uint32_t addr, uint64_t now)
+{
+
+	int i;
+	int32_t index;
+	uint32_t bucket = rateLimitHash(limiter, addr);
+	RateLimitSource* source;
+
+	for(index = limiter->buckets[bucket]; index >= 0; index = limiter->sources[index].hashNext) {
+		if(limiter->sources[index].addr == addr) {
+			if(limiter->lruHead != index) {
+				lruRemove(limiter, index);
+				lruPushHead(limiter, index);
+			}
+			return &limiter->sources[index];
+		}
+	}
+
+	if(limiter->numSources < limiter->maxSources) {
+		index = limiter->numSources++;
+	} else {
+		index = limiter->lruTail;
+		lruRemove(limiter, index);
+		hashRemove(limiter, index);
+		limiter->evictedCounter++;
+	}
+
+	source = &limiter->sources[index];
+	source->addr = addr;
+	source->lastRefill = now;
+	source->droppedCounter = 0;
+	for(i = 0; i < RATELIMIT_CLASSES; i++)
+		source->tokens[i] = limiter->rates[i];
+
+	source->hashNext = limiter->buckets[bucket];
+	limiter->buckets[bucket] = index;
+	lruPushHead(limiter, index);
+
+	return source;
+
+}
+
+/* Structure initialisation for RateLimiter */
+RateLimiter*
+createRateLimiter(int maxSources, const int rates[RATELIMIT_CLASSES])
+{
+
+	int i;
+	RateLimiter* ret;
+
+	if(maxSources < 1)
+		return NULL;
+
+	ret = (RateLimiter*)calloc(1, sizeof(RateLimiter));
+	if(ret == NULL)
+		return NULL;
+
+	ret->maxSources = maxSources;
+	ret->hashSize = maxSources * RATELIMIT_HASH_LOAD;
+	ret->buckets = (int32_t*)malloc(ret->hashSize * sizeof(int32_t));
+	ret->sources = (RateLimitSource*)calloc(maxSources, sizeof(RateLimitSource));
+
+	if(ret->buckets == NULL || ret->sources == NULL) {
+		ERROR("Could not allocate memory for rate limiter\n");
+		freeRateLimiter(&ret);
+		return NULL;
+	}
+
+	for(i = 0; i < ret->hashSize; i++)
+		ret->buckets[i] = -1;
+
+	memcpy(ret->rates, rates, sizeof(ret->rates));
+	ret->lruHead = -1;
+	ret->lruTail = -1;
+
+	return ret;
+
+}
+
+/* Destroy a RateLimiter structure */
+void
+freeRateLimiter(RateLimiter** limiter)
+{
+
+	if(*limiter == NULL)
+		return;
+
+	if((*limiter)->buckets != NULL)
+		free((*limiter)->buckets);
+	if((*limiter)->sources != NULL)
+		free((*limiter)->sources);
+
+	free(*limiter);
+	*limiter = NULL;
+
+}
+
+/*
+ * Refill the source's buckets for the time elapsed since the last
+ * message and take one token from the message class bucket.
+ */
+int
+rateLimitAccept(RateLimiter* limiter, const uint32_t addr, const uint8_t messageType)
+{
+
+	int i;
+	int class = rateLimitClass(messageType);
+	uint64_t now;
+	double elapsed;
+	RateLimitSource* source;
+
+	/* Non-functional or unlimited rate limiter accepts everything */
+	if(limiter == NULL || limiter->rates[class] == 0)
+		return 1;
+
+	now = rateLimitNow();
+	source = rateLimitSource(limiter, addr, now);
+
+	elapsed = (now - source->lastRefill) / 1E9;
+	source->lastRefill = now;
+
+	for(i = 0; i < RATELIMIT_CLASSES; i++) {
+		source->tokens[i] += elapsed * limiter->rates[i];
+		/* burst: one second worth of messages */
+		if(source->tokens[i] > limiter->rates[i])
+			source->tokens[i] = limiter->rates[i];
+	}
+
+	if(source->tokens[class] < 1.0) {
+		limiter->droppedCounter[class]++;
+		source->droppedCounter++;
+		return 0;
+	}
+
+	source->tokens[class] -= 1.0;
+	return 1;
+
+}
+
+/* Dump the contents and counters of a rate limiter */
+void
+dumpRateLimiter(RateLimiter* limiter)
+{
+
+	int i;
+	int32_t index;
+	struct in_addr in;
+
+	INFO("\n\n");
+	if(limiter == NULL) {
+		INFO("(uninitialised rate limiter)\n");
+		return;
+	}
+
+	INFO("Tracked sources: %d of %d, evicted: %d\n",
+		limiter->numSources, limiter->maxSources, limiter->evictedCounter);
+	for(i = 0; i < RATELIMIT_CLASSES; i++) {
+		INFO("%10s budget: %d/s, dropped messages: %d\n",
+			rateLimitClassNames[i], limiter->rates[i], limiter->droppedCounter[i]);
+	}
+	INFO("--------\n");
+	INFO("Sources, most recently seen first:\n");
+	for(index = limiter->lruHead; index >= 0; index = limiter->sources[index].lruNext) {
+		in.s_addr = htonl(limiter->sources[index].addr);
+		INFO("%s\t dropped messages: %d\n", inet_ntoa(in),
+			limiter->sources[index].droppedCounter);
+	}
+	INFO("\n\n");
+
+}
+
+/* Clear rate limiter counters */
+void
+clearRateLimiterCounters(RateLimiter* limiter)
+{
+
+	int i;
+
+	if(limiter == NULL)
+		return;
+
+	memset(limiter->droppedCounter, 0, sizeof(limiter->droppedCounter));
+	limiter->evictedCounter = 0;
+	for(i = 0; i < limiter->numSources; i++)
+		limiter->sources[i].droppedCounter = 0;
+
+}
@@ -0,0 +1,62 @@
+/**
+ * @file   ratelimit.h
+ *
+ * @brief  definitions related to per-source rate limiting of received messages
+ *
+ */
+
+#ifndef PTPD_RATELIMIT_H_
+#define PTPD_RATELIMIT_H_
+
+/* Message classes with separate budgets */
+enum {
+	RATELIMIT_EVENT = 0,	/* Sync, Delay_Req, Pdelay_Req, Pdelay_Resp */
+	RATELIMIT_GENERAL,	/* Follow_Up, Delay_Resp, Pdelay_Resp_Follow_Up */
+	RATELIMIT_ANNOUNCE,	/* Announce, Signaling */
+	RATELIMIT_MANAGEMENT,	/* Management and unknown message types */
+	RATELIMIT_CLASSES
+};
+
+/* Hash buckets per tracked source */
+#define RATELIMIT_HASH_LOAD	2
+
+typedef struct {
+	uint32_t addr;
+	/* hash chain and LRU list links - indexes, -1 if none */
+	int32_t hashNext;
+	int32_t lruPrev;
+	int32_t lruNext;
+	/* last refill, monotonic nanoseconds */
+	uint64_t lastRefill;
+	double tokens[RATELIMIT_CLASSES];
+	uint32_t droppedCounter;
+} RateLimitSource;
+
+typedef struct {
+	/* budgets in messages per second, 0 = unlimited */
+	int rates[RATELIMIT_CLASSES];
+	int maxSources;
+	int numSources;
+	int hashSize;
+	int32_t* buckets;
+	RateLimitSource* sources;
+	/* least recently seen source is evicted when the table is full */
+	int32_t lruHead;
+	int32_t lruTail;
+	/* counters */
+	uint32_t droppedCounter[RATELIMIT_CLASSES];
+	uint32_t evictedCounter;
+} RateLimiter;
+
+/* Initialise a RateLimiter structure */
+RateLimiter* createRateLimiter(int maxSources, const int rates[RATELIMIT_CLASSES]);
+/* Destroy a RateLimiter structure */
+void freeRateLimiter(RateLimiter** limiter);
+/* Charge a message from a source address against its budget - return 1 if within budget */
+int rateLimitAccept(RateLimiter* limiter, const uint32_t addr, const uint8_t messageType);
+/* Display the contents and counters of a rate limiter */
+void dumpRateLimiter(RateLimiter* limiter);
+/* Clear counters */
+void clearRateLimiterCounters(RateLimiter* limiter);
+
+#endif /* PTPD_RATELIMIT_H_ */
@@ -83,8 +83,10 @@ initClock(RunTimeOpts * rtOpts, PtpClock * ptpClock)
 	/* clean more original filter variables */
 	clearTime(&ptpClock->offsetFromMaster);
 	clearTime(&ptpClock->meanPathDelay);
-	clearTime(&ptpClock->delaySM);
-	clearTime(&ptpClock->delayMS);
+	datasetChanged(ptpClock, MGMT_CACHE_CURRENT_DS);
+	ptpClock->delaySM = 0;
+	ptpClock->delayMS = 0;
+	ptpClock->delayMSOverflow = FALSE;
 
 	FilterClear(ptpClock->owd_filt);	/* clears one-way delay filter */
 	FilterClear(ptpClock->ofm_filt);	/* clears offset from master filter */
@@ -102,7 +104,7 @@ initClock(RunTimeOpts * rtOpts, PtpClock * ptpClock)
 }
 
 void
-updateDelay(Filter * owd_filt, RunTimeOpts * rtOpts, PtpClock * ptpClock, TimeInternal * correctionField)
+updateDelay(Filter * owd_filt, RunTimeOpts * rtOpts, PtpClock * ptpClock, TimeScaled correctionField)
 {
 
 	/* updates paused, leap second pending - do nothing */
@@ -115,8 +117,10 @@ updateDelay(Filter * owd_filt, RunTimeOpts * rtOpts, PtpClock * ptpClock, TimeIn
 
 	/* todo: do all intermediate calculations on temp vars */
 	TimeInternal prev_meanPathDelay = ptpClock->meanPathDelay;
+	TimeScaled delaySM;
 
 	ptpClock->char_last_msg = 'D';
+	datasetChanged(ptpClock, MGMT_CACHE_CURRENT_DS);
 
 	{
 		//perform basic checks, using local variables only
@@ -180,40 +184,46 @@ updateDelay(Filter * owd_filt, RunTimeOpts * rtOpts, PtpClock * ptpClock, TimeIn
 			dump_TimeInternal2("Req_RECV:", &ptpClock->delay_req_receive_time,
 			"Req_SENT:", &ptpClock->delay_req_send_time));
 		
+		/*
+		 * the clocks are too far apart for scaled units: no path delay
+		 * until the clock has been stepped
+		 */
+		if (!subTimeScaled(&delaySM, &ptpClock->delay_req_receive_time,
+			&ptpClock->delay_req_send_time) || ptpClock->delayMSOverflow) {
+			INFO("Servo: Ignoring delayResp because of large OFM\n");
+			FilterClear(owd_filt);
+			goto display;
+		}
+
 #ifdef PTPD_STATISTICS
 	if (rtOpts->delaySMOutlierFilterEnabled) {
-		subTime(&ptpClock->rawDelaySM, &ptpClock->delay_req_receive_time, 
-			&ptpClock->delay_req_send_time);
+		TimeScaled rawDelaySM = delaySM;
+		scaled_to_internalTime(rawDelaySM, &ptpClock->rawDelaySM);
 		if(!isDoublePeircesOutlier(ptpClock->delaySMRawStats, timeInternalToDouble(&ptpClock->rawDelaySM), rtOpts->delaySMOutlierFilterThreshold)) {
-			ptpClock->delaySM = ptpClock->rawDelaySM;
+			ptpClock->delaySM = rawDelaySM;
 			ptpClock->delaySMoutlier = FALSE;
 		} else {
 			ptpClock->delaySMoutlier = TRUE;
 			ptpClock->counters.delaySMOutliersFound++;
 			if (!rtOpts->delaySMOutlierFilterDiscard)  {
-				ptpClock->delaySM = doubleToTimeInternal(ptpClock->delaySMFiltered->mean);
+				TimeInternal mean = doubleToTimeInternal(ptpClock->delaySMFiltered->mean);
+				ptpClock->delaySM = internalTime_to_scaled(&mean);
 			} else {
 				    goto statistics;
 			}
 		}
 	} else {
-		subTime(&ptpClock->delaySM, &ptpClock->delay_req_receive_time, 
-			&ptpClock->delay_req_send_time);
+		ptpClock->delaySM = delaySM;
 	}
 #else
-		subTime(&ptpClock->delaySM, &ptpClock->delay_req_receive_time, 
-			&ptpClock->delay_req_send_time);
+		ptpClock->delaySM = delaySM;
 #endif
-		/* update 'one_way_delay' */
-		addTime(&ptpClock->meanPathDelay, &ptpClock->delaySM, 
-			&ptpClock->delayMS);
-
-		/* Substract correctionField */
-		subTime(&ptpClock->meanPathDelay, &ptpClock->meanPathDelay, 
-			correctionField);
-
-		/* Compute one-way delay */
-		div2Time(&ptpClock->meanPathDelay);
+		/*
+		 * update 'one_way_delay': both directions less the
+		 * correctionField, halved - rounded to ns only once
+		 */
+		scaled_to_internalTime((ptpClock->delaySM + ptpClock->delayMS -
+			correctionField) / 2, &ptpClock->meanPathDelay);
 		
 		if (ptpClock->meanPathDelay.seconds) {
 			DBG("update delay: cannot filter with large OFM, "
@@ -262,7 +272,7 @@ statistics:
                             dDelaySM = ptpClock->delaySMRawStats->meanContainer->mean + rtOpts->delaySMOutlierWeight * ( dDelaySM - ptpClock->delaySMRawStats->meanContainer->mean);
                             } 
                                         feedDoubleMovingStdDev(ptpClock->delaySMRawStats, dDelaySM);
-                                        feedDoubleMovingMean(ptpClock->delaySMFiltered, timeInternalToDouble(&ptpClock->delaySM));
+                                        feedDoubleMovingMean(ptpClock->delaySMFiltered, (double)ptpClock->delaySM / TIME_SCALED_NS / 1E9);
                                 }
                         feedDoublePermanentStdDev(&ptpClock->slaveStats.owdStats, timeInternalToDouble(&ptpClock->meanPathDelay));
 #endif
@@ -280,7 +290,7 @@ display:
 }
 
 void
-updatePeerDelay(Filter * owd_filt, RunTimeOpts * rtOpts, PtpClock * ptpClock, TimeInternal * correctionField, Boolean twoStep)
+updatePeerDelay(Filter * owd_filt, RunTimeOpts * rtOpts, PtpClock * ptpClock, TimeScaled correctionField, Boolean twoStep)
 {
 	/* updates paused, leap second pending - do nothing */
 	if(ptpClock->leapSecondInProgress)
@@ -290,40 +300,41 @@ updatePeerDelay(Filter * owd_filt, RunTimeOpts * rtOpts, PtpClock * ptpClock, Ti
 	DBGV("updatePeerDelay\n");
 
 	ptpClock->char_last_msg = 'P';	
+	datasetChanged(ptpClock, MGMT_CACHE_PORT_DS);
 
 	if (twoStep) {
-		/* calc 'slave_to_master_delay' */
-		subTime(&ptpClock->pdelayMS, 
+		TimeScaled turnaround, residence;
+
+		/* calc 'slave_to_master_delay' - shown in the statistics only */
+		subTimeScaled(&ptpClock->pdelayMS,
 			&ptpClock->pdelay_resp_receive_time, 
 			&ptpClock->pdelay_resp_send_time);
-		subTime(&ptpClock->pdelaySM, 
+		subTimeScaled(&ptpClock->pdelaySM,
 			&ptpClock->pdelay_req_receive_time, 
 			&ptpClock->pdelay_req_send_time);
 
-		/* update 'one_way_delay' */
-		addTime(&ptpClock->peerMeanPathDelay, 
-			&ptpClock->pdelayMS, 
-			&ptpClock->pdelaySM);
-
-		/* Substract correctionField */
-		subTime(&ptpClock->peerMeanPathDelay, 
-			&ptpClock->peerMeanPathDelay, correctionField);
-
-		/* Compute one-way delay */
-		div2Time(&ptpClock->peerMeanPathDelay);
+		/*
+		 * update 'one_way_delay': less the correctionField, halved.
+		 * Summed as our turnaround less the peer's residence time: each
+		 * is taken on one clock, so it holds however far apart the
+		 * two clocks are.
+		 */
+		subTimeScaled(&turnaround, &ptpClock->pdelay_resp_receive_time,
+			&ptpClock->pdelay_req_send_time);
+		subTimeScaled(&residence, &ptpClock->pdelay_resp_send_time,
+			&ptpClock->pdelay_req_receive_time);
+		scaled_to_internalTime((turnaround - residence -
+			correctionField) / 2, &ptpClock->peerMeanPathDelay);
 	} else {
+		TimeScaled turnaround;
+
 		/* One step clock */
 
-		subTime(&ptpClock->peerMeanPathDelay, 
-			&ptpClock->pdelay_resp_receive_time, 
+		/* turnaround time less the correctionField, halved */
+		subTimeScaled(&turnaround, &ptpClock->pdelay_resp_receive_time,
 			&ptpClock->pdelay_req_send_time);
-
-		/* Substract correctionField */
-		subTime(&ptpClock->peerMeanPathDelay, 
-			&ptpClock->peerMeanPathDelay, correctionField);
-
-		/* Compute one-way delay */
-		div2Time(&ptpClock->peerMeanPathDelay);
+		scaled_to_internalTime((turnaround - correctionField) / 2,
+			&ptpClock->peerMeanPathDelay);
 	}
 
 	if (ptpClock->peerMeanPathDelay.seconds) {
@@ -349,7 +360,7 @@ updatePeerDelay(Filter * owd_filt, RunTimeOpts * rtOpts, PtpClock * ptpClock, Ti
 
 void
 updateOffset(TimeInternal * send_time, TimeInternal * recv_time,
-    Filter * ofm_filt, RunTimeOpts * rtOpts, PtpClock * ptpClock, TimeInternal * correctionField)
+    Filter * ofm_filt, RunTimeOpts * rtOpts, PtpClock * ptpClock, TimeScaled correctionField)
 {
 
 	DBGV("UTCOffset: %d | leap 59: %d |  leap61: %d\n", 
@@ -359,6 +370,7 @@ updateOffset(TimeInternal * send_time, TimeInternal * recv_time,
 		return;
 
 	DBGV("==> updateOffset\n");
+	datasetChanged(ptpClock, MGMT_CACHE_CURRENT_DS);
 
 	{
 	//perform basic checks, using only local variables
@@ -394,45 +406,69 @@ updateOffset(TimeInternal * send_time, TimeInternal * recv_time,
 	 *   - update the global delayMS variable
 	 *   - calculate a new filtered OFM
 	 */
+	TimeScaled delayMS;
+	Boolean inRange = subTimeScaled(&delayMS, recv_time, send_time);
+
 #ifdef PTPD_STATISTICS
 	if (rtOpts->delayMSOutlierFilterEnabled) {
 		subTime(&ptpClock->rawDelayMS, recv_time, send_time);
 		if(!isDoublePeircesOutlier(ptpClock->delayMSRawStats, timeInternalToDouble(&ptpClock->rawDelayMS), rtOpts->delayMSOutlierFilterThreshold)) {
 			ptpClock->delayMSoutlier = FALSE;
-			ptpClock->delayMS = ptpClock->rawDelayMS;
+			ptpClock->delayMS = delayMS;
 		} else {
 			ptpClock->delayMSoutlier = TRUE;
 			ptpClock->counters.delayMSOutliersFound++;
-			if(!rtOpts->delayMSOutlierFilterDiscard)
-			ptpClock->delayMS = doubleToTimeInternal(ptpClock->delayMSFiltered->mean);
+			/* the filtered mean or the previous value is used instead */
+			if(!rtOpts->delayMSOutlierFilterDiscard) {
+				TimeInternal mean = doubleToTimeInternal(ptpClock->delayMSFiltered->mean);
+				ptpClock->delayMS = internalTime_to_scaled(&mean);
+				inRange = TRUE;
+			} else {
+				inRange = !ptpClock->delayMSOverflow;
+			}
 		}
 	} else {
-		subTime(&ptpClock->delayMS, recv_time, send_time);
+		ptpClock->delayMS = delayMS;
 	}
 #else
 	/* Used just for End to End mode. */
-	subTime(&ptpClock->delayMS, recv_time, send_time);
+	ptpClock->delayMS = delayMS;
 #endif
 
 	/* Take care about correctionField */
-	subTime(&ptpClock->delayMS,
-		&ptpClock->delayMS, correctionField);
+	ptpClock->delayMS -= correctionField;
+	ptpClock->delayMSOverflow = !inRange;
 
-#ifdef PTPD_STATISTICS
-#endif
-
-	/* update 'offsetFromMaster' */
-	if (ptpClock->delayMechanism == P2P) {
-		subTime(&ptpClock->offsetFromMaster, 
-			&ptpClock->delayMS, 
-			&ptpClock->peerMeanPathDelay);
+	/*
+	 * update 'offsetFromMaster'. With the clocks too far apart for scaled
+	 * units (delayMS is left saturated), the offset to step by is worked
+	 * out in TimeInternal.
+	 */
+	if (!inRange) {
+		TimeInternal correction;
+
+		scaled_to_internalTime(correctionField, &correction);
+		subTime(&ptpClock->offsetFromMaster, recv_time, send_time);
+		subTime(&ptpClock->offsetFromMaster, &ptpClock->offsetFromMaster,
+			&correction);
+		if (ptpClock->delayMechanism == P2P)
+			subTime(&ptpClock->offsetFromMaster, &ptpClock->offsetFromMaster,
+				&ptpClock->peerMeanPathDelay);
+		else if (ptpClock->delayMechanism == E2E ||
+		    ptpClock->delayMechanism == DELAY_DISABLED)
+			subTime(&ptpClock->offsetFromMaster, &ptpClock->offsetFromMaster,
+				&ptpClock->meanPathDelay);
+	} else if (ptpClock->delayMechanism == P2P) {
+		scaled_to_internalTime(ptpClock->delayMS -
+			internalTime_to_scaled(&ptpClock->peerMeanPathDelay),
+			&ptpClock->offsetFromMaster);
 	/* (End to End mode or disabled - if disabled, meanpath delay is zero) */
 	} else if (ptpClock->delayMechanism == E2E ||
 	    ptpClock->delayMechanism == DELAY_DISABLED ) {
 
-		subTime(&ptpClock->offsetFromMaster, 
-			&ptpClock->delayMS, 
-			&ptpClock->meanPathDelay);
+		scaled_to_internalTime(ptpClock->delayMS -
+			internalTime_to_scaled(&ptpClock->meanPathDelay),
+			&ptpClock->offsetFromMaster);
 	}
 
 	if (ptpClock->offsetFromMaster.seconds) {
@@ -722,6 +758,18 @@ updateClock(RunTimeOpts * rtOpts, PtpClock * ptpClock)
 	    DBG("Panic mode - skipping updateClock");
 	}
 
+	/* Measurement-only mode: NTP disciplines the clock - post the sample, leave the servo idle */
+	if(rtOpts->ntpShmEnabled) {
+#ifdef PTPD_STATISTICS
+		if(!(rtOpts->delayMSOutlierFilterEnabled && rtOpts->delayMSOutlierFilterDiscard && ptpClock->delayMSoutlier))
+			ntpShmUpdate(&ptpClock->ntpShm, ptpClock);
+		goto statistics;
+#else
+		ntpShmUpdate(&ptpClock->ntpShm, ptpClock);
+		goto display;
+#endif /* PTPD_STATISTICS */
+	}
+
 
 
 /*
@@ -893,6 +941,8 @@ if(rtOpts->ntpOptions.enableEngine && rtOpts->panicModeNtp) {
 		unsetTimexFlags(STA_UNSYNC, TRUE);
 		/* "Tell" the clock about maxerror, esterror etc. */
 		informClockSource(ptpClock);
+		/* learn the oscillator model for holdover */
+		holdoverFeed(rtOpts, ptpClock);
 #endif /* HAVE_SYS_TIMEX_H */
 	}
 
@@ -908,7 +958,7 @@ statistics:
 						    rtOpts->delayMSOutlierWeight * ( dDelayMS - ptpClock->delayMSRawStats->meanContainer->mean);
                         	}
                                 feedDoubleMovingStdDev(ptpClock->delayMSRawStats, dDelayMS);
-                                feedDoubleMovingMean(ptpClock->delayMSFiltered, timeInternalToDouble(&ptpClock->delayMS));
+                                feedDoubleMovingMean(ptpClock->delayMSFiltered, (double)ptpClock->delayMS / TIME_SCALED_NS / 1E9);
                         }
                         feedDoublePermanentStdDev(&ptpClock->slaveStats.ofmStats, timeInternalToDouble(&ptpClock->offsetFromMaster));
                         feedDoublePermanentStdDev(&ptpClock->servo.driftStats, ptpClock->servo.observedDrift);
@@ -917,10 +967,13 @@ statistics:
 display:
 		logStatistics(rtOpts, ptpClock);
 
+	/* publish the new estimates for local applications */
+	clockPageUpdate(rtOpts, ptpClock, TRUE);
+	ctlSocketServoSample(ptpClock);
+
 	DBGV("\n--Offset Correction-- \n");
-	DBGV("Raw offset from master:  %10ds %11dns\n",
-	    ptpClock->delayMS.seconds,
-	    ptpClock->delayMS.nanoseconds);
+	DBGV("Raw offset from master:  %22.3fns\n",
+	    (double)ptpClock->delayMS / TIME_SCALED_NS);
 
 	DBGV("\n--Offset and Delay filtered-- \n");
 
@@ -1061,7 +1114,7 @@ updatePtpEngineStats (PtpClock* ptpClock, RunTimeOpts* rtOpts)
 				}
 			}
 	if( (rtOpts->calibrationDelay == 0) || ptpClock->isCalibrated )
-	if(rtOpts->servoStabilityDetection) {
+	if(rtOpts->servoStabilityDetection && !bcClockTaken(ptpClock)) {
                 ++ptpClock->servo.updateCount;
                         if ( !ptpClock->servo.runningMaxOutput && (ptpClock->servo.driftStdDev <= ptpClock->servo.stabilityThreshold))  {
                             /* Only update the stable period counter if we received some Sync messages since last update */
@@ -0,0 +1,412 @@
+/*-
+ * Copyright (c) 2014 Wojciech Owczarek,
+ *
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file   snapshot.c
+ *
+ * @brief  Warm start state snapshot
+ *
+ * Saves the slave servo, delay and filter state to a binary file and
+ * restores it when the port next synchronises to the same master, so a
+ * restarted daemon does not have to re-learn the frequency, the path
+ * delay and the outlier filter windows. See snapshot.h for the layout.
+ */
+
+#include "../ptpd.h"
+
+/* FNV-1a over the snapshot, computed with the checksum field zeroed */
+static uint32_t
+snapshotChecksum(const PtpdSnapshot *snapshot)
+{
+
+	PtpdSnapshot copy = *snapshot;
+	const unsigned char *p = (const unsigned char *)&copy;
+	uint32_t hash = 2166136261U;
+	size_t i;
+
+	copy.checksum = 0;
+
+	for(i = 0; i < sizeof(copy); i++) {
+		hash ^= p[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+
+}
+
+#ifdef PTPD_STATISTICS
+
+/*
+ * Save the newest samples oldest first - the order the replay feeds them
+ * back in. The window ends at the container's write index: the moving
+ * containers shift on every feed, so that is count, with the oldest
+ * sample at 0.
+ */
+static void
+snapshotSaveWindow(PtpdSnapshotWindow *window, const DoubleMovingMean *container)
+{
+
+	uint32_t i, start;
+
+	window->count = 0;
+
+	if(container == NULL || container->count <= 0)
+		return;
+
+	window->count = (container->count > PTPD_SNAPSHOT_WINDOW) ?
+			PTPD_SNAPSHOT_WINDOW : container->count;
+	start = container->count - window->count;
+
+	for(i = 0; i < window->count; i++)
+		window->samples[i] = container->samples[start + i];
+
+}
+
+static void
+snapshotSaveStats(PtpdSnapshotStats *stats, const DoublePermanentStdDev *container)
+{
+
+	stats->mean = container->meanContainer.mean;
+	stats->count = container->meanContainer.count;
+	stats->squareSum = container->squareSum;
+	stats->stdDev = container->stdDev;
+
+}
+
+static void
+snapshotRestoreStats(DoublePermanentStdDev *container, const PtpdSnapshotStats *stats)
+{
+
+	container->meanContainer.mean = stats->mean;
+	container->meanContainer.count = stats->count;
+	container->squareSum = stats->squareSum;
+	container->stdDev = stats->stdDev;
+
+}
+
+/*
+ * The moving containers keep running sums, so the samples are replayed
+ * rather than copied - a window larger than the current capacity simply
+ * loses its oldest samples.
+ */
+static void
+snapshotReplayMean(DoubleMovingMean *container, const PtpdSnapshotWindow *window)
+{
+
+	uint32_t i;
+
+	if(container == NULL)
+		return;
+
+	resetDoubleMovingMean(container);
+	for(i = 0; i < window->count && i < PTPD_SNAPSHOT_WINDOW; i++)
+		feedDoubleMovingMean(container, window->samples[i]);
+
+}
+
+static void
+snapshotReplayStdDev(DoubleMovingStdDev *container, const PtpdSnapshotWindow *window)
+{
+
+	uint32_t i;
+
+	if(container == NULL)
+		return;
+
+	resetDoubleMovingStdDev(container);
+	for(i = 0; i < window->count && i < PTPD_SNAPSHOT_WINDOW; i++)
+		feedDoubleMovingStdDev(container, window->samples[i]);
+
+}
+
+#endif /* PTPD_STATISTICS */
+
+/**
+ * Read and validate the snapshot file. A valid snapshot is kept in
+ * ptpClock->warmStart and applied by snapshotApply() when the port
+ * reaches SLAVE state. Returns TRUE if a usable snapshot was loaded.
+ */
+Boolean
+snapshotLoad(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	PtpdSnapshot *snapshot = &ptpClock->warmStart;
+	FILE *fp;
+	size_t got;
+	int64_t age;
+
+	ptpClock->warmStartPending = FALSE;
+
+	if((fp = fopen(rtOpts->snapshotFile, "r")) == NULL) {
+		if(errno != ENOENT)
+			PERROR("Could not open state snapshot %s", rtOpts->snapshotFile);
+		else
+			INFO("No state snapshot in %s - starting cold\n", rtOpts->snapshotFile);
+		return FALSE;
+	}
+
+	got = fread(snapshot, 1, sizeof(PtpdSnapshot), fp);
+	fclose(fp);
+
+	if(got != sizeof(PtpdSnapshot) ||
+	    snapshot->magic != PTPD_SNAPSHOT_MAGIC ||
+	    snapshot->version != PTPD_SNAPSHOT_VERSION ||
+	    snapshot->size != sizeof(PtpdSnapshot)) {
+		WARNING("State snapshot %s has an unknown format - ignoring\n",
+			rtOpts->snapshotFile);
+		return FALSE;
+	}
+
+	if(snapshot->checksum != snapshotChecksum(snapshot)) {
+		WARNING("State snapshot %s is corrupt - ignoring\n",
+			rtOpts->snapshotFile);
+		return FALSE;
+	}
+
+	age = (int64_t)time(NULL) - snapshot->savedAt;
+	if(age < 0 || age > rtOpts->snapshotMaxAge) {
+		INFO("State snapshot %s is %lld seconds old - starting cold\n",
+			rtOpts->snapshotFile, (long long)age);
+		return FALSE;
+	}
+
+	INFO("Loaded state snapshot from %s, saved %lld seconds ago\n",
+		rtOpts->snapshotFile, (long long)age);
+	ptpClock->warmStartPending = TRUE;
+
+	return TRUE;
+
+}
+
+/**
+ * Write the current slave state to the snapshot file. The file is
+ * replaced atomically: written to a temporary file, synced and renamed,
+ * so a crash never leaves a truncated snapshot behind. Nothing is
+ * written until the servo has produced its first offset.
+ */
+void
+snapshotSave(RunTimeOpts *rtOpts, PtpClock *ptpClock, Boolean quiet)
+{
+
+	PtpdSnapshot snapshot;
+	char tmpFile[PATH_MAX + 5];
+	const char *p;
+	size_t left;
+	ssize_t ret;
+	int fd;
+
+	if(ptpClock->portState != PTP_SLAVE || !rtOpts->offset_first_updated) {
+		DBGV("Not synchronised - not saving state snapshot\n");
+		return;
+	}
+
+	if(ptpClock->servo.runningMaxOutput) {
+		DBG("Servo running at maximum shift - not saving state snapshot\n");
+		return;
+	}
+
+	memset(&snapshot, 0, sizeof(snapshot));
+
+	snapshot.magic = PTPD_SNAPSHOT_MAGIC;
+	snapshot.version = PTPD_SNAPSHOT_VERSION;
+	snapshot.size = sizeof(snapshot);
+	snapshot.savedAt = time(NULL);
+
+	memcpy(snapshot.clockIdentity, ptpClock->clockIdentity, CLOCK_IDENTITY_LENGTH);
+	memcpy(snapshot.grandmasterIdentity, ptpClock->grandmasterIdentity, CLOCK_IDENTITY_LENGTH);
+	memcpy(snapshot.parentClockIdentity, ptpClock->parentPortIdentity.clockIdentity,
+		CLOCK_IDENTITY_LENGTH);
+	snapshot.parentPortNumber = ptpClock->parentPortIdentity.portNumber;
+	snapshot.domainNumber = ptpClock->domainNumber;
+	snapshot.delayMechanism = ptpClock->delayMechanism;
+
+	snapshot.observedDrift = ptpClock->servo.observedDrift;
+	snapshot.output = ptpClock->servo.output;
+	snapshot.input = ptpClock->servo.input;
+
+	snapshot.meanPathDelay = internalTime_to_scaled(&ptpClock->meanPathDelay);
+	snapshot.peerMeanPathDelay = internalTime_to_scaled(&ptpClock->peerMeanPathDelay);
+	snapshot.delayMS = ptpClock->delayMS;
+	snapshot.delaySM = ptpClock->delaySM;
+
+#ifdef PTPD_STATISTICS
+	snapshot.flags |= PTPD_SNAPSHOT_STATISTICS;
+	if(ptpClock->servo.isStable)
+		snapshot.flags |= PTPD_SNAPSHOT_STABLE;
+	if(ptpClock->isCalibrated)
+		snapshot.flags |= PTPD_SNAPSHOT_CALIBRATED;
+
+	snapshot.driftMean = ptpClock->servo.driftMean;
+	snapshot.driftStdDev = ptpClock->servo.driftStdDev;
+	snapshotSaveStats(&snapshot.driftStats, &ptpClock->servo.driftStats);
+	snapshotSaveStats(&snapshot.ofmStats, &ptpClock->slaveStats.ofmStats);
+	snapshotSaveStats(&snapshot.owdStats, &ptpClock->slaveStats.owdStats);
+
+	if(ptpClock->delayMSRawStats != NULL)
+		snapshotSaveWindow(&snapshot.delayMSRaw, ptpClock->delayMSRawStats->meanContainer);
+	snapshotSaveWindow(&snapshot.delayMSFiltered, ptpClock->delayMSFiltered);
+	if(ptpClock->delaySMRawStats != NULL)
+		snapshotSaveWindow(&snapshot.delaySMRaw, ptpClock->delaySMRawStats->meanContainer);
+	snapshotSaveWindow(&snapshot.delaySMFiltered, ptpClock->delaySMFiltered);
+#endif /* PTPD_STATISTICS */
+
+	snapshot.checksum = snapshotChecksum(&snapshot);
+
+	snprintf(tmpFile, sizeof(tmpFile), "%s.tmp", rtOpts->snapshotFile);
+
+	if((fd = open(tmpFile, O_WRONLY | O_CREAT | O_TRUNC, DEFAULT_FILE_PERMS)) < 0) {
+		PERROR("Could not open state snapshot %s for writing", tmpFile);
+		return;
+	}
+
+	p = (const char *)&snapshot;
+	left = sizeof(snapshot);
+	while(left > 0) {
+		ret = write(fd, p, left);
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret <= 0)
+			goto failure;
+		p += ret;
+		left -= ret;
+	}
+
+	if(fsync(fd) < 0)
+		goto failure;
+
+	close(fd);
+
+	if(rename(tmpFile, rtOpts->snapshotFile) < 0) {
+		PERROR("Could not replace state snapshot %s", rtOpts->snapshotFile);
+		unlink(tmpFile);
+		return;
+	}
+
+	if(quiet)
+		DBGV("Wrote state snapshot to %s\n", rtOpts->snapshotFile);
+	else
+		INFO("Wrote state snapshot to %s\n", rtOpts->snapshotFile);
+
+	return;
+
+failure:
+	PERROR("Could not write state snapshot %s", tmpFile);
+	close(fd);
+	unlink(tmpFile);
+
+}
+
+/**
+ * Resume from the loaded snapshot. Called once the port has entered
+ * SLAVE state and reset its servo: if the snapshot was taken with this
+ * clock, in this domain, synchronised to the same parent and GM, the
+ * servo integrator, delays and statistics are restored. Either way the
+ * snapshot is only considered once.
+ */
+void
+snapshotApply(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	PtpdSnapshot *snapshot = &ptpClock->warmStart;
+	int64_t age;
+
+	if(!ptpClock->warmStartPending)
+		return;
+
+	ptpClock->warmStartPending = FALSE;
+
+	if(memcmp(snapshot->clockIdentity, ptpClock->clockIdentity, CLOCK_IDENTITY_LENGTH) ||
+	    snapshot->domainNumber != ptpClock->domainNumber ||
+	    snapshot->delayMechanism != ptpClock->delayMechanism) {
+		INFO("State snapshot was taken with a different clock configuration - starting cold\n");
+		return;
+	}
+
+	if(memcmp(snapshot->grandmasterIdentity, ptpClock->grandmasterIdentity, CLOCK_IDENTITY_LENGTH) ||
+	    memcmp(snapshot->parentClockIdentity, ptpClock->parentPortIdentity.clockIdentity,
+		CLOCK_IDENTITY_LENGTH) ||
+	    snapshot->parentPortNumber != ptpClock->parentPortIdentity.portNumber) {
+		INFO("State snapshot was taken with a different master - starting cold\n");
+		return;
+	}
+
+	age = (int64_t)time(NULL) - snapshot->savedAt;
+	if(age < 0 || age > rtOpts->snapshotMaxAge) {
+		INFO("State snapshot expired before reaching SLAVE state - starting cold\n");
+		return;
+	}
+
+	ptpClock->servo.observedDrift = snapshot->observedDrift;
+	ptpClock->servo.output = snapshot->output;
+	ptpClock->servo.input = snapshot->input;
+	if(!rtOpts->noAdjust) {
+#ifndef HAVE_SYS_TIMEX_H
+		adjTime(-snapshot->observedDrift);
+#else
+		adjFreq_wrapper(rtOpts, ptpClock, -snapshot->observedDrift);
+#endif /* HAVE_SYS_TIMEX_H */
+	}
+
+	scaled_to_internalTime(snapshot->meanPathDelay, &ptpClock->meanPathDelay);
+	scaled_to_internalTime(snapshot->peerMeanPathDelay, &ptpClock->peerMeanPathDelay);
+	datasetChanged(ptpClock, MGMT_CACHE_CURRENT_DS);
+	datasetChanged(ptpClock, MGMT_CACHE_PORT_DS);
+	ptpClock->delayMS = snapshot->delayMS;
+	ptpClock->delaySM = snapshot->delaySM;
+
+	/* the libcck delay filter has no state access - seed it with the saved value */
+	if(ptpClock->delayMechanism == P2P)
+		FilterFeed(ptpClock->owd_filt, &ptpClock->peerMeanPathDelay.nanoseconds);
+	else
+		FilterFeed(ptpClock->owd_filt, &ptpClock->meanPathDelay.nanoseconds);
+
+#ifdef PTPD_STATISTICS
+	if(snapshot->flags & PTPD_SNAPSHOT_STATISTICS) {
+		ptpClock->servo.driftMean = snapshot->driftMean;
+		ptpClock->servo.driftStdDev = snapshot->driftStdDev;
+		ptpClock->servo.isStable = (snapshot->flags & PTPD_SNAPSHOT_STABLE) != 0;
+		snapshotRestoreStats(&ptpClock->servo.driftStats, &snapshot->driftStats);
+		snapshotRestoreStats(&ptpClock->slaveStats.ofmStats, &snapshot->ofmStats);
+		snapshotRestoreStats(&ptpClock->slaveStats.owdStats, &snapshot->owdStats);
+
+		snapshotReplayStdDev(ptpClock->delayMSRawStats, &snapshot->delayMSRaw);
+		snapshotReplayMean(ptpClock->delayMSFiltered, &snapshot->delayMSFiltered);
+		snapshotReplayStdDev(ptpClock->delaySMRawStats, &snapshot->delaySMRaw);
+		snapshotReplayMean(ptpClock->delaySMFiltered, &snapshot->delaySMFiltered);
+
+		ptpClock->isCalibrated = (snapshot->flags & PTPD_SNAPSHOT_CALIBRATED) != 0;
+	}
+#endif /* PTPD_STATISTICS */
+
+	NOTICE("Warm start: resumed servo and delay state saved %lld seconds ago "
+		"(drift %.0f ppb, mean path delay %d ns)\n", (long long)age,
+		snapshot->observedDrift,
+		ptpClock->delayMechanism == P2P ? ptpClock->peerMeanPathDelay.nanoseconds :
+		ptpClock->meanPathDelay.nanoseconds);
+
+}
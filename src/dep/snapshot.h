@@ -0,0 +1,94 @@
+/**
+ * @file   snapshot.h
+ *
+ * @brief  Warm start state snapshot layout
+ *
+ * The snapshot holds the slave state that takes minutes to rebuild after
+ * a restart: the servo integrator and output, the mean path delay, the
+ * outlier filter windows and the running statistics, together with the
+ * parent and grandmaster identity they were learned from. It is written
+ * atomically at regular intervals and on shutdown, and is used once on
+ * the next startup if the port comes back to the same master within the
+ * configured validity window.
+ */
+
+#ifndef PTPD_SNAPSHOT_H_
+#define PTPD_SNAPSHOT_H_
+
+#include <stdint.h>
+
+#define PTPD_SNAPSHOT_MAGIC	0x50545053	/* "PTPS" */
+#define PTPD_SNAPSHOT_VERSION	1
+
+/* outlier filter window capacity - matches STATCONTAINER_MAX_SAMPLES */
+#define PTPD_SNAPSHOT_WINDOW	60
+
+/* a moving statistics window: the samples in chronological order */
+typedef struct {
+	uint32_t count;
+	uint32_t reserved;
+	double samples[PTPD_SNAPSHOT_WINDOW];
+} PtpdSnapshotWindow;
+
+/* a running mean / std dev container */
+typedef struct {
+	double mean;
+	double count;
+	double squareSum;
+	double stdDev;
+} PtpdSnapshotStats;
+
+/*
+ * File layout: fixed-width fields only, 64-bit members naturally aligned.
+ * The layout does not depend on build options - statistics fields are
+ * zero when ptpd2 is built without statistics support. Any layout change
+ * must bump PTPD_SNAPSHOT_VERSION.
+ */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;			/* sizeof(PtpdSnapshot) */
+	uint32_t checksum;		/* FNV-1a over the snapshot, this field zeroed */
+	int64_t savedAt;		/* CLOCK_REALTIME seconds when written */
+
+	/* who the state was learned from */
+	uint8_t clockIdentity[8];	/* our own clock identity */
+	uint8_t grandmasterIdentity[8];
+	uint8_t parentClockIdentity[8];
+	uint16_t parentPortNumber;
+	uint8_t domainNumber;
+	uint8_t delayMechanism;
+	uint32_t flags;
+
+	/* servo */
+	double observedDrift;		/* integrator, ppb */
+	double output;			/* last output, ppb */
+	int32_t input;			/* last input, ns */
+	uint32_t reserved1;
+
+	/* delay, 2^-16 ns */
+	int64_t meanPathDelay;
+	int64_t peerMeanPathDelay;
+	int64_t delayMS;
+	int64_t delaySM;
+
+	/* statistics */
+	double driftMean;
+	double driftStdDev;
+	PtpdSnapshotStats driftStats;
+	PtpdSnapshotStats ofmStats;
+	PtpdSnapshotStats owdStats;
+	PtpdSnapshotWindow delayMSRaw;
+	PtpdSnapshotWindow delayMSFiltered;
+	PtpdSnapshotWindow delaySMRaw;
+	PtpdSnapshotWindow delaySMFiltered;
+
+	uint32_t reserved[8];
+} PtpdSnapshot;
+
+/* flags */
+#define PTPD_SNAPSHOT_STATISTICS	0x01	/* statistics fields are valid */
+#define PTPD_SNAPSHOT_STABLE		0x02	/* servo was stable when saved */
+#define PTPD_SNAPSHOT_CALIBRATED	0x04	/* outlier filters were calibrated */
+
+#endif /* PTPD_SNAPSHOT_H_ */
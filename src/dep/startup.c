@@ -160,6 +160,8 @@ do_signal_sighup(RunTimeOpts * rtOpts, PtpClock * ptpClock)
 	    goto end;
 
 	dictionary* tmpConfig = dictionary_new(0);
+	/* changed settings forcing PTP_INITIALIZING, for the reload report */
+	char reinitKeys[BUF_SIZE];
 	/* Try reloading the config file */
 	NOTIFY("Reloading configuration file: %s\n",rtOpts->configFile);
             if(!loadConfigFile(&tmpConfig, rtOpts)) {
@@ -191,7 +193,8 @@ do_signal_sighup(RunTimeOpts * rtOpts, PtpClock * ptpClock)
 	 */
 
 	rtOpts->restartSubsystems =
-	    checkSubsystemRestart(rtOpts->candidateConfig, rtOpts->currentConfig);
+	    checkSubsystemRestart(rtOpts->candidateConfig, rtOpts->currentConfig,
+		reinitKeys, sizeof(reinitKeys));
 
 	/* If we're told to re-check lock files, do it: tmpOpts already has what rtOpts should */
 	if( (rtOpts->restartSubsystems & PTPD_CHECK_LOCKS) &&
@@ -281,6 +284,13 @@ do_signal_sighup(RunTimeOpts * rtOpts, PtpClock * ptpClock)
 		goto cleanup;
 	}
 
+	/* Say what the reload is going to cost */
+	if(strlen(reinitKeys) > 0) {
+		NOTIFY("Reload requires PTP re-initialisation - changed: %s\n", reinitKeys);
+	} else {
+		NOTIFY("Reload will be applied in place - port state, servo and foreign masters kept\n");
+	}
+
 
 		/* Tell parseConfig to shut up - it's had its chance already */
 		dictionary_set(rtOpts->candidateConfig,"%quiet%:%quiet%","Y");
@@ -374,6 +384,11 @@ checkSignals(RunTimeOpts * rtOpts, PtpClock * ptpClock)
 			INFO("** Management message ACL:\n");
 			dumpIpv4AccessList(ptpClock->netPath.managementAcl);
 		}
+		if(rtOpts->rateLimitEnabled) {
+			INFO("\n\n");
+			INFO("** Per-source rate limiter:\n");
+			dumpRateLimiter(ptpClock->netPath.rateLimiter);
+		}
 		if(rtOpts->clearCounters) {
 			clearCounters(ptpClock);
 			NOTIFY("PTP engine counters cleared\n");
@@ -441,27 +456,189 @@ writeLockFile(RunTimeOpts * rtOpts)
 
 }
 
+/*
+ * Allocate a protocol engine instance: the engine data with its foreign
+ * master, monitor and slave tables and its filters. Used for port 1 at
+ * startup and for every other port of a boundary clock.
+ */
+PtpClock *
+createPtpClock(RunTimeOpts * rtOpts)
+{
+	PtpClock * ptpClock;
+	int i;
+
+	ptpClock = (PtpClock *) calloc(1, sizeof(PtpClock));
+	if (!ptpClock) {
+		PERROR("Error: Failed to allocate memory for protocol engine data");
+		return NULL;
+	}
+
+	DBG("allocated %d bytes for protocol engine data\n", 
+	    (int)sizeof(PtpClock));
+	ptpClock->foreign = (ForeignMasterRecord *)
+		calloc(rtOpts->max_foreign_records, 
+		       sizeof(ForeignMasterRecord));
+	if (!ptpClock->foreign) {
+		PERROR("failed to allocate memory for foreign "
+		       "master data");
+		free(ptpClock);
+		return NULL;
+	} else {
+		DBG("allocated %d bytes for foreign master data\n", 
+		    (int)(rtOpts->max_foreign_records * 
+			  sizeof(ForeignMasterRecord)));
+	}
+
+	if (rtOpts->monitorMode) {
+		ptpClock->monitor = (MonitorMaster *)
+			calloc(rtOpts->monitorCapacity, sizeof(MonitorMaster));
+		if (!ptpClock->monitor) {
+			PERROR("failed to allocate memory for monitored "
+			       "master data");
+			free(ptpClock->foreign);
+			free(ptpClock);
+			return NULL;
+		}
+		ptpClock->monitorCapacity = rtOpts->monitorCapacity;
+		DBG("allocated %d bytes for monitored master data\n",
+		    (int)(rtOpts->monitorCapacity * sizeof(MonitorMaster)));
+	}
+
+	if (rtOpts->slaveTableEnabled) {
+		ptpClock->slaveTable = createSlaveTable(rtOpts->slaveTableSize,
+							rtOpts->slaveTimeout);
+		if (!ptpClock->slaveTable) {
+			PERROR("failed to allocate memory for the slave table");
+			free(ptpClock->monitor);
+			free(ptpClock->foreign);
+			free(ptpClock);
+			return NULL;
+		}
+		DBG("allocated %d bytes for the slave table\n",
+		    (int)(rtOpts->slaveTableSize * (sizeof(SlaveRecord) +
+		    SLAVE_TABLE_HASH_LOAD * sizeof(int32_t))));
+	}
+	
+	ptpClock->owd_filt = FilterCreate(FILTER_EXPONENTIAL_SMOOTH, "owd");
+	ptpClock->ofm_filt = FilterCreate(FILTER_MOVING_AVERAGE, "ofm");
+	for (i = 0; i < STANDBY_MAX_MASTERS; i++) {
+		ptpClock->standby[i].owd_filt = FilterCreate(FILTER_EXPONENTIAL_SMOOTH, "owd");
+		ptpClock->standby[i].ofm_filt = FilterCreate(FILTER_MOVING_AVERAGE, "ofm");
+	}
+	ptpClock->ntpServer.sockFD = -1;
+	ptpClock->ctlSocket.listenFD = -1;
+	/* doInit() shuts the sockets down first - not those of another port */
+	ptpClock->netPath.eventSock = -1;
+	ptpClock->netPath.generalSock = -1;
+#ifdef PTPD_NTPDC
+	/* NTP control socket is opened later, its reply timeouts use our timers */
+	ptpClock->ntpControl.sockFD = -1;
+	ptpClock->ntpControl.itimer = ptpClock->itimer;
+#endif /* PTPD_NTPDC */
+
+	/* Init user_description */
+	memcpy(ptpClock->user_description, &USER_DESCRIPTION, sizeof(USER_DESCRIPTION));
+	
+	/* Init outgoing management message */
+	ptpClock->outgoingManageTmp.tlv = NULL;
+
+#ifdef PTPD_STATISTICS
+	if (rtOpts->delayMSOutlierFilterEnabled) {
+		ptpClock->delayMSRawStats = createDoubleMovingStdDev(rtOpts->delayMSOutlierFilterCapacity);
+		strncpy(ptpClock->delayMSRawStats->identifier, "delayMS", 10);
+		ptpClock->delayMSFiltered = createDoubleMovingMean(rtOpts->delayMSOutlierFilterCapacity);
+	} else {
+		ptpClock->delayMSRawStats = NULL;
+		ptpClock->delayMSFiltered = NULL;
+	}
+
+	if (rtOpts->delaySMOutlierFilterEnabled) {
+		ptpClock->delaySMRawStats = createDoubleMovingStdDev(rtOpts->delaySMOutlierFilterCapacity);
+		strncpy(ptpClock->delaySMRawStats->identifier, "delaySM", 10);
+		ptpClock->delaySMFiltered = createDoubleMovingMean(rtOpts->delaySMOutlierFilterCapacity);
+	} else {
+		ptpClock->delaySMRawStats = NULL;
+		ptpClock->delaySMFiltered = NULL;
+	}
+#endif
+
+	return ptpClock;
+}
+
+/* free a protocol engine instance - its sockets must be closed already */
+void
+freePtpClock(PtpClock ** ptpClock)
+{
+	int i;
+
+	if (*ptpClock == NULL)
+		return;
+
+	free((*ptpClock)->foreign);
+	free((*ptpClock)->monitor);
+	freeSlaveTable(&(*ptpClock)->slaveTable);
+
+	/* free management messages, they can have dynamic memory allocated */
+	if((*ptpClock)->msgTmpHeader.messageType == MANAGEMENT)
+		freeManagementTLV(&(*ptpClock)->msgTmp.manage);
+	freeManagementTLV(&(*ptpClock)->outgoingManageTmp);
+
+	FilterDestroy((*ptpClock)->owd_filt);
+	FilterDestroy((*ptpClock)->ofm_filt);
+	for (i = 0; i < STANDBY_MAX_MASTERS; i++) {
+		FilterDestroy((*ptpClock)->standby[i].owd_filt);
+		FilterDestroy((*ptpClock)->standby[i].ofm_filt);
+	}
+
+#ifdef PTPD_STATISTICS
+	if((*ptpClock)->delayMSRawStats != NULL)
+		freeDoubleMovingStdDev(&(*ptpClock)->delayMSRawStats);
+	if((*ptpClock)->delayMSFiltered != NULL)
+		freeDoubleMovingMean(&(*ptpClock)->delayMSFiltered);
+	if((*ptpClock)->delaySMRawStats != NULL)
+		freeDoubleMovingStdDev(&(*ptpClock)->delaySMRawStats);
+	if((*ptpClock)->delaySMFiltered != NULL)
+		freeDoubleMovingMean(&(*ptpClock)->delaySMFiltered);
+#endif /* PTPD_STATISTICS */
+
+	free(*ptpClock);
+	*ptpClock = NULL;
+}
+
 void 
 ptpdShutdown(PtpClock * ptpClock)
 {
 
 	extern RunTimeOpts rtOpts;
 
+	/* called from another port of a boundary clock: the whole clock goes */
+	if (ptpClock->boundaryClock != NULL)
+		ptpClock = ptpClock->boundaryClock->ports[0];
+	/* likewise from the instance of another domain */
+	if (ptpClock->domainInstances != NULL)
+		ptpClock = ptpClock->domainInstances->instances[0];
+
+	/* the other ports and domain instances go first */
+	bcShutdown(ptpClock);
+	domainShutdown(ptpClock);
+
 	netShutdown(&ptpClock->netPath);
 #ifdef PTPD_NTPDC
 	ntpShutdown(&rtOpts.ntpOptions, &ptpClock->ntpControl);
 #endif /* PTPD_NTPDC */
-	free(ptpClock->foreign);
-
-	/* free management messages, they can have dynamic memory allocated */
-	if(ptpClock->msgTmpHeader.messageType == MANAGEMENT)
-		freeManagementTLV(&ptpClock->msgTmp.manage);
-	freeManagementTLV(&ptpClock->outgoingManageTmp);
 
 #ifdef PTPD_SNMP
 	snmpShutdown();
 #endif /* PTPD_SNMP */
 
+	ntpShmShutdown(&ptpClock->ntpShm);
+	ntpServerShutdown(&ptpClock->ntpServer);
+	ctlSocketShutdown(&ptpClock->ctlSocket);
+	clockPageShutdown(&rtOpts, ptpClock);
+
+	if(rtOpts.snapshotEnabled)
+		snapshotSave(&rtOpts, ptpClock, FALSE);
+
 #ifdef HAVE_SYS_TIMEX_H
 #ifndef PTPD_STATISTICS
 	/* Not running statistics code - write observed drift to driftfile if enabled, inform user */
@@ -478,12 +655,8 @@ ptpdShutdown(PtpClock * ptpClock)
 		dictionary_del(rtOpts.currentConfig);
 	if(rtOpts.cliConfig != NULL)
 		dictionary_del(rtOpts.cliConfig);
-	
-	FilterDestroy(ptpClock->owd_filt);
-	FilterDestroy(ptpClock->ofm_filt);
 
-	free(ptpClock);
-	ptpClock = NULL;
+	freePtpClock(&ptpClock);
 
 	extern PtpClock* G_ptpClock;
 	G_ptpClock = NULL;
@@ -624,6 +797,13 @@ ptpdStartup(int argc, char **argv, Integer16 * ret, RunTimeOpts * rtOpts)
 	    goto configcheck;
 	}
 
+	for (i = 0; i < rtOpts->bcPortCount; i++)
+	    if(!testInterface(rtOpts->bcInterfaces[i], rtOpts)) {
+		ERROR("Error: Cannot use %s interface\n",rtOpts->bcInterfaces[i]);
+		*ret = 1;
+		goto configcheck;
+	    }
+
 configcheck:
 	/*
 	 * We've been told to check config only - clean exit before checking locks
@@ -661,47 +841,14 @@ configcheck:
 	restartLogging(rtOpts);
 
 	/* Allocate memory after we're done with other checks but before going into daemon */
-	ptpClock = (PtpClock *) calloc(1, sizeof(PtpClock));
-	if (!ptpClock) {
-		PERROR("Error: Failed to allocate memory for protocol engine data");
+	if (!(ptpClock = createPtpClock(rtOpts))) {
 		*ret = 2;
 		return 0;
-	} else {
-		DBG("allocated %d bytes for protocol engine data\n", 
-		    (int)sizeof(PtpClock));
-		ptpClock->foreign = (ForeignMasterRecord *)
-			calloc(rtOpts->max_foreign_records, 
-			       sizeof(ForeignMasterRecord));
-		if (!ptpClock->foreign) {
-			PERROR("failed to allocate memory for foreign "
-			       "master data");
-			*ret = 2;
-			free(ptpClock);
-			return 0;
-		} else {
-			DBG("allocated %d bytes for foreign master data\n", 
-			    (int)(rtOpts->max_foreign_records * 
-				  sizeof(ForeignMasterRecord)));
-		}
-		
-		ptpClock->owd_filt = FilterCreate(FILTER_EXPONENTIAL_SMOOTH, "owd");
-		ptpClock->ofm_filt = FilterCreate(FILTER_MOVING_AVERAGE, "ofm");
 	}
 
 	if(rtOpts->statisticsLog.logEnabled)
 		ptpClock->resetStatisticsLog = TRUE;
 
-	/* Init to 0 net buffer */
-	memset(ptpClock->msgIbuf, 0, PACKET_SIZE);
-	memset(ptpClock->msgObuf, 0, PACKET_SIZE);
-
-	/* Init user_description */
-	memset(ptpClock->user_description, 0, sizeof(ptpClock->user_description));
-	memcpy(ptpClock->user_description, &USER_DESCRIPTION, sizeof(USER_DESCRIPTION));
-	
-	/* Init outgoing management message */
-	ptpClock->outgoingManageTmp.tlv = NULL;
-	
 
 	/*  DAEMON */
 #ifdef PTPD_NO_DAEMON
@@ -794,6 +941,46 @@ configcheck:
 		snmpInit(rtOpts, ptpClock);
 #endif
 
+	/* Measurement-only mode - without the SHM segment we have nowhere to send offsets */
+	if (rtOpts->ntpShmEnabled && !ntpShmInit(rtOpts, &ptpClock->ntpShm)) {
+		ERROR("Could not attach to NTP SHM segment - exiting\n");
+		*ret = 3;
+		return 0;
+	}
+
+	/* NTP clients depend on us - most likely the port is taken by another NTP daemon */
+	if (rtOpts->ntpServerEnabled && !ntpServerInit(rtOpts, &ptpClock->ntpServer)) {
+		ERROR("Could not start NTP server - exiting\n");
+		*ret = 3;
+		return 0;
+	}
+
+	/* Publish the clock page - not fatal if this fails */
+	if (rtOpts->clockPageEnabled)
+		clockPageInit(rtOpts, ptpClock);
+
+	/* Local control socket - not fatal if this fails either */
+	if (rtOpts->controlSocketEnabled)
+		ctlSocketInit(rtOpts, &ptpClock->ctlSocket);
+
+	/* Warm start state - applied when we become slave to the same master */
+	if (rtOpts->snapshotEnabled)
+		snapshotLoad(rtOpts, ptpClock);
+
+	/* Boundary clock - the other ports run alongside this one */
+	if (!bcInit(rtOpts, ptpClock)) {
+		ERROR("Could not start the boundary clock ports - exiting\n");
+		*ret = 2;
+		return 0;
+	}
+
+	/* Other domains - their instances share our sockets */
+	if (!domainInit(rtOpts, ptpClock)) {
+		ERROR("Could not start the domain instances - exiting\n");
+		*ret = 2;
+		return 0;
+	}
+
 
 
 	NOTICE(USER_DESCRIPTION" started successfully on %s using \"%s\" preset (PID %d)\n",
@@ -802,26 +989,6 @@ configcheck:
 			    getpid());
 	ptpClock->resetStatisticsLog = TRUE;
 
-#ifdef PTPD_STATISTICS
-	if (rtOpts->delayMSOutlierFilterEnabled) {
-		ptpClock->delayMSRawStats = createDoubleMovingStdDev(rtOpts->delayMSOutlierFilterCapacity);
-		strncpy(ptpClock->delayMSRawStats->identifier, "delayMS", 10);
-		ptpClock->delayMSFiltered = createDoubleMovingMean(rtOpts->delayMSOutlierFilterCapacity);
-	} else {
-		ptpClock->delayMSRawStats = NULL;
-		ptpClock->delayMSFiltered = NULL;
-	}
-
-	if (rtOpts->delaySMOutlierFilterEnabled) {
-		ptpClock->delaySMRawStats = createDoubleMovingStdDev(rtOpts->delaySMOutlierFilterCapacity);
-		strncpy(ptpClock->delaySMRawStats->identifier, "delaySM", 10);
-		ptpClock->delaySMFiltered = createDoubleMovingMean(rtOpts->delaySMOutlierFilterCapacity);
-	} else {
-		ptpClock->delaySMRawStats = NULL;
-		ptpClock->delaySMFiltered = NULL;
-	}
-#endif
-
 	*ret = 0;
 	return ptpClock;
 	
@@ -322,6 +322,7 @@ int writeMessage(FILE* destination, int priority, const char * format, va_list a
 
 	int written;
 	char time_str[MAXTIMESTR];
+	char source[IFACE_NAME_LENGTH + 8];
 	struct timeval now;
 
 	extern char *translatePortState(PtpClock *ptpClock);
@@ -347,8 +348,21 @@ int writeMessage(FILE* destination, int priority, const char * format, va_list a
 		gettimeofday(&now, 0);
 		strftime(time_str, MAXTIMESTR, "%F %X", localtime((time_t*)&now.tv_sec));
 		fprintf(destination, "%s.%06d ", time_str, (int)now.tv_usec  );
+
+		/* boundary clock port interface, domain of a domain instance */
+		if (startupInProgress)
+			snprintf(source, sizeof(source), "startup");
+		else if (G_ptpClock && G_ptpClock->boundaryClock)
+			snprintf(source, sizeof(source), "%s",
+			    G_ptpClock->boundaryClock->portOpts[G_ptpClock->portIndex]->ifaceName);
+		else if (G_ptpClock && G_ptpClock->domainIndex > 0)
+			snprintf(source, sizeof(source), "%s.d%d", rtOpts.ifaceName,
+			    G_ptpClock->domainInstances->instanceOpts[G_ptpClock->domainIndex]->domainNumber);
+		else
+			snprintf(source, sizeof(source), "%s", rtOpts.ifaceName);
+
 		fprintf(destination,PTPD_PROGNAME"[%d].%s (%-9s ",
-		getpid(), startupInProgress ? "startup" : rtOpts.ifaceName,
+		getpid(), source,
 		priority == LOG_EMERG   ? "emergency)" :
 		priority == LOG_ALERT   ? "alert)" :
 		priority == LOG_CRIT    ? "critical)" :
@@ -592,13 +606,14 @@ logStatistics(RunTimeOpts * rtOpts, PtpClock * ptpClock)
 {
 	static char sbuf[SCREEN_BUFSZ];
 	int len = 0;
-	TimeInternal now;
+	TimeInternal now, delay;
 	time_t time_s;
 	FILE* destination;
 	static TimeInternal prev_now_sync, prev_now_delay;
 	char time_str[MAXTIMESTR];
 
-	if (!rtOpts->logStatistics) {
+	/* the monitor writes its own records */
+	if (!rtOpts->logStatistics || rtOpts->monitorMode) {
 		return;
 	}
 
@@ -688,18 +703,14 @@ logStatistics(RunTimeOpts * rtOpts, PtpClock * ptpClock)
 		/* print MS and SM with sign */
 		len += snprintf(sbuf + len, sizeof(sbuf) - len, ", ");
 			
-		if(rtOpts->delayMechanism == E2E) {
-			len += snprint_TimeInternal(sbuf + len, sizeof(sbuf) - len,
-							&(ptpClock->delaySM));
-		} else {
-			len += snprint_TimeInternal(sbuf + len, sizeof(sbuf) - len,
-							&(ptpClock->pdelaySM));
-		}
+		scaled_to_internalTime((rtOpts->delayMechanism == E2E) ?
+		    ptpClock->delaySM : ptpClock->pdelaySM, &delay);
+		len += snprint_TimeInternal(sbuf + len, sizeof(sbuf) - len, &delay);
 
 		len += snprintf(sbuf + len, sizeof(sbuf) - len, ", ");
 
-		len += snprint_TimeInternal(sbuf + len, sizeof(sbuf) - len,
-				&(ptpClock->delayMS));
+		scaled_to_internalTime(ptpClock->delayMS, &delay);
+		len += snprint_TimeInternal(sbuf + len, sizeof(sbuf) - len, &delay);
 
 		len += snprintf(sbuf + len, sizeof(sbuf) - len, ", %.09f, %c",
 			       ptpClock->servo.observedDrift,
@@ -788,7 +799,8 @@ writeStatusFile(PtpClock *ptpClock,RunTimeOpts *rtOpts, Boolean quiet)
 	if(rtOpts->statusLog.logFP == NULL)
 	    return;
 
-	char outBuf[4096];
+	/* setbuf() takes a BUFSIZ buffer */
+	char outBuf[BUFSIZ];
 	char tmpBuf[200];
 	FILE* out = rtOpts->statusLog.logFP;
 	memset(outBuf, 0, sizeof(outBuf));
@@ -810,7 +822,14 @@ writeStatusFile(PtpClock *ptpClock,RunTimeOpts *rtOpts, Boolean quiet)
 	fprintf(out, 		STATUSPREFIX"  %s\n","Sync mode", ptpClock->twoStepFlag ? "TWO_STEP" : "ONE_STEP");
 	}
 	fprintf(out, 		STATUSPREFIX"  %d\n","PTP domain", rtOpts->domainNumber);
+	if(rtOpts->monitorMode)
+	fprintf(out, 		STATUSPREFIX"  %s\n","Monitored domains", strlen(rtOpts->monitorDomainsText) ?
+		rtOpts->monitorDomainsText : "PTP domain only");
 	fprintf(out, 		STATUSPREFIX"  %s\n","Port state", portState_getName(ptpClock->portState));
+	/* boundary clock: the state of every port */
+	bcStatus(ptpClock, out);
+	/* and every other domain */
+	domainStatus(ptpClock, out);
 
 	    memset(tmpBuf, 0, sizeof(tmpBuf));
 	    snprint_PortIdentity(tmpBuf, sizeof(tmpBuf),
@@ -944,7 +963,37 @@ else {
 
 	}
 
+	if(rtOpts->holdoverEnabled) {
+	fprintf(out, 		STATUSPREFIX"  ","Holdover");
+	if(ptpClock->holdover.active)
+	    fprintf(out, "active for %.0f s, error bound %.0f ns",
+		ptpClock->holdover.elapsed, ptpClock->holdover.errorBound);
+	else if(ptpClock->holdover.expired)
+	    fprintf(out, "expired, free running");
+	else if(ptpClock->holdover.modelValid)
+	    fprintf(out, "ready");
+	else
+	    fprintf(out, "learning, %d of %d samples", ptpClock->holdover.sampleCount,
+		HOLDOVER_MIN_SAMPLES);
+	if(ptpClock->holdover.modelValid)
+	    fprintf(out, ", frequency % .03f ppm, aging % .03f ppb/h",
+		ptpClock->holdover.frequency / 1000.0,
+		ptpClock->holdover.aging * 3600.0);
+	fprintf(out,"\n");
+	}
 
+	if(rtOpts->monitorMode)
+		monitorStatus(ptpClock, out);
+
+	if(ptpClock->slaveTable != NULL && ptpClock->portState == PTP_MASTER)
+		slaveTableStatus(ptpClock->slaveTable, out);
+
+	if(rtOpts->standbyMasters && ptpClock->portState == PTP_SLAVE) {
+	int tracked, warm;
+	standbyStatus(ptpClock, &tracked, &warm);
+	fprintf(out, 		STATUSPREFIX"  %d measured, %d warm\n","Standby masters",
+		tracked, warm);
+	}
 
 	if(ptpClock->portState == PTP_MASTER || ptpClock->portState == PTP_PASSIVE) {
 
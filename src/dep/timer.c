@@ -55,6 +55,14 @@
 #define US_TIMER_INTERVAL (62500)
 volatile unsigned int elapsed;
 
+/*
+ * Timer arrays of all ports of a boundary clock. The ticks are counted
+ * once for the whole process, so whichever port latches them has to
+ * advance the timers of every port. Empty for an ordinary clock.
+ */
+static IntervalTimer *timerSets[TIMER_MAX_SETS];
+static int timerSetCount = 0;
+
 /*
  * original code calls sigalarm every fixed 1ms. This highly pollutes the debug_log, and causes more interrupted instructions
  * This was later modified to have a fixed granularity of 1s.
@@ -87,6 +95,30 @@ initTimer(void)
 	setitimer(ITIMER_REAL, &itimer, 0);
 }
 
+/* advance one timer array by delta ticks */
+static void
+timerAdvance(IntervalTimer * itimer, int delta)
+{
+
+	int i;
+
+	/*
+	 * if time actually passed, then decrease every timer left
+	 * the one(s) that went to zero or negative are:
+	 *  a) rearmed at the original time (ignoring the time that may have passed ahead)
+	 *  b) have their expiration latched until timerExpired() is called
+	 */
+	for (i = 0; i < TIMER_ARRAY_SIZE; ++i) {
+		if ((itimer[i].interval) > 0 && ((itimer[i].left) -= delta) 
+		    <= 0) {
+			itimer[i].left = itimer[i].interval;
+			itimer[i].expire = TRUE;
+			DBG2("TimerUpdate:    Timer %u has now expired.   (Re-armed again with interval %d, left %d)\n", i, itimer[i].interval, itimer[i].left );
+		}
+	}
+
+}
+
 void 
 timerUpdate(IntervalTimer * itimer)
 {
@@ -103,18 +135,42 @@ timerUpdate(IntervalTimer * itimer)
 	if (delta <= 0)
 		return;
 
-	/*
-	 * if time actually passed, then decrease every timer left
-	 * the one(s) that went to zero or negative are:
-	 *  a) rearmed at the original time (ignoring the time that may have passed ahead)
-	 *  b) have their expiration latched until timerExpired() is called
-	 */
-	for (i = 0; i < TIMER_ARRAY_SIZE; ++i) {
-		if ((itimer[i].interval) > 0 && ((itimer[i].left) -= delta) 
-		    <= 0) {
-			itimer[i].left = itimer[i].interval;
-			itimer[i].expire = TRUE;
-			DBG2("TimerUpdate:    Timer %u has now expired.   (Re-armed again with interval %d, left %d)\n", i, itimer[i].interval, itimer[i].left );
+	if (timerSetCount == 0) {
+		timerAdvance(itimer, delta);
+		return;
+	}
+
+	for (i = 0; i < timerSetCount; i++)
+		timerAdvance(timerSets[i], delta);
+
+}
+
+/* share the ticks with another port's timers */
+void
+timerRegister(IntervalTimer * itimer)
+{
+
+	int i;
+
+	for (i = 0; i < timerSetCount; i++)
+		if (timerSets[i] == itimer)
+			return;
+
+	if (timerSetCount < TIMER_MAX_SETS)
+		timerSets[timerSetCount++] = itimer;
+
+}
+
+void
+timerUnregister(IntervalTimer * itimer)
+{
+
+	int i;
+
+	for (i = 0; i < timerSetCount; i++) {
+		if (timerSets[i] == itimer) {
+			timerSets[i] = timerSets[--timerSetCount];
+			return;
 		}
 	}
 
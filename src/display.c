@@ -804,6 +804,9 @@ void
 displayCounters(const PtpClock * ptpClock)
 {
 
+	int i;
+	static const char* rxQueueNames[RXQ_CLASSES] = { "timing", "announce", "management" };
+
 	/* TODO: print port identity */
 	INFO("\n============= PTP port counters =============\n");
 
@@ -848,6 +851,8 @@ displayCounters(const PtpClock * ptpClock)
 		ptpClock->counters.managementMessagesSent);
 	INFO("        managementMessagesReceived : %d\n",
 		ptpClock->counters.managementMessagesReceived);
+	INFO("               managementCacheHits : %d\n",
+		ptpClock->counters.managementCacheHits);
 
 /* not implemented yet */
 #if 0
@@ -881,6 +886,23 @@ displayCounters(const PtpClock * ptpClock)
 		ptpClock->counters.aclManagementDiscardedMessages);
 	INFO("        aclTimingDiscardedMessages : %d\n",
 		ptpClock->counters.aclTimingDiscardedMessages);
+	INFO("        rateLimitDiscardedMessages : %d\n",
+		ptpClock->counters.rateLimitDiscardedMessages);
+
+	INFO("Receive queue counters:\n");
+	for (i = 0; i < RXQ_CLASSES; i++) {
+		INFO("%34s : depth %d, max depth %d, queued %d, overflows %d, latency mean %.0f ns, max %u ns\n",
+		    rxQueueNames[i],
+		    ptpClock->rxQueues[i].depth, ptpClock->rxQueues[i].maxDepth,
+		    ptpClock->rxQueues[i].queued, ptpClock->rxQueues[i].overflows,
+		    ptpClock->rxQueues[i].processed ?
+		    (double)ptpClock->rxQueues[i].latencyTotal / ptpClock->rxQueues[i].processed : 0.0,
+		    ptpClock->rxQueues[i].latencyMax);
+	}
+
+	INFO("Management arena: max used %zu of %zu bytes, failed allocations %d\n",
+	    ptpClock->managementArena.highWater, sizeof(ptpClock->managementArena.memory),
+	    ptpClock->managementArena.failures);
 
 	INFO("Error counters:\n");
 	INFO("                 messageSendErrors : %d\n",
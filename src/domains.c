@@ -0,0 +1,260 @@
+/*-
+ * Copyright (c) 2014 Wojciech Owczarek,
+ *
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+
+/**
+ * @file   domains.c
+ *
+ * @brief  Engine instances for several PTP domains over one set of sockets
+ *
+ * Each domain listed in ptpengine:domain_instances gets a complete
+ * protocol engine of its own, next to the one for ptpengine:domain:
+ * its own datasets, foreign masters, timers, filters and servo. Only
+ * the ptpengine:domain instance opens sockets and disciplines the clock.
+ * The other instances send through its sockets, and every message it
+ * receives is queued for the instance of the message's domain. They
+ * either monitor their domain - slave only, never adjusting the clock -
+ * or serve it as a master. All instances are run from the one main loop;
+ * the process-wide services stay with the ptpengine:domain instance.
+ */
+
+#include "ptpd.h"
+
+/*
+ * Parse the domain instance list: domain numbers separated by commas or
+ * spaces, each optionally followed by ":monitor" (default) or ":master".
+ * Returns FALSE on a malformed list.
+ */
+Boolean
+domainParseInstances(RunTimeOpts *rtOpts)
+{
+
+	char text[PATH_MAX];
+	char *token, *end, *save = NULL;
+	long domainNumber;
+	Boolean serve;
+	int i;
+
+	rtOpts->domainInstanceCount = 0;
+	strncpy(text, rtOpts->domainInstancesText, sizeof(text) - 1);
+	text[sizeof(text) - 1] = '\0';
+
+	for (token = strtok_r(text, ", \t", &save); token != NULL;
+	     token = strtok_r(NULL, ", \t", &save)) {
+		domainNumber = strtol(token, &end, 10);
+		if (end == token || domainNumber < 0 || domainNumber > 127)
+			return FALSE;
+		if (*end == '\0' || !strcmp(end, ":monitor"))
+			serve = FALSE;
+		else if (!strcmp(end, ":master"))
+			serve = TRUE;
+		else
+			return FALSE;
+		if (domainNumber == rtOpts->domainNumber)
+			return FALSE;
+		for (i = 0; i < rtOpts->domainInstanceCount; i++)
+			if (rtOpts->domainInstanceNumbers[i] == domainNumber)
+				return FALSE;
+		if (rtOpts->domainInstanceCount == DOMAIN_MAX_INSTANCES - 1)
+			return FALSE;
+		rtOpts->domainInstanceNumbers[rtOpts->domainInstanceCount] = domainNumber;
+		rtOpts->domainInstanceServe[rtOpts->domainInstanceCount++] = serve;
+	}
+
+	return TRUE;
+
+}
+
+/* options of a domain instance: those of a boundary clock port, in its own domain and role */
+static void
+domainInstanceOptions(RunTimeOpts *instanceOpts, const RunTimeOpts *rtOpts, int index)
+{
+
+	bcPortOptions(instanceOpts, rtOpts, rtOpts->ifaceName);
+
+	instanceOpts->domainNumber = rtOpts->domainInstanceNumbers[index];
+	/* the clock belongs to the ptpengine:domain instance */
+	instanceOpts->noAdjust = TRUE;
+	instanceOpts->monitorMode = FALSE;
+	instanceOpts->slaveTableEnabled = FALSE;
+
+	if (rtOpts->domainInstanceServe[index]) {
+		instanceOpts->slaveOnly = FALSE;
+		if (rtOpts->clockQuality.clockClass > 127)
+			instanceOpts->clockQuality.clockClass =
+				DEFAULT_CLOCK_CLASS__APPLICATION_SPECIFIC_TIME_SOURCE;
+	} else {
+		instanceOpts->slaveOnly = TRUE;
+		instanceOpts->clockQuality.clockClass = SLAVE_ONLY_CLOCK_CLASS;
+	}
+
+}
+
+/**
+ * Create the instances for the other domains. They are initialised from
+ * the main loop, after the ptpengine:domain instance has opened the sockets.
+ */
+Boolean
+domainInit(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	DomainInstances *domains;
+	PtpClock *instance;
+	int i;
+
+	if (rtOpts->domainInstanceCount == 0)
+		return TRUE;
+
+	if ((domains = (DomainInstances *)calloc(1, sizeof(DomainInstances))) == NULL) {
+		PERROR("failed to allocate memory for the domain instances");
+		return FALSE;
+	}
+
+	domains->instances[0] = ptpClock;
+	domains->instanceOpts[0] = rtOpts;
+	domains->count = 1;
+	ptpClock->domainInstances = domains;
+	ptpClock->domainIndex = 0;
+	timerRegister(ptpClock->itimer);
+
+	for (i = 0; i < rtOpts->domainInstanceCount; i++) {
+		if ((domains->instanceOpts[i + 1] = (RunTimeOpts *)malloc(sizeof(RunTimeOpts))) == NULL) {
+			PERROR("failed to allocate memory for domain instance options");
+			return FALSE;
+		}
+		domainInstanceOptions(domains->instanceOpts[i + 1], rtOpts, i);
+
+		if ((instance = createPtpClock(domains->instanceOpts[i + 1])) == NULL) {
+			free(domains->instanceOpts[i + 1]);
+			domains->instanceOpts[i + 1] = NULL;
+			return FALSE;
+		}
+
+		instance->domainInstances = domains;
+		instance->domainIndex = i + 1;
+		domains->instances[i + 1] = instance;
+		domains->count++;
+		timerRegister(instance->itimer);
+	}
+
+	INFO("Running %d domain instances\n", domains->count);
+
+	return TRUE;
+
+}
+
+/* free the other instances - the sockets they used are not theirs to close */
+void
+domainShutdown(PtpClock *ptpClock)
+{
+
+	DomainInstances *domains = ptpClock->domainInstances;
+	int i;
+
+	if (domains == NULL)
+		return;
+
+	for (i = 1; i < domains->count; i++) {
+		timerUnregister(domains->instances[i]->itimer);
+		freePtpClock(&domains->instances[i]);
+		free(domains->instanceOpts[i]);
+	}
+
+	timerUnregister(ptpClock->itimer);
+	ptpClock->domainInstances = NULL;
+	free(domains);
+
+}
+
+/* the configuration was reloaded - the other instances take the new options */
+void
+domainUpdateOptions(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	DomainInstances *domains = ptpClock->domainInstances;
+	int i;
+
+	if (domains == NULL)
+		return;
+
+	for (i = 1; i < domains->count; i++)
+		domainInstanceOptions(domains->instanceOpts[i], rtOpts, i - 1);
+
+}
+
+/* the instance a received message belongs to, by its domain */
+PtpClock*
+domainDemux(PtpClock *ptpClock, const Octet *buf, ssize_t length)
+{
+
+	DomainInstances *domains = ptpClock->domainInstances;
+	UInteger8 domainNumber;
+	int i;
+
+	/* too short to tell - processMessage() will count it */
+	if (domains == NULL || length < HEADER_LENGTH)
+		return ptpClock;
+
+	domainNumber = *(UInteger8 *)(buf + 4);
+
+	for (i = 1; i < domains->count; i++)
+		if (domains->instanceOpts[i]->domainNumber == domainNumber)
+			return domains->instances[i];
+
+	return ptpClock;
+
+}
+
+/* status file: one line per other domain */
+void
+domainStatus(const PtpClock *ptpClock, FILE *out)
+{
+
+	const DomainInstances *domains = ptpClock->domainInstances;
+	const PtpClock *instance;
+	char name[16];
+	int i;
+
+	if (domains == NULL)
+		return;
+
+	for (i = 1; i < domains->count; i++) {
+		instance = domains->instances[i];
+		snprintf(name, sizeof(name), "Domain %d", instance->domainNumber);
+		fprintf(out, "%-19s:  %s, %s", name,
+			domains->instanceOpts[i]->slaveOnly ? "monitor" : "master",
+			portState_getName(instance->portState));
+		if (instance->portState == PTP_SLAVE)
+			fprintf(out, ", offset %.9f s, delay %.9f s",
+				timeInternalToDouble(&instance->offsetFromMaster),
+				timeInternalToDouble(&instance->meanPathDelay));
+		fprintf(out, "\n");
+	}
+
+}
@@ -76,8 +76,8 @@ void initOutgoingMsgManagement(MsgManagement* incoming, MsgManagement* outgoing,
 	outgoing->boundaryHops = outgoing->startingBoundaryHops;
         outgoing->actionField = 0; /* set default action, avoid uninitialized value */
 
-	/* init managementTLV */
-	XMALLOC(outgoing->tlv, sizeof(ManagementTLV));
+	/* init managementTLV - not from the arena, every handler fills it in */
+	outgoing->tlv = &ptpClock->outgoingManageTLV;
 	outgoing->tlv->dataField = NULL;
 	outgoing->tlv->lengthField = 0;
 }
@@ -102,7 +102,6 @@ void handleMMNullManagement(MsgManagement* incoming, MsgManagement* outgoing, Pt
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_NULL_MANAGEMENT,
 			NOT_SUPPORTED);
@@ -126,7 +125,7 @@ void handleMMClockDescription(MsgManagement* incoming, MsgManagement* outgoing,
 		DBGV(" GET action \n");
 		/* Table 38 */
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof( MMClockDescription));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof( MMClockDescription));
 		data = (MMClockDescription*)outgoing->tlv->dataField;
 		memset(data, 0, sizeof( MMClockDescription));
 		/* GET actions */
@@ -135,21 +134,21 @@ void handleMMClockDescription(MsgManagement* incoming, MsgManagement* outgoing,
 		data->clockType1 = 0x00;
 		/* physical layer protocol */
                 data->physicalLayerProtocol.lengthField = sizeof(PROTOCOL) - 1;
-                XMALLOC(data->physicalLayerProtocol.textField,
+                XMALLOC_MANAGEMENT(data->physicalLayerProtocol.textField,
                                 data->physicalLayerProtocol.lengthField);
                 memcpy(data->physicalLayerProtocol.textField,
                         &PROTOCOL,
                         data->physicalLayerProtocol.lengthField);
 		/* physical address */
                 data->physicalAddress.addressLength = PTP_UUID_LENGTH;
-                XMALLOC(data->physicalAddress.addressField, PTP_UUID_LENGTH);
+                XMALLOC_MANAGEMENT(data->physicalAddress.addressField, PTP_UUID_LENGTH);
                 memcpy(data->physicalAddress.addressField,
                         ptpClock->netPath.interfaceID,
                         PTP_UUID_LENGTH);
 		/* protocol address */
                 data->protocolAddress.addressLength = 4;
                 data->protocolAddress.networkProtocol = 1;
-                XMALLOC(data->protocolAddress.addressField,
+                XMALLOC_MANAGEMENT(data->protocolAddress.addressField,
                         data->protocolAddress.addressLength);
                 memcpy(data->protocolAddress.addressField,
                         &ptpClock->netPath.interfaceAddr.s_addr,
@@ -162,21 +161,21 @@ void handleMMClockDescription(MsgManagement* incoming, MsgManagement* outgoing,
 		data->reserved = 0;
 		/* product description */
                 data->productDescription.lengthField = sizeof(PRODUCT_DESCRIPTION) - 1;
-                XMALLOC(data->productDescription.textField,
+                XMALLOC_MANAGEMENT(data->productDescription.textField,
                                         data->productDescription.lengthField);
                 memcpy(data->productDescription.textField,
                         &PRODUCT_DESCRIPTION,
                         data->productDescription.lengthField);
 		/* revision data */
                 data->revisionData.lengthField = sizeof(REVISION) - 1;
-                XMALLOC(data->revisionData.textField,
+                XMALLOC_MANAGEMENT(data->revisionData.textField,
                                         data->revisionData.lengthField);
                 memcpy(data->revisionData.textField,
                         &REVISION,
                         data->revisionData.lengthField);
 		/* user description */
                 data->userDescription.lengthField = strlen(ptpClock->user_description);
-                XMALLOC(data->userDescription.textField,
+                XMALLOC_MANAGEMENT(data->userDescription.textField,
                                         data->userDescription.lengthField);
                 memcpy(data->userDescription.textField,
                         ptpClock->user_description,
@@ -195,7 +194,6 @@ void handleMMClockDescription(MsgManagement* incoming, MsgManagement* outgoing,
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_CLOCK_DESCRIPTION,
 			NOT_SUPPORTED);
@@ -224,7 +222,7 @@ void handleMMSlaveOnly(MsgManagement* incoming, MsgManagement* outgoing, PtpCloc
 	case GET:
 		DBGV(" GET action \n");
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof(MMSlaveOnly));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMSlaveOnly));
 		data = (MMSlaveOnly*)outgoing->tlv->dataField;
 		/* GET actions */
 		data->so = ptpClock->slaveOnly;
@@ -232,7 +230,6 @@ void handleMMSlaveOnly(MsgManagement* incoming, MsgManagement* outgoing, PtpCloc
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_SLAVE_ONLY,
 			NOT_SUPPORTED);
@@ -268,12 +265,12 @@ void handleMMUserDescription(MsgManagement* incoming, MsgManagement* outgoing, P
 	case GET:
 		DBGV(" GET action \n");
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof( MMUserDescription));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof( MMUserDescription));
 		data = (MMUserDescription*)outgoing->tlv->dataField;
 		memset(data, 0, sizeof(MMUserDescription));
 		/* GET actions */
                 data->userDescription.lengthField = strlen(ptpClock->user_description);
-                XMALLOC(data->userDescription.textField,
+                XMALLOC_MANAGEMENT(data->userDescription.textField,
                                         data->userDescription.lengthField);
                 memcpy(data->userDescription.textField,
                         ptpClock->user_description,
@@ -281,7 +278,6 @@ void handleMMUserDescription(MsgManagement* incoming, MsgManagement* outgoing, P
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_USER_DESCRIPTION,
 			NOT_SUPPORTED);
@@ -306,7 +302,6 @@ void handleMMSaveInNonVolatileStorage(MsgManagement* incoming, MsgManagement* ou
 		/* issue a NOT_SUPPORTED error management message, intentionally fall through */
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_SAVE_IN_NON_VOLATILE_STORAGE,
 			NOT_SUPPORTED);
@@ -331,7 +326,6 @@ void handleMMResetNonVolatileStorage(MsgManagement* incoming, MsgManagement* out
 		/* issue a NOT_SUPPORTED error management message, intentionally fall through */
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_RESET_NON_VOLATILE_STORAGE,
 			NOT_SUPPORTED);
@@ -355,7 +349,7 @@ void handleMMInitialize(MsgManagement* incoming, MsgManagement* outgoing, PtpClo
 	case COMMAND:
 		DBGV(" COMMAND action\n");
 		outgoing->actionField = ACKNOWLEDGE;
-		XMALLOC(outgoing->tlv->dataField, sizeof(MMInitialize));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMInitialize));
 		incomingData = (MMInitialize*)incoming->tlv->dataField;
 		outgoingData = (MMInitialize*)outgoing->tlv->dataField;
 		/* Table 45 - INITIALIZATION_KEY enumeration */
@@ -377,7 +371,6 @@ void handleMMInitialize(MsgManagement* incoming, MsgManagement* outgoing, PtpClo
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_INITIALIZE,
 			NOT_SUPPORTED);
@@ -400,7 +393,7 @@ void handleMMDefaultDataSet(MsgManagement* incoming, MsgManagement* outgoing, Pt
 	case GET:
 		DBGV(" GET action\n");
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof(MMDefaultDataSet));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMDefaultDataSet));
 		data = (MMDefaultDataSet*)outgoing->tlv->dataField;
 		/* GET actions */
 		/* get bit and align for slave only */
@@ -427,7 +420,6 @@ void handleMMDefaultDataSet(MsgManagement* incoming, MsgManagement* outgoing, Pt
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_DEFAULT_DATA_SET,
 			NOT_SUPPORTED);
@@ -450,7 +442,7 @@ void handleMMCurrentDataSet(MsgManagement* incoming, MsgManagement* outgoing, Pt
 	case GET:
 		DBGV(" GET action\n");
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof( MMCurrentDataSet));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof( MMCurrentDataSet));
 		data = (MMCurrentDataSet*)outgoing->tlv->dataField;
 		/* GET actions */
 		data->stepsRemoved = ptpClock->stepsRemoved;
@@ -473,7 +465,6 @@ void handleMMCurrentDataSet(MsgManagement* incoming, MsgManagement* outgoing, Pt
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_CURRENT_DATA_SET,
 			NOT_SUPPORTED);
@@ -496,7 +487,7 @@ void handleMMParentDataSet(MsgManagement* incoming, MsgManagement* outgoing, Ptp
 	case GET:
 		DBGV(" GET action\n");
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof(MMParentDataSet));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMParentDataSet));
 		data = (MMParentDataSet*)outgoing->tlv->dataField;
 		/* GET actions */
 		copyPortIdentity(&data->parentPortIdentity, &ptpClock->parentPortIdentity);
@@ -522,7 +513,6 @@ void handleMMParentDataSet(MsgManagement* incoming, MsgManagement* outgoing, Ptp
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_PARENT_DATA_SET,
 			NOT_SUPPORTED);
@@ -545,7 +535,7 @@ void handleMMTimePropertiesDataSet(MsgManagement* incoming, MsgManagement* outgo
 	case GET:
 		DBGV(" GET action\n");
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof(MMTimePropertiesDataSet));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMTimePropertiesDataSet));
 		data = (MMTimePropertiesDataSet*)outgoing->tlv->dataField;
 		/* GET actions */
 		data->currentUtcOffset = ptpClock->timePropertiesDS.currentUtcOffset;
@@ -564,7 +554,6 @@ void handleMMTimePropertiesDataSet(MsgManagement* incoming, MsgManagement* outgo
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_TIME_PROPERTIES_DATA_SET,
 			NOT_SUPPORTED);
@@ -587,7 +576,7 @@ void handleMMPortDataSet(MsgManagement* incoming, MsgManagement* outgoing, PtpCl
 	case GET:
 		DBGV(" GET action\n");
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof(MMPortDataSet));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMPortDataSet));
 		data = (MMPortDataSet*)outgoing->tlv->dataField;
 		copyPortIdentity(&data->portIdentity, &ptpClock->portIdentity);
 		data->portState = ptpClock->portState;
@@ -612,7 +601,6 @@ void handleMMPortDataSet(MsgManagement* incoming, MsgManagement* outgoing, PtpCl
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_PORT_DATA_SET,
 			NOT_SUPPORTED);
@@ -642,7 +630,7 @@ void handleMMPriority1(MsgManagement* incoming, MsgManagement* outgoing, PtpCloc
 	case GET:
 		DBGV(" GET action\n");
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof(MMPriority1));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMPriority1));
 		data = (MMPriority1*)outgoing->tlv->dataField;
 		/* GET actions */
 		data->priority1 = ptpClock->priority1;
@@ -654,7 +642,6 @@ void handleMMPriority1(MsgManagement* incoming, MsgManagement* outgoing, PtpCloc
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_PRIORITY1,
 			NOT_SUPPORTED);
@@ -684,7 +671,7 @@ void handleMMPriority2(MsgManagement* incoming, MsgManagement* outgoing, PtpCloc
 	case GET:
 		DBGV(" GET action\n");
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof(MMPriority2));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMPriority2));
 		data = (MMPriority2*)outgoing->tlv->dataField;
 		/* GET actions */
 		data->priority2 = ptpClock->priority2;
@@ -696,7 +683,6 @@ void handleMMPriority2(MsgManagement* incoming, MsgManagement* outgoing, PtpCloc
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_PRIORITY2,
 			NOT_SUPPORTED);
@@ -726,7 +712,7 @@ void handleMMDomain(MsgManagement* incoming, MsgManagement* outgoing, PtpClock*
 	case GET:
 		DBGV(" GET action\n");
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof(MMDomain));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMDomain));
 		data = (MMDomain*)outgoing->tlv->dataField;
 		/* GET actions */
 		data->domainNumber = ptpClock->domainNumber;
@@ -738,7 +724,6 @@ void handleMMDomain(MsgManagement* incoming, MsgManagement* outgoing, PtpClock*
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_DOMAIN,
 			NOT_SUPPORTED);
@@ -768,7 +753,7 @@ void handleMMLogAnnounceInterval(MsgManagement* incoming, MsgManagement* outgoin
 	case GET:
 		DBGV(" GET action\n");
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof(MMLogAnnounceInterval));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMLogAnnounceInterval));
 		data = (MMLogAnnounceInterval*)outgoing->tlv->dataField;
 		/* GET actions */
 		data->logAnnounceInterval = ptpClock->logAnnounceInterval;
@@ -780,7 +765,6 @@ void handleMMLogAnnounceInterval(MsgManagement* incoming, MsgManagement* outgoin
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_LOG_ANNOUNCE_INTERVAL,
 			NOT_SUPPORTED);
@@ -810,7 +794,7 @@ void handleMMAnnounceReceiptTimeout(MsgManagement* incoming, MsgManagement* outg
 	case GET:
 		DBGV(" GET action\n");
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof(MMAnnounceReceiptTimeout));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMAnnounceReceiptTimeout));
 		data = (MMAnnounceReceiptTimeout*)outgoing->tlv->dataField;
 		/* GET actions */
 		data->announceReceiptTimeout = ptpClock->announceReceiptTimeout;
@@ -822,7 +806,6 @@ void handleMMAnnounceReceiptTimeout(MsgManagement* incoming, MsgManagement* outg
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_ANNOUNCE_RECEIPT_TIMEOUT,
 			NOT_SUPPORTED);
@@ -852,7 +835,7 @@ void handleMMLogSyncInterval(MsgManagement* incoming, MsgManagement* outgoing, P
 	case GET:
 		DBGV(" GET action\n");
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof(MMLogSyncInterval));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMLogSyncInterval));
 		data = (MMLogSyncInterval*)outgoing->tlv->dataField;
 		/* GET actions */
 		data->logSyncInterval = ptpClock->logSyncInterval;
@@ -864,7 +847,6 @@ void handleMMLogSyncInterval(MsgManagement* incoming, MsgManagement* outgoing, P
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_LOG_SYNC_INTERVAL,
 			NOT_SUPPORTED);
@@ -894,7 +876,7 @@ void handleMMVersionNumber(MsgManagement* incoming, MsgManagement* outgoing, Ptp
 	case GET:
 		DBGV(" GET action\n");
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof(MMVersionNumber));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMVersionNumber));
 		data = (MMVersionNumber*)outgoing->tlv->dataField;
 		/* GET actions */
 		data->reserved0 = 0x0;
@@ -907,7 +889,6 @@ void handleMMVersionNumber(MsgManagement* incoming, MsgManagement* outgoing, Ptp
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_VERSION_NUMBER,
 			NOT_SUPPORTED);
@@ -939,7 +920,6 @@ void handleMMEnablePort(MsgManagement* incoming, MsgManagement* outgoing, PtpClo
 		/* TODO: implementation specific */
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_ENABLE_PORT,
 			NOT_SUPPORTED);
@@ -969,7 +949,6 @@ void handleMMDisablePort(MsgManagement* incoming, MsgManagement* outgoing, PtpCl
 		/* TODO: implementation specific */
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_DISABLE_PORT,
 			NOT_SUPPORTED);
@@ -997,7 +976,7 @@ void handleMMTime(MsgManagement* incoming, MsgManagement* outgoing, PtpClock* pt
 	case GET:
 		DBGV(" GET action\n");
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof(MMTime));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMTime));
 		data = (MMTime*)outgoing->tlv->dataField;
 		/* GET actions */
 		TimeInternal internalTime;
@@ -1014,7 +993,6 @@ void handleMMTime(MsgManagement* incoming, MsgManagement* outgoing, PtpClock* pt
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_TIME,
 			NOT_SUPPORTED);
@@ -1044,7 +1022,7 @@ void handleMMClockAccuracy(MsgManagement* incoming, MsgManagement* outgoing, Ptp
 	case GET:
 		DBGV(" GET action\n");
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof(MMClockAccuracy));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMClockAccuracy));
 		data = (MMClockAccuracy*)outgoing->tlv->dataField;
 		/* GET actions */
 		data->clockAccuracy = ptpClock->clockQuality.clockAccuracy;
@@ -1056,7 +1034,6 @@ void handleMMClockAccuracy(MsgManagement* incoming, MsgManagement* outgoing, Ptp
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_CLOCK_ACCURACY,
 			NOT_SUPPORTED);
@@ -1090,7 +1067,7 @@ void handleMMUtcProperties(MsgManagement* incoming, MsgManagement* outgoing, Ptp
 	case GET:
 		DBGV(" GET action\n");
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof(MMUtcProperties));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMUtcProperties));
 		data = (MMUtcProperties*)outgoing->tlv->dataField;
 		/* GET actions */
 		data->currentUtcOffset = ptpClock->timePropertiesDS.currentUtcOffset;
@@ -1106,7 +1083,6 @@ void handleMMUtcProperties(MsgManagement* incoming, MsgManagement* outgoing, Ptp
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_UTC_PROPERTIES,
 			NOT_SUPPORTED);
@@ -1137,7 +1113,7 @@ void handleMMTraceabilityProperties(MsgManagement* incoming, MsgManagement* outg
 	case GET:
 		DBGV(" GET action\n");
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof(MMTraceabilityProperties));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMTraceabilityProperties));
 		data = (MMTraceabilityProperties*)outgoing->tlv->dataField;
 		/* GET actions */
 		Octet ftra = SET_FIELD(ptpClock->timePropertiesDS.frequencyTraceable, FTRA);
@@ -1151,7 +1127,6 @@ void handleMMTraceabilityProperties(MsgManagement* incoming, MsgManagement* outg
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_TRACEABILITY_PROPERTIES,
 			NOT_SUPPORTED);
@@ -1181,7 +1156,7 @@ void handleMMDelayMechanism(MsgManagement* incoming, MsgManagement* outgoing, Pt
 	case GET:
 		DBGV(" GET action\n");
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof(MMDelayMechanism));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMDelayMechanism));
 		data = (MMDelayMechanism*)outgoing->tlv->dataField;
 		/* GET actions */
 		data->delayMechanism = ptpClock->delayMechanism;
@@ -1193,7 +1168,6 @@ void handleMMDelayMechanism(MsgManagement* incoming, MsgManagement* outgoing, Pt
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_DELAY_MECHANISM,
 			NOT_SUPPORTED);
@@ -1223,7 +1197,7 @@ void handleMMLogMinPdelayReqInterval(MsgManagement* incoming, MsgManagement* out
 	case GET:
 		DBGV(" GET action\n");
 		outgoing->actionField = RESPONSE;
-		XMALLOC(outgoing->tlv->dataField, sizeof(MMLogMinPdelayReqInterval));
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMLogMinPdelayReqInterval));
 		data = (MMLogMinPdelayReqInterval*)outgoing->tlv->dataField;
 		/* GET actions */
 		data->logMinPdelayReqInterval = ptpClock->logMinPdelayReqInterval;
@@ -1235,7 +1209,6 @@ void handleMMLogMinPdelayReqInterval(MsgManagement* incoming, MsgManagement* out
 		break;
 	default:
 		DBGV(" unknown actionType \n");
-		free(outgoing->tlv);
 		handleErrorManagementMessage(incoming, outgoing,
 			ptpClock, MM_LOG_MIN_PDELAY_REQ_INTERVAL,
 			NOT_SUPPORTED);
@@ -1243,6 +1216,264 @@ void handleMMLogMinPdelayReqInterval(MsgManagement* incoming, MsgManagement* out
 
 }
 
+/* Real value to 32.32 fixed point, as used by the PTPD_SERVO TLV */
+static void
+doubleToFixed32_32(double value, Integer64 *fixed)
+{
+	int64_t scaled = (int64_t)(value * 4294967296.0);
+
+	fixed->msb = (Integer32)(scaled >> 32);
+	fixed->lsb = (UInteger32)(scaled & 0xffffffff);
+}
+
+#ifdef PTPD_STATISTICS
+/* TimeInternal to a TimeInterval, as used by the PTPD_SLAVE_STATS TLV */
+static void
+timeInternalToTimeInterval(TimeInternal time, TimeInterval *interval)
+{
+	interval->scaledNanoseconds.msb = 0;
+	interval->scaledNanoseconds.lsb = 0;
+	internalTime_to_integer64(time, &interval->scaledNanoseconds);
+}
+#endif /* PTPD_STATISTICS */
+
+/**\brief Handle incoming PTPD_COUNTERS management message type*/
+void handleMMPtpdCounters(MsgManagement* incoming, MsgManagement* outgoing, PtpClock* ptpClock)
+{
+	DBGV("received PTPD_COUNTERS message\n");
+
+	initOutgoingMsgManagement(incoming, outgoing, ptpClock);
+	outgoing->tlv->tlvType = TLV_MANAGEMENT;
+	outgoing->tlv->managementId = MM_PTPD_COUNTERS;
+
+	MMPtpdCounters* data = NULL;
+	switch( incoming->actionField )
+	{
+	case GET:
+		DBGV(" GET action\n");
+		outgoing->actionField = RESPONSE;
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMPtpdCounters));
+		data = (MMPtpdCounters*)outgoing->tlv->dataField;
+		/* GET actions */
+		#define OPERATE( name, size, type ) \
+			data->name = ptpClock->counters.name;
+		#include "def/managementTLV/ptpdCounters.def"
+		break;
+	case RESPONSE:
+		DBGV(" RESPONSE action\n");
+		/* TODO: implementation specific */
+		break;
+	default:
+		DBGV(" unknown actionType \n");
+		handleErrorManagementMessage(incoming, outgoing,
+			ptpClock, MM_PTPD_COUNTERS,
+			NOT_SUPPORTED);
+	}
+
+}
+
+/**\brief Handle incoming PTPD_SERVO management message type*/
+void handleMMPtpdServo(MsgManagement* incoming, MsgManagement* outgoing, PtpClock* ptpClock)
+{
+	DBGV("received PTPD_SERVO message\n");
+
+	initOutgoingMsgManagement(incoming, outgoing, ptpClock);
+	outgoing->tlv->tlvType = TLV_MANAGEMENT;
+	outgoing->tlv->managementId = MM_PTPD_SERVO;
+
+	MMPtpdServo* data = NULL;
+	PIservo* servo = &ptpClock->servo;
+	switch( incoming->actionField )
+	{
+	case GET:
+		DBGV(" GET action\n");
+		outgoing->actionField = RESPONSE;
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMPtpdServo));
+		data = (MMPtpdServo*)outgoing->tlv->dataField;
+		/* GET actions - the arena hands out zeroed memory, statistics stay 0 without them */
+		doubleToFixed32_32(servo->kP, &data->kP);
+		doubleToFixed32_32(servo->kI, &data->kI);
+		data->input = servo->input;
+		doubleToFixed32_32(servo->output, &data->output);
+		doubleToFixed32_32(servo->observedDrift, &data->observedDrift);
+		data->maxOutput = servo->maxOutput;
+		data->flags = servo->runningMaxOutput ? PTPD_SERVO_RUNNING_MAX_OUTPUT : 0;
+		data->dTmethod = servo->dTmethod;
+		data->logdT = servo->logdT;
+		data->reserved = 0x0;
+#ifdef PTPD_STATISTICS
+		if(servo->statsCalculated)
+			data->flags |= PTPD_SERVO_STATS_CALCULATED;
+		if(servo->isStable)
+			data->flags |= PTPD_SERVO_STABLE;
+		data->updateCount = servo->updateCount;
+		data->stableCount = servo->stableCount;
+		doubleToFixed32_32(servo->driftMean, &data->driftMean);
+		doubleToFixed32_32(servo->driftStdDev, &data->driftStdDev);
+		doubleToFixed32_32(servo->stabilityThreshold, &data->stabilityThreshold);
+#endif /* PTPD_STATISTICS */
+		break;
+	case RESPONSE:
+		DBGV(" RESPONSE action\n");
+		/* TODO: implementation specific */
+		break;
+	default:
+		DBGV(" unknown actionType \n");
+		handleErrorManagementMessage(incoming, outgoing,
+			ptpClock, MM_PTPD_SERVO,
+			NOT_SUPPORTED);
+	}
+
+}
+
+/**\brief Handle incoming PTPD_SLAVE_STATS management message type*/
+void handleMMPtpdSlaveStats(MsgManagement* incoming, MsgManagement* outgoing, PtpClock* ptpClock)
+{
+	DBGV("received PTPD_SLAVE_STATS message\n");
+
+	initOutgoingMsgManagement(incoming, outgoing, ptpClock);
+	outgoing->tlv->tlvType = TLV_MANAGEMENT;
+	outgoing->tlv->managementId = MM_PTPD_SLAVE_STATS;
+
+#ifdef PTPD_STATISTICS
+	MMPtpdSlaveStats* data = NULL;
+	PtpEngineSlaveStats* stats = &ptpClock->slaveStats;
+	TimeInternal zero = { 0, 0 };
+	switch( incoming->actionField )
+	{
+	case GET:
+		DBGV(" GET action\n");
+		outgoing->actionField = RESPONSE;
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMPtpdSlaveStats));
+		data = (MMPtpdSlaveStats*)outgoing->tlv->dataField;
+		/* GET actions */
+		data->flags = 0;
+		if(stats->statsCalculated)
+			data->flags |= PTPD_STATS_CALCULATED;
+		if(stats->owdIsStable)
+			data->flags |= PTPD_STATS_OWD_STABLE;
+		if(ptpClock->delayMSoutlier)
+			data->flags |= PTPD_STATS_DELAYMS_OUTLIER;
+		if(ptpClock->delaySMoutlier)
+			data->flags |= PTPD_STATS_DELAYSM_OUTLIER;
+		data->reserved = 0x0;
+		timeInternalToTimeInterval(doubleToTimeInternal(stats->ofmMean), &data->ofmMean);
+		timeInternalToTimeInterval(doubleToTimeInternal(stats->ofmStdDev), &data->ofmStdDev);
+		timeInternalToTimeInterval(doubleToTimeInternal(stats->owdMean), &data->owdMean);
+		timeInternalToTimeInterval(doubleToTimeInternal(stats->owdStdDev), &data->owdStdDev);
+		timeInternalToTimeInterval(ptpClock->rawDelayMS, &data->rawDelayMS);
+		timeInternalToTimeInterval(ptpClock->rawDelaySM, &data->rawDelaySM);
+		/* outlier filter moving means, zero if the filter is disabled */
+		timeInternalToTimeInterval(ptpClock->delayMSFiltered != NULL ?
+			doubleToTimeInternal(ptpClock->delayMSFiltered->mean) : zero,
+			&data->delayMSFiltered);
+		timeInternalToTimeInterval(ptpClock->delaySMFiltered != NULL ?
+			doubleToTimeInternal(ptpClock->delaySMFiltered->mean) : zero,
+			&data->delaySMFiltered);
+		break;
+	case RESPONSE:
+		DBGV(" RESPONSE action\n");
+		/* TODO: implementation specific */
+		break;
+	default:
+		DBGV(" unknown actionType \n");
+		handleErrorManagementMessage(incoming, outgoing,
+			ptpClock, MM_PTPD_SLAVE_STATS,
+			NOT_SUPPORTED);
+	}
+#else
+	DBGV(" slave statistics not compiled in\n");
+	handleErrorManagementMessage(incoming, outgoing,
+		ptpClock, MM_PTPD_SLAVE_STATS,
+		NOT_SUPPORTED);
+#endif /* PTPD_STATISTICS */
+
+}
+
+/**\brief Handle incoming PTPD_CLEAR_COUNTERS management message type*/
+void handleMMPtpdClearCounters(MsgManagement* incoming, MsgManagement* outgoing, PtpClock* ptpClock)
+{
+	DBGV("received PTPD_CLEAR_COUNTERS message\n");
+
+	initOutgoingMsgManagement(incoming, outgoing, ptpClock);
+	outgoing->tlv->tlvType = TLV_MANAGEMENT;
+	outgoing->tlv->managementId = MM_PTPD_CLEAR_COUNTERS;
+
+	switch( incoming->actionField )
+	{
+	case COMMAND:
+		DBGV(" COMMAND action\n");
+		outgoing->actionField = ACKNOWLEDGE;
+		clearCounters(ptpClock);
+		break;
+	case ACKNOWLEDGE:
+		DBGV(" ACKNOWLEDGE action\n");
+		/* TODO: implementation specific */
+		break;
+	default:
+		DBGV(" unknown actionType \n");
+		handleErrorManagementMessage(incoming, outgoing,
+			ptpClock, MM_PTPD_CLEAR_COUNTERS,
+			NOT_SUPPORTED);
+	}
+
+}
+
+/**\brief Handle incoming PTPD_SLAVE_TABLE management message type*/
+void handleMMPtpdSlaveTable(MsgManagement* incoming, MsgManagement* outgoing, PtpClock* ptpClock)
+{
+	DBGV("received PTPD_SLAVE_TABLE message\n");
+
+	initOutgoingMsgManagement(incoming, outgoing, ptpClock);
+	outgoing->tlv->tlvType = TLV_MANAGEMENT;
+	outgoing->tlv->managementId = MM_PTPD_SLAVE_TABLE;
+
+	MMPtpdSlaveTable* data = NULL;
+	SlaveTable* table = ptpClock->slaveTable;
+	SlaveTableTotals totals;
+	switch( incoming->actionField )
+	{
+	case GET:
+		DBGV(" GET action\n");
+		/* slave table disabled */
+		if(table == NULL) {
+			handleErrorManagementMessage(incoming, outgoing,
+				ptpClock, MM_PTPD_SLAVE_TABLE,
+				NOT_SUPPORTED);
+			break;
+		}
+		outgoing->actionField = RESPONSE;
+		XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof(MMPtpdSlaveTable));
+		data = (MMPtpdSlaveTable*)outgoing->tlv->dataField;
+		/* GET actions */
+		slaveTableTotals(table, &totals);
+		data->capacity = table->capacity;
+		data->slaves = totals.slaves;
+		data->floodingSlaves = totals.flooding;
+		data->evictedSlaves = table->evicted;
+		data->expiredSlaves = table->expired;
+		data->floodEvents = table->floodEvents;
+		data->sequenceGaps = totals.sequenceGaps;
+		data->sequenceErrors = totals.sequenceErrors;
+		doubleToFixed32_32(totals.maxRate, &data->maxRate);
+		data->maxJitter.scaledNanoseconds.msb = 0;
+		data->maxJitter.scaledNanoseconds.lsb = 0;
+		internalTime_to_integer64(doubleToTimeInternal(totals.maxJitter),
+			&data->maxJitter.scaledNanoseconds);
+		break;
+	case RESPONSE:
+		DBGV(" RESPONSE action\n");
+		/* TODO: implementation specific */
+		break;
+	default:
+		DBGV(" unknown actionType \n");
+		handleErrorManagementMessage(incoming, outgoing,
+			ptpClock, MM_PTPD_SLAVE_TABLE,
+			NOT_SUPPORTED);
+	}
+
+}
+
 /**\brief Handle incoming ERROR_STATUS management message type*/
 void handleMMErrorStatus(MsgManagement *incoming)
 {
@@ -1273,7 +1504,7 @@ void handleErrorManagementMessage(MsgManagement *incoming, MsgManagement *outgoi
 		outgoing->actionField = 0;
 	}
 
-	XMALLOC(outgoing->tlv->dataField, sizeof( MMErrorStatus));
+	XMALLOC_MANAGEMENT(outgoing->tlv->dataField, sizeof( MMErrorStatus));
 	MMErrorStatus *data = (MMErrorStatus*)outgoing->tlv->dataField;
 	/* set managementId */
 	data->managementId = mgmtId;
@@ -1282,3 +1513,121 @@ void handleErrorManagementMessage(MsgManagement *incoming, MsgManagement *outgoi
 	data->displayData.textField = NULL;
 
 }
+
+/* Cache slot for a dataset GET response, -1 if the dataset is not cached */
+static int
+managementCacheSlot(Enumeration16 managementId)
+{
+	switch(managementId)
+	{
+	case MM_DEFAULT_DATA_SET:
+		return MGMT_CACHE_DEFAULT_DS;
+	case MM_CURRENT_DATA_SET:
+		return MGMT_CACHE_CURRENT_DS;
+	case MM_PARENT_DATA_SET:
+		return MGMT_CACHE_PARENT_DS;
+	case MM_TIME_PROPERTIES_DATA_SET:
+		return MGMT_CACHE_TIME_PROPERTIES_DS;
+	case MM_PORT_DATA_SET:
+		return MGMT_CACHE_PORT_DS;
+	default:
+		return -1;
+	}
+}
+
+/**\brief Record a write to a dataset: its cached GET response is no longer valid */
+void
+datasetChanged(PtpClock *ptpClock, int dataset)
+{
+	ptpClock->datasetGeneration[dataset]++;
+}
+
+/**\brief Record a write that may have touched any dataset */
+void
+allDatasetsChanged(PtpClock *ptpClock)
+{
+	int i;
+
+	for(i = 0; i < MGMT_CACHE_ENTRIES; i++)
+		ptpClock->datasetGeneration[i]++;
+}
+
+/**
+ * \brief Answer a dataset GET from the cache, without running its handler
+ *
+ * A cached TLV is used while its dataset is still at the generation the
+ * TLV was packed under - every write to the dataset goes through
+ * datasetChanged(). On a hit the response header is set up in outgoing
+ * and the TLV is copied into buf. Returns the TLV length, type and length
+ * fields included, or 0 if the request has to go to its handler.
+ */
+UInteger16
+managementCachedResponse(MsgManagement *incoming, MsgManagement *outgoing,
+			 Octet *buf, PtpClock *ptpClock)
+{
+	int slot;
+	ManagementCacheEntry *entry;
+
+	if(incoming->actionField != GET ||
+	    incoming->tlv->tlvType != TLV_MANAGEMENT)
+		return 0;
+
+	slot = managementCacheSlot(incoming->tlv->managementId);
+	if(slot < 0)
+		return 0;
+
+	entry = &ptpClock->managementCache[slot];
+	if(entry->tlvLength == 0 ||
+	    entry->generation != ptpClock->datasetGeneration[slot])
+		return 0;
+
+	initOutgoingMsgManagement(incoming, outgoing, ptpClock);
+	outgoing->actionField = RESPONSE;
+	outgoing->tlv->tlvType = TLV_MANAGEMENT;
+	outgoing->tlv->managementId = incoming->tlv->managementId;
+	outgoing->tlv->lengthField = entry->tlvLength - TL_LENGTH;
+	memcpy(buf + MANAGEMENT_LENGTH, entry->tlv, entry->tlvLength);
+
+	ptpClock->counters.managementCacheHits++;
+	DBGV("management response for dataset %d served from cache, generation %u\n",
+		slot, entry->generation);
+	return entry->tlvLength;
+}
+
+/**
+ * \brief Pack the outgoing management or error status TLV into buf
+ *
+ * A dataset GET response is also kept in the cache, under the dataset's
+ * current generation, for managementCachedResponse(). Returns the TLV
+ * length, type and length fields included.
+ */
+UInteger16
+packManagementResponseTLV(MsgManagement *outgoing, Octet *buf, PtpClock *ptpClock)
+{
+	int slot;
+	ManagementCacheEntry *entry;
+
+	if(outgoing->tlv->tlvType == TLV_MANAGEMENT_ERROR_STATUS) {
+		msgPackManagementErrorStatusTLV(buf, outgoing, ptpClock);
+		return TL_LENGTH + outgoing->tlv->lengthField;
+	}
+
+	msgPackManagementTLV(buf, outgoing, ptpClock);
+
+	if(outgoing->tlv->tlvType != TLV_MANAGEMENT ||
+	    outgoing->actionField != RESPONSE ||
+	    outgoing->tlv->dataField == NULL)
+		return TL_LENGTH + outgoing->tlv->lengthField;
+
+	slot = managementCacheSlot(outgoing->tlv->managementId);
+
+	if(slot >= 0 &&
+	    TL_LENGTH + outgoing->tlv->lengthField <= MANAGEMENT_CACHE_TLV_LENGTH) {
+		entry = &ptpClock->managementCache[slot];
+		entry->generation = ptpClock->datasetGeneration[slot];
+		entry->tlvLength = TL_LENGTH + outgoing->tlv->lengthField;
+		memcpy(entry->tlv, buf + MANAGEMENT_LENGTH, entry->tlvLength);
+	}
+
+	return TL_LENGTH + outgoing->tlv->lengthField;
+}
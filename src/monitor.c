@@ -0,0 +1,443 @@
+/*-
+ * Copyright (c) 2014 Wojciech Owczarek,
+ *
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file   monitor.c
+ *
+ * @brief  Passive multi-master monitor
+ *
+ * In monitor mode the port never leaves LISTENING and the clock is never
+ * adjusted. Announce, Sync and Follow_Up messages from every monitored
+ * domain are tracked per master: each master's offset against the local
+ * clock (no path delay is known - no timing messages are sent, only
+ * management messages are answered), its variation over the last
+ * MONITOR_WINDOW Syncs, and its offset against the best master of its
+ * domain. Results go to the statistics log, the status file and the
+ * control socket.
+ */
+
+#include "ptpd.h"
+
+/* entry times are monotonic - immune to clock steps */
+static double
+monitorNow(void)
+{
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1E9;
+
+}
+
+Boolean
+monitorDomainEnabled(const RunTimeOpts *rtOpts, UInteger8 domainNumber)
+{
+
+	return (rtOpts->monitorDomains[domainNumber >> 3] & (1 << (domainNumber & 7))) != 0;
+
+}
+
+/*
+ * Parse the monitored domain list: domain numbers separated by commas or
+ * spaces. An empty list monitors ptpengine:domain only. Returns FALSE on
+ * a malformed list.
+ */
+Boolean
+monitorParseDomains(RunTimeOpts *rtOpts)
+{
+
+	char text[PATH_MAX];
+	char *token, *end, *save = NULL;
+	long domainNumber;
+
+	memset(rtOpts->monitorDomains, 0, sizeof(rtOpts->monitorDomains));
+	strncpy(text, rtOpts->monitorDomainsText, sizeof(text) - 1);
+	text[sizeof(text) - 1] = '\0';
+
+	for (token = strtok_r(text, ", \t", &save); token != NULL;
+	     token = strtok_r(NULL, ", \t", &save)) {
+		domainNumber = strtol(token, &end, 10);
+		if (*end != '\0' || domainNumber < 0 || domainNumber > 255)
+			return FALSE;
+		rtOpts->monitorDomains[domainNumber >> 3] |= 1 << (domainNumber & 7);
+	}
+
+	if (!strlen(rtOpts->monitorDomainsText))
+		rtOpts->monitorDomains[rtOpts->domainNumber >> 3] |=
+			1 << (rtOpts->domainNumber & 7);
+
+	return TRUE;
+
+}
+
+/* drop the masters that have stopped announcing - at most once a second */
+static void
+monitorExpire(const RunTimeOpts *rtOpts, PtpClock *ptpClock, double now)
+{
+
+	static double lastExpiry = 0;
+	int i;
+	char buf[64];
+
+	if (now - lastExpiry < 1)
+		return;
+	lastExpiry = now;
+
+	for (i = 0; i < ptpClock->monitorCapacity; i++) {
+		MonitorMaster *master = &ptpClock->monitor[i];
+		if (!master->inUse || now - master->lastSeen <= rtOpts->monitorTimeout)
+			continue;
+		snprint_PortIdentity(buf, sizeof(buf), &master->portIdentity);
+		NOTICE("Monitor: master %s in domain %d is gone\n", buf, master->domainNumber);
+		master->inUse = FALSE;
+	}
+
+}
+
+static MonitorMaster *
+monitorFind(PtpClock *ptpClock, UInteger8 domainNumber, const PortIdentity *portIdentity)
+{
+
+	int i;
+
+	for (i = 0; i < ptpClock->monitorCapacity; i++) {
+		MonitorMaster *master = &ptpClock->monitor[i];
+		if (master->inUse && master->domainNumber == domainNumber &&
+		    master->portIdentity.portNumber == portIdentity->portNumber &&
+		    !memcmp(master->portIdentity.clockIdentity, portIdentity->clockIdentity,
+			    CLOCK_IDENTITY_LENGTH))
+			return master;
+	}
+
+	return NULL;
+
+}
+
+/* a new master is only tracked once it announces */
+static MonitorMaster *
+monitorAdd(PtpClock *ptpClock, UInteger8 domainNumber, const PortIdentity *portIdentity, double now)
+{
+
+	static Boolean warned = FALSE;
+	int i;
+	char buf[64];
+
+	for (i = 0; i < ptpClock->monitorCapacity; i++) {
+		MonitorMaster *master = &ptpClock->monitor[i];
+		if (master->inUse)
+			continue;
+		memset(master, 0, sizeof(MonitorMaster));
+		master->inUse = TRUE;
+		master->domainNumber = domainNumber;
+		master->portIdentity = *portIdentity;
+		master->firstSeen = now;
+		snprint_PortIdentity(buf, sizeof(buf), portIdentity);
+		NOTICE("Monitor: new master %s in domain %d\n", buf, domainNumber);
+		return master;
+	}
+
+	if (!warned) {
+		WARNING("Monitor: table full (%d masters) - increase ptpengine:monitor_capacity\n",
+			ptpClock->monitorCapacity);
+		warned = TRUE;
+	}
+
+	return NULL;
+
+}
+
+/* best announcing master of a domain */
+static MonitorMaster *
+monitorReference(const RunTimeOpts *rtOpts, PtpClock *ptpClock, UInteger8 domainNumber)
+{
+
+	MonitorMaster *best = NULL;
+	int i;
+
+	for (i = 0; i < ptpClock->monitorCapacity; i++) {
+		MonitorMaster *master = &ptpClock->monitor[i];
+		if (!master->inUse || !master->sampleCount ||
+		    master->domainNumber != domainNumber)
+			continue;
+		if (best == NULL ||
+		    bmcDataSetComparison(&master->announceHeader, &master->announce,
+					 &best->announceHeader, &best->announce,
+					 ptpClock, rtOpts) < 0)
+			best = master;
+	}
+
+	return best;
+
+}
+
+/* one line per sample to the statistics log, at most every statistics_log_interval */
+static void
+monitorLog(RunTimeOpts *rtOpts, PtpClock *ptpClock, MonitorMaster *master, double now)
+{
+
+	FILE *destination;
+	TimeInternal time;
+	time_t time_s;
+	char time_str[MAXTIMESTR];
+	char port[64], gm[64];
+
+	if (!rtOpts->logStatistics)
+		return;
+
+	if (rtOpts->statisticsLogInterval &&
+	    now - master->lastLogged < rtOpts->statisticsLogInterval)
+		return;
+	master->lastLogged = now;
+
+	if (rtOpts->statisticsLog.logEnabled && rtOpts->statisticsLog.logFP != NULL)
+		destination = rtOpts->statisticsLog.logFP;
+	else
+		destination = stdout;
+
+	if (ptpClock->resetStatisticsLog) {
+		ptpClock->resetStatisticsLog = FALSE;
+		fprintf(destination, "# Timestamp, Domain, Port ID, GM ID, Clock Class, "
+			"Offset, Offset Mean, Offset Std Dev, Offset Min, Offset Max, "
+			"Relative Offset, Syncs, Sequence Errors\n");
+	}
+
+	getTime(&time);
+	time_s = time.seconds;
+	strftime(time_str, MAXTIMESTR, "%Y-%m-%d %X", localtime(&time_s));
+	snprint_PortIdentity(port, sizeof(port), &master->portIdentity);
+	snprint_ClockIdentity(gm, sizeof(gm), master->announce.grandmasterIdentity);
+
+	fprintf(destination, "%s.%06d, %d, %s, %s, %d, %.0f, %.0f, %.0f, %.0f, %.0f, %.0f, %u, %u\n",
+		time_str, (int)time.nanoseconds / 1000, master->domainNumber, port, gm,
+		master->announce.grandmasterClockQuality.clockClass,
+		master->offset, master->mean, master->stdDev, master->min, master->max,
+		master->relativeOffset, master->syncCount, master->sequenceErrors);
+
+	if (destination == rtOpts->statisticsLog.logFP) {
+		if (maintainLogSize(&rtOpts->statisticsLog))
+			ptpClock->resetStatisticsLog = TRUE;
+	}
+
+}
+
+/* offset of one Sync against the local clock */
+static void
+monitorSample(RunTimeOpts *rtOpts, PtpClock *ptpClock, MonitorMaster *master,
+	      const TimeInternal *send_time, const TimeInternal *recv_time,
+	      TimeScaled correctionField, double now)
+{
+
+	TimeInternal localTime = *recv_time;
+	TimeInternal offset;
+	MonitorMaster *reference;
+	double mean = 0, m2 = 0, delta, sample;
+	int i;
+
+	/* timescale of the master - same rule as respectUtcOffset() */
+	if (rtOpts->alwaysRespectUtcOffset ||
+	    IS_SET(master->announceHeader.flagField1, UTCV))
+		localTime.seconds += master->announce.currentUtcOffset;
+
+	/* in TimeInternal: a monitored master may be any distance away */
+	subTime(&offset, &localTime, send_time);
+	master->offset = offset.seconds * 1E9 + offset.nanoseconds -
+		(double)correctionField / TIME_SCALED_NS;
+
+	master->samples[master->sampleHead] = master->offset;
+	master->sampleHead = (master->sampleHead + 1) % MONITOR_WINDOW;
+	if (master->sampleCount < MONITOR_WINDOW)
+		master->sampleCount++;
+
+	/*
+	 * Welford's update: the offsets are absolute and can be seconds or
+	 * years (another timescale) large, their squares would swamp the
+	 * nanosecond variation in a double
+	 */
+	master->min = master->max = master->offset;
+	for (i = 0; i < master->sampleCount; i++) {
+		sample = master->samples[i];
+		delta = sample - mean;
+		mean += delta / (i + 1);
+		m2 += delta * (sample - mean);
+		if (sample < master->min)
+			master->min = sample;
+		if (sample > master->max)
+			master->max = sample;
+	}
+	master->mean = mean;
+	master->stdDev = (master->sampleCount > 1) ?
+		sqrt(m2 / (master->sampleCount - 1)) : 0;
+
+	reference = monitorReference(rtOpts, ptpClock, master->domainNumber);
+	master->isReference = (reference == master);
+	master->relativeOffset = (reference != NULL) ? master->mean - reference->mean : 0;
+
+	DBGV("Monitor: domain %d offset %.0f ns mean %.0f std dev %.0f relative %.0f\n",
+	     master->domainNumber, master->offset, master->mean, master->stdDev,
+	     master->relativeOffset);
+
+	monitorLog(rtOpts, ptpClock, master, now);
+	ctlSocketMonitorSample(ptpClock, master);
+
+}
+
+/*
+ * Handle a message in monitor mode: called from processMessage() for
+ * every timing message from a monitored domain, instead of the protocol
+ * engine.
+ */
+void
+monitorMessage(RunTimeOpts *rtOpts, PtpClock *ptpClock, TimeInternal *timeStamp, ssize_t length)
+{
+
+	MsgHeader *header = &ptpClock->msgTmpHeader;
+	MonitorMaster *master;
+	TimeInternal originTimestamp;
+	double now = monitorNow();
+
+	monitorExpire(rtOpts, ptpClock, now);
+
+	msgUnpackHeader(ptpClock->msgIbuf, header);
+
+	master = monitorFind(ptpClock, header->domainNumber, &header->sourcePortIdentity);
+
+	switch (header->messageType) {
+
+	case ANNOUNCE:
+		if (length < ANNOUNCE_LENGTH) {
+			ptpClock->counters.messageFormatErrors++;
+			return;
+		}
+		if (master == NULL &&
+		    (master = monitorAdd(ptpClock, header->domainNumber,
+					 &header->sourcePortIdentity, now)) == NULL)
+			return;
+		msgUnpackAnnounce(ptpClock->msgIbuf, &master->announce);
+		master->announceHeader = *header;
+		master->announceCount++;
+		master->lastSeen = now;
+		ptpClock->counters.announceMessagesReceived++;
+		return;
+
+	case SYNC:
+		if (length < SYNC_LENGTH) {
+			ptpClock->counters.messageFormatErrors++;
+			return;
+		}
+		if (master == NULL || timeStamp->seconds <= 0)
+			return;
+		ptpClock->counters.syncMessagesReceived++;
+		master->syncCount++;
+		if (master->haveSync &&
+		    header->sequenceId != (UInteger16)(master->lastSyncSequenceId + 1))
+			master->sequenceErrors++;
+		master->haveSync = TRUE;
+		master->lastSyncSequenceId = header->sequenceId;
+		master->logSyncInterval = header->logMessageInterval;
+
+		subTime(timeStamp, timeStamp, &rtOpts->inboundLatency);
+
+		if ((header->flagField0 & PTP_TWO_STEP) == PTP_TWO_STEP) {
+			master->waitingForFollow = TRUE;
+			master->syncSequenceId = header->sequenceId;
+			master->syncReceiveTime = *timeStamp;
+			master->syncCorrectionField = integer64_to_scaled(&header->correctionField);
+			return;
+		}
+
+		master->waitingForFollow = FALSE;
+		msgUnpackSync(ptpClock->msgIbuf, &ptpClock->msgTmp.sync);
+		toInternalTime(&originTimestamp, &ptpClock->msgTmp.sync.originTimestamp);
+		monitorSample(rtOpts, ptpClock, master, &originTimestamp, timeStamp,
+			      integer64_to_scaled(&header->correctionField), now);
+		return;
+
+	case FOLLOW_UP:
+		if (length < FOLLOW_UP_LENGTH) {
+			ptpClock->counters.messageFormatErrors++;
+			return;
+		}
+		if (master == NULL || !master->waitingForFollow ||
+		    master->syncSequenceId != header->sequenceId)
+			return;
+		ptpClock->counters.followUpMessagesReceived++;
+		master->followUpCount++;
+		master->waitingForFollow = FALSE;
+		msgUnpackFollowUp(ptpClock->msgIbuf, &ptpClock->msgTmp.follow);
+		toInternalTime(&originTimestamp, &ptpClock->msgTmp.follow.preciseOriginTimestamp);
+		monitorSample(rtOpts, ptpClock, master, &originTimestamp, &master->syncReceiveTime,
+			      integer64_to_scaled(&header->correctionField) +
+			      master->syncCorrectionField, now);
+		return;
+
+	default:
+		/* the monitor only listens to masters */
+		ptpClock->counters.discardedMessages++;
+		return;
+
+	}
+
+}
+
+/* monitored masters in the status file */
+void
+monitorStatus(const PtpClock *ptpClock, FILE *out)
+{
+
+	int i, count = 0;
+	char port[64], label[32];
+
+	for (i = 0; i < ptpClock->monitorCapacity; i++)
+		if (ptpClock->monitor[i].inUse)
+			count++;
+
+	fprintf(out, "%-19s:  %d (capacity %d)\n", "Monitored masters", count,
+		ptpClock->monitorCapacity);
+
+	for (i = 0; i < ptpClock->monitorCapacity; i++) {
+		const MonitorMaster *master = &ptpClock->monitor[i];
+		if (!master->inUse)
+			continue;
+		snprint_PortIdentity(port, sizeof(port), &master->portIdentity);
+		snprintf(label, sizeof(label), "  Domain %d", master->domainNumber);
+		fprintf(out, "%-19s:  %s, class %d", label, port,
+			master->announce.grandmasterClockQuality.clockClass);
+		if (master->sampleCount)
+			fprintf(out, ", offset %.0f ns, mean %.0f ns, std dev %.0f ns, %s %.0f ns",
+				master->offset, master->mean, master->stdDev,
+				master->isReference ? "reference" : "relative",
+				master->relativeOffset);
+		else
+			fprintf(out, ", no Syncs");
+		if (master->sequenceErrors)
+			fprintf(out, ", %u sequence errors", master->sequenceErrors);
+		fprintf(out, "\n");
+	}
+
+}
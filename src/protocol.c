@@ -65,7 +65,8 @@ void handleDelayReq(const MsgHeader*, ssize_t, const TimeInternal*,Boolean,RunTi
 static void handlePDelayResp(const MsgHeader*, TimeInternal* ,ssize_t,Boolean,RunTimeOpts*,PtpClock*);
 static void handleDelayResp(const MsgHeader*, ssize_t, RunTimeOpts*,PtpClock*);
 static void handlePDelayRespFollowUp(const MsgHeader*, ssize_t, Boolean, RunTimeOpts*,PtpClock*);
-static void handleManagement(MsgHeader*, Boolean,RunTimeOpts*,PtpClock*);
+static void handleManagement(MsgHeader*, ssize_t,Boolean,RunTimeOpts*,PtpClock*);
+static void handleManagementTLV(Octet*,RunTimeOpts*,PtpClock*);
 static void handleSignaling(PtpClock*);
 static void updateDatasets(PtpClock* ptpClock, RunTimeOpts* rtOpts);
 
@@ -80,9 +81,18 @@ static void issuePDelayRespFollowUp(const TimeInternal*,MsgHeader*,RunTimeOpts*,
 #if 0
 static void issueManagement(MsgHeader*,MsgManagement*,RunTimeOpts*,PtpClock*);
 #endif
-static void issueManagementRespOrAck(MsgManagement*,RunTimeOpts*,PtpClock*);
-static void issueManagementErrorStatus(MsgManagement*,RunTimeOpts*,PtpClock*);
+static void issueManagementResponse(MsgManagement*,UInteger16,RunTimeOpts*,PtpClock*);
 static void processMessage(RunTimeOpts* rtOpts, PtpClock* ptpClock, TimeInternal* timeStamp, ssize_t length);
+static Boolean rxAccept(RunTimeOpts* rtOpts, PtpClock* ptpClock, PtpClock* instance, ssize_t length);
+static void rxQueuePush(RunTimeOpts* rtOpts, PtpClock* ptpClock, TimeInternal* timeStamp, ssize_t length);
+static Boolean rxQueueRoom(PtpClock* ptpClock, int class);
+static void rxQueueDispatch(RunTimeOpts* rtOpts, PtpClock* ptpClock);
+static void rxQueueFlush(PtpClock* ptpClock);
+static Boolean rxQueuePending(PtpClock* ptpClock);
+static void doPorts(PtpClock* ptpClock);
+static void doDomains(PtpClock* ptpClock);
+static void applyPortConfig(RunTimeOpts* rtOpts, PtpClock* ptpClock);
+static void applyDomainConfig(RunTimeOpts* rtOpts, PtpClock* ptpClock);
 static void processSyncFromSelf(const TimeInternal * tint, RunTimeOpts * rtOpts, PtpClock * ptpClock, const UInteger16 sequenceId);
 static void processDelayReqFromSelf(const TimeInternal * tint, RunTimeOpts * rtOpts, PtpClock * ptpClock);
 static void processPDelayReqFromSelf(const TimeInternal * tint, RunTimeOpts * rtOpts, PtpClock * ptpClock);
@@ -97,9 +107,21 @@ void addForeign(Octet*,MsgHeader*,PtpClock*);
 void 
 protocol(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 {
+	int i;
+
 	DBG("event POWERUP\n");
 
 	toState(PTP_INITIALIZING, rtOpts, ptpClock);
+	/* the other ports of a boundary clock power up with port 1 */
+	if (ptpClock->boundaryClock != NULL)
+		for (i = 1; i < ptpClock->boundaryClock->numberPorts; i++)
+			toState(PTP_INITIALIZING, ptpClock->boundaryClock->portOpts[i],
+				ptpClock->boundaryClock->ports[i]);
+	/* so do the other domains */
+	if (ptpClock->domainInstances != NULL)
+		for (i = 1; i < ptpClock->domainInstances->count; i++)
+			toState(PTP_INITIALIZING, ptpClock->domainInstances->instanceOpts[i],
+				ptpClock->domainInstances->instances[i]);
 	if(rtOpts->statusLog.logEnabled)
 		writeStatusFile(ptpClock, rtOpts, TRUE);
 
@@ -136,6 +158,7 @@ protocol(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 #endif /* PTPD_NTPDC */
 
 	timerStart(STATUSFILE_UPDATE_TIMER,rtOpts->statusFileUpdateInterval,ptpClock->itimer);
+	timerStart(SNAPSHOT_TIMER,rtOpts->snapshotInterval,ptpClock->itimer);
 
 	DBG("Debug Initializing...\n");
 
@@ -154,6 +177,13 @@ protocol(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 			doState(rtOpts, ptpClock);
 		}
 
+		/* port 1 has waited for all ports - now service the others */
+		if (ptpClock->boundaryClock != NULL)
+			doPorts(ptpClock);
+		/* and the other domains, with what it received for them */
+		if (ptpClock->domainInstances != NULL)
+			doDomains(ptpClock);
+
 		if (ptpClock->message_activity)
 			DBGV("activity\n");
 
@@ -173,9 +203,22 @@ protocol(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 			    /* Those two parameters have to be passed to ptpClock before re-init */
 			    ptpClock->clockQuality.clockClass = rtOpts->clockQuality.clockClass;
 			    ptpClock->slaveOnly = rtOpts->slaveOnly;
+			    datasetChanged(ptpClock, MGMT_CACHE_DEFAULT_DS);
 
 			    toState(PTP_INITIALIZING, rtOpts, ptpClock);
 		    } else {
+		    /* Addressing changed only: new sockets under the running port */
+		    if(rtOpts->restartSubsystems & PTPD_RESTART_SOCKETS) {
+				NOTIFY("Applying network configuration: re-opening sockets, port state kept\n");
+				netShutdown(&ptpClock->netPath);
+				/* anything still queued arrived on the old sockets */
+				rxQueueFlush(ptpClock);
+				ptpClock->txTemplatesValid = FALSE;
+				if (!netInit(&ptpClock->netPath, rtOpts, ptpClock)) {
+					ERROR("failed to re-initialize network\n");
+					toState(PTP_FAULTY, rtOpts, ptpClock);
+				}
+		    }
 		    /* Nothing happens here for now - SIGHUP handler does this anyway */
 		    if(rtOpts->restartSubsystems & PTPD_UPDATE_DATASETS) {
 				NOTIFY("Applying PTP engine configuration: updating datasets\n");
@@ -202,6 +245,60 @@ protocol(RunTimeOpts *rtOpts, PtpClock *ptpClock)
     		}
 
 
+		if(rtOpts->restartSubsystems & PTPD_RESTART_RATELIMIT) {
+			freeRateLimiter(&ptpClock->netPath.rateLimiter);
+			if(rtOpts->rateLimitEnabled) {
+				NOTIFY("Applying rate limiter configuration: re-creating source table\n");
+				ptpClock->netPath.rateLimiter=createRateLimiter(rtOpts->rateLimitSources,
+				    rtOpts->rateLimitRates);
+			} else {
+				NOTIFY("Applying rate limiter configuration: rate limiting disabled\n");
+			}
+		}
+
+		if(rtOpts->restartSubsystems & PTPD_RESTART_NTPSHM) {
+			ntpShmShutdown(&ptpClock->ntpShm);
+			if(rtOpts->ntpShmEnabled) {
+				NOTIFY("Applying NTP SHM output configuration: re-attaching segment\n");
+				if(!ntpShmInit(rtOpts, &ptpClock->ntpShm))
+					ERROR("Could not attach to NTP SHM segment - offsets will not be posted\n");
+			} else {
+				NOTIFY("Applying NTP SHM output configuration: measurement-only mode disabled\n");
+			}
+		}
+
+		if(rtOpts->restartSubsystems & PTPD_RESTART_NTPSERVER) {
+			ntpServerShutdown(&ptpClock->ntpServer);
+			if(rtOpts->ntpServerEnabled) {
+				NOTIFY("Applying NTP server configuration: re-opening server socket\n");
+				if(!ntpServerInit(rtOpts, &ptpClock->ntpServer))
+					ERROR("Could not start NTP server\n");
+			} else {
+				NOTIFY("Applying NTP server configuration: NTP server disabled\n");
+			}
+		}
+
+		if(rtOpts->restartSubsystems & PTPD_RESTART_CLOCKPAGE) {
+			clockPageShutdown(rtOpts, ptpClock);
+			if(rtOpts->clockPageEnabled) {
+				NOTIFY("Applying clock page configuration: re-creating clock page\n");
+				clockPageInit(rtOpts, ptpClock);
+			} else {
+				NOTIFY("Applying clock page configuration: clock page disabled\n");
+			}
+		}
+
+		if(rtOpts->restartSubsystems & PTPD_RESTART_CTLSOCKET) {
+			ctlSocketShutdown(&ptpClock->ctlSocket);
+			if(rtOpts->controlSocketEnabled) {
+				NOTIFY("Applying control socket configuration: re-creating control socket\n");
+				if(!ctlSocketInit(rtOpts, &ptpClock->ctlSocket))
+					ERROR("Could not create control socket\n");
+			} else {
+				NOTIFY("Applying control socket configuration: control socket disabled\n");
+			}
+		}
+
 #ifdef PTPD_STATISTICS
                     /* Reinitialising the outlier filter containers */
                     if(rtOpts->restartSubsystems & PTPD_RESTART_PEIRCE) {
@@ -299,6 +396,10 @@ protocol(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 
 		    /* Update PI servo parameters */
 		    setupPIservo(&ptpClock->servo, rtOpts);
+		    /* the other ports of a boundary clock follow */
+		    applyPortConfig(rtOpts, ptpClock);
+		    /* and so do the other domains */
+		    applyDomainConfig(rtOpts, ptpClock);
 		    /* Config changes don't require subsystem restarts - acknowledge it */
 		    if(rtOpts->restartSubsystems == PTPD_RESTART_NONE) {
 				NOTIFY("Applying configuration\n");
@@ -314,10 +415,151 @@ protocol(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 }
 
 
+/*
+ * Run the ports of a boundary clock other than port 1, once per pass of
+ * the main loop. They never block: their sockets are in port 1's select
+ * set. Log messages are tagged with the port being run.
+ */
+static void
+doPorts(PtpClock *ptpClock)
+{
+	extern PtpClock *G_ptpClock;
+	BoundaryClock *bc = ptpClock->boundaryClock;
+	PtpClock *port;
+	int i;
+
+	for (i = 1; i < bc->numberPorts; i++) {
+		port = bc->ports[i];
+		G_ptpClock = port;
+		if (port->portState == PTP_INITIALIZING)
+			doInit(bc->portOpts[i], port);
+		else
+			doState(bc->portOpts[i], port);
+	}
+
+	G_ptpClock = ptpClock;
+}
+
+/*
+ * Run the instances for the other domains, once per pass of the main
+ * loop, on the sockets of the ptpengine:domain instance - which may have
+ * just reopened them.
+ */
+static void
+doDomains(PtpClock *ptpClock)
+{
+	extern PtpClock *G_ptpClock;
+	DomainInstances *domains = ptpClock->domainInstances;
+	PtpClock *instance;
+	int i;
+
+	for (i = 1; i < domains->count; i++) {
+		instance = domains->instances[i];
+		G_ptpClock = instance;
+		netShare(&instance->netPath, &ptpClock->netPath);
+		if (instance->portState == PTP_INITIALIZING)
+			doInit(domains->instanceOpts[i], instance);
+		else
+			doState(domains->instanceOpts[i], instance);
+	}
+
+	G_ptpClock = ptpClock;
+}
+
+/* apply a reloaded configuration to the instances for the other domains */
+static void
+applyDomainConfig(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+	extern PtpClock *G_ptpClock;
+	DomainInstances *domains = ptpClock->domainInstances;
+	RunTimeOpts *instanceOpts;
+	PtpClock *instance;
+	int i;
+
+	if (domains == NULL)
+		return;
+
+	domainUpdateOptions(rtOpts, ptpClock);
+
+	for (i = 1; i < domains->count; i++) {
+		instance = domains->instances[i];
+		instanceOpts = domains->instanceOpts[i];
+		G_ptpClock = instance;
+
+		if ((rtOpts->restartSubsystems & PTPD_RESTART_PROTOCOL) ||
+		    (rtOpts->restartSubsystems & PTPD_RESTART_NETWORK)) {
+			instance->clockQuality.clockClass = instanceOpts->clockQuality.clockClass;
+			instance->slaveOnly = instanceOpts->slaveOnly;
+			toState(PTP_INITIALIZING, instanceOpts, instance);
+			continue;
+		}
+
+		if (rtOpts->restartSubsystems & PTPD_UPDATE_DATASETS)
+			updateDatasets(instance, instanceOpts);
+
+		setupPIservo(&instance->servo, instanceOpts);
+	}
+
+	G_ptpClock = ptpClock;
+}
+
+/* apply a reloaded configuration to the other ports of a boundary clock */
+static void
+applyPortConfig(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+	extern PtpClock *G_ptpClock;
+	BoundaryClock *bc = ptpClock->boundaryClock;
+	RunTimeOpts *portOpts;
+	PtpClock *port;
+	int i;
+
+	if (bc == NULL)
+		return;
+
+	bcUpdateOptions(rtOpts, ptpClock);
+
+	for (i = 1; i < bc->numberPorts; i++) {
+		port = bc->ports[i];
+		portOpts = bc->portOpts[i];
+		G_ptpClock = port;
+
+		if ((rtOpts->restartSubsystems & PTPD_RESTART_PROTOCOL) ||
+		    (rtOpts->restartSubsystems & PTPD_RESTART_NETWORK)) {
+			port->clockQuality.clockClass = portOpts->clockQuality.clockClass;
+			port->slaveOnly = portOpts->slaveOnly;
+			datasetChanged(port, MGMT_CACHE_DEFAULT_DS);
+			toState(PTP_INITIALIZING, portOpts, port);
+			continue;
+		}
+
+		/* access lists and the rate limiter are rebuilt with the sockets */
+		if (port->portState != PTP_INITIALIZING &&
+		    (rtOpts->restartSubsystems & (PTPD_RESTART_SOCKETS |
+		     PTPD_RESTART_ACLS | PTPD_RESTART_RATELIMIT))) {
+			netShutdown(&port->netPath);
+			rxQueueFlush(port);
+			port->txTemplatesValid = FALSE;
+			if (!netInit(&port->netPath, portOpts, port)) {
+				ERROR("failed to re-initialize network\n");
+				toState(PTP_FAULTY, portOpts, port);
+			}
+		}
+
+		if (rtOpts->restartSubsystems & PTPD_UPDATE_DATASETS)
+			updateDatasets(port, portOpts);
+
+		setupPIservo(&port->servo, portOpts);
+	}
+
+	G_ptpClock = ptpClock;
+}
+
 /* perform actions required when leaving 'port_state' and entering 'state' */
 void 
 toState(UInteger8 state, RunTimeOpts *rtOpts, PtpClock *ptpClock)
 {
+	UInteger8 previousState = ptpClock->portState;
+
 	ptpClock->message_activity = TRUE;
 	
 	/* leaving state tasks */
@@ -337,11 +579,14 @@ toState(UInteger8 state, RunTimeOpts *rtOpts, PtpClock *ptpClock)
 			timerStop(DELAYREQ_INTERVAL_TIMER, ptpClock->itimer);
 		else if (ptpClock->delayMechanism == P2P)
 			timerStop(PDELAYREQ_INTERVAL_TIMER, ptpClock->itimer);
+		/* redundant slave: another path carries on with the clock */
+		bcPathFailover(ptpClock);
 /* If statistics are enabled, drift should have been saved already - otherwise save it*/
 #ifndef PTPD_STATISTICS
 #ifdef HAVE_SYS_TIMEX_H
 		/* save observed drift value, don't inform user */
-		saveDrift(ptpClock, rtOpts, TRUE);
+		if (!bcClockTaken(ptpClock))
+			saveDrift(ptpClock, rtOpts, TRUE);
 #endif /* HAVE_SYS_TIMEX_H */
 #endif /* PTPD_STATISTICS */
 
@@ -353,6 +598,9 @@ toState(UInteger8 state, RunTimeOpts *rtOpts, PtpClock *ptpClock)
 		ptpClock->panicOver = FALSE;
 		timerStop(PANIC_MODE_TIMER, ptpClock->itimer);
 		initClock(rtOpts, ptpClock); 
+		/* GM lost - steer the clock along the oscillator model, unless another port has it */
+		if((state == PTP_LISTENING || state == PTP_MASTER) && !bcClockTaken(ptpClock))
+			holdoverStart(rtOpts, ptpClock);
 		break;
 		
 	case PTP_PASSIVE:
@@ -371,6 +619,8 @@ toState(UInteger8 state, RunTimeOpts *rtOpts, PtpClock *ptpClock)
 	/* entering state tasks */
 
 	ptpClock->counters.stateTransitions++;
+	/* portState, and in LISTENING the DelayReq interval */
+	datasetChanged(ptpClock, MGMT_CACHE_PORT_DS);
 
 	DBG("state %s\n",portState_getName(state));
 
@@ -397,10 +647,14 @@ toState(UInteger8 state, RunTimeOpts *rtOpts, PtpClock *ptpClock)
 	switch (state)
 	{
 	case PTP_INITIALIZING:
+		holdoverStop(rtOpts, ptpClock, FALSE);
 		ptpClock->portState = PTP_INITIALIZING;
 		break;
 		
 	case PTP_FAULTY:
+		holdoverStop(rtOpts, ptpClock, FALSE);
+		if (ptpClock->portIndex > 0 || ptpClock->domainIndex > 0)
+			timerStart(PORT_FAULT_TIMER, BC_FAULT_RETRY_INTERVAL, ptpClock->itimer);
 		ptpClock->portState = PTP_FAULTY;
 		break;
 		
@@ -541,6 +795,8 @@ if(!rtOpts->panicModeNtp || !ptpClock->panicMode)
 #endif /* PTPD_NTPDC */
 
 		initClock(rtOpts, ptpClock);
+		/* boundary clock: another port had the clock - carry on from its frequency */
+		if (!bcTakeClock(rtOpts, ptpClock)) {
 #ifdef HAVE_SYS_TIMEX_H
 		/*
 		 * restore the observed drift value using the selected method,
@@ -548,6 +804,9 @@ if(!rtOpts->panicModeNtp || !ptpClock->panicMode)
 		 */
 		restoreDrift(ptpClock, rtOpts, TRUE);
 #endif /* HAVE_SYS_TIMEX_H */
+		/* back from holdover: the servo starts from the holdover frequency */
+		holdoverStop(rtOpts, ptpClock, TRUE);
+		}
 
 		ptpClock->waitingForFollow = FALSE;
 		ptpClock->waitingForDelayResp = FALSE;
@@ -602,6 +861,10 @@ if(!rtOpts->panicModeNtp || !ptpClock->panicMode)
 		timerStart(STATISTICS_UPDATE_TIMER, rtOpts->statsUpdateInterval, ptpClock->itimer);
 #endif /* PTPD_STATISTICS */
 
+		/* resume from the state snapshot if it was taken with this master */
+		if(rtOpts->snapshotEnabled)
+			snapshotApply(rtOpts, ptpClock);
+
 #ifdef HAVE_SYS_TIMEX_H
 
 		/* 
@@ -627,6 +890,14 @@ if(!rtOpts->panicModeNtp || !ptpClock->panicMode)
 
 	if (rtOpts->logStatistics)
 		logStatistics(rtOpts, ptpClock);
+
+	/* publish the new lock state - offset and reference stay as they were */
+	clockPageUpdate(rtOpts, ptpClock, FALSE);
+	ctlSocketStateChange(ptpClock, previousState);
+
+	/* the other ports of a boundary clock decide again */
+	if (ptpClock->portState != previousState)
+		bcStateChange(ptpClock);
 }
 
 
@@ -638,9 +909,15 @@ doInit(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 		MANUFACTURER_ID_OUI0,
 		MANUFACTURER_ID_OUI1,
 		MANUFACTURER_ID_OUI2);
-	/* initialize networking */
-	netShutdown(&ptpClock->netPath);
-	if (!netInit(&ptpClock->netPath, rtOpts, ptpClock)) {
+	/* initialize networking - the other domains only borrow the sockets */
+	if (ptpClock->domainIndex == 0)
+		netShutdown(&ptpClock->netPath);
+	/* anything still queued arrived on the old sockets */
+	rxQueueFlush(ptpClock);
+	/* datasets are about to be re-initialised */
+	ptpClock->txTemplatesValid = FALSE;
+	if (ptpClock->domainIndex == 0 &&
+	    !netInit(&ptpClock->netPath, rtOpts, ptpClock)) {
 		ERROR("failed to initialize network\n");
 		toState(PTP_FAULTY, rtOpts, ptpClock);
 		return FALSE;
@@ -665,12 +942,14 @@ doInit(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 
 	/* initialize other stuff */
 	initData(rtOpts, ptpClock);
-	initTimer();
+	/* the tick counter is shared by all ports and domain instances */
+	if (ptpClock->portIndex == 0 && ptpClock->domainIndex == 0)
+		initTimer();
 	initClock(rtOpts, ptpClock);
 	setupPIservo(&ptpClock->servo, rtOpts);
 #ifdef HAVE_SYS_TIMEX_H
 	/* restore observed drift and inform user */
-	if(ptpClock->clockQuality.clockClass > 127)
+	if(ptpClock->clockQuality.clockClass > 127 && !bcClockTaken(ptpClock))
 		restoreDrift(ptpClock, rtOpts, FALSE);
 #endif /* HAVE_SYS_TIMEX_H */
 	m1(rtOpts, ptpClock );
@@ -715,6 +994,7 @@ doState(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 			state = bmc(ptpClock->foreign, rtOpts, ptpClock);
 			if(state != ptpClock->portState)
 				toState(state, rtOpts, ptpClock);
+			standbySelect(rtOpts, ptpClock);
 		}
 		break;
 		
@@ -722,10 +1002,18 @@ doState(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 		break;
 	}
 	
+	/* follow domain / parent changes before receiving anything */
+	if (ptpClock->portState != PTP_FAULTY)
+		netUpdateFilters(&ptpClock->netPath, rtOpts, ptpClock);
 	
 	switch (ptpClock->portState)
 	{
 	case PTP_FAULTY:
+		/* a boundary clock port or domain instance retries later - the others carry on */
+		if ((ptpClock->portIndex > 0 || ptpClock->domainIndex > 0) &&
+		    !timerExpired(PORT_FAULT_TIMER, ptpClock->itimer))
+			return;
+		timerStop(PORT_FAULT_TIMER, ptpClock->itimer);
 		/* imaginary troubleshooting */
 		DBG("event FAULT_CLEARED\n");
 		toState(PTP_INITIALIZING, rtOpts, ptpClock);
@@ -773,6 +1061,7 @@ doState(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 					ptpClock->grandmasterClockQuality.clockClass = 255;
 					ptpClock->grandmasterPriority1 = 255;
 					ptpClock->grandmasterPriority2 = 255;
+					datasetChanged(ptpClock, MGMT_CACHE_PARENT_DS);
 					ptpClock->foreign[ptpClock->foreign_record_best].announce.grandmasterPriority1=255;
 					ptpClock->foreign[ptpClock->foreign_record_best].announce.grandmasterPriority2=255;
 					ptpClock->foreign[ptpClock->foreign_record_best].announce.grandmasterClockQuality.clockClass=255;
@@ -804,6 +1093,12 @@ doState(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 				 *  Force a reset when getting a timeout in state listening, that will lead to an IGMP reset
 				 *  previously this was not the case when we were already in LISTENING mode
 				 */
+				if (rtOpts->monitorMode) {
+					/* the monitor never gets Announces here - just keep the memberships fresh */
+					if (rtOpts->ip_mode != IPMODE_UNICAST && rtOpts->do_IGMP_refresh &&
+					    rtOpts->transport != IEEE_802_3)
+						netRefreshIGMP(&ptpClock->netPath, rtOpts, ptpClock);
+				} else
 				    toState(PTP_LISTENING, rtOpts, ptpClock);
                                 }
                 }
@@ -817,10 +1112,8 @@ doState(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 				ptpClock->ntpControl.requestFailed = FALSE;
 				ptpClock->ntpControl.isRequired = TRUE;
 				ptpClock->ntpControl.isFailOver = TRUE;
-				if(ntpdControl(&rtOpts->ntpOptions, &ptpClock->ntpControl, FALSE)) {
-					/* successfully failed over to NTP - stop failover timer */
-					timerStop(NTPD_FAILOVER_TIMER, ptpClock->itimer);
-				} else {
+				/* the NTP engine stops the failover timer once NTPd is in control */
+				if(!ntpdControl(&rtOpts->ntpOptions, &ptpClock->ntpControl, FALSE)) {
 					DBG("Could not check / request NTP failover\n");
 				}
 				/* (re)start the NTP check timer, so that you don't check just after a failover attempt */
@@ -970,6 +1263,10 @@ doState(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 			/* Explicitly restart NTP check timer with the current interval value */
 			timerStart(NTPD_CHECK_TIMER,rtOpts->ntpOptions.checkInterval,ptpClock->itimer);
 		}
+		/* NTPd did not answer the last request in time */
+		if(timerExpired(NTPD_REPLY_TIMER,ptpClock->itimer)) {
+			ntpdControlTimeout(&rtOpts->ntpOptions, &ptpClock->ntpControl);
+		}
 #endif /* PTPD_NTPDC */
 
         if(rtOpts->statusLog.logEnabled && timerExpired(STATUSFILE_UPDATE_TIMER,ptpClock->itimer)) {
@@ -978,6 +1275,17 @@ doState(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 		timerStart(STATUSFILE_UPDATE_TIMER,rtOpts->statusFileUpdateInterval,ptpClock->itimer);
         }
 
+	if(timerExpired(SNAPSHOT_TIMER,ptpClock->itimer)) {
+		if(rtOpts->snapshotEnabled)
+			snapshotSave(rtOpts, ptpClock, TRUE);
+		/* picks up interval changes on reload */
+		timerStart(SNAPSHOT_TIMER,rtOpts->snapshotInterval,ptpClock->itimer);
+	}
+
+	if(timerExpired(HOLDOVER_UPDATE_TIMER,ptpClock->itimer)) {
+		holdoverUpdate(rtOpts, ptpClock);
+	}
+
 	if(rtOpts->enablePanicMode && timerExpired(PANIC_MODE_TIMER, ptpClock->itimer)) {
 
 		DBG("Panic check\n");
@@ -1009,6 +1317,8 @@ processMessage(RunTimeOpts* rtOpts, PtpClock* ptpClock, TimeInternal* timeStamp,
 {
 
     Boolean isFromSelf;
+    MsgView view;
+    UInteger8 messageType;
 
     /*
      * make sure we use the TAI to UTC offset specified, if the
@@ -1026,7 +1336,8 @@ processMessage(RunTimeOpts* rtOpts, PtpClock* ptpClock, TimeInternal* timeStamp,
      * announced UTC offset, preventing clock jumps with some GMs
      */
     DBGV("__UTC_offset: %d %d \n", ptpClock->timePropertiesDS.currentUtcOffsetValid, ptpClock->timePropertiesDS.currentUtcOffset);
-    if (respectUtcOffset(rtOpts, ptpClock) == TRUE) {
+    /* the monitor applies each master's own UTC offset */
+    if (!rtOpts->monitorMode && respectUtcOffset(rtOpts, ptpClock) == TRUE) {
 	timeStamp->seconds += ptpClock->timePropertiesDS.currentUtcOffset;
     }
 
@@ -1036,49 +1347,36 @@ processMessage(RunTimeOpts* rtOpts, PtpClock* ptpClock, TimeInternal* timeStamp,
 	ptpClock->counters.messageFormatErrors++;
 	return;
     }
-    msgUnpackHeader(ptpClock->msgIbuf, &ptpClock->msgTmpHeader);
 
-    /* packet is not from self, and is from a non-zero source address - check ACLs */
-    if(ptpClock->netPath.lastRecvAddr && 
-	(ptpClock->netPath.lastRecvAddr != ptpClock->netPath.interfaceAddr.s_addr)) {
-		struct in_addr in;
-		in.s_addr=ptpClock->netPath.lastRecvAddr;
-		if(ptpClock->msgTmpHeader.messageType == MANAGEMENT) {
-			if(rtOpts->managementAclEnabled) {
-			    if (!matchIpv4AccessList(
-				ptpClock->netPath.managementAcl, 
-				ntohl(ptpClock->netPath.lastRecvAddr))) {
-					DBG("ACL dropped management message from %s\n", inet_ntoa(in));
-					ptpClock->counters.aclManagementDiscardedMessages++;
-					return;
-				} else
-					DBG("ACL Accepted management message from %s\n", inet_ntoa(in));
-			}
-	        } else if(rtOpts->timingAclEnabled) {
-			if(!matchIpv4AccessList(ptpClock->netPath.timingAcl, 
-			    ntohl(ptpClock->netPath.lastRecvAddr))) {
-				DBG("ACL dropped timing message from %s\n", inet_ntoa(in));
-				ptpClock->counters.aclTimingDiscardedMessages++;
-				return;
-			} else
-				DBG("ACL accepted timing message from %s\n", inet_ntoa(in));
-		}
-    }
+    /* the checks below read the fields straight from the buffer - only accepted messages are unpacked */
+    msgViewInit(&view, ptpClock->msgIbuf, length);
+    messageType = msgViewHeader_messageType(&view);
+
+    /* the rate limiter and the access lists were applied by rxAccept() */
 
-    if (ptpClock->msgTmpHeader.versionPTP != ptpClock->versionNumber) {
-	DBG("ignore version %d message\n", ptpClock->msgTmpHeader.versionPTP);
+    if (msgViewHeader_versionPTP(&view) != ptpClock->versionNumber) {
+	DBG("ignore version %d message\n", msgViewHeader_versionPTP(&view));
 	ptpClock->counters.discardedMessages++;
 	ptpClock->counters.versionMismatchErrors++;
 	return;
     }
 
-    if(ptpClock->msgTmpHeader.domainNumber != ptpClock->domainNumber) {
-	DBG("ignore message from domainNumber %d\n", ptpClock->msgTmpHeader.domainNumber);
+    /* monitor mode: timing traffic is only measured, management is still served */
+    if(rtOpts->monitorMode && messageType != MANAGEMENT &&
+	monitorDomainEnabled(rtOpts, msgViewHeader_domainNumber(&view))) {
+	monitorMessage(rtOpts, ptpClock, timeStamp, length);
+	return;
+    }
+
+    if(msgViewHeader_domainNumber(&view) != ptpClock->domainNumber) {
+	DBG("ignore message from domainNumber %d\n", msgViewHeader_domainNumber(&view));
 	ptpClock->counters.discardedMessages++;
 	ptpClock->counters.domainMismatchErrors++;
 	return;
     }
 
+    msgUnpackHeader(ptpClock->msgIbuf, &ptpClock->msgTmpHeader);
+
     /*Spec 9.5.2.2*/
     isFromSelf = (ptpClock->portIdentity.portNumber == ptpClock->msgTmpHeader.sourcePortIdentity.portNumber
 	      && !memcmp(ptpClock->msgTmpHeader.sourcePortIdentity.clockIdentity, ptpClock->portIdentity.clockIdentity, CLOCK_IDENTITY_LENGTH));
@@ -1173,7 +1471,7 @@ processMessage(RunTimeOpts* rtOpts, PtpClock* ptpClock, TimeInternal* timeStamp,
 	break;
     case MANAGEMENT:
 	handleManagement(&ptpClock->msgTmpHeader,
-		 isFromSelf, rtOpts, ptpClock);
+		 length, isFromSelf, rtOpts, ptpClock);
 	break;
     case SIGNALING:
 	handleSignaling(ptpClock);
@@ -1192,19 +1490,314 @@ processMessage(RunTimeOpts* rtOpts, PtpClock* ptpClock, TimeInternal* timeStamp,
 }
 
 
+/* Receive queue class of a message */
+static int
+rxQueueClass(const Octet *buf, ssize_t length)
+{
+
+	MsgView view;
+	UInteger8 messageType;
+
+	msgViewInit(&view, buf, length);
+	messageType = msgViewHeader_messageType(&view);
+
+	if (view.error)
+		return RXQ_MANAGEMENT;
+
+	switch (messageType) {
+	case SYNC:
+	case DELAY_REQ:
+	case PDELAY_REQ:
+	case PDELAY_RESP:
+	case FOLLOW_UP:
+	case DELAY_RESP:
+	case PDELAY_RESP_FOLLOW_UP:
+		return RXQ_TIMING;
+	case ANNOUNCE:
+	case SIGNALING:
+		return RXQ_BMC;
+	default:
+		return RXQ_MANAGEMENT;
+	}
+
+}
+
+/* queueing latency is measured on the monotonic clock - immune to clock steps */
+static void
+rxQueueTime(TimeInternal *time)
+{
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	time->seconds = ts.tv_sec;
+	time->nanoseconds = ts.tv_nsec;
+
+}
+
+/*
+ * Checks made on the message just received into msgIbuf before it is
+ * queued for instance, so that nothing a source should not be sending
+ * takes up queue space: the rate limiter, the access lists, and the
+ * domain when no instance serves it. Discards are counted on instance.
+ */
+static Boolean
+rxAccept(RunTimeOpts *rtOpts, PtpClock *ptpClock, PtpClock *instance, ssize_t length)
+{
+
+	MsgView view;
+	UInteger8 messageType, domainNumber;
+	struct in_addr in;
+
+	/* too short to tell - processMessage() will count it */
+	if (length < HEADER_LENGTH)
+		return TRUE;
+
+	msgViewInit(&view, ptpClock->msgIbuf, length);
+	messageType = msgViewHeader_messageType(&view);
+	domainNumber = msgViewHeader_domainNumber(&view);
+
+	/* packet is not from self, and is from a non-zero source address */
+	if (ptpClock->netPath.lastRecvAddr &&
+	    ptpClock->netPath.lastRecvAddr != ptpClock->netPath.interfaceAddr.s_addr) {
+
+		in.s_addr = ptpClock->netPath.lastRecvAddr;
+
+		/* charge the message to its source before doing any work on it */
+		if (ptpClock->netPath.rateLimiter != NULL &&
+		    !rateLimitAccept(ptpClock->netPath.rateLimiter,
+			ntohl(ptpClock->netPath.lastRecvAddr), messageType)) {
+			DBGV("Rate limit dropped message type %d\n", messageType);
+			instance->counters.rateLimitDiscardedMessages++;
+			return FALSE;
+		}
+
+		if (messageType == MANAGEMENT) {
+			if (rtOpts->managementAclEnabled &&
+			    !matchIpv4AccessList(ptpClock->netPath.managementAcl,
+				ntohl(ptpClock->netPath.lastRecvAddr))) {
+				DBG("ACL dropped management message from %s\n", inet_ntoa(in));
+				instance->counters.aclManagementDiscardedMessages++;
+				return FALSE;
+			}
+		} else if (rtOpts->timingAclEnabled &&
+			   !matchIpv4AccessList(ptpClock->netPath.timingAcl,
+				ntohl(ptpClock->netPath.lastRecvAddr))) {
+			DBG("ACL dropped timing message from %s\n", inet_ntoa(in));
+			instance->counters.aclTimingDiscardedMessages++;
+			return FALSE;
+		}
+
+	}
+
+	/* no instance for this domain - unless the monitor watches it */
+	if (domainNumber != instance->domainNumber &&
+	    !(rtOpts->monitorMode && messageType != MANAGEMENT &&
+	      monitorDomainEnabled(rtOpts, domainNumber))) {
+		DBG("ignore message from domainNumber %d\n", domainNumber);
+		instance->counters.discardedMessages++;
+		instance->counters.domainMismatchErrors++;
+		return FALSE;
+	}
+
+	return TRUE;
+
+}
+
+/*
+ * Queue the message just received into msgIbuf - with domain instances,
+ * into the queue of the instance of its domain
+ */
+static void
+rxQueuePush(RunTimeOpts *rtOpts, PtpClock *ptpClock, TimeInternal *timeStamp, ssize_t length)
+{
+
+	PtpClock *instance = domainDemux(ptpClock, ptpClock->msgIbuf, length);
+	RxQueue *queue = &instance->rxQueues[rxQueueClass(ptpClock->msgIbuf, length)];
+	RxQueueEntry *entry;
+
+	if (!rxAccept(rtOpts, ptpClock, instance, length))
+		return;
+
+	if (queue->depth == RXQ_CAPACITY) {
+		DBG("Receive queue full - dropping message type %d\n",
+		    (UInteger8)ptpClock->msgIbuf[0] & 0x0F);
+		queue->overflows++;
+		return;
+	}
+
+	entry = &queue->entries[(queue->head + queue->depth) % RXQ_CAPACITY];
+	/* whole buffer: the unpack functions may look past the message length */
+	memcpy(entry->buf, ptpClock->msgIbuf, PACKET_SIZE);
+	entry->length = length;
+	entry->timeStamp = *timeStamp;
+	entry->sourceAddr = ptpClock->netPath.lastRecvAddr;
+	rxQueueTime(&entry->queuedTime);
+
+	queue->queued++;
+	if (++queue->depth > queue->maxDepth)
+		queue->maxDepth = queue->depth;
+
+}
+
+/* Process up to budget messages from a queue, all of them if budget < 0 */
+static void
+rxQueueProcess(RunTimeOpts *rtOpts, PtpClock *ptpClock, int class, int budget)
+{
+
+	RxQueue *queue = &ptpClock->rxQueues[class];
+	RxQueueEntry *entry;
+	TimeInternal now, latency;
+	uint32_t latencyNs;
+
+	while (queue->depth > 0 && budget-- != 0) {
+
+		entry = &queue->entries[queue->head];
+		queue->head = (queue->head + 1) % RXQ_CAPACITY;
+		queue->depth--;
+
+		rxQueueTime(&now);
+		subTime(&latency, &now, &entry->queuedTime);
+		latencyNs = (latency.seconds >= 4) ? UINT32_MAX :
+			latency.seconds * 1000000000U + latency.nanoseconds;
+		queue->processed++;
+		queue->latencyTotal += latencyNs;
+		if (latencyNs > queue->latencyMax)
+			queue->latencyMax = latencyNs;
+
+		memcpy(ptpClock->msgIbuf, entry->buf, PACKET_SIZE);
+		ptpClock->netPath.lastRecvAddr = entry->sourceAddr;
+		processMessage(rtOpts, ptpClock, &entry->timeStamp, entry->length);
+
+	}
+
+}
+
+/*
+ * Timing messages are always processed first and in full, Announce /
+ * Signaling and Management messages only up to their budget per pass -
+ * the rest waits for the next pass.
+ */
+static void
+rxQueueDispatch(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	rxQueueProcess(rtOpts, ptpClock, RXQ_TIMING, -1);
+	rxQueueProcess(rtOpts, ptpClock, RXQ_BMC, rtOpts->rxBudgetBmc);
+	rxQueueProcess(rtOpts, ptpClock, RXQ_MANAGEMENT, rtOpts->rxBudgetManagement);
+
+}
+
+/*
+ * Whether a message of class - of any class if class < 0 - can still be
+ * queued, whichever domain instance it is for. A socket is only read
+ * while it can: the rest stays in the kernel until the queues have been
+ * processed, instead of being read and dropped.
+ */
+static Boolean
+rxQueueRoom(PtpClock *ptpClock, int class)
+{
+
+	DomainInstances *domains = ptpClock->domainInstances;
+	PtpClock *instance;
+	int i, c;
+
+	for (i = 0; i < (domains != NULL ? domains->count : 1); i++) {
+		instance = (domains != NULL) ? domains->instances[i] : ptpClock;
+		for (c = 0; c < RXQ_CLASSES; c++)
+			if ((class < 0 || c == class) &&
+			    instance->rxQueues[c].depth == RXQ_CAPACITY)
+				return FALSE;
+	}
+
+	return TRUE;
+
+}
+
+static Boolean
+rxQueuePending(PtpClock *ptpClock)
+{
+
+	int i;
+
+	for (i = 0; i < RXQ_CLASSES; i++)
+		if (ptpClock->rxQueues[i].depth > 0)
+			return TRUE;
+
+	return FALSE;
+
+}
+
+static void
+rxQueueFlush(PtpClock *ptpClock)
+{
+
+	int i;
+
+	for (i = 0; i < RXQ_CLASSES; i++) {
+		ptpClock->rxQueues[i].head = 0;
+		ptpClock->rxQueues[i].depth = 0;
+	}
+
+}
+
+/*
+ * Whether handle() may wait for a message or a timer tick: not with
+ * messages still queued, for us or another domain instance. Only port 1
+ * of a boundary clock waits, for the sockets of all ports - the other
+ * ports are only polled.
+ */
+static Boolean
+handleMayBlock(PtpClock *ptpClock)
+{
+    BoundaryClock *bc = ptpClock->boundaryClock;
+    DomainInstances *domains = ptpClock->domainInstances;
+    int i;
+
+    if (rxQueuePending(ptpClock))
+	return FALSE;
+
+    /* messages received for the other domains wait in their queues */
+    if (domains != NULL && ptpClock->domainIndex == 0)
+	for (i = 1; i < domains->count; i++)
+	    if (rxQueuePending(domains->instances[i]) ||
+		domains->instances[i]->record_update)
+		return FALSE;
+
+    if (bc == NULL)
+	return TRUE;
+
+    if (ptpClock->portIndex > 0)
+	return FALSE;
+
+    for (i = 1; i < bc->numberPorts; i++)
+	if (rxQueuePending(bc->ports[i]) || bc->ports[i]->record_update)
+	    return FALSE;
+
+    return TRUE;
+}
+
 /* check and handle received messages */
 void
 handle(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 {
-    int ret;
+    int ret, i;
     ssize_t length = -1;
 
     TimeInternal timeStamp = { 0, 0 };
+    TimeInternal noWait = { 0, 0 };
     fd_set readfds;
 
+    /* another domain: its messages were received and queued for it already */
+    if (ptpClock->domainIndex > 0) {
+	rxQueueDispatch(rtOpts, ptpClock);
+	return;
+    }
+
     FD_ZERO(&readfds);
     if (!ptpClock->message_activity) {
-	ret = netSelect(NULL, &ptpClock->netPath, &readfds);
+	/* low priority messages left over from the last pass - only poll */
+	ret = netSelect(handleMayBlock(ptpClock) ? NULL : &noWait, &ptpClock->netPath, &readfds);
 	if (ret < 0) {
 	    PERROR("failed to poll sockets");
 	    ptpClock->counters.messageRecvErrors++;
@@ -1212,6 +1805,9 @@ handle(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 	    return;
 	} else if (!ret) {
 	    /* DBGV("handle: nothing\n"); */
+	    rxQueueDispatch(rtOpts, ptpClock);
+	    /* push out stream lines queued while dispatching */
+	    ctlSocketService(ptpClock, NULL);
 	    return;
 	}
 	/* else length > 0 */
@@ -1232,7 +1828,11 @@ handle(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 		ptpClock->counters.messageRecvErrors++;
 		return;
 	    }
-	    processMessage(rtOpts, ptpClock, &timeStamp, length);
+	    /* the other domains' messages are queued for them */
+	    if (ptpClock->domainInstances != NULL)
+		rxQueuePush(rtOpts, ptpClock, &timeStamp, length);
+	    else if (rxAccept(rtOpts, ptpClock, ptpClock, length))
+		processMessage(rtOpts, ptpClock, &timeStamp, length);
 	}
 	if (ptpClock->netPath.pcapGeneralSock >=0 && FD_ISSET(ptpClock->netPath.pcapGeneralSock, &readfds)) {
 	    length = netRecvGeneral(ptpClock->msgIbuf, &ptpClock->netPath);
@@ -1244,36 +1844,77 @@ handle(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 		ptpClock->counters.messageRecvErrors++;
 		return;
 	    }
-	    processMessage(rtOpts, ptpClock, &timeStamp, length);
+	    /* the other domains' messages are queued for them */
+	    if (ptpClock->domainInstances != NULL)
+		rxQueuePush(rtOpts, ptpClock, &timeStamp, length);
+	    else if (rxAccept(rtOpts, ptpClock, ptpClock, length))
+		processMessage(rtOpts, ptpClock, &timeStamp, length);
 	}
     } else {
 #endif
+	/*
+	 * Drain both sockets into the receive queues first, so that
+	 * timing messages never wait behind Announce or Management
+	 * messages received before them. A socket is only read while
+	 * the queues it feeds have room - the class of a general
+	 * message is not known before it is read, so that socket
+	 * stops when any queue is full.
+	 */
 	if (FD_ISSET(ptpClock->netPath.eventSock, &readfds)) {
-	    length = netRecvEvent(ptpClock->msgIbuf, &timeStamp, 
-		          &ptpClock->netPath, 0);
-	    if (length < 0) {
-		PERROR("failed to receive on the event socket");
-		toState(PTP_FAULTY, rtOpts, ptpClock);
-		ptpClock->counters.messageRecvErrors++;
-		return;
+	    for (i = 0; i < RXQ_CAPACITY && rxQueueRoom(ptpClock, RXQ_TIMING); i++) {
+		length = netRecvEvent(ptpClock->msgIbuf, &timeStamp, 
+			      &ptpClock->netPath, 0);
+		if (length < 0) {
+		    PERROR("failed to receive on the event socket");
+		    toState(PTP_FAULTY, rtOpts, ptpClock);
+		    ptpClock->counters.messageRecvErrors++;
+		    return;
+		}
+		/* nothing left, or nothing usable */
+		if (length == 0)
+		    break;
+		rxQueuePush(rtOpts, ptpClock, &timeStamp, length);
 	    }
-	    processMessage(rtOpts, ptpClock, &timeStamp, length);
 	}
 
 	if (FD_ISSET(ptpClock->netPath.generalSock, &readfds)) {
-	    length = netRecvGeneral(ptpClock->msgIbuf, &ptpClock->netPath);
-	    if (length < 0) {
-		PERROR("failed to receive on the general socket");
-		toState(PTP_FAULTY, rtOpts, ptpClock);
-		ptpClock->counters.messageRecvErrors++;
-		return;
+	    /* general messages carry no receive time stamp */
+	    timeStamp.seconds = 0;
+	    timeStamp.nanoseconds = 0;
+	    for (i = 0; i < RXQ_CAPACITY && rxQueueRoom(ptpClock, -1); i++) {
+		length = netRecvGeneral(ptpClock->msgIbuf, &ptpClock->netPath);
+		if (length < 0) {
+		    if (errno == EAGAIN || errno == EWOULDBLOCK)
+			break;
+		    PERROR("failed to receive on the general socket");
+		    toState(PTP_FAULTY, rtOpts, ptpClock);
+		    ptpClock->counters.messageRecvErrors++;
+		    return;
+		}
+		rxQueuePush(rtOpts, ptpClock, &timeStamp, length);
 	    }
-	    processMessage(rtOpts, ptpClock, &timeStamp, length);
 	}
 #ifdef PTPD_PCAP
     }
 #endif
 
+    rxQueueDispatch(rtOpts, ptpClock);
+
+    /* NTP clients are served after PTP traffic */
+    if (ptpClock->ntpServer.sockFD >= 0 && FD_ISSET(ptpClock->ntpServer.sockFD, &readfds)) {
+	ntpServerReceive(rtOpts, ptpClock);
+    }
+
+    /* local control clients come last */
+    ctlSocketService(ptpClock, &readfds);
+
+#ifdef PTPD_NTPDC
+    /* replies from NTPd - only picked up here, never waited for */
+    if (ptpClock->ntpControl.sockFD >= 0 && FD_ISSET(ptpClock->ntpControl.sockFD, &readfds)) {
+	ntpdControlReceive(&rtOpts->ntpOptions, &ptpClock->ntpControl);
+    }
+#endif /* PTPD_NTPDC */
+
 }
 
 /*spec 9.5.3*/
@@ -1290,6 +1931,16 @@ handleAnnounce(MsgHeader *header, ssize_t length,
 		return;
 	}
 
+	/* 9.3.2.5: never qualify an Announce from another port of this clock */
+	if (!isFromSelf && ptpClock->boundaryClock != NULL &&
+	    !memcmp(header->sourcePortIdentity.clockIdentity,
+		    ptpClock->clockIdentity, CLOCK_IDENTITY_LENGTH)) {
+		DBGV("HandleAnnounce : Ignore message from port %d of this clock\n",
+		     header->sourcePortIdentity.portNumber);
+		ptpClock->counters.discardedMessages++;
+		return;
+	}
+
 	//DBGV("  >> HandleAnnounce : %d  \n", ptpClock->portState);
 
 	switch (ptpClock->portState) {
@@ -1346,6 +1997,7 @@ handleAnnounce(MsgHeader *header, ssize_t length,
 					ptpClock->leapSecondInProgress=FALSE;
 					ptpClock->timePropertiesDS.leap59 = FALSE;
 					ptpClock->timePropertiesDS.leap61 = FALSE;
+					datasetChanged(ptpClock, MGMT_CACHE_TIME_PROPERTIES_DS);
 #ifdef HAVE_SYS_TIMEX_H
 					unsetTimexFlags(STA_INS | STA_DEL, TRUE);
 #endif /* HAVE_SYS_TIMEX_H */
@@ -1495,7 +2147,7 @@ handleSync(const MsgHeader *header, ssize_t length,
 	   RunTimeOpts *rtOpts, PtpClock *ptpClock)
 {
 	TimeInternal OriginTimestamp;
-	TimeInternal correctionField;
+	TimeScaled correctionField;
 
 	DBGV("Sync message received : \n");
 
@@ -1537,7 +2189,10 @@ handleSync(const MsgHeader *header, ssize_t length,
 						   ptpClock->itimer);
 			}
 
-			ptpClock->logSyncInterval = header->logMessageInterval;
+			if (ptpClock->logSyncInterval != header->logMessageInterval) {
+				ptpClock->logSyncInterval = header->logMessageInterval;
+				datasetChanged(ptpClock, MGMT_CACHE_PORT_DS);
+			}
 
 			ptpClock->sync_receive_time.seconds = tint->seconds;
 			ptpClock->sync_receive_time.nanoseconds = tint->nanoseconds;
@@ -1546,34 +2201,33 @@ handleSync(const MsgHeader *header, ssize_t length,
 
 			if ((header->flagField0 & PTP_TWO_STEP) == PTP_TWO_STEP) {
 				DBG2("HandleSync: waiting for follow-up \n");
+				if (!ptpClock->twoStepFlag)
+					datasetChanged(ptpClock, MGMT_CACHE_DEFAULT_DS);
 				ptpClock->twoStepFlag=TRUE;
 				ptpClock->waitingForFollow = TRUE;
 				ptpClock->recvSyncSequenceId = 
 					header->sequenceId;
 				/*Save correctionField of Sync message*/
-				integer64_to_internalTime(
-					header->correctionField,
-					&correctionField);
-				ptpClock->lastSyncCorrectionField.seconds = 
-					correctionField.seconds;
-				ptpClock->lastSyncCorrectionField.nanoseconds =
-					correctionField.nanoseconds;
+				ptpClock->lastSyncCorrectionField =
+					integer64_to_scaled(&header->correctionField);
 				break;
 			} else {
 				msgUnpackSync(ptpClock->msgIbuf,
 					      &ptpClock->msgTmp.sync);
-				integer64_to_internalTime(
-					ptpClock->msgTmpHeader.correctionField,
-					&correctionField);
-				timeInternal_display(&correctionField);
+				correctionField = integer64_to_scaled(
+					&ptpClock->msgTmpHeader.correctionField);
+				DBGV("correctionField: %.3f ns\n",
+					(double)correctionField / TIME_SCALED_NS);
 				ptpClock->waitingForFollow = FALSE;
 				toInternalTime(&OriginTimestamp,
 					       &ptpClock->msgTmp.sync.originTimestamp);
 				updateOffset(&OriginTimestamp,
 					     &ptpClock->sync_receive_time,
 					     ptpClock->ofm_filt,rtOpts,
-					     ptpClock,&correctionField);
-				updateClock(rtOpts,ptpClock);
+					     ptpClock,correctionField);
+				bcUpdateClock(rtOpts,ptpClock);
+				if (ptpClock->twoStepFlag)
+					datasetChanged(ptpClock, MGMT_CACHE_DEFAULT_DS);
 				ptpClock->twoStepFlag=FALSE;
 				break;
 			}
@@ -1581,6 +2235,8 @@ handleSync(const MsgHeader *header, ssize_t length,
 			DBG("HandleSync: Sync message received from "
 			     "another Master not our own \n");
 			ptpClock->counters.discardedMessages++;
+			if (rtOpts->standbyMasters && ptpClock->portState == PTP_SLAVE)
+				standbySync(header, tint, rtOpts, ptpClock);
 		}
 		break;
 
@@ -1619,7 +2275,7 @@ handleFollowUp(const MsgHeader *header, ssize_t length,
 	DBGV("Handlefollowup : Follow up message received \n");
 
 	TimeInternal preciseOriginTimestamp;
-	TimeInternal correctionField;
+	TimeScaled correctionField;
 
 	if (length < FOLLOW_UP_LENGTH)
 	{
@@ -1648,7 +2304,10 @@ handleFollowUp(const MsgHeader *header, ssize_t length,
 	case PTP_SLAVE:
 		if (isFromCurrentParent(ptpClock, header)) {
 			ptpClock->counters.followUpMessagesReceived++;
-			ptpClock->logSyncInterval = header->logMessageInterval;
+			if (ptpClock->logSyncInterval != header->logMessageInterval) {
+				ptpClock->logSyncInterval = header->logMessageInterval;
+				datasetChanged(ptpClock, MGMT_CACHE_PORT_DS);
+			}
 			if (ptpClock->waitingForFollow)	{
 				if (ptpClock->recvSyncSequenceId == 
 				     header->sequenceId) {
@@ -1657,10 +2316,9 @@ handleFollowUp(const MsgHeader *header, ssize_t length,
 					ptpClock->waitingForFollow = FALSE;
 					toInternalTime(&preciseOriginTimestamp,
 						       &ptpClock->msgTmp.follow.preciseOriginTimestamp);
-					integer64_to_internalTime(ptpClock->msgTmpHeader.correctionField,
-								  &correctionField);
-					addTime(&correctionField,&correctionField,
-						&ptpClock->lastSyncCorrectionField);
+					/* Sync and Follow_Up corrections, sub-nanosecond parts included */
+					correctionField = integer64_to_scaled(&ptpClock->msgTmpHeader.correctionField) +
+						ptpClock->lastSyncCorrectionField;
 
 					/*
 					send_time = preciseOriginTimestamp (received inside followup)
@@ -1669,8 +2327,8 @@ handleFollowUp(const MsgHeader *header, ssize_t length,
 					updateOffset(&preciseOriginTimestamp,
 						     &ptpClock->sync_receive_time, ptpClock->ofm_filt,
 						     rtOpts,ptpClock,
-						     &correctionField);
-					updateClock(rtOpts,ptpClock);
+						     correctionField);
+					bcUpdateClock(rtOpts,ptpClock);
 					break;
 				} else
 					INFO("Ignored followup, SequenceID doesn't match with "
@@ -1683,6 +2341,8 @@ handleFollowUp(const MsgHeader *header, ssize_t length,
 		} else {
 			DBG2("Ignored, Follow up message is not from current parent \n");
 			ptpClock->counters.discardedMessages++;
+			if (rtOpts->standbyMasters && ptpClock->portState == PTP_SLAVE)
+				standbyFollowUp(header, rtOpts, ptpClock);
 			}
 
 	case PTP_MASTER:
@@ -1777,6 +2437,8 @@ handleDelayReq(const MsgHeader *header, ssize_t length,
 			// remember IP address of this client for hybrid mode
 			ptpClock->LastSlaveAddr = ptpClock->netPath.lastRecvAddr;
 
+			slaveTableDelayReq(rtOpts, ptpClock, &ptpClock->delayReqHeader, tint);
+
 			issueDelayResp(tint,&ptpClock->delayReqHeader,
 				       rtOpts,ptpClock);
 			break;
@@ -1822,7 +2484,8 @@ handleDelayResp(const MsgHeader *header, ssize_t length,
 {
 	if (ptpClock->delayMechanism == E2E) {
 		TimeInternal requestReceiptTimestamp;
-		TimeInternal correctionField;
+		MsgView view;
+		PortIdentity requestingPortIdentity;
 
 		DBGV("delayResp message received : \n");
 
@@ -1843,18 +2506,22 @@ handleDelayResp(const MsgHeader *header, ssize_t length,
 			return;
 
 		case PTP_SLAVE:
-			msgUnpackDelayResp(ptpClock->msgIbuf,
-					   &ptpClock->msgTmp.resp);
+			/* with multicast, most responses are for other slaves - only unpack our own */
+			msgViewInit(&view, ptpClock->msgIbuf, length);
+			requestingPortIdentity = msgViewDelayResp_requestingPortIdentity(&view);
 
 			if ((memcmp(ptpClock->portIdentity.clockIdentity,
-				    ptpClock->msgTmp.resp.requestingPortIdentity.clockIdentity,
+				    requestingPortIdentity.clockIdentity,
 				    CLOCK_IDENTITY_LENGTH) == 0) &&
 			    (ptpClock->portIdentity.portNumber == 
-			     ptpClock->msgTmp.resp.requestingPortIdentity.portNumber)
+			     requestingPortIdentity.portNumber)
 			    && isFromCurrentParent(ptpClock, header)) {
 				DBG("==> Handle DelayResp (%d)\n",
 					 header->sequenceId);
 
+				msgUnpackDelayResp(ptpClock->msgIbuf,
+						   &ptpClock->msgTmp.resp);
+
 				if (!ptpClock->waitingForDelayResp) {
 					DBGV("Ignored DelayResp - wasn't waiting for one\n");
 					ptpClock->counters.discardedMessages++;
@@ -1883,16 +2550,13 @@ handleDelayResp(const MsgHeader *header, ssize_t length,
 				ptpClock->delay_req_receive_time.nanoseconds = 
 					requestReceiptTimestamp.nanoseconds;
 
-				integer64_to_internalTime(
-					header->correctionField,
-					&correctionField);
 				/*
 					send_time = delay_req_send_time (received as CMSG in handleEvent)
 					recv_time = requestReceiptTimestamp (received inside delayResp)
 				*/
 
 				updateDelay(ptpClock->owd_filt,
-					    rtOpts,ptpClock, &correctionField);
+					    rtOpts,ptpClock, integer64_to_scaled(&header->correctionField));
 				if (ptpClock->waiting_for_first_delayresp) {
 					ptpClock->waiting_for_first_delayresp = FALSE;
 					NOTICE("Received first Delay Response from Master\n");
@@ -1921,9 +2585,18 @@ handleDelayResp(const MsgHeader *header, ssize_t length,
 					}
 					ptpClock->logMinDelayReqInterval = rtOpts->subsequent_delayreq;
 				}
+				datasetChanged(ptpClock, MGMT_CACHE_PORT_DS);
 			} else {
 				DBG("HandledelayResp : delayResp doesn't match with the delayReq. \n");
 				ptpClock->counters.discardedMessages++;
+				/* our own request, answered by a backup master */
+				if (rtOpts->standbyMasters &&
+				    (memcmp(ptpClock->portIdentity.clockIdentity,
+					    requestingPortIdentity.clockIdentity,
+					    CLOCK_IDENTITY_LENGTH) == 0) &&
+				    (ptpClock->portIdentity.portNumber ==
+				     requestingPortIdentity.portNumber))
+					standbyDelayResp(header, rtOpts, ptpClock);
 				break;
 			}
 		}
@@ -2019,7 +2692,6 @@ handlePDelayResp(const MsgHeader *header, TimeInternal *tint,
 	if (ptpClock->delayMechanism == P2P) {
 		/* Boolean isFromCurrentParent = FALSE; NOTE: This is never used in this function */
 		TimeInternal requestReceiptTimestamp;
-		TimeInternal correctionField;
 	
 		DBG("PdelayResp message received : \n");
 
@@ -2082,17 +2754,15 @@ handlePDelayResp(const MsgHeader *header, TimeInternal *tint,
 					ptpClock->pdelay_req_receive_time.seconds = requestReceiptTimestamp.seconds;
 					ptpClock->pdelay_req_receive_time.nanoseconds = requestReceiptTimestamp.nanoseconds;
 					
-					integer64_to_internalTime(header->correctionField,&correctionField);
-					ptpClock->lastPdelayRespCorrectionField.seconds = correctionField.seconds;
-					ptpClock->lastPdelayRespCorrectionField.nanoseconds = correctionField.nanoseconds;
+					ptpClock->lastPdelayRespCorrectionField = integer64_to_scaled(&header->correctionField);
 				} else {
 				/* One step Clock */
 					/*Store t4 (Fig 35)*/
 					ptpClock->pdelay_resp_receive_time.seconds = tint->seconds;
 					ptpClock->pdelay_resp_receive_time.nanoseconds = tint->nanoseconds;
 					
-					integer64_to_internalTime(header->correctionField,&correctionField);
-					updatePeerDelay (ptpClock->owd_filt,rtOpts,ptpClock,&correctionField,FALSE);
+					updatePeerDelay (ptpClock->owd_filt,rtOpts,ptpClock,
+						integer64_to_scaled(&header->correctionField),FALSE);
 				}
 				ptpClock->recvPDelayRespSequenceId = header->sequenceId;
 				break;
@@ -2138,7 +2808,6 @@ handlePDelayRespFollowUp(const MsgHeader *header, ssize_t length,
 
 	if (ptpClock->delayMechanism == P2P) {
 		TimeInternal responseOriginTimestamp;
-		TimeInternal correctionField;
 	
 		DBG("PdelayRespfollowup message received : \n");
 	
@@ -2176,14 +2845,10 @@ handlePDelayRespFollowUp(const MsgHeader *header, ssize_t length,
 					responseOriginTimestamp.seconds;
 				ptpClock->pdelay_resp_send_time.nanoseconds = 
 					responseOriginTimestamp.nanoseconds;
-				integer64_to_internalTime(
-					ptpClock->msgTmpHeader.correctionField,
-					&correctionField);
-				addTime(&correctionField,&correctionField,
-					&ptpClock->lastPdelayRespCorrectionField);
 				updatePeerDelay (ptpClock->owd_filt,
 						 rtOpts, ptpClock,
-						 &correctionField,TRUE);
+						 integer64_to_scaled(&ptpClock->msgTmpHeader.correctionField) +
+						 ptpClock->lastPdelayRespCorrectionField,TRUE);
 				break;
 			} else {
 				DBG("PdelayRespFollowup: sequence mismatch - Received: %d "
@@ -2226,61 +2891,23 @@ acceptManagementMessage(PortIdentity thisPort, PortIdentity targetPort)
 }
 
 
-static void
-handleManagement(MsgHeader *header,
-		 Boolean isFromSelf, RunTimeOpts *rtOpts, PtpClock *ptpClock)
-{
-	DBGV("Management message received : \n");
-
-	if(!rtOpts->managementEnabled) {
-		DBGV("Dropping management message - management message support disabled");
-		ptpClock->counters.discardedMessages++;
-		return;
-	}
-
-	if (isFromSelf) {
-		DBGV("handleManagement: Ignore message from self \n");
+/* Unpack the TLV data for its handler - without memory for it, the TLV is not handled */
+#define UNPACK_MANAGEMENT_DATA(name) \
+	unpackMM##name(buf, &ptpClock->msgTmp.manage, ptpClock); \
+	if(ptpClock->msgTmp.manage.tlv->dataField == NULL) \
 		return;
-	}
-
-	msgUnpackManagement(ptpClock->msgIbuf,&ptpClock->msgTmp.manage, header, ptpClock);
-
-	if(ptpClock->msgTmp.manage.tlv == NULL) {
-		DBGV("handleManagement: TLV is empty\n");
-		ptpClock->counters.messageFormatErrors++;
-		return;
-	}
-
-        if(!acceptManagementMessage(ptpClock->portIdentity, ptpClock->msgTmp.manage.targetPortIdentity))
-        {
-                DBGV("handleManagement: The management message was not accepted");
-		ptpClock->counters.discardedMessages++;
-                return;
-        }
 
-	if(!rtOpts->managementSetEnable &&
-	    (ptpClock->msgTmp.manage.actionField == SET ||
-	    ptpClock->msgTmp.manage.actionField == COMMAND)) {
-		DBGV("Dropping SET/COMMAND management message - read-only mode enabled");
-		ptpClock->counters.discardedMessages++;
-		return;
-	}
+/* Handle one management TLV, found at buf + MANAGEMENT_LENGTH, into outgoingManageTmp */
+static void
+handleManagementTLV(Octet *buf, RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
 
 	/* is this an error status management TLV? */
 	if(ptpClock->msgTmp.manage.tlv->tlvType == TLV_MANAGEMENT_ERROR_STATUS) {
 		DBGV("handleManagement: Error Status TLV\n");
-		unpackMMErrorStatus(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+		UNPACK_MANAGEMENT_DATA(ErrorStatus);
 		handleMMErrorStatus(&ptpClock->msgTmp.manage);
 		ptpClock->counters.managementMessagesReceived++;
-		/* cleanup msgTmp managementTLV */
-		if(ptpClock->msgTmp.manage.tlv) {
-			DBGV("cleanup ptpClock->msgTmp.manage message \n");
-			if(ptpClock->msgTmp.manage.tlv->dataField) {
-				freeMMErrorStatusTLV(ptpClock->msgTmp.manage.tlv);
-				free(ptpClock->msgTmp.manage.tlv->dataField);
-			}
-			free(ptpClock->msgTmp.manage.tlv);
-		}
 		return;
 	} else if (ptpClock->msgTmp.manage.tlv->tlvType != TLV_MANAGEMENT) {
 		/* do nothing, implemention specific handling */
@@ -2298,13 +2925,13 @@ handleManagement(MsgHeader *header,
 		break;
 	case MM_CLOCK_DESCRIPTION:
 		DBGV("handleManagement: Clock Description\n");
-		unpackMMClockDescription(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+		UNPACK_MANAGEMENT_DATA(ClockDescription);
 		handleMMClockDescription(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
 		break;
 	case MM_USER_DESCRIPTION:
 		DBGV("handleManagement: User Description\n");
-		unpackMMUserDescription(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+		UNPACK_MANAGEMENT_DATA(UserDescription);
 		handleMMUserDescription(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
 		break;
@@ -2320,85 +2947,85 @@ handleManagement(MsgHeader *header,
 		break;
 	case MM_INITIALIZE:
 		DBGV("handleManagement: Initialize\n");
-		unpackMMInitialize(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+		UNPACK_MANAGEMENT_DATA(Initialize);
 		handleMMInitialize(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
 		break;
 	case MM_DEFAULT_DATA_SET:
 		DBGV("handleManagement: Default Data Set\n");
-		unpackMMDefaultDataSet(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+		UNPACK_MANAGEMENT_DATA(DefaultDataSet);
 		handleMMDefaultDataSet(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
 		break;
 	case MM_CURRENT_DATA_SET:
 		DBGV("handleManagement: Current Data Set\n");
-		unpackMMCurrentDataSet(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+		UNPACK_MANAGEMENT_DATA(CurrentDataSet);
 		handleMMCurrentDataSet(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
 		break;
         case MM_PARENT_DATA_SET:
                 DBGV("handleManagement: Parent Data Set\n");
-                unpackMMParentDataSet(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+                UNPACK_MANAGEMENT_DATA(ParentDataSet);
                 handleMMParentDataSet(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
                 break;
         case MM_TIME_PROPERTIES_DATA_SET:
                 DBGV("handleManagement: TimeProperties Data Set\n");
-                unpackMMTimePropertiesDataSet(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+                UNPACK_MANAGEMENT_DATA(TimePropertiesDataSet);
                 handleMMTimePropertiesDataSet(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
                 break;
         case MM_PORT_DATA_SET:
                 DBGV("handleManagement: Port Data Set\n");
-                unpackMMPortDataSet(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+                UNPACK_MANAGEMENT_DATA(PortDataSet);
                 handleMMPortDataSet(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
                 break;
         case MM_PRIORITY1:
                 DBGV("handleManagement: Priority1\n");
-                unpackMMPriority1(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+                UNPACK_MANAGEMENT_DATA(Priority1);
                 handleMMPriority1(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
                 break;
         case MM_PRIORITY2:
                 DBGV("handleManagement: Priority2\n");
-                unpackMMPriority2(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+                UNPACK_MANAGEMENT_DATA(Priority2);
                 handleMMPriority2(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
                 break;
         case MM_DOMAIN:
                 DBGV("handleManagement: Domain\n");
-                unpackMMDomain(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+                UNPACK_MANAGEMENT_DATA(Domain);
                 handleMMDomain(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
                 break;
 	case MM_SLAVE_ONLY:
 		DBGV("handleManagement: Slave Only\n");
-		unpackMMSlaveOnly(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+		UNPACK_MANAGEMENT_DATA(SlaveOnly);
 		handleMMSlaveOnly(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
 		break;
         case MM_LOG_ANNOUNCE_INTERVAL:
                 DBGV("handleManagement: Log Announce Interval\n");
-                unpackMMLogAnnounceInterval(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+                UNPACK_MANAGEMENT_DATA(LogAnnounceInterval);
                 handleMMLogAnnounceInterval(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
                 break;
         case MM_ANNOUNCE_RECEIPT_TIMEOUT:
                 DBGV("handleManagement: Announce Receipt Timeout\n");
-                unpackMMAnnounceReceiptTimeout(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+                UNPACK_MANAGEMENT_DATA(AnnounceReceiptTimeout);
                 handleMMAnnounceReceiptTimeout(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
                 break;
         case MM_LOG_SYNC_INTERVAL:
                 DBGV("handleManagement: Log Sync Interval\n");
-                unpackMMLogSyncInterval(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+                UNPACK_MANAGEMENT_DATA(LogSyncInterval);
                 handleMMLogSyncInterval(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
                 break;
         case MM_VERSION_NUMBER:
                 DBGV("handleManagement: Version Number\n");
-                unpackMMVersionNumber(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+                UNPACK_MANAGEMENT_DATA(VersionNumber);
                 handleMMVersionNumber(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
                 break;
@@ -2414,40 +3041,65 @@ handleManagement(MsgHeader *header,
                 break;
         case MM_TIME:
                 DBGV("handleManagement: Time\n");
-                unpackMMTime(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+                UNPACK_MANAGEMENT_DATA(Time);
                 handleMMTime(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock, rtOpts);
 		ptpClock->counters.managementMessagesReceived++;
                 break;
         case MM_CLOCK_ACCURACY:
                 DBGV("handleManagement: Clock Accuracy\n");
-                unpackMMClockAccuracy(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+                UNPACK_MANAGEMENT_DATA(ClockAccuracy);
                 handleMMClockAccuracy(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
                 break;
         case MM_UTC_PROPERTIES:
                 DBGV("handleManagement: Utc Properties\n");
-                unpackMMUtcProperties(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+                UNPACK_MANAGEMENT_DATA(UtcProperties);
                 handleMMUtcProperties(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
                 break;
         case MM_TRACEABILITY_PROPERTIES:
                 DBGV("handleManagement: Traceability Properties\n");
-                unpackMMTraceabilityProperties(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+                UNPACK_MANAGEMENT_DATA(TraceabilityProperties);
                 handleMMTraceabilityProperties(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
                 break;
         case MM_DELAY_MECHANISM:
                 DBGV("handleManagement: Delay Mechanism\n");
-                unpackMMDelayMechanism(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+                UNPACK_MANAGEMENT_DATA(DelayMechanism);
                 handleMMDelayMechanism(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
                 break;
         case MM_LOG_MIN_PDELAY_REQ_INTERVAL:
                 DBGV("handleManagement: Log Min Pdelay Req Interval\n");
-                unpackMMLogMinPdelayReqInterval(ptpClock->msgIbuf, &ptpClock->msgTmp.manage, ptpClock);
+                UNPACK_MANAGEMENT_DATA(LogMinPdelayReqInterval);
                 handleMMLogMinPdelayReqInterval(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
 		ptpClock->counters.managementMessagesReceived++;
                 break;
+	case MM_PTPD_COUNTERS:
+		DBGV("handleManagement: PTPd Counters\n");
+		handleMMPtpdCounters(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
+		ptpClock->counters.managementMessagesReceived++;
+		break;
+	case MM_PTPD_SERVO:
+		DBGV("handleManagement: PTPd Servo\n");
+		handleMMPtpdServo(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
+		ptpClock->counters.managementMessagesReceived++;
+		break;
+	case MM_PTPD_SLAVE_STATS:
+		DBGV("handleManagement: PTPd Slave Statistics\n");
+		handleMMPtpdSlaveStats(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
+		ptpClock->counters.managementMessagesReceived++;
+		break;
+	case MM_PTPD_CLEAR_COUNTERS:
+		DBGV("handleManagement: PTPd Clear Counters\n");
+		handleMMPtpdClearCounters(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
+		ptpClock->counters.managementMessagesReceived++;
+		break;
+	case MM_PTPD_SLAVE_TABLE:
+		DBGV("handleManagement: PTPd Slave Table\n");
+		handleMMPtpdSlaveTable(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp, ptpClock);
+		ptpClock->counters.managementMessagesReceived++;
+		break;
 	case MM_FAULT_LOG:
 	case MM_FAULT_LOG_RESET:
 	case MM_TIMESCALE_PROPERTIES:
@@ -2484,25 +3136,167 @@ handleManagement(MsgHeader *header,
 		ptpClock->counters.discardedMessages++;
 	}
 
+}
+
+/* Release the management arena, and drop the TLV pointers into it with it */
+static void
+managementRelease(PtpClock *ptpClock)
+{
+	ptpClock->msgTmp.manage.tlv = NULL;
+	ptpClock->outgoingManageTmp.tlv = NULL;
+	managementArenaReset(&ptpClock->managementArena);
+}
+
+static void
+handleManagement(MsgHeader *header, ssize_t length,
+		 Boolean isFromSelf, RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+	int messageLength;
+	int tlvOffset = 0;
+	UInteger16 tlvLength;
+	uint32_t arenaFailures;
+	UInteger16 responseLength = MANAGEMENT_LENGTH;
+	Enumeration4 responseAction = 0;
+	Octet tlvBuf[PACKET_SIZE];
+	/* handlers may send on their own (e.g. INITIALIZE), so msgObuf is only filled at the end */
+	Octet response[PACKET_SIZE];
+
+	DBGV("Management message received : \n");
+
+	if(!rtOpts->managementEnabled) {
+		DBGV("Dropping management message - management message support disabled");
+		ptpClock->counters.discardedMessages++;
+		return;
+	}
+
+	if (isFromSelf) {
+		DBGV("handleManagement: Ignore message from self \n");
+		return;
+	}
+
+	/* whatever the previous message left allocated goes back in one go */
+	managementRelease(ptpClock);
+
+	msgUnpackManagement(ptpClock->msgIbuf,&ptpClock->msgTmp.manage, header, ptpClock);
+
+	if(ptpClock->msgTmp.manage.tlv == NULL) {
+		DBGV("handleManagement: TLV is empty\n");
+		ptpClock->counters.messageFormatErrors++;
+		return;
+	}
+
+        if(!acceptManagementMessage(ptpClock->portIdentity, ptpClock->msgTmp.manage.targetPortIdentity))
+        {
+                DBGV("handleManagement: The management message was not accepted");
+		ptpClock->counters.discardedMessages++;
+                return;
+        }
+
+	if(!rtOpts->managementSetEnable &&
+	    (ptpClock->msgTmp.manage.actionField == SET ||
+	    ptpClock->msgTmp.manage.actionField == COMMAND)) {
+		DBGV("Dropping SET/COMMAND management message - read-only mode enabled");
+		ptpClock->counters.discardedMessages++;
+		return;
+	}
+
         /* If the management message we received was unicast, we also reply with unicast */
         if((header->flagField0 & PTP_UNICAST) == PTP_UNICAST)
                 ptpClock->LastSlaveAddr = ptpClock->netPath.lastRecvAddr;
         else ptpClock->LastSlaveAddr = 0;
 
-	/* send management message response or acknowledge */
-	if(ptpClock->outgoingManageTmp.tlv->tlvType == TLV_MANAGEMENT) {
-		if(ptpClock->outgoingManageTmp.actionField == RESPONSE ||
-				ptpClock->outgoingManageTmp.actionField == ACKNOWLEDGE) {
-			issueManagementRespOrAck(&ptpClock->outgoingManageTmp, rtOpts, ptpClock);
+	/* never walk past what was received, whatever the header claims */
+	messageLength = ptpClock->msgTmp.manage.header.messageLength;
+	if(messageLength > length)
+		messageLength = length;
+	if(messageLength > PACKET_SIZE)
+		messageLength = PACKET_SIZE;
+
+	/*
+	 * A message may carry several TLVs: each one is handled in turn
+	 * and the responses are packed, in order, into a single reply
+	 */
+	for(;;) {
+
+		ptpClock->outgoingManageTmp.tlv = NULL;
+		tlvLength = managementCachedResponse(&ptpClock->msgTmp.manage,
+				&ptpClock->outgoingManageTmp, tlvBuf, ptpClock);
+
+		if(tlvLength) {
+			ptpClock->counters.managementMessagesReceived++;
+		} else {
+			arenaFailures = ptpClock->managementArena.failures;
+			handleManagementTLV(ptpClock->msgIbuf + tlvOffset, rtOpts, ptpClock);
+			/* a SET or COMMAND may have written any dataset */
+			if(ptpClock->msgTmp.manage.actionField != GET)
+				allDatasetsChanged(ptpClock);
+			if(ptpClock->managementArena.failures != arenaFailures) {
+				/*
+				 * The arena ran out on this TLV: drop what was built for it and
+				 * start over from its header, answering with an error status
+				 */
+				DBG("handleManagement: out of memory for TLV at offset %d\n", tlvOffset);
+				managementRelease(ptpClock);
+				/* a header always fits in an empty arena */
+				unpackManagementTLV(ptpClock->msgIbuf + tlvOffset, &ptpClock->msgTmp.manage, ptpClock);
+				ptpClock->msgTmp.manage.tlv->dataField = NULL;
+				handleErrorManagementMessage(&ptpClock->msgTmp.manage, &ptpClock->outgoingManageTmp,
+					ptpClock, ptpClock->msgTmp.manage.tlv->managementId,
+					GENERAL_ERROR);
+				tlvLength = packManagementResponseTLV(&ptpClock->outgoingManageTmp,
+							tlvBuf, ptpClock);
+			} else if(ptpClock->outgoingManageTmp.tlv != NULL &&
+			    (ptpClock->outgoingManageTmp.tlv->tlvType == TLV_MANAGEMENT_ERROR_STATUS ||
+			    (ptpClock->outgoingManageTmp.tlv->tlvType == TLV_MANAGEMENT &&
+			    (ptpClock->outgoingManageTmp.actionField == RESPONSE ||
+			    ptpClock->outgoingManageTmp.actionField == ACKNOWLEDGE))))
+				tlvLength = packManagementResponseTLV(&ptpClock->outgoingManageTmp,
+							tlvBuf, ptpClock);
 		}
-	} else if(ptpClock->outgoingManageTmp.tlv->tlvType == TLV_MANAGEMENT_ERROR_STATUS) {
-		issueManagementErrorStatus(&ptpClock->outgoingManageTmp, rtOpts, ptpClock);
+
+		if(tlvLength) {
+			if(responseLength + tlvLength > PACKET_SIZE) {
+				DBG("handleManagement: response full, remaining TLVs not answered\n");
+				break;
+			}
+			memcpy(response + responseLength,
+				tlvBuf + MANAGEMENT_LENGTH, tlvLength);
+			if(responseLength == MANAGEMENT_LENGTH)
+				responseAction = ptpClock->outgoingManageTmp.actionField;
+			responseLength += tlvLength;
+		}
+
+		/* next TLV, if there is a complete one */
+		tlvOffset += TL_LENGTH + ptpClock->msgTmp.manage.tlv->lengthField;
+		if(MANAGEMENT_LENGTH + tlvOffset + TLV_LENGTH > messageLength)
+			break;
+
+		managementRelease(ptpClock);
+		unpackManagementTLV(ptpClock->msgIbuf + tlvOffset, &ptpClock->msgTmp.manage, ptpClock);
+		ptpClock->msgTmp.manage.tlv->dataField = NULL;
+		if(MANAGEMENT_LENGTH + tlvOffset + TL_LENGTH +
+		    ptpClock->msgTmp.manage.tlv->lengthField > messageLength) {
+			DBGV("handleManagement: truncated TLV at offset %d\n", tlvOffset);
+			ptpClock->counters.messageFormatErrors++;
+			break;
+		}
+
+	}
+
+	/* send management message response or acknowledge */
+	if(responseLength > MANAGEMENT_LENGTH) {
+		ptpClock->outgoingManageTmp.actionField = responseAction;
+		memcpy(ptpClock->msgObuf + MANAGEMENT_LENGTH, response + MANAGEMENT_LENGTH,
+			responseLength - MANAGEMENT_LENGTH);
+		issueManagementResponse(&ptpClock->outgoingManageTmp, responseLength,
+					rtOpts, ptpClock);
 	}
 
 	/* cleanup msgTmp managementTLV */
 	freeManagementTLV(&ptpClock->msgTmp.manage);
 	/* cleanup outgoing managementTLV */
 	freeManagementTLV(&ptpClock->outgoingManageTmp);
+	managementRelease(ptpClock);
 
 }
 
@@ -2546,7 +3340,7 @@ issueSync(RunTimeOpts *rtOpts,PtpClock *ptpClock)
 	}
 	fromInternalTime(&internalTime,&originTimestamp);
 
-	msgPackSync(ptpClock->msgObuf,&originTimestamp,ptpClock);
+	msgPatchSync(ptpClock->msgObuf,&originTimestamp,ptpClock);
 
 	if (!netSendEvent(ptpClock->msgObuf,SYNC_LENGTH,&ptpClock->netPath,
 		rtOpts, 0, &internalTime)) {
@@ -2578,7 +3372,7 @@ issueFollowup(const TimeInternal *tint,RunTimeOpts *rtOpts,PtpClock *ptpClock, U
 	Timestamp preciseOriginTimestamp;
 	fromInternalTime(tint,&preciseOriginTimestamp);
 	
-	msgPackFollowUp(ptpClock->msgObuf,&preciseOriginTimestamp,ptpClock,sequenceId);	
+	msgPatchFollowUp(ptpClock->msgObuf,&preciseOriginTimestamp,ptpClock,sequenceId);	
 
 	if (!netSendGeneral(ptpClock->msgObuf,FOLLOW_UP_LENGTH,
 			    &ptpClock->netPath, rtOpts, 0)) {
@@ -2615,7 +3409,7 @@ issueDelayReq(RunTimeOpts *rtOpts,PtpClock *ptpClock)
 	fromInternalTime(&internalTime,&originTimestamp);
 
 	// uses current sentDelayReqSequenceId
-	msgPackDelayReq(ptpClock->msgObuf,&originTimestamp,ptpClock);
+	msgPatchDelayReq(ptpClock->msgObuf,&originTimestamp,ptpClock);
 
 	Integer32 dst = 0;
 
@@ -2734,7 +3528,7 @@ issueDelayResp(const TimeInternal *tint,MsgHeader *header,RunTimeOpts *rtOpts, P
 {
 	Timestamp requestReceiptTimestamp;
 	fromInternalTime(tint,&requestReceiptTimestamp);
-	msgPackDelayResp(ptpClock->msgObuf,header,&requestReceiptTimestamp,
+	msgPatchDelayResp(ptpClock->msgObuf,header,&requestReceiptTimestamp,
 			 ptpClock);
 
 	Integer32 dst = 0;
@@ -2789,19 +3583,14 @@ issueManagement(MsgHeader *header,MsgManagement *manage,RunTimeOpts *rtOpts,
 }
 #endif
 
-static void 
-issueManagementRespOrAck(MsgManagement *outgoing, RunTimeOpts *rtOpts,
-		PtpClock *ptpClock)
+/* Send a management response, its TLVs already packed after the management header */
+static void
+issueManagementResponse(MsgManagement *outgoing, UInteger16 length,
+		RunTimeOpts *rtOpts, PtpClock *ptpClock)
 {
 	Integer32 dst = 0;
 
-	/* pack ManagementTLV */
-	msgPackManagementTLV( ptpClock->msgObuf, outgoing, ptpClock);
-
-	/* set header messageLength, the outgoing->tlv->lengthField is now valid */
-	outgoing->header.messageLength = MANAGEMENT_LENGTH +
-					TL_LENGTH +
-					outgoing->tlv->lengthField;
+	outgoing->header.messageLength = length;
 
 	msgPackManagement( ptpClock->msgObuf, outgoing, ptpClock);
 
@@ -2820,36 +3609,6 @@ issueManagementRespOrAck(MsgManagement *outgoing, RunTimeOpts *rtOpts,
 	}
 }
 
-static void
-issueManagementErrorStatus(MsgManagement *outgoing, RunTimeOpts *rtOpts, PtpClock *ptpClock)
-{
-	Integer32 dst = 0;
-
-	/* pack ManagementErrorStatusTLV */
-	msgPackManagementErrorStatusTLV( ptpClock->msgObuf, outgoing, ptpClock);
-
-	/* set header messageLength, the outgoing->tlv->lengthField is now valid */
-	outgoing->header.messageLength = MANAGEMENT_LENGTH +
-					TL_LENGTH +
-					outgoing->tlv->lengthField;
-
-	msgPackManagement( ptpClock->msgObuf, outgoing, ptpClock);
-
-	if (ptpClock->LastSlaveAddr > 0)
-		dst = ptpClock->LastSlaveAddr;
-
-	if(!netSendGeneral(ptpClock->msgObuf, outgoing->header.messageLength,
-			   &ptpClock->netPath, rtOpts, dst)) {
-		DBGV("Management error status can't be sent -> FAULTY state \n");
-		ptpClock->counters.messageSendErrors++;
-		toState(PTP_FAULTY, rtOpts, ptpClock);
-	} else {
-		DBGV("Management error status msg sent \n");
-		ptpClock->counters.managementMessagesSent++;
-	}
-
-}
-
 void
 addForeign(Octet *buf,MsgHeader *header,PtpClock *ptpClock)
 {
@@ -2948,6 +3707,15 @@ updateDatasets(PtpClock* ptpClock, RunTimeOpts* rtOpts)
 			ptpClock->logSyncInterval = rtOpts->syncInterval;
 			ptpClock->logMinPdelayReqInterval = rtOpts->logMinPdelayReqInterval;
 			ptpClock->logMinDelayReqInterval = rtOpts->initial_delayreq;
+			/* IGMP refresh interval may have changed */
+			timerStop(MASTER_NETREFRESH_TIMER, ptpClock->itimer);
+			if( rtOpts->do_IGMP_refresh &&
+			    rtOpts->transport == UDP_IPV4 &&
+			    rtOpts->ip_mode != IPMODE_UNICAST &&
+			    rtOpts->masterRefreshInterval > 9 )
+				timerStart(MASTER_NETREFRESH_TIMER, 
+				   rtOpts->masterRefreshInterval, 
+				   ptpClock->itimer);
 			break;
 		/*
 		 * we are not master so update the port dataset only - parent will be updated
@@ -2971,15 +3739,33 @@ updateDatasets(PtpClock* ptpClock, RunTimeOpts* rtOpts)
 		    break;
 	}
 
+	allDatasetsChanged(ptpClock);
+
 }
 
 void
 clearCounters(PtpClock * ptpClock)
 {
 
+	int i;
+
 	/* TODO: print port info */
 	DBG("Port counters cleared\n");
 	memset(&ptpClock->counters, 0, sizeof(ptpClock->counters));
+	clearRateLimiterCounters(ptpClock->netPath.rateLimiter);
+	clearSlaveTableCounters(ptpClock->slaveTable);
+
+	for (i = 0; i < RXQ_CLASSES; i++) {
+		ptpClock->rxQueues[i].maxDepth = ptpClock->rxQueues[i].depth;
+		ptpClock->rxQueues[i].queued = 0;
+		ptpClock->rxQueues[i].overflows = 0;
+		ptpClock->rxQueues[i].processed = 0;
+		ptpClock->rxQueues[i].latencyTotal = 0;
+		ptpClock->rxQueues[i].latencyMax = 0;
+	}
+
+	ptpClock->managementArena.highWater = ptpClock->managementArena.used;
+	ptpClock->managementArena.failures = 0;
 
 }
 
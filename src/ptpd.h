@@ -115,9 +115,15 @@
 #include "limits.h"
 
 #include "dep/ipv4_acl.h"
+#include "dep/ratelimit.h"
+#include "dep/clockpage.h"
+#include "dep/snapshot.h"
+#include "dep/ntpshm.h"
 
 #include "dep/constants_dep.h"
 #include "dep/datatypes_dep.h"
+#include "dep/ntpserver.h"
+#include "dep/ctlsocket.h"
 
 #ifdef PTPD_NTPDC
 #include "dep/ntpengine/ntpdcontrol.h"
@@ -131,6 +137,7 @@
 #endif
 
 #include "dep/ptpd_dep.h"
+#include "dep/msgview.h"
 #include "dep/iniparser/dictionary.h"
 #include "dep/iniparser/iniparser.h"
 #include "dep/daemonconfig.h"
@@ -143,6 +150,17 @@
 		exit(1); \
 	}
 
+/*
+ * Allocate from the management arena - released all at once by managementArenaReset().
+ * When the arena is full, give up on the TLV: handleManagement() sees the failure
+ * count change and answers the TLV with an error status instead.
+ */
+#define XMALLOC_MANAGEMENT(ptr,size) \
+	if(!((ptr)=managementArenaAlloc(&ptpClock->managementArena, size))) { \
+		DBG("management message arena exhausted\n"); \
+		return; \
+	}
+
 #define IS_SET(data, bitpos) \
 	((data & ( 0x1 << bitpos )) == (0x1 << bitpos))
 
@@ -169,6 +187,18 @@ void integer64_to_internalTime(Integer64,TimeInternal*);
  * \brief Convert TimeInternal structure to Integer64
  */
 void internalTime_to_integer64(TimeInternal, Integer64*);
+/**
+ * \brief Scaled interval conversions: lossless to and from the wire,
+ * rounded to the nearest nanosecond into TimeInternal
+ */
+TimeScaled integer64_to_scaled(const Integer64*);
+void scaled_to_integer64(TimeScaled, Integer64*);
+TimeScaled internalTime_to_scaled(const TimeInternal*);
+void scaled_to_internalTime(TimeScaled, TimeInternal*);
+/**
+ * \brief Difference of two time values as a scaled interval, FALSE if out of range
+ */
+Boolean subTimeScaled(TimeScaled*, const TimeInternal *x, const TimeInternal *y);
 /**
  * \brief Convert TimeInternal into Timestamp structure (defined by the spec)
  */
@@ -229,6 +259,20 @@ void m1(const RunTimeOpts *, PtpClock*);
  */
 void s1(MsgHeader*,MsgAnnounce*,PtpClock*, const RunTimeOpts *);
 
+/**
+ * \brief Data set comparison between two foreign masters
+ * \return Negative if A is better, positive if B is better
+ */
+Integer8 bmcDataSetComparison(const MsgHeader*, const MsgAnnounce*,
+			      const MsgHeader*, const MsgAnnounce*,
+			      const PtpClock*, const RunTimeOpts*);
+
+/**
+ * \brief Rank the foreign masters other than the parent, best first
+ * \return The number of record indices filled
+ */
+int bmcRankForeign(const RunTimeOpts*, const PtpClock*, Integer16*, int);
+
 
 void p1(PtpClock *ptpClock, const RunTimeOpts *rtOpts);
 
@@ -283,10 +327,87 @@ void handleMMUtcProperties(MsgManagement*, MsgManagement*, PtpClock*);
 void handleMMTraceabilityProperties(MsgManagement*, MsgManagement*, PtpClock*);
 void handleMMDelayMechanism(MsgManagement*, MsgManagement*, PtpClock*);
 void handleMMLogMinPdelayReqInterval(MsgManagement*, MsgManagement*, PtpClock*);
+void handleMMPtpdCounters(MsgManagement*, MsgManagement*, PtpClock*);
+void handleMMPtpdServo(MsgManagement*, MsgManagement*, PtpClock*);
+void handleMMPtpdSlaveStats(MsgManagement*, MsgManagement*, PtpClock*);
+void handleMMPtpdClearCounters(MsgManagement*, MsgManagement*, PtpClock*);
+void handleMMPtpdSlaveTable(MsgManagement*, MsgManagement*, PtpClock*);
 void handleMMErrorStatus(MsgManagement*);
 void handleErrorManagementMessage(MsgManagement *incoming, MsgManagement *outgoing,
                                 PtpClock *ptpClock, Enumeration16 mgmtId,
                                 Enumeration16 errorId);
+UInteger16 packManagementResponseTLV(MsgManagement*, Octet*, PtpClock*);
+UInteger16 managementCachedResponse(MsgManagement*, MsgManagement*, Octet*, PtpClock*);
+void datasetChanged(PtpClock*, int);
+void allDatasetsChanged(PtpClock*);
+/** \}*/
+
+/** \name standby.c
+ * -Hot standby measurement of backup masters*/
+ /**\{*/
+/* standby.c */
+void standbySelect(const RunTimeOpts*, PtpClock*);
+void standbySync(const MsgHeader*, const TimeInternal*, const RunTimeOpts*, PtpClock*);
+void standbyFollowUp(const MsgHeader*, const RunTimeOpts*, PtpClock*);
+void standbyDelayResp(const MsgHeader*, const RunTimeOpts*, PtpClock*);
+/**
+ * \brief Hand the warm measurements of a backup master over to the servo
+ * \return TRUE if the new parent had warm measurements
+ */
+Boolean standbySwitch(const RunTimeOpts*, PtpClock*, const PortIdentity*);
+void standbyStatus(const PtpClock*, int*, int*);
+/** \}*/
+
+/** \name monitor.c
+ * -Passive multi-master monitor*/
+ /**\{*/
+/* monitor.c */
+Boolean monitorDomainEnabled(const RunTimeOpts*, UInteger8);
+Boolean monitorParseDomains(RunTimeOpts*);
+void monitorMessage(RunTimeOpts*, PtpClock*, TimeInternal*, ssize_t);
+void monitorStatus(const PtpClock*, FILE*);
+/** \}*/
+
+/** \name slavetable.c
+ * -Master-side slave table built from DelayReq traffic*/
+ /**\{*/
+/* slavetable.c */
+SlaveTable* createSlaveTable(int, int);
+void freeSlaveTable(SlaveTable**);
+double slaveRate(const SlaveRecord*);
+void slaveTableDelayReq(const RunTimeOpts*, PtpClock*, const MsgHeader*, const TimeInternal*);
+void slaveTableTotals(SlaveTable*, SlaveTableTotals*);
+void clearSlaveTableCounters(SlaveTable*);
+void slaveTableStatus(SlaveTable*, FILE*);
+/** \}*/
+
+/** \name boundary.c
+ * -Boundary clock ports and redundant slave paths*/
+ /**\{*/
+/* boundary.c */
+Boolean bcParseInterfaces(RunTimeOpts*);
+void bcPortOptions(RunTimeOpts*, const RunTimeOpts*, const char*);
+Boolean bcInit(RunTimeOpts*, PtpClock*);
+void bcShutdown(PtpClock*);
+void bcUpdateOptions(RunTimeOpts*, PtpClock*);
+Boolean bcClockTaken(const PtpClock*);
+Boolean bcTakeClock(RunTimeOpts*, PtpClock*);
+void bcStateChange(PtpClock*);
+void bcUpdateClock(RunTimeOpts*, PtpClock*);
+void bcPathFailover(PtpClock*);
+void bcStatus(const PtpClock*, FILE*);
+/** \}*/
+
+/** \name domains.c
+ * -Engine instances for other domains*/
+ /**\{*/
+/* domains.c */
+Boolean domainParseInstances(RunTimeOpts*);
+Boolean domainInit(RunTimeOpts*, PtpClock*);
+void domainShutdown(PtpClock*);
+void domainUpdateOptions(RunTimeOpts*, PtpClock*);
+PtpClock* domainDemux(PtpClock*, const Octet*, ssize_t);
+void domainStatus(const PtpClock*, FILE*);
 /** \}*/
 
 /*
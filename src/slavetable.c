@@ -0,0 +1,455 @@
+/*-
+ * Copyright (c) 2014 Wojciech Owczarek,
+ *
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+/**
+ * @file   slavetable.c
+ *
+ * @brief  Master-side slave table built from DelayReq traffic
+ *
+ * A master answers every DelayReq and would otherwise forget it. With
+ * the slave table enabled, each slave - keyed by port identity and
+ * source address - gets a record of its DelayReq count and rate,
+ * sequence gaps, inter-arrival jitter and last-seen time. Slaves that
+ * send faster than ptpengine:slave_flood_factor times the advertised
+ * logMinDelayReqInterval allows are flagged as flooding. The table has
+ * a fixed size with a hash index and LRU eviction, like the rate limiter,
+ * so hundreds of slaves cost a bounded amount of memory and a constant
+ * amount of work per DelayReq.
+ */
+
+#include "ptpd.h"
+
+static double
+slaveTableNow(void)
+{
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1E9;
+
+}
+
+static inline uint32_t
+slaveTableHash(SlaveTable *table, const PortIdentity *portIdentity, Integer32 address)
+{
+
+	uint32_t hash = (uint32_t)address ^ portIdentity->portNumber;
+	int i;
+
+	for (i = 0; i < CLOCK_IDENTITY_LENGTH; i++)
+		hash = hash * 31 + (uint8_t)portIdentity->clockIdentity[i];
+
+	/* Fibonacci hashing - spreads sequential identities */
+	return (uint32_t)(hash * 2654435761U) % table->hashSize;
+
+}
+
+/* Unlink a record from the LRU list */
+static void
+lruRemove(SlaveTable *table, int32_t index)
+{
+
+	SlaveRecord *record = &table->records[index];
+
+	if (record->lruPrev >= 0)
+		table->records[record->lruPrev].lruNext = record->lruNext;
+	else
+		table->lruHead = record->lruNext;
+
+	if (record->lruNext >= 0)
+		table->records[record->lruNext].lruPrev = record->lruPrev;
+	else
+		table->lruTail = record->lruPrev;
+
+}
+
+/* Make a record the most recently seen one */
+static void
+lruPushHead(SlaveTable *table, int32_t index)
+{
+
+	SlaveRecord *record = &table->records[index];
+
+	record->lruPrev = -1;
+	record->lruNext = table->lruHead;
+	if (table->lruHead >= 0)
+		table->records[table->lruHead].lruPrev = index;
+	table->lruHead = index;
+	if (table->lruTail < 0)
+		table->lruTail = index;
+
+}
+
+/* Unlink a record from its hash chain */
+static void
+hashRemove(SlaveTable *table, int32_t index)
+{
+
+	SlaveRecord *record = &table->records[index];
+	int32_t *link = &table->buckets[slaveTableHash(table, &record->portIdentity,
+							record->address)];
+
+	while (*link >= 0) {
+		if (*link == index) {
+			*link = record->hashNext;
+			return;
+		}
+		link = &table->records[*link].hashNext;
+	}
+
+}
+
+/* Stop tracking a record - it stays in the array for reuse */
+static void
+slaveTableRemove(SlaveTable *table, int32_t index)
+{
+
+	lruRemove(table, index);
+	hashRemove(table, index);
+	if (table->records[index].flooding)
+		table->flooding--;
+	table->records[index].inUse = FALSE;
+	table->count--;
+
+}
+
+/* drop the slaves that have stopped sending - at most once a second */
+static void
+slaveTableExpire(SlaveTable *table, double now)
+{
+
+	int32_t index;
+
+	if (now - table->lastExpiry < 1)
+		return;
+	table->lastExpiry = now;
+
+	/* the least recently seen slaves are at the tail */
+	while ((index = table->lruTail) >= 0 &&
+	       now - table->records[index].lastSeen > table->timeout) {
+		slaveTableRemove(table, index);
+		table->records[index].hashNext = table->freeHead;
+		table->freeHead = index;
+		table->expired++;
+	}
+
+}
+
+/* Find a slave, or start tracking it */
+static SlaveRecord *
+slaveTableRecord(SlaveTable *table, const PortIdentity *portIdentity, Integer32 address,
+		 double now)
+{
+
+	int32_t index;
+	uint32_t bucket = slaveTableHash(table, portIdentity, address);
+	SlaveRecord *record;
+
+	for (index = table->buckets[bucket]; index >= 0; index = table->records[index].hashNext) {
+		record = &table->records[index];
+		if (record->address == address &&
+		    record->portIdentity.portNumber == portIdentity->portNumber &&
+		    !memcmp(record->portIdentity.clockIdentity, portIdentity->clockIdentity,
+			    CLOCK_IDENTITY_LENGTH)) {
+			if (table->lruHead != index) {
+				lruRemove(table, index);
+				lruPushHead(table, index);
+			}
+			return record;
+		}
+	}
+
+	if (table->freeHead >= 0) {
+		index = table->freeHead;
+		table->freeHead = table->records[index].hashNext;
+	} else if (table->used < table->capacity) {
+		index = table->used++;
+	} else {
+		index = table->lruTail;
+		slaveTableRemove(table, index);
+		table->evicted++;
+	}
+
+	record = &table->records[index];
+	memset(record, 0, sizeof(SlaveRecord));
+	record->inUse = TRUE;
+	record->portIdentity = *portIdentity;
+	record->address = address;
+	record->firstSeen = now;
+
+	record->hashNext = table->buckets[bucket];
+	table->buckets[bucket] = index;
+	lruPushHead(table, index);
+	table->count++;
+
+	return record;
+
+}
+
+/* Structure initialisation for SlaveTable */
+SlaveTable *
+createSlaveTable(int capacity, int timeout)
+{
+
+	int i;
+	SlaveTable *ret;
+
+	if (capacity < 1)
+		return NULL;
+
+	ret = (SlaveTable *)calloc(1, sizeof(SlaveTable));
+	if (ret == NULL)
+		return NULL;
+
+	ret->capacity = capacity;
+	ret->timeout = timeout;
+	ret->hashSize = capacity * SLAVE_TABLE_HASH_LOAD;
+	ret->buckets = (int32_t *)malloc(ret->hashSize * sizeof(int32_t));
+	ret->records = (SlaveRecord *)calloc(capacity, sizeof(SlaveRecord));
+
+	if (ret->buckets == NULL || ret->records == NULL) {
+		ERROR("Could not allocate memory for slave table\n");
+		freeSlaveTable(&ret);
+		return NULL;
+	}
+
+	for (i = 0; i < ret->hashSize; i++)
+		ret->buckets[i] = -1;
+
+	ret->freeHead = -1;
+	ret->lruHead = -1;
+	ret->lruTail = -1;
+
+	return ret;
+
+}
+
+/* Destroy a SlaveTable structure */
+void
+freeSlaveTable(SlaveTable **table)
+{
+
+	if (*table == NULL)
+		return;
+
+	free((*table)->buckets);
+	free((*table)->records);
+
+	free(*table);
+	*table = NULL;
+
+}
+
+/* DelayReqs per second of a slave, 0 until two have arrived */
+double
+slaveRate(const SlaveRecord *record)
+{
+
+	return (record->requests > 1 && record->meanInterval > 0) ?
+		1.0 / record->meanInterval : 0;
+
+}
+
+/*
+ * Account for a DelayReq answered in master state: called from
+ * handleDelayReq() with the unpacked header and the receive timestamp.
+ */
+void
+slaveTableDelayReq(const RunTimeOpts *rtOpts, PtpClock *ptpClock,
+		   const MsgHeader *header, const TimeInternal *receiveTime)
+{
+
+	SlaveTable *table = ptpClock->slaveTable;
+	SlaveRecord *record;
+	TimeInternal elapsed;
+	UInteger16 step;
+	double now = slaveTableNow();
+	double interval, spacing, floodInterval;
+	char buf[64];
+	struct in_addr in;
+
+	if (table == NULL)
+		return;
+
+	/* picks up timeout changes on reload */
+	table->timeout = rtOpts->slaveTimeout;
+	slaveTableExpire(table, now);
+
+	record = slaveTableRecord(table, &header->sourcePortIdentity,
+				  ptpClock->netPath.lastRecvAddr, now);
+	record->lastSeen = now;
+
+	if (record->requests++ == 0) {
+		record->lastSequenceId = header->sequenceId;
+		record->lastReceiveTime = *receiveTime;
+		return;
+	}
+
+	step = header->sequenceId - record->lastSequenceId;
+	record->lastSequenceId = header->sequenceId;
+
+	/* duplicate, reordered, or the slave restarted its sequence */
+	if (step == 0 || step > SLAVE_MAX_SEQUENCE_GAP) {
+		record->sequenceErrors++;
+		step = 1;
+	} else {
+		record->sequenceGaps += step - 1;
+	}
+
+	subTime(&elapsed, receiveTime, &record->lastReceiveTime);
+	record->lastReceiveTime = *receiveTime;
+	interval = timeInternalToDouble(&elapsed);
+
+	/* clock stepped between the two DelayReqs */
+	if (interval <= 0)
+		return;
+
+	if (record->requests == 2) {
+		record->meanInterval = interval;
+	} else {
+		record->meanInterval += (interval - record->meanInterval) / SLAVE_INTERVAL_WEIGHT;
+		/* jitter of the sending interval - lost DelayReqs do not count */
+		spacing = interval / step;
+		record->jitter += (fabs(spacing - record->meanInterval) - record->jitter) /
+			SLAVE_INTERVAL_WEIGHT;
+	}
+
+	if (record->requests < SLAVE_MIN_REQUESTS)
+		return;
+
+	floodInterval = pow(2, ptpClock->logMinDelayReqInterval) / rtOpts->slaveFloodFactor;
+
+	if (!record->flooding && record->meanInterval < floodInterval) {
+		record->flooding = TRUE;
+		record->floodEvents++;
+		table->flooding++;
+		table->floodEvents++;
+		snprint_PortIdentity(buf, sizeof(buf), &record->portIdentity);
+		in.s_addr = record->address;
+		WARNING("Slave %s (%s) is flooding: %.1f DelayReq/s, advertised %.1f/s\n",
+			buf, inet_ntoa(in), slaveRate(record),
+			pow(2, -ptpClock->logMinDelayReqInterval));
+	} else if (record->flooding &&
+		   record->meanInterval >= floodInterval * SLAVE_FLOOD_HYSTERESIS) {
+		record->flooding = FALSE;
+		table->flooding--;
+		snprint_PortIdentity(buf, sizeof(buf), &record->portIdentity);
+		in.s_addr = record->address;
+		NOTICE("Slave %s (%s) is no longer flooding: %.1f DelayReq/s\n",
+			buf, inet_ntoa(in), slaveRate(record));
+	}
+
+}
+
+/* Aggregates over the tracked slaves, after expiring the silent ones */
+void
+slaveTableTotals(SlaveTable *table, SlaveTableTotals *totals)
+{
+
+	int32_t index;
+	const SlaveRecord *record;
+
+	memset(totals, 0, sizeof(SlaveTableTotals));
+
+	if (table == NULL)
+		return;
+
+	slaveTableExpire(table, slaveTableNow());
+
+	for (index = table->lruHead; index >= 0; index = record->lruNext) {
+		record = &table->records[index];
+		totals->slaves++;
+		if (record->flooding)
+			totals->flooding++;
+		totals->sequenceGaps += record->sequenceGaps;
+		totals->sequenceErrors += record->sequenceErrors;
+		if (slaveRate(record) > totals->maxRate)
+			totals->maxRate = slaveRate(record);
+		if (record->jitter > totals->maxJitter)
+			totals->maxJitter = record->jitter;
+	}
+
+}
+
+/* Clear slave table counters */
+void
+clearSlaveTableCounters(SlaveTable *table)
+{
+
+	int i;
+
+	if (table == NULL)
+		return;
+
+	table->evicted = 0;
+	table->expired = 0;
+	table->floodEvents = 0;
+	for (i = 0; i < table->used; i++) {
+		table->records[i].sequenceGaps = 0;
+		table->records[i].sequenceErrors = 0;
+		table->records[i].floodEvents = 0;
+	}
+
+}
+
+/* slave table summary and flooding slaves in the status file */
+void
+slaveTableStatus(SlaveTable *table, FILE *out)
+{
+
+	SlaveTableTotals totals;
+	int32_t index;
+	const SlaveRecord *record;
+	char port[64];
+	struct in_addr in;
+
+	slaveTableTotals(table, &totals);
+
+	fprintf(out, "%-19s:  %d (capacity %d), %d flooding, max %.1f DelayReq/s, "
+		"max jitter %.0f us\n", "Slaves", totals.slaves, table->capacity,
+		totals.flooding, totals.maxRate, totals.maxJitter * 1E6);
+	fprintf(out, "%-19s:  %u sequence gaps, %u sequence errors, %u evicted, %u expired\n",
+		"Slave counters", totals.sequenceGaps, totals.sequenceErrors,
+		table->evicted, table->expired);
+
+	if (!totals.flooding)
+		return;
+
+	for (index = table->lruHead; index >= 0; index = record->lruNext) {
+		record = &table->records[index];
+		if (!record->flooding)
+			continue;
+		snprint_PortIdentity(port, sizeof(port), &record->portIdentity);
+		in.s_addr = record->address;
+		fprintf(out, "%-19s:  %s (%s), %.1f DelayReq/s\n", "  Flooding",
+			port, inet_ntoa(in), slaveRate(record));
+	}
+
+}
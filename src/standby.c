@@ -0,0 +1,459 @@
+/*-
+ * Copyright (c) 2014 Wojciech Owczarek,
+ *
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file   standby.c
+ *
+ * @brief  Hot standby measurement of backup masters
+ *
+ * While in SLAVE state, the best few foreign masters other than the parent
+ * are measured alongside it: offset from their multicast Syncs, path delay
+ * from their responses to our own (multicast) Delay Requests. Each has its
+ * own offset and delay filters. When the BMC selects one of them as the
+ * new parent, its warm path delay and filters are handed to the servo,
+ * instead of the servo carrying on with the old master's path delay and
+ * settling again.
+ */
+
+#include "ptpd.h"
+
+/* slot times are monotonic - immune to clock steps */
+static double
+standbyNow(void)
+{
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1E9;
+
+}
+
+/* measurements older than this are not used for a failover */
+static double
+standbyStaleTime(const PtpClock *ptpClock)
+{
+
+	Integer8 logInterval = ptpClock->logSyncInterval;
+	double staleTime;
+
+	if (ptpClock->delayMechanism == E2E &&
+	    ptpClock->logMinDelayReqInterval > logInterval)
+		logInterval = ptpClock->logMinDelayReqInterval;
+
+	staleTime = 4 * pow(2, logInterval);
+
+	return (staleTime > STANDBY_MIN_STALE_TIME) ?
+		staleTime : STANDBY_MIN_STALE_TIME;
+
+}
+
+static Boolean
+standbyIsWarm(const PtpClock *ptpClock, const StandbyMaster *master)
+{
+
+	if (!master->inUse || !master->haveSync)
+		return FALSE;
+
+	if (ptpClock->delayMechanism == E2E &&
+	    master->delaySamples < STANDBY_MIN_DELAY_SAMPLES)
+		return FALSE;
+
+	return (standbyNow() - master->lastUpdate) <= standbyStaleTime(ptpClock);
+
+}
+
+static Boolean
+standbyIdentityMatch(const PortIdentity *a, const PortIdentity *b)
+{
+
+	return !memcmp(a->clockIdentity, b->clockIdentity, CLOCK_IDENTITY_LENGTH) &&
+		a->portNumber == b->portNumber;
+
+}
+
+static const char *
+standbyName(const PortIdentity *portIdentity)
+{
+
+	static char buf[64];
+
+	snprint_PortIdentity(buf, sizeof(buf), portIdentity);
+	return buf;
+
+}
+
+static StandbyMaster *
+standbyFind(PtpClock *ptpClock, const PortIdentity *portIdentity)
+{
+
+	int i;
+
+	for (i = 0; i < STANDBY_MAX_MASTERS; i++)
+		if (ptpClock->standby[i].inUse &&
+		    standbyIdentityMatch(&ptpClock->standby[i].portIdentity, portIdentity))
+			return &ptpClock->standby[i];
+
+	return NULL;
+
+}
+
+/* clear a slot's measurements, keeping its filters */
+static void
+standbyReset(StandbyMaster *master)
+{
+
+	Filter *ofm_filt = master->ofm_filt;
+	Filter *owd_filt = master->owd_filt;
+
+	FilterClear(ofm_filt);
+	FilterClear(owd_filt);
+	memset(master, 0, sizeof(StandbyMaster));
+	master->ofm_filt = ofm_filt;
+	master->owd_filt = owd_filt;
+
+}
+
+static void
+standbyRelease(StandbyMaster *master)
+{
+
+	if (!master->inUse)
+		return;
+
+	DBG("Standby: released %s\n", standbyName(&master->portIdentity));
+	standbyReset(master);
+
+}
+
+/* offset from a standby master, same arithmetic as updateOffset() */
+static void
+standbyUpdateOffset(StandbyMaster *master, const TimeInternal *send_time,
+		    const TimeInternal *recv_time, TimeScaled correctionField,
+		    const RunTimeOpts *rtOpts, const PtpClock *ptpClock)
+{
+
+	TimeInternal master_to_slave_delay;
+	TimeScaled delayMS, pathDelay = 0;
+
+	if (ptpClock->leapSecondInProgress)
+		return;
+
+	/* clocks too far apart to measure: not usable until we are stepped */
+	if (!subTimeScaled(&delayMS, recv_time, send_time)) {
+		master->haveSync = FALSE;
+		FilterClear(master->ofm_filt);
+		return;
+	}
+	scaled_to_internalTime(delayMS, &master_to_slave_delay);
+
+	if (rtOpts->maxDelay &&
+	    (master_to_slave_delay.seconds ||
+	     master_to_slave_delay.nanoseconds > rtOpts->maxDelay))
+		return;
+
+	master->delayMS = delayMS - correctionField;
+	master->haveSync = TRUE;
+
+	if (ptpClock->delayMechanism == E2E) {
+		/* no path delay yet - the offset is meaningless */
+		if (!master->delaySamples)
+			return;
+		pathDelay = internalTime_to_scaled(&master->meanPathDelay);
+	} else if (ptpClock->delayMechanism == P2P) {
+		pathDelay = internalTime_to_scaled(&ptpClock->peerMeanPathDelay);
+	}
+
+	scaled_to_internalTime(master->delayMS - pathDelay, &master->offsetFromMaster);
+
+	if (master->offsetFromMaster.seconds) {
+		FilterClear(master->ofm_filt);
+		return;
+	}
+
+	FilterFeed(master->ofm_filt, &master->offsetFromMaster.nanoseconds);
+	master->lastUpdate = standbyNow();
+
+	DBGV("Standby: %s offset %d ns\n",
+	     standbyName(&master->portIdentity),
+	     master->offsetFromMaster.nanoseconds);
+
+}
+
+/*
+ * Keep hot standby slots for the best rtOpts->standbyMasters foreign
+ * masters other than the parent. Called after every BMC run; outside
+ * SLAVE state all slots are released.
+ */
+void
+standbySelect(const RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	Integer16 ranking[STANDBY_MAX_MASTERS];
+	int count = 0;
+	int i, j;
+	Boolean wanted;
+	StandbyMaster *master;
+	char stiffness[32];
+
+	if (ptpClock->portState == PTP_SLAVE && rtOpts->standbyMasters > 0)
+		count = bmcRankForeign(rtOpts, ptpClock, ranking,
+				       min(rtOpts->standbyMasters, STANDBY_MAX_MASTERS));
+
+	/* drop the slots no longer among the best */
+	for (i = 0; i < STANDBY_MAX_MASTERS; i++) {
+		master = &ptpClock->standby[i];
+		if (!master->inUse)
+			continue;
+		wanted = FALSE;
+		for (j = 0; j < count; j++)
+			if (standbyIdentityMatch(&master->portIdentity,
+			    &ptpClock->foreign[ranking[j]].header.sourcePortIdentity))
+				wanted = TRUE;
+		if (!wanted) {
+			standbyRelease(master);
+		} else if (master->lastUpdate &&
+			   standbyNow() - master->lastUpdate > standbyStaleTime(ptpClock)) {
+			/* gone quiet for a while - start over */
+			PortIdentity portIdentity = master->portIdentity;
+
+			DBG("Standby: measurements from %s are stale\n",
+			    standbyName(&portIdentity));
+			standbyReset(master);
+			master->inUse = TRUE;
+			master->portIdentity = portIdentity;
+		}
+	}
+
+	/* take a free slot for each new one */
+	for (j = 0; j < count; j++) {
+		const PortIdentity *portIdentity =
+			&ptpClock->foreign[ranking[j]].header.sourcePortIdentity;
+
+		if (standbyFind(ptpClock, portIdentity) != NULL)
+			continue;
+
+		for (i = 0; i < STANDBY_MAX_MASTERS; i++)
+			if (!ptpClock->standby[i].inUse)
+				break;
+		if (i == STANDBY_MAX_MASTERS)
+			break;
+
+		master = &ptpClock->standby[i];
+		standbyReset(master);
+		master->inUse = TRUE;
+		master->portIdentity = *portIdentity;
+		snprintf(stiffness, sizeof(stiffness), "%d", rtOpts->s);
+		FilterConfigure(master->owd_filt, "stiffness", stiffness);
+		INFO("Standby: measuring backup master %s\n",
+		     standbyName(portIdentity));
+	}
+
+}
+
+/* Sync from a foreign master other than the parent */
+void
+standbySync(const MsgHeader *header, const TimeInternal *tint,
+	    const RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	StandbyMaster *master = standbyFind(ptpClock, &header->sourcePortIdentity);
+	TimeInternal originTimestamp;
+
+	if (master == NULL)
+		return;
+
+	master->syncCount++;
+
+	if ((header->flagField0 & PTP_TWO_STEP) == PTP_TWO_STEP) {
+		master->waitingForFollow = TRUE;
+		master->syncSequenceId = header->sequenceId;
+		master->syncReceiveTime = *tint;
+		master->syncCorrectionField = integer64_to_scaled(&header->correctionField);
+		return;
+	}
+
+	master->waitingForFollow = FALSE;
+	msgUnpackSync(ptpClock->msgIbuf, &ptpClock->msgTmp.sync);
+	toInternalTime(&originTimestamp, &ptpClock->msgTmp.sync.originTimestamp);
+	standbyUpdateOffset(master, &originTimestamp, tint,
+			    integer64_to_scaled(&header->correctionField),
+			    rtOpts, ptpClock);
+
+}
+
+/* Follow_Up from a foreign master other than the parent */
+void
+standbyFollowUp(const MsgHeader *header, const RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	StandbyMaster *master = standbyFind(ptpClock, &header->sourcePortIdentity);
+	TimeInternal preciseOriginTimestamp;
+
+	if (master == NULL || !master->waitingForFollow ||
+	    master->syncSequenceId != header->sequenceId)
+		return;
+
+	master->waitingForFollow = FALSE;
+	msgUnpackFollowUp(ptpClock->msgIbuf, &ptpClock->msgTmp.follow);
+	toInternalTime(&preciseOriginTimestamp,
+		       &ptpClock->msgTmp.follow.preciseOriginTimestamp);
+	standbyUpdateOffset(master, &preciseOriginTimestamp, &master->syncReceiveTime,
+			    integer64_to_scaled(&header->correctionField) +
+			    master->syncCorrectionField,
+			    rtOpts, ptpClock);
+
+}
+
+/*
+ * Delay_Resp from a foreign master other than the parent, answering our
+ * last Delay_Req - same arithmetic as updateDelay()
+ */
+void
+standbyDelayResp(const MsgHeader *header, const RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+
+	StandbyMaster *master = standbyFind(ptpClock, &header->sourcePortIdentity);
+	TimeInternal receiveTimestamp;
+	TimeInternal meanPathDelay;
+
+	if (master == NULL || !master->haveSync ||
+	    ptpClock->leapSecondInProgress)
+		return;
+
+	if (ptpClock->sentDelayReqSequenceId != (UInteger16)(header->sequenceId + 1))
+		return;
+
+	msgUnpackDelayResp(ptpClock->msgIbuf, &ptpClock->msgTmp.resp);
+	toInternalTime(&receiveTimestamp, &ptpClock->msgTmp.resp.receiveTimestamp);
+
+	master->delayRespCount++;
+	if (!subTimeScaled(&master->delaySM, &receiveTimestamp,
+			   &ptpClock->delay_req_send_time)) {
+		FilterClear(master->owd_filt);
+		return;
+	}
+
+	scaled_to_internalTime((master->delaySM + master->delayMS -
+		integer64_to_scaled(&header->correctionField)) / 2, &meanPathDelay);
+
+	if (meanPathDelay.seconds) {
+		FilterClear(master->owd_filt);
+		return;
+	}
+
+	if (meanPathDelay.nanoseconds < 0)
+		return;
+
+	FilterFeed(master->owd_filt, &meanPathDelay.nanoseconds);
+	master->meanPathDelay = meanPathDelay;
+	master->delaySamples++;
+	master->lastUpdate = standbyNow();
+
+	DBGV("Standby: %s path delay %d ns\n",
+	     standbyName(&master->portIdentity),
+	     master->meanPathDelay.nanoseconds);
+
+}
+
+/*
+ * The BMC has selected a new parent while in SLAVE state. If it has been
+ * measured in hot standby, hand its path delay and warm filters over to
+ * the servo, so that it carries on without settling again. The parent's
+ * filters go back to the slot, which is released.
+ */
+Boolean
+standbySwitch(const RunTimeOpts *rtOpts, PtpClock *ptpClock, const PortIdentity *newParent)
+{
+
+	StandbyMaster *master = standbyFind(ptpClock, newParent);
+	Filter *filter;
+
+	if (master == NULL)
+		return FALSE;
+
+	if (!standbyIsWarm(ptpClock, master)) {
+		INFO("Standby: no recent measurements from the new master\n");
+		standbyRelease(master);
+		return FALSE;
+	}
+
+	filter = ptpClock->ofm_filt;
+	ptpClock->ofm_filt = master->ofm_filt;
+	master->ofm_filt = filter;
+
+	if (ptpClock->delayMechanism == E2E) {
+		filter = ptpClock->owd_filt;
+		ptpClock->owd_filt = master->owd_filt;
+		master->owd_filt = filter;
+		ptpClock->meanPathDelay = master->meanPathDelay;
+		datasetChanged(ptpClock, MGMT_CACHE_CURRENT_DS);
+		ptpClock->delaySM = master->delaySM;
+	}
+
+	ptpClock->delayMS = master->delayMS;
+	ptpClock->delayMSOverflow = FALSE;
+	ptpClock->waitingForFollow = FALSE;
+
+#ifdef PTPD_STATISTICS
+	/* the outlier filters have learned the old master's delays */
+	resetDoubleMovingStdDev(ptpClock->delayMSRawStats);
+	resetDoubleMovingMean(ptpClock->delayMSFiltered);
+	resetDoubleMovingStdDev(ptpClock->delaySMRawStats);
+	resetDoubleMovingMean(ptpClock->delaySMFiltered);
+	ptpClock->delayMSoutlier = FALSE;
+	ptpClock->delaySMoutlier = FALSE;
+#endif /* PTPD_STATISTICS */
+
+	NOTICE("Standby: switched to warm measurements, offset %d ns, path delay %d ns\n",
+	       master->offsetFromMaster.nanoseconds,
+	       master->meanPathDelay.nanoseconds);
+
+	standbyRelease(master);
+	return TRUE;
+
+}
+
+/* number of backup masters measured, and how many of them are warm */
+void
+standbyStatus(const PtpClock *ptpClock, int *tracked, int *warm)
+{
+
+	int i;
+
+	*tracked = 0;
+	*warm = 0;
+
+	for (i = 0; i < STANDBY_MAX_MASTERS; i++) {
+		if (!ptpClock->standby[i].inUse)
+			continue;
+		(*tracked)++;
+		if (standbyIsWarm(ptpClock, &ptpClock->standby[i]))
+			(*warm)++;
+	}
+
+}
@@ -0,0 +1,253 @@
+/*-
+ * Copyright (c) 2014 Wojciech Owczarek,
+ *
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file   acl_bench.c
+ *
+ * @brief  IPv4 access list lookup benchmark
+ *
+ * Builds access lists of random subnets through createIpv4AccessList()
+ * and times matchIpv4AccessList() - a scan below ACL_TRIE_MIN_ENTRIES,
+ * the prefix trie from there on - against the first-match linear scan
+ * the trie replaced. Every lookup address is also checked against the
+ * linear result in both processing orders; any disagreement fails the run.
+ *
+ * The crossover is measured by linking ipv4_acl.o built with
+ * -DACL_TRIE_MIN_ENTRIES=1 (always the trie) and with a huge value
+ * (never the trie), see test/testing.org.
+ *
+ * Links against the objects of a built tree, see test/Makefile.
+ */
+
+#include "ptpd.h"
+
+/* ptpd.c is not linked in, it owns these */
+RunTimeOpts rtOpts;
+Boolean startupInProgress;
+PtpClock *G_ptpClock = NULL;
+
+#define DEFAULT_LOOKUPS	1000000
+
+static uint32_t rngState = 0x2545f491;
+
+/* xorshift32 - reproducible across runs and platforms */
+static uint32_t
+rng(void)
+{
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 17;
+	rngState ^= rngState << 5;
+	return rngState;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1E9;
+}
+
+/* The pre-trie matcher: first entry covering the address wins */
+static int
+linearMatchTable(const uint32_t addr, MaskTable* table)
+{
+	int i;
+
+	if(table == NULL || table->numEntries == 0)
+		return 0;
+
+	for(i = 0; i < table->numEntries; i++) {
+		if((table->entries[i].bitmask & addr) == table->entries[i].network) {
+			table->entries[i].hitCount++;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* Same permit / deny semantics as matchIpv4AccessList() */
+static int
+linearMatch(Ipv4AccessList* acl, const uint32_t addr)
+{
+	int matchPermit = linearMatchTable(addr, acl->permitTable);
+	int matchDeny = linearMatchTable(addr, acl->denyTable);
+
+	if(acl->processingOrder == ACL_PERMIT_DENY)
+		return matchPermit && !matchDeny;
+
+	return !(matchDeny && !matchPermit);
+}
+
+/* Random subnets, /8 to /32, as an access list string */
+static char*
+randomList(int count, uint32_t *networks, uint32_t *bitmasks)
+{
+	char *list, *pos;
+	uint32_t network, bitmask;
+	int i, len;
+
+	if((list = malloc(count * 20 + 1)) == NULL)
+		return NULL;
+
+	for(i = 0, pos = list; i < count; i++) {
+		len = 8 + rng() % 25;
+		bitmask = ~0U << (32 - len);
+		network = rng() & bitmask;
+		if(networks != NULL) {
+			networks[i] = network;
+			bitmasks[i] = bitmask;
+		}
+		pos += sprintf(pos, "%s%u.%u.%u.%u/%d", i ? "," : "",
+		    network >> 24, (network >> 16) & 0xff,
+		    (network >> 8) & 0xff, network & 0xff, len);
+	}
+
+	return list;
+}
+
+static int
+runSize(int entries, int lookups)
+{
+	Ipv4AccessList *acl;
+	uint32_t *networks, *bitmasks, *addrs;
+	char *permit, *deny;
+	double start, matchTime, linearTime;
+	volatile int sink = 0;
+	int i, order, n, errors = 0, permitted = 0;
+
+	networks = calloc(entries, sizeof(uint32_t));
+	bitmasks = calloc(entries, sizeof(uint32_t));
+	addrs = calloc(lookups, sizeof(uint32_t));
+	permit = randomList(entries, networks, bitmasks);
+	deny = randomList(entries / 4 + 1, NULL, NULL);
+
+	if(networks == NULL || bitmasks == NULL || addrs == NULL ||
+	    permit == NULL || deny == NULL) {
+		fprintf(stderr, "out of memory\n");
+		exit(2);
+	}
+
+	/* half the lookups fall inside a permitted subnet, half are random */
+	for(i = 0; i < lookups; i++) {
+		n = rng() % entries;
+		addrs[i] = (i & 1) ? rng() : (networks[n] | (rng() & ~bitmasks[n]));
+	}
+
+	for(order = ACL_PERMIT_DENY; order <= ACL_DENY_PERMIT; order++) {
+
+		if((acl = createIpv4AccessList(permit, deny, order)) == NULL) {
+			fprintf(stderr, "could not create access list with %d entries\n", entries);
+			exit(2);
+		}
+
+		for(i = 0; i < lookups; i++) {
+			if(matchIpv4AccessList(acl, addrs[i]) != linearMatch(acl, addrs[i])) {
+				if(errors++ < 10)
+					fprintf(stderr, "mismatch: %08x, %d entries, order %d\n",
+					    addrs[i], entries, order);
+			}
+		}
+
+		start = now();
+		for(i = 0; i < lookups; i++)
+			sink += matchIpv4AccessList(acl, addrs[i]);
+		matchTime = now() - start;
+		permitted = sink;
+
+		start = now();
+		for(i = 0; i < lookups; i++)
+			sink += linearMatch(acl, addrs[i]);
+		linearTime = now() - start;
+
+		printf("%8d %10s %12.1f %6s %9.1f %9.1fx %7.1f%%\n", entries,
+		    order == ACL_PERMIT_DENY ? "permit-deny" : "deny-permit",
+		    linearTime * 1E9 / lookups,
+		    acl->permitTable->nodes != NULL ? "trie" : "scan",
+		    matchTime * 1E9 / lookups,
+		    linearTime / matchTime, 100.0 * permitted / lookups);
+
+		sink = 0;
+		freeIpv4AccessList(&acl);
+	}
+
+	free(networks);
+	free(bitmasks);
+	free(addrs);
+	free(permit);
+	free(deny);
+
+	return errors;
+}
+
+int
+main(int argc, char **argv)
+{
+	static const int sizes[] = { 8, 32, 64, 128, 512, 4096, 16384 };
+	int lookups = DEFAULT_LOOKUPS;
+	int entries = 0;
+	int i, c, errors = 0;
+
+	while((c = getopt(argc, argv, "n:l:s:h")) != -1) {
+		switch(c) {
+		case 'n': entries = atoi(optarg); break;
+		case 'l': lookups = atoi(optarg); break;
+		case 's': rngState = strtoul(optarg, NULL, 0) | 1; break;
+		default:
+			fprintf(stderr, "usage: %s [-n entries] [-l lookups] [-s seed]\n"
+			    "  without -n, runs 8 to 16384 permit entries\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if(lookups <= 0 || entries < 0) {
+		fprintf(stderr, "invalid arguments\n");
+		return 2;
+	}
+
+	/* parse errors for the lists would be logged here */
+	rtOpts.logLevel = LOG_ERR;
+
+	printf(" entries      order   linear ns/op    matcher ns/op   speedup  permit\n");
+
+	if(entries > 0)
+		errors = runSize(entries, lookups);
+	else
+		for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+			errors += runSize(sizes[i], lookups);
+
+	if(errors) {
+		printf("FAIL: %d lookups disagree with the linear matcher\n", errors);
+		return 1;
+	}
+
+	printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,298 @@
+/*-
+ * Copyright (c) 2014 Wojciech Owczarek,
+ *
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file   clockpage_test.c
+ *
+ * @brief  Clock page reader / writer protocol test
+ *
+ * Publishes a clock page with the daemon's writer (clockpage.c) and
+ * reads it through a separate read-only mapping with the client reader
+ * from clockpage.h, the way an application would:
+ *
+ * - a writer thread publishes updates as fast as it can while reader
+ *   threads check every snapshot for fields from different updates;
+ * - a page left mid-update (odd sequence, writer gone) makes the reader
+ *   give up with -2 instead of spinning, and the client sees INVALID;
+ * - a page without the magic number is rejected with -1;
+ * - after shutdown the page reads as INVALID.
+ *
+ * Links against the objects of a built tree, see test/Makefile.
+ */
+
+#include "ptpd.h"
+
+#include <pthread.h>
+#include <sys/mman.h>
+
+/* ptpd.c is not linked in, it owns these */
+RunTimeOpts rtOpts;
+Boolean startupInProgress;
+PtpClock *G_ptpClock = NULL;
+
+#define READERS		3
+#define DEFAULT_DURATION	1.0
+
+static int failures = 0;
+
+#define CHECK(expr, ...) \
+	do { \
+		if(!(expr)) { \
+			fprintf(stderr, "FAIL %s:%d: %s: ", __FILE__, __LINE__, #expr); \
+			fprintf(stderr, __VA_ARGS__); \
+			fprintf(stderr, "\n"); \
+			failures++; \
+		} \
+	} while(0)
+
+typedef struct {
+	const volatile PtpdClockPage *page;
+	unsigned long reads;
+	unsigned long busy;
+	unsigned long torn;
+	unsigned long invalid;
+} Reader;
+
+static volatile int running = 1;
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1E9;
+}
+
+/*
+ * Update k sets the offset and the path delay to k ns, the grandmaster
+ * identity bytes to k and steps removed to k & 0xff; without a std dev
+ * the error bound is |delay| + |offset|. A snapshot holding anything
+ * else mixes two updates.
+ */
+static void
+writeUpdate(PtpClock *ptpClock, uint32_t k)
+{
+	ptpClock->offsetFromMaster.nanoseconds = k;
+	ptpClock->meanPathDelay.nanoseconds = k;
+	ptpClock->stepsRemoved = k & 0xff;
+	memset(ptpClock->grandmasterIdentity, k & 0xff, CLOCK_IDENTITY_LENGTH);
+	clockPageUpdate(&rtOpts, ptpClock, TRUE);
+}
+
+static Boolean
+consistent(const PtpdClockPage *snap)
+{
+	int i;
+	int64_t k = snap->offsetNs;
+
+	if(snap->meanPathDelayNs != k || snap->stepsRemoved != (k & 0xff) ||
+	    snap->errorBoundNs != 2.0 * k)
+		return FALSE;
+	for(i = 0; i < sizeof(snap->grandmasterIdentity); i++)
+		if(snap->grandmasterIdentity[i] != (k & 0xff))
+			return FALSE;
+	return TRUE;
+}
+
+static void*
+readerThread(void *arg)
+{
+	Reader *reader = arg;
+	PtpdClockPage snap;
+	int ret;
+
+	while(running) {
+		ret = ptpdClockPageRead(reader->page, &snap);
+		if(ret == -2) {
+			/* writer preempted mid-update for longer than the retries */
+			reader->busy++;
+			continue;
+		}
+		if(ret != 0) {
+			reader->invalid++;
+			continue;
+		}
+		reader->reads++;
+		if(!consistent(&snap) && reader->torn++ < 5)
+			fprintf(stderr, "torn snapshot: offset %lld delay %lld bound %.0f\n",
+			    (long long)snap.offsetNs, (long long)snap.meanPathDelayNs,
+			    snap.errorBoundNs);
+	}
+
+	return NULL;
+}
+
+static void
+testConcurrent(PtpClock *ptpClock, const volatile PtpdClockPage *page, double duration)
+{
+	pthread_t threads[READERS];
+	Reader readers[READERS];
+	unsigned long reads = 0, busy = 0, torn = 0, invalid = 0;
+	uint32_t k = 0;
+	double end;
+	int i;
+
+	writeUpdate(ptpClock, k++);
+
+	memset(readers, 0, sizeof(readers));
+	for(i = 0; i < READERS; i++) {
+		readers[i].page = page;
+		if(pthread_create(&threads[i], NULL, readerThread, &readers[i]) != 0) {
+			fprintf(stderr, "could not start reader thread\n");
+			exit(2);
+		}
+	}
+
+	for(end = now() + duration; now() < end; )
+		writeUpdate(ptpClock, k++);
+
+	running = 0;
+	for(i = 0; i < READERS; i++) {
+		pthread_join(threads[i], NULL);
+		reads += readers[i].reads;
+		busy += readers[i].busy;
+		torn += readers[i].torn;
+		invalid += readers[i].invalid;
+	}
+
+	printf("concurrent: %u updates, %lu reads, %lu busy, %lu torn\n",
+	    k, reads, busy, torn);
+
+	CHECK(torn == 0, "%lu snapshots mix two updates", torn);
+	CHECK(invalid == 0, "%lu reads rejected the page", invalid);
+	CHECK(reads > 0, "no successful reads");
+	CHECK(page->updateCount == k, "update count %u, expected %u", page->updateCount, k);
+}
+
+static void
+testStuck(PtpClock *ptpClock, const volatile PtpdClockPage *page)
+{
+	PtpdClockPage snap;
+	struct timespec ts;
+	double bound;
+	double start;
+	int ret;
+
+	/* the writer dies between the two sequence increments */
+	ptpClock->clockPage->sequence++;
+	PTPD_CLOCKPAGE_BARRIER();
+
+	start = now();
+	ret = ptpdClockPageRead(page, &snap);
+	CHECK(ret == -2, "stuck page read returned %d", ret);
+	CHECK(now() - start < 1.0, "gave up after %.3f s", now() - start);
+	ret = ptpdClockPageGetTime(page, &ts, &bound);
+	CHECK(ret == PTPD_CLOCKPAGE_INVALID, "stuck page lock state %d", ret);
+
+	/* and the page is readable again once the update completes */
+	ptpClock->clockPage->sequence++;
+	ret = ptpdClockPageRead(page, &snap);
+	CHECK(ret == 0 && consistent(&snap), "read after recovery returned %d", ret);
+}
+
+static void
+testInvalid(void)
+{
+	PtpdClockPage page, snap;
+	int ret;
+
+	memset(&page, 0, sizeof(page));
+	ret = ptpdClockPageRead(&page, &snap);
+	CHECK(ret == -1, "page without magic returned %d", ret);
+	page.magic = PTPD_CLOCKPAGE_MAGIC;
+	page.version = PTPD_CLOCKPAGE_VERSION + 1;
+	ret = ptpdClockPageRead(&page, &snap);
+	CHECK(ret == -1, "page with a future version returned %d", ret);
+	ret = ptpdClockPageRead(NULL, &snap);
+	CHECK(ret == -1, "NULL page returned %d", ret);
+}
+
+int
+main(int argc, char **argv)
+{
+	PtpClock *ptpClock;
+	const volatile PtpdClockPage *page;
+	PtpdClockPage snap;
+	double duration = DEFAULT_DURATION;
+	int fd, c;
+
+	while((c = getopt(argc, argv, "d:h")) != -1) {
+		switch(c) {
+		case 'd': duration = atof(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-d seconds]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	/* INFO from clockPageInit() is not interesting here */
+	rtOpts.logLevel = LOG_ERR;
+	snprintf(rtOpts.clockPageFile, PATH_MAX, "/tmp/clockpage_test.%d", (int)getpid());
+
+	if((ptpClock = calloc(1, sizeof(PtpClock))) == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return 2;
+	}
+	ptpClock->portState = PTP_SLAVE;
+	ptpClock->delayMechanism = E2E;
+
+	if(!clockPageInit(&rtOpts, ptpClock)) {
+		fprintf(stderr, "could not create %s\n", rtOpts.clockPageFile);
+		return 2;
+	}
+
+	/* a client's view: a separate read-only mapping */
+	if((fd = open(rtOpts.clockPageFile, O_RDONLY)) < 0 ||
+	    (page = mmap(NULL, sizeof(PtpdClockPage), PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		fprintf(stderr, "could not map %s\n", rtOpts.clockPageFile);
+		clockPageShutdown(&rtOpts, ptpClock);
+		return 2;
+	}
+	close(fd);
+
+	testInvalid();
+	testConcurrent(ptpClock, page, duration);
+	testStuck(ptpClock, page);
+
+	clockPageShutdown(&rtOpts, ptpClock);
+	CHECK(ptpdClockPageRead(page, &snap) == 0 && snap.lockState == PTPD_CLOCKPAGE_INVALID,
+	    "lock state after shutdown %u", snap.lockState);
+	CHECK(access(rtOpts.clockPageFile, F_OK) != 0, "page file not removed");
+
+	munmap((void*)page, sizeof(PtpdClockPage));
+	free(ptpClock);
+
+	if(failures) {
+		printf("FAIL: %d checks failed\n", failures);
+		return 1;
+	}
+
+	printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,340 @@
+#!/usr/bin/env python3
+#
+# Management message fuzz and leak test.
+#
+# Starts ptpd2 on the loopback interface with management SET enabled and
+# sends it valid and malformed management messages: every management ID
+# and action, lying TLV and text lengths, truncated and padded messages,
+# several TLVs per message, random error status TLVs and random byte
+# flips. Fails if the daemon dies or exits uncleanly, if its resident
+# size grows past the limit after the warm-up, or if the management
+# arena reports failed allocations.
+#
+# Run it as root (ptpd2 binds ports 319/320), preferably against a
+# sanitizer build:
+#
+#   ./configure CFLAGS="-g -O1 -fsanitize=address" && make
+#   test/mgmt_fuzz.py src/ptpd2
+#
+# or under valgrind with --valgrind (the RSS check is skipped then).
+# Extra arguments after the binary are passed to ptpd2.
+
+import argparse
+import os
+import random
+import re
+import signal
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+PTP_GENERAL_PORT = 320
+HEADER_LENGTH = 34
+MANAGEMENT_LENGTH = 48
+
+GET, SET, RESPONSE, COMMAND, ACKNOWLEDGE = range(5)
+TLV_MANAGEMENT, TLV_MANAGEMENT_ERROR_STATUS = 1, 2
+
+MANAGEMENT_IDS = (
+    [0x0000 + i for i in range(8)] +
+    [0x2000 + i for i in range(0x22)] +
+    [0x4000, 0x4001, 0x4002, 0x6000, 0x6001] +
+    [0xC000 + i for i in range(5)]
+)
+
+# IDs with PTPText / PortAddress members, worth more length games
+TEXT_IDS = [0x0001, 0x0002, 0x201F, 0x2002]
+
+# SET / COMMAND on these takes the daemon off the air for the rest of the
+# run, or clears the counters the results are read from
+DISRUPTIVE_IDS = {
+    0x0005,     # INITIALIZE
+    0x2007,     # DOMAIN
+    0x200C,     # VERSION_NUMBER
+    0x200E,     # DISABLE_PORT
+    0x200F,     # TIME
+    0x4002,     # PRIMARY_DOMAIN
+    0xC003,     # PTPD_CLEAR_COUNTERS
+}
+
+
+class Abort(Exception):
+    pass
+
+
+def tlv(mgmt_id, data=b'', tlv_type=TLV_MANAGEMENT, length=None):
+    if length is None:
+        length = 2 + len(data)
+    return struct.pack('!HHH', tlv_type, length & 0xffff, mgmt_id) + data
+
+
+def management(tlvs, seq, action=GET, length=None):
+    body = (b'\xff' * 8 + b'\xff\xff' +
+            bytes([1, 1, action & 0x0f, 0]) + b''.join(tlvs))
+    if length is None:
+        length = HEADER_LENGTH + len(body)
+    header = (bytes([0x0d, 0x02]) + struct.pack('!H', length & 0xffff) +
+              bytes([0, 0, 0x04, 0]) + b'\0' * 8 + b'\0' * 4 +
+              b'mgmtfuzz' + struct.pack('!HHBb', 1, seq & 0xffff, 4, 0x7f))
+    return header + body
+
+
+def rand_bytes(rng, n):
+    return bytes(rng.getrandbits(8) for _ in range(n))
+
+
+def rand_payload(rng, mgmt_id):
+    n = rng.choice([0, 1, 2, 3, 4, 8, rng.randrange(0, 160)])
+    data = bytearray(rand_bytes(rng, n))
+    # a PTPText is a length octet followed by the text: make it lie
+    if mgmt_id in TEXT_IDS and data:
+        data[0] = rng.choice([0, 1, len(data), len(data) + 1, 0xff])
+    return bytes(data)
+
+
+def sanitise(msg):
+    """Keep the daemon reachable: our domain and version, no disruptive SETs."""
+    msg = bytearray(msg)
+    if len(msg) > 4:
+        msg[1] = (msg[1] & 0xf0) | 2
+        msg[4] = 0
+    if len(msg) > 46 and (msg[46] & 0x0f) not in (GET, RESPONSE, ACKNOWLEDGE):
+        offset = MANAGEMENT_LENGTH
+        while offset + 6 <= len(msg):
+            length, mgmt_id = struct.unpack('!HH', msg[offset + 2:offset + 6])
+            if mgmt_id in DISRUPTIVE_IDS:
+                msg[offset + 4:offset + 6] = b'\0\0'
+            if length < 2:
+                break
+            offset += 4 + length
+    return bytes(msg)
+
+
+def fuzz_message(rng, seq):
+    mgmt_id = rng.choice(MANAGEMENT_IDS)
+    kind = rng.choice(['get', 'get', 'set', 'set', 'action', 'tlvlen',
+                       'multi', 'trunc', 'msglen', 'tlvtype', 'flip',
+                       'garbage'])
+
+    if kind == 'get':
+        return management([tlv(mgmt_id)], seq)
+    if kind == 'set':
+        return management([tlv(mgmt_id, rand_payload(rng, mgmt_id))], seq,
+                          rng.choice([SET, COMMAND]))
+    if kind == 'action':
+        return management([tlv(mgmt_id, rand_payload(rng, mgmt_id))], seq,
+                          rng.randrange(16))
+    if kind == 'tlvlen':
+        data = rand_payload(rng, mgmt_id)
+        return management([tlv(mgmt_id, data, length=rng.choice(
+            [0, 1, 2, 3, 0xffff, len(data) + 2 + rng.randrange(-4, 64)]))],
+            seq, rng.choice([GET, SET]))
+    if kind == 'multi':
+        return management([tlv(rng.choice(MANAGEMENT_IDS),
+                               rand_payload(rng, mgmt_id))
+                           for _ in range(rng.randrange(2, 9))],
+                          seq, rng.choice([GET, SET]))
+    if kind == 'trunc':
+        msg = management([tlv(mgmt_id, rand_payload(rng, mgmt_id))], seq,
+                         rng.choice([GET, SET]))
+        return msg[:rng.randrange(len(msg))]
+    if kind == 'msglen':
+        return management([tlv(mgmt_id, rand_payload(rng, mgmt_id))], seq,
+                          rng.choice([GET, SET]),
+                          length=rng.randrange(0, 0x10000))
+    if kind == 'tlvtype':
+        return management([tlv(mgmt_id, rand_payload(rng, mgmt_id),
+                               tlv_type=rng.choice(
+                                   [TLV_MANAGEMENT_ERROR_STATUS, 0,
+                                    rng.randrange(0x10000)]))],
+                          seq, rng.randrange(5))
+    if kind == 'flip':
+        msg = bytearray(management([tlv(mgmt_id, rand_payload(rng, mgmt_id))],
+                                   seq, rng.choice([GET, SET])))
+        for _ in range(rng.randrange(1, 6)):
+            msg[rng.randrange(len(msg))] ^= 1 << rng.randrange(8)
+        return bytes(msg)
+    # garbage behind a plausible header
+    msg = bytearray(rand_bytes(rng, rng.randrange(MANAGEMENT_LENGTH, 300)))
+    msg[0] = 0x0d
+    return bytes(msg)
+
+
+def rss_kb(pid):
+    try:
+        with open('/proc/%d/status' % pid) as f:
+            for line in f:
+                if line.startswith('VmRSS:'):
+                    return int(line.split()[1])
+    except OSError:
+        pass
+    return None
+
+
+def dump_counters(proc, log_path):
+    """SIGUSR2 makes ptpd2 log its counters - return the latest values."""
+    size = os.path.getsize(log_path)
+    proc.send_signal(signal.SIGUSR2)
+    time.sleep(0.5)
+    with open(log_path, errors='replace') as f:
+        f.seek(size)
+        text = f.read()
+    counters = {}
+    for name in ('managementMessagesReceived', 'managementMessagesSent',
+                 'discardedMessages'):
+        m = re.search(r'%s : (\d+)' % name, text)
+        counters[name] = int(m.group(1)) if m else None
+    m = re.search(r'Management arena: max used (\d+) of (\d+) bytes, '
+                  r'failed allocations (\d+)', text)
+    if m:
+        counters['arenaHighWater'] = int(m.group(1))
+        counters['arenaSize'] = int(m.group(2))
+        counters['arenaFailures'] = int(m.group(3))
+    return counters
+
+
+def send_rounds(sock, rng, proc, first, count, rate):
+    batch = 32
+    start = time.time()
+    for i in range(first, first + count):
+        sock.sendto(sanitise(fuzz_message(rng, i)),
+                    ('127.0.0.1', PTP_GENERAL_PORT))
+        if (i - first) % batch == batch - 1:
+            if proc.poll() is not None:
+                return False
+            ahead = (i - first + 1) / rate - (time.time() - start)
+            if ahead > 0:
+                time.sleep(ahead)
+    return proc.poll() is None
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Fuzz the ptpd2 management message path and check for leaks')
+    parser.add_argument('ptpd2', help='ptpd2 binary')
+    parser.add_argument('options', nargs='*', help='extra ptpd2 options')
+    parser.add_argument('-n', '--rounds', type=int, default=50000,
+                        help='messages to send (default 50000)')
+    parser.add_argument('-r', '--rate', type=float, default=2000,
+                        help='messages per second (default 2000)')
+    parser.add_argument('-s', '--seed', type=int, default=None,
+                        help='random seed (default: random, printed)')
+    parser.add_argument('--rss-limit', type=int, default=64,
+                        help='allowed RSS growth after warm-up in kB (default 64)')
+    parser.add_argument('--valgrind', action='store_true',
+                        help='run ptpd2 under valgrind memcheck')
+    parser.add_argument('--keep', action='store_true',
+                        help='keep the work directory with the ptpd2 log')
+    args = parser.parse_args()
+
+    seed = args.seed if args.seed is not None else random.randrange(1 << 32)
+    rng = random.Random(seed)
+    work = tempfile.mkdtemp(prefix='mgmt_fuzz.')
+    log_path = os.path.join(work, 'ptpd2.log')
+
+    cmd = [args.ptpd2, '-C', '-i', 'lo', '-s',
+           '--clock:no_adjust=y',
+           '--ptpengine:management_enable=y',
+           '--ptpengine:management_set_enable=y',
+           '--global:lock_file=' + os.path.join(work, 'ptpd2.lock'),
+           '--global:status_file=' + os.path.join(work, 'ptpd2.status'),
+           '--global:control_socket_file=' + os.path.join(work, 'ptpd2.sock')
+           ] + args.options
+    if args.valgrind:
+        cmd = ['valgrind', '--leak-check=full', '--errors-for-leak-kinds=definite',
+               '--error-exitcode=99'] + cmd
+
+    print('seed %d, %d messages at %.0f/s, work directory %s' %
+          (seed, args.rounds, args.rate, work))
+
+    log = open(log_path, 'w')
+    proc = subprocess.Popen(cmd, stdout=log, stderr=subprocess.STDOUT)
+    failures = []
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(('127.0.0.1', 0))
+
+    try:
+        time.sleep(10 if args.valgrind else 2)
+        if proc.poll() is not None:
+            failures.append('ptpd2 did not start')
+            raise Abort()
+
+        warmup = max(args.rounds // 10, 1)
+        if not send_rounds(sock, rng, proc, 0, warmup, args.rate):
+            failures.append('ptpd2 died during the warm-up')
+            raise Abort()
+        time.sleep(0.5)
+        rss_before = rss_kb(proc.pid)
+
+        if not send_rounds(sock, rng, proc, warmup, args.rounds - warmup, args.rate):
+            failures.append('ptpd2 died')
+            raise Abort()
+        time.sleep(0.5)
+        after = dump_counters(proc, log_path)
+        rss_after = rss_kb(proc.pid)
+
+        # unsupported management IDs and TLV types are counted as discarded
+        print('messages sent %d: received %s, discarded %s, responses sent %s' %
+              (args.rounds, after['managementMessagesReceived'],
+               after['discardedMessages'], after['managementMessagesSent']))
+        if not after['managementMessagesReceived']:
+            failures.append('no management messages were handled')
+
+        if 'arenaHighWater' in after:
+            print('management arena: max used %d of %d bytes, failed allocations %d' %
+                  (after['arenaHighWater'], after['arenaSize'], after['arenaFailures']))
+            if after['arenaFailures']:
+                failures.append('failed management arena allocations')
+        else:
+            failures.append('no management arena counters in the log')
+
+        if not args.valgrind and rss_before and rss_after:
+            print('RSS after warm-up %d kB, at the end %d kB' % (rss_before, rss_after))
+            if rss_after - rss_before > args.rss_limit:
+                failures.append('RSS grew by %d kB' % (rss_after - rss_before))
+
+    except Abort:
+        pass
+    finally:
+        if proc.poll() is None:
+            proc.send_signal(signal.SIGTERM)
+            try:
+                proc.wait(timeout=60 if args.valgrind else 10)
+            except subprocess.TimeoutExpired:
+                proc.kill()
+                proc.wait()
+                failures.append('ptpd2 did not shut down')
+        log.close()
+        sock.close()
+
+    if proc.returncode not in (0, None) and not failures:
+        failures.append('ptpd2 exited with status %d' % proc.returncode)
+
+    with open(log_path, errors='replace') as f:
+        text = f.read()
+    for pattern in ('ERROR: AddressSanitizer', 'ERROR: LeakSanitizer',
+                    'runtime error:', 'definitely lost: [1-9]',
+                    'Invalid (read|write)'):
+        if re.search(pattern, text):
+            failures.append('log contains "%s"' % pattern)
+
+    if failures:
+        print('FAIL (seed %d): %s' % (seed, '; '.join(failures)))
+        print('ptpd2 log: %s' % log_path)
+        return 1
+
+    if not args.keep:
+        for name in os.listdir(work):
+            os.unlink(os.path.join(work, name))
+        os.rmdir(work)
+
+    print('PASS')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,450 @@
+/*-
+ * Copyright (c) 2014 Wojciech Owczarek,
+ *
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file   msgview_bench.c
+ *
+ * @brief  Message view vs. unpack benchmark
+ *
+ * Replays a synthesised multicast stream - Announce, Sync, Follow_Up and
+ * Delay_Resp for a number of slaves, part of it from a foreign domain -
+ * through two receive paths: the unpack-everything path processMessage()
+ * used before the message views (header and body unpacked, then checked),
+ * and the current one (version / domain and the Delay_Resp requesting
+ * port checked on the view, only accepted messages unpacked). Before
+ * timing, every field read through a view is compared with the unpacked
+ * value; any difference fails the run.
+ *
+ * Links against the objects of a built tree, see test/Makefile.
+ */
+
+#include "ptpd.h"
+
+/* ptpd.c is not linked in, it owns these */
+RunTimeOpts rtOpts;
+Boolean startupInProgress;
+PtpClock *G_ptpClock = NULL;
+
+#define STREAM_LENGTH	4096
+#define SLOT_SIZE	128
+#define OUR_DOMAIN	0
+#define OUR_PORT	1
+
+typedef struct {
+	Octet buf[SLOT_SIZE];
+	ssize_t length;
+} Packet;
+
+/* What the handlers would see: enough to keep the compiler honest */
+typedef struct {
+	uint64_t sum;
+	unsigned long accepted;
+	unsigned long unpacked;
+} Result;
+
+static Packet stream[STREAM_LENGTH];
+static MsgHeader header;
+static MsgSync syncMsg;
+static MsgFollowUp followUp;
+static MsgDelayResp delayResp;
+static MsgAnnounce announce;
+static const Octet ourIdentity[CLOCK_IDENTITY_LENGTH] = { 0, 1, 2, 0xff, 0xfe, 3, 4, 5 };
+static const Octet masterIdentity[CLOCK_IDENTITY_LENGTH] = { 0, 9, 8, 0xff, 0xfe, 7, 6, 5 };
+
+static uint32_t rngState = 0x9e3779b9;
+
+static uint32_t
+rng(void)
+{
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 17;
+	rngState ^= rngState << 5;
+	return rngState;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1E9;
+}
+
+static void
+put16(Octet *p, UInteger16 v)
+{
+	v = flip16(v);
+	memcpy(p, &v, 2);
+}
+
+static void
+put32(Octet *p, UInteger32 v)
+{
+	v = flip32(v);
+	memcpy(p, &v, 4);
+}
+
+static void
+putTimestamp(Octet *p)
+{
+	put16(p, 0);
+	put32(p + 2, 1400000000 + rng() % 1000);
+	put32(p + 6, rng() % 1000000000);
+}
+
+/*
+ * Per group of 16: 1 Announce, 2 Sync + Follow_Up, 11 Delay_Resp of
+ * which 1 is ours - a master answering a dozen slaves over multicast.
+ */
+static void
+buildStream(int foreignPercent)
+{
+	static const Enumeration4 group[16] = {
+		ANNOUNCE, SYNC, FOLLOW_UP, DELAY_RESP, DELAY_RESP, DELAY_RESP,
+		DELAY_RESP, SYNC, FOLLOW_UP, DELAY_RESP, DELAY_RESP, DELAY_RESP,
+		DELAY_RESP, DELAY_RESP, DELAY_RESP, DELAY_RESP
+	};
+	Packet *pkt;
+	Octet *buf;
+	int i, ours;
+
+	memset(stream, 0, sizeof(stream));
+
+	for(i = 0; i < STREAM_LENGTH; i++) {
+		pkt = &stream[i];
+		buf = pkt->buf;
+
+		switch(group[i % 16]) {
+		case ANNOUNCE:   pkt->length = ANNOUNCE_LENGTH; break;
+		case SYNC:       pkt->length = SYNC_LENGTH; break;
+		case FOLLOW_UP:  pkt->length = FOLLOW_UP_LENGTH; break;
+		default:         pkt->length = DELAY_RESP_LENGTH; break;
+		}
+
+		buf[0] = group[i % 16];
+		buf[1] = 2;
+		put16(buf + 2, pkt->length);
+		buf[4] = ((int)(rng() % 100) < foreignPercent) ? OUR_DOMAIN + 1 : OUR_DOMAIN;
+		buf[6] = (group[i % 16] == SYNC) ? PTP_TWO_STEP : 0;
+		put32(buf + 12, rng() % 65536);
+		memcpy(buf + 20, masterIdentity, CLOCK_IDENTITY_LENGTH);
+		put16(buf + 28, 1);
+		put16(buf + 30, i);
+		buf[33] = (group[i % 16] == DELAY_RESP) ? 0 : 0xff;
+
+		putTimestamp(buf + HEADER_LENGTH);
+
+		if(group[i % 16] == DELAY_RESP) {
+			/* the first Delay_Resp of each group answers our Delay_Req */
+			ours = (i % 16) == 3;
+			memcpy(buf + 44, ourIdentity, CLOCK_IDENTITY_LENGTH);
+			if(!ours)
+				buf[44 + CLOCK_IDENTITY_LENGTH - 1] ^= rng() % 255 + 1;
+			put16(buf + 52, OUR_PORT);
+		} else if(group[i % 16] == ANNOUNCE) {
+			put16(buf + 44, 35);
+			buf[47] = 128;
+			buf[48] = 6;
+			buf[49] = 0x21;
+			put16(buf + 50, 0x4e5d);
+			buf[52] = 128;
+			memcpy(buf + 53, masterIdentity, CLOCK_IDENTITY_LENGTH);
+			put16(buf + 61, 0);
+			buf[63] = 0x20;
+		}
+	}
+}
+
+static uint64_t
+timestampSum(const Timestamp *ts)
+{
+	return ts->secondsField.lsb + ts->nanosecondsField;
+}
+
+/* Unpack first, then decide - processMessage() before the message views */
+static void
+unpackPath(const Packet *pkt, Result *res)
+{
+	Octet *buf = (Octet *)pkt->buf;
+
+	msgUnpackHeader(buf, &header);
+	if(header.versionPTP != 2 || header.domainNumber != OUR_DOMAIN)
+		return;
+
+	res->accepted++;
+	res->sum += header.sequenceId;
+
+	switch(header.messageType) {
+	case SYNC:
+		msgUnpackSync(buf, &syncMsg);
+		res->sum += timestampSum(&syncMsg.originTimestamp);
+		break;
+	case FOLLOW_UP:
+		msgUnpackFollowUp(buf, &followUp);
+		res->sum += timestampSum(&followUp.preciseOriginTimestamp);
+		break;
+	case DELAY_RESP:
+		msgUnpackDelayResp(buf, &delayResp);
+		if(memcmp(delayResp.requestingPortIdentity.clockIdentity, ourIdentity,
+			  CLOCK_IDENTITY_LENGTH) ||
+		   delayResp.requestingPortIdentity.portNumber != OUR_PORT)
+			return;
+		res->sum += timestampSum(&delayResp.receiveTimestamp);
+		break;
+	case ANNOUNCE:
+		msgUnpackAnnounce(buf, &announce);
+		res->sum += announce.grandmasterPriority1 + announce.stepsRemoved;
+		break;
+	}
+
+	res->unpacked++;
+}
+
+/* Decide on the view, unpack only what is kept - processMessage() now */
+static void
+viewPath(const Packet *pkt, Result *res)
+{
+	Octet *buf = (Octet *)pkt->buf;
+	PortIdentity requestingPortIdentity;
+	MsgView view;
+
+	msgViewInit(&view, buf, pkt->length);
+	if(msgViewHeader_versionPTP(&view) != 2 ||
+	   msgViewHeader_domainNumber(&view) != OUR_DOMAIN)
+		return;
+
+	res->accepted++;
+
+	if(msgViewHeader_messageType(&view) == DELAY_RESP) {
+		requestingPortIdentity = msgViewDelayResp_requestingPortIdentity(&view);
+		if(memcmp(requestingPortIdentity.clockIdentity, ourIdentity,
+			  CLOCK_IDENTITY_LENGTH) ||
+		   requestingPortIdentity.portNumber != OUR_PORT) {
+			res->sum += msgViewHeader_sequenceId(&view);
+			return;
+		}
+	}
+
+	msgUnpackHeader(buf, &header);
+	res->sum += header.sequenceId;
+
+	switch(header.messageType) {
+	case SYNC:
+		msgUnpackSync(buf, &syncMsg);
+		res->sum += timestampSum(&syncMsg.originTimestamp);
+		break;
+	case FOLLOW_UP:
+		msgUnpackFollowUp(buf, &followUp);
+		res->sum += timestampSum(&followUp.preciseOriginTimestamp);
+		break;
+	case DELAY_RESP:
+		msgUnpackDelayResp(buf, &delayResp);
+		res->sum += timestampSum(&delayResp.receiveTimestamp);
+		break;
+	case ANNOUNCE:
+		msgUnpackAnnounce(buf, &announce);
+		res->sum += announce.grandmasterPriority1 + announce.stepsRemoved;
+		break;
+	}
+
+	res->unpacked++;
+}
+
+#define CHECK(expr) \
+	do { \
+		if(!(expr)) { \
+			fprintf(stderr, "packet %d: %s\n", i, #expr); \
+			errors++; \
+		} \
+	} while(0)
+
+static int
+timestampEqual(Timestamp a, Timestamp b)
+{
+	return a.secondsField.msb == b.secondsField.msb &&
+	    a.secondsField.lsb == b.secondsField.lsb &&
+	    a.nanosecondsField == b.nanosecondsField;
+}
+
+/* Every field the views expose must read the same as the unpacked message */
+static int
+crossCheck(void)
+{
+	PortIdentity pid;
+	ClockQuality cq;
+	Integer64 cf;
+	MsgView view;
+	Octet *buf;
+	int i, errors = 0;
+
+	for(i = 0; i < STREAM_LENGTH; i++) {
+		buf = stream[i].buf;
+		msgViewInit(&view, buf, stream[i].length);
+		msgUnpackHeader(buf, &header);
+
+		CHECK(msgViewHeader_transportSpecific(&view) == header.transportSpecific);
+		CHECK(msgViewHeader_messageType(&view) == header.messageType);
+		CHECK(msgViewHeader_versionPTP(&view) == header.versionPTP);
+		CHECK(msgViewHeader_messageLength(&view) == header.messageLength);
+		CHECK(msgViewHeader_domainNumber(&view) == header.domainNumber);
+		CHECK(msgViewHeader_flagField0(&view) == header.flagField0);
+		CHECK(msgViewHeader_flagField1(&view) == header.flagField1);
+		cf = msgViewHeader_correctionField(&view);
+		CHECK(cf.msb == header.correctionField.msb && cf.lsb == header.correctionField.lsb);
+		pid = msgViewHeader_sourcePortIdentity(&view);
+		CHECK(!memcmp(&pid.clockIdentity, header.sourcePortIdentity.clockIdentity,
+			      CLOCK_IDENTITY_LENGTH));
+		CHECK(pid.portNumber == header.sourcePortIdentity.portNumber);
+		CHECK(msgViewHeader_sequenceId(&view) == header.sequenceId);
+		CHECK(msgViewHeader_controlField(&view) == header.controlField);
+		CHECK(msgViewHeader_logMessageInterval(&view) == header.logMessageInterval);
+
+		switch(header.messageType) {
+		case SYNC:
+			msgUnpackSync(buf, &syncMsg);
+			CHECK(timestampEqual(msgViewSync_originTimestamp(&view),
+					     syncMsg.originTimestamp));
+			break;
+		case FOLLOW_UP:
+			msgUnpackFollowUp(buf, &followUp);
+			CHECK(timestampEqual(msgViewFollowUp_preciseOriginTimestamp(&view),
+					     followUp.preciseOriginTimestamp));
+			break;
+		case DELAY_RESP:
+			msgUnpackDelayResp(buf, &delayResp);
+			CHECK(timestampEqual(msgViewDelayResp_receiveTimestamp(&view),
+					     delayResp.receiveTimestamp));
+			pid = msgViewDelayResp_requestingPortIdentity(&view);
+			CHECK(!memcmp(pid.clockIdentity,
+				      delayResp.requestingPortIdentity.clockIdentity,
+				      CLOCK_IDENTITY_LENGTH));
+			CHECK(pid.portNumber == delayResp.requestingPortIdentity.portNumber);
+			break;
+		case ANNOUNCE:
+			msgUnpackAnnounce(buf, &announce);
+			CHECK(timestampEqual(msgViewAnnounce_originTimestamp(&view),
+					     announce.originTimestamp));
+			CHECK(msgViewAnnounce_currentUtcOffset(&view) == announce.currentUtcOffset);
+			CHECK(msgViewAnnounce_grandmasterPriority1(&view) == announce.grandmasterPriority1);
+			cq = msgViewAnnounce_grandmasterClockQuality(&view);
+			CHECK(cq.clockClass == announce.grandmasterClockQuality.clockClass);
+			CHECK(cq.clockAccuracy == announce.grandmasterClockQuality.clockAccuracy);
+			CHECK(cq.offsetScaledLogVariance ==
+			      announce.grandmasterClockQuality.offsetScaledLogVariance);
+			CHECK(msgViewAnnounce_grandmasterPriority2(&view) == announce.grandmasterPriority2);
+			CHECK(!memcmp(msgViewAnnounce_grandmasterIdentity(&view),
+				      announce.grandmasterIdentity, CLOCK_IDENTITY_LENGTH));
+			CHECK(msgViewAnnounce_stepsRemoved(&view) == announce.stepsRemoved);
+			CHECK(msgViewAnnounce_timeSource(&view) == announce.timeSource);
+			break;
+		}
+
+		CHECK(!view.error);
+
+		/* one octet short of the header: zero and the sticky error flag */
+		msgViewInit(&view, buf, HEADER_LENGTH - 1);
+		CHECK(msgViewHeader_logMessageInterval(&view) == 0 && view.error);
+		CHECK(msgViewHeader_sequenceId(&view) == header.sequenceId && view.error);
+	}
+
+	return errors;
+}
+
+static double
+runPath(void (*path)(const Packet *, Result *), int rounds, Result *res)
+{
+	double start;
+	int r, i;
+
+	memset(res, 0, sizeof(Result));
+	start = now();
+	for(r = 0; r < rounds; r++)
+		for(i = 0; i < STREAM_LENGTH; i++)
+			path(&stream[i], res);
+
+	return (now() - start) * 1E9 / ((double)rounds * STREAM_LENGTH);
+}
+
+int
+main(int argc, char **argv)
+{
+	static const int foreign[] = { 0, 50, 90 };
+	Result unpackResult, viewResult;
+	double unpackTime, viewTime;
+	int rounds = 500;
+	int i, c, errors = 0;
+
+	while((c = getopt(argc, argv, "r:h")) != -1) {
+		switch(c) {
+		case 'r': rounds = atoi(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-r rounds of %d messages]\n",
+			    argv[0], STREAM_LENGTH);
+			return 2;
+		}
+	}
+
+	if(rounds <= 0) {
+		fprintf(stderr, "invalid arguments\n");
+		return 2;
+	}
+
+	rtOpts.logLevel = LOG_ERR;
+
+	printf(" foreign   accepted   unpacked   unpack ns/msg   view ns/msg   speedup\n");
+
+	for(i = 0; i < sizeof(foreign) / sizeof(foreign[0]); i++) {
+		buildStream(foreign[i]);
+		errors += crossCheck();
+
+		unpackTime = runPath(unpackPath, rounds, &unpackResult);
+		viewTime = runPath(viewPath, rounds, &viewResult);
+
+		/* both paths must keep, and hand on, the same messages */
+		if(unpackResult.sum != viewResult.sum ||
+		   unpackResult.unpacked != viewResult.unpacked ||
+		   unpackResult.accepted != viewResult.accepted) {
+			fprintf(stderr, "paths disagree with %d%% foreign traffic\n", foreign[i]);
+			errors++;
+		}
+
+		printf("%7d%% %9.1f%% %9.1f%% %15.1f %13.1f %8.2fx\n", foreign[i],
+		    100.0 * viewResult.accepted / ((double)rounds * STREAM_LENGTH),
+		    100.0 * viewResult.unpacked / ((double)rounds * STREAM_LENGTH),
+		    unpackTime, viewTime, unpackTime / viewTime);
+	}
+
+	if(errors) {
+		printf("FAIL: %d view / unpack differences\n", errors);
+		return 1;
+	}
+
+	printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,360 @@
+/*-
+ * Copyright (c) 2014 Wojciech Owczarek,
+ *
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file   msgview_test.c
+ *
+ * @brief  Message view layout test against the packers
+ *
+ * The Sync, Follow_Up, Delay_Resp and Announce .def files only drive
+ * the message views (dep/msgview.h) - msg.c packs and unpacks those
+ * messages with its own offsets. This test keeps the two in step: each
+ * message is packed with its msgPack* function from known values and
+ * every field is read back through the view accessors and through the
+ * matching msgUnpack* function. It also checks that each layout adds
+ * up to the message length, and that a message one octet short sets
+ * the view's error flag.
+ *
+ * Links against the objects of a built tree, see test/Makefile.
+ */
+
+#include "ptpd.h"
+
+/* ptpd.c is not linked in, it owns these */
+RunTimeOpts rtOpts;
+Boolean startupInProgress;
+PtpClock *G_ptpClock = NULL;
+
+static int failures = 0;
+
+#define CHECK(expr) \
+	do { \
+		if(!(expr)) { \
+			fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, #expr); \
+			failures++; \
+		} \
+	} while(0)
+
+static const Octet clockIdentity[CLOCK_IDENTITY_LENGTH] =
+	{ 0x00, 0x1b, 0x21, 0xff, 0xfe, 0x3c, 0x4d, 0x5e };
+static const Octet gmIdentity[CLOCK_IDENTITY_LENGTH] =
+	{ 0xec, 0x46, 0x70, 0xff, 0xfe, 0x01, 0x02, 0x03 };
+static const Octet requesterIdentity[CLOCK_IDENTITY_LENGTH] =
+	{ 0x68, 0x05, 0xca, 0xff, 0xfe, 0xa1, 0xb2, 0xc3 };
+
+static Octet buf[PACKET_SIZE];
+
+static Boolean
+timestampEqual(Timestamp a, Timestamp b)
+{
+	return a.secondsField.msb == b.secondsField.msb &&
+	    a.secondsField.lsb == b.secondsField.lsb &&
+	    a.nanosecondsField == b.nanosecondsField;
+}
+
+static Boolean
+portIdentityEqual(PortIdentity a, const Octet *clockIdentity, UInteger16 portNumber)
+{
+	return !memcmp(a.clockIdentity, clockIdentity, CLOCK_IDENTITY_LENGTH) &&
+	    a.portNumber == portNumber;
+}
+
+/* all fields distinct and multi-octet fields with distinct octets */
+static void
+setupClock(PtpClock *ptpClock)
+{
+	memset(ptpClock, 0, sizeof(PtpClock));
+	ptpClock->versionNumber = 2;
+	ptpClock->domainNumber = 44;
+	memcpy(ptpClock->portIdentity.clockIdentity, clockIdentity, CLOCK_IDENTITY_LENGTH);
+	ptpClock->portIdentity.portNumber = 0x0102;
+	ptpClock->twoStepFlag = TRUE;
+	ptpClock->sentSyncSequenceId = 0x1234;
+	ptpClock->sentAnnounceSequenceId = 0x2345;
+	ptpClock->logSyncInterval = -3;
+	ptpClock->logAnnounceInterval = 1;
+	ptpClock->logMinDelayReqInterval = -2;
+	ptpClock->grandmasterPriority1 = 127;
+	ptpClock->grandmasterPriority2 = 129;
+	ptpClock->clockQuality.clockClass = 6;
+	ptpClock->clockQuality.clockAccuracy = 0x21;
+	ptpClock->clockQuality.offsetScaledLogVariance = 0x4e5d;
+	memcpy(ptpClock->grandmasterIdentity, gmIdentity, CLOCK_IDENTITY_LENGTH);
+	ptpClock->stepsRemoved = 0x0304;
+	ptpClock->timePropertiesDS.currentUtcOffset = -37;
+	ptpClock->timePropertiesDS.timeSource = 0x20;
+	ptpClock->timePropertiesDS.currentUtcOffsetValid = TRUE;
+	ptpClock->timePropertiesDS.ptpTimescale = TRUE;
+}
+
+static Timestamp
+timestamp(UInteger16 msb, UInteger32 lsb, UInteger32 ns)
+{
+	Timestamp t;
+
+	t.secondsField.msb = msb;
+	t.secondsField.lsb = lsb;
+	t.nanosecondsField = ns;
+	return t;
+}
+
+/* header fields set by msgPackHeader() plus the per-message ones */
+static void
+checkHeader(MsgView *view, PtpClock *ptpClock, Enumeration4 messageType, UInteger16 length,
+	    UInteger16 sequenceId, UInteger8 controlField, Integer8 logMessageInterval)
+{
+	MsgHeader header;
+
+	CHECK(msgViewHeader_transportSpecific(view) == 0);
+	CHECK(msgViewHeader_messageType(view) == messageType);
+	CHECK(msgViewHeader_versionPTP(view) == ptpClock->versionNumber);
+	CHECK(msgViewHeader_messageLength(view) == length);
+	CHECK(msgViewHeader_domainNumber(view) == ptpClock->domainNumber);
+	CHECK(portIdentityEqual(msgViewHeader_sourcePortIdentity(view),
+	    clockIdentity, ptpClock->portIdentity.portNumber));
+	CHECK(msgViewHeader_sequenceId(view) == sequenceId);
+	CHECK(msgViewHeader_controlField(view) == controlField);
+	CHECK(msgViewHeader_logMessageInterval(view) == logMessageInterval);
+
+	msgUnpackHeader(buf, &header);
+	CHECK(msgViewHeader_flagField0(view) == header.flagField0);
+	CHECK(msgViewHeader_flagField1(view) == header.flagField1);
+	CHECK(msgViewHeader_correctionField(view).msb == header.correctionField.msb);
+	CHECK(msgViewHeader_correctionField(view).lsb == header.correctionField.lsb);
+}
+
+static void
+testLayouts(void)
+{
+	CHECK(sizeof(MsgViewHeaderLayout) == HEADER_LENGTH);
+	CHECK(sizeof(MsgViewSyncLayout) == SYNC_LENGTH);
+	CHECK(sizeof(MsgViewSyncLayout) == DELAY_REQ_LENGTH);
+	CHECK(sizeof(MsgViewFollowUpLayout) == FOLLOW_UP_LENGTH);
+	CHECK(sizeof(MsgViewDelayRespLayout) == DELAY_RESP_LENGTH);
+	CHECK(sizeof(MsgViewAnnounceLayout) == ANNOUNCE_LENGTH);
+	CHECK(sizeof(MsgViewManagementLayout) == MANAGEMENT_LENGTH);
+}
+
+static void
+testSync(PtpClock *ptpClock)
+{
+	Timestamp origin = timestamp(0x0a0b, 0x11223344, 0x05060708);
+	MsgSync sync;
+	MsgView view;
+
+	memset(buf, 0, sizeof(buf));
+	msgPackSync(buf, &origin, ptpClock);
+	msgViewInit(&view, buf, SYNC_LENGTH);
+
+	checkHeader(&view, ptpClock, SYNC, SYNC_LENGTH, 0x1234, 0x00, -3);
+	CHECK(msgViewHeader_flagField0(&view) & PTP_TWO_STEP);
+	CHECK(timestampEqual(msgViewSync_originTimestamp(&view), origin));
+	msgUnpackSync(buf, &sync);
+	CHECK(timestampEqual(msgViewSync_originTimestamp(&view), sync.originTimestamp));
+	CHECK(!view.error);
+
+	msgViewInit(&view, buf, SYNC_LENGTH - 1);
+	msgViewSync_originTimestamp(&view);
+	CHECK(view.error);
+}
+
+static void
+testFollowUp(PtpClock *ptpClock)
+{
+	Timestamp origin = timestamp(0x0c0d, 0x22334455, 0x090a0b0c);
+	MsgFollowUp follow;
+	MsgView view;
+
+	memset(buf, 0, sizeof(buf));
+	msgPackFollowUp(buf, &origin, ptpClock, 0x3456);
+	msgViewInit(&view, buf, FOLLOW_UP_LENGTH);
+
+	checkHeader(&view, ptpClock, FOLLOW_UP, FOLLOW_UP_LENGTH, 0x3456, 0x02, -3);
+	CHECK(timestampEqual(msgViewFollowUp_preciseOriginTimestamp(&view), origin));
+	msgUnpackFollowUp(buf, &follow);
+	CHECK(timestampEqual(msgViewFollowUp_preciseOriginTimestamp(&view),
+	    follow.preciseOriginTimestamp));
+	CHECK(!view.error);
+
+	msgViewInit(&view, buf, FOLLOW_UP_LENGTH - 1);
+	msgViewFollowUp_preciseOriginTimestamp(&view);
+	CHECK(view.error);
+}
+
+static void
+testDelayResp(PtpClock *ptpClock)
+{
+	Timestamp receive = timestamp(0x0e0f, 0x33445566, 0x0d0e0f10);
+	MsgHeader request;
+	MsgDelayResp resp;
+	MsgView view;
+
+	/* the Delay_Req being answered */
+	memset(&request, 0, sizeof(request));
+	request.domainNumber = ptpClock->domainNumber;
+	request.sequenceId = 0x4567;
+	request.correctionField.msb = 0x01020304;
+	request.correctionField.lsb = 0x05060708;
+	memcpy(request.sourcePortIdentity.clockIdentity, requesterIdentity, CLOCK_IDENTITY_LENGTH);
+	request.sourcePortIdentity.portNumber = 0x0a0b;
+
+	memset(buf, 0, sizeof(buf));
+	msgPackDelayResp(buf, &request, &receive, ptpClock);
+	msgViewInit(&view, buf, DELAY_RESP_LENGTH);
+
+	checkHeader(&view, ptpClock, DELAY_RESP, DELAY_RESP_LENGTH, 0x4567, 0x03, -2);
+	CHECK(msgViewHeader_correctionField(&view).msb == request.correctionField.msb);
+	CHECK(msgViewHeader_correctionField(&view).lsb == request.correctionField.lsb);
+	CHECK(timestampEqual(msgViewDelayResp_receiveTimestamp(&view), receive));
+	CHECK(portIdentityEqual(msgViewDelayResp_requestingPortIdentity(&view),
+	    requesterIdentity, 0x0a0b));
+	msgUnpackDelayResp(buf, &resp);
+	CHECK(timestampEqual(msgViewDelayResp_receiveTimestamp(&view), resp.receiveTimestamp));
+	CHECK(portIdentityEqual(msgViewDelayResp_requestingPortIdentity(&view),
+	    resp.requestingPortIdentity.clockIdentity, resp.requestingPortIdentity.portNumber));
+	CHECK(!view.error);
+
+	msgViewInit(&view, buf, DELAY_RESP_LENGTH - 1);
+	msgViewDelayResp_requestingPortIdentity(&view);
+	CHECK(view.error);
+}
+
+static void
+testAnnounce(PtpClock *ptpClock)
+{
+	MsgAnnounce announce;
+	ClockQuality quality;
+	MsgView view;
+
+	memset(buf, 0, sizeof(buf));
+	msgPackAnnounce(buf, ptpClock);
+	msgViewInit(&view, buf, ANNOUNCE_LENGTH);
+
+	checkHeader(&view, ptpClock, ANNOUNCE, ANNOUNCE_LENGTH, 0x2345, 0x05, 1);
+	CHECK(msgViewHeader_flagField1(&view) == ((1 << 2) | (1 << 3)));
+	CHECK(msgViewAnnounce_currentUtcOffset(&view) == -37);
+	CHECK(msgViewAnnounce_grandmasterPriority1(&view) == 127);
+	quality = msgViewAnnounce_grandmasterClockQuality(&view);
+	CHECK(quality.clockClass == 6);
+	CHECK(quality.clockAccuracy == 0x21);
+	CHECK(quality.offsetScaledLogVariance == 0x4e5d);
+	CHECK(msgViewAnnounce_grandmasterPriority2(&view) == 129);
+	CHECK(!memcmp(msgViewAnnounce_grandmasterIdentity(&view), gmIdentity,
+	    CLOCK_IDENTITY_LENGTH));
+	CHECK(msgViewAnnounce_stepsRemoved(&view) == 0x0304);
+	CHECK(msgViewAnnounce_timeSource(&view) == 0x20);
+
+	msgUnpackAnnounce(buf, &announce);
+	CHECK(timestampEqual(msgViewAnnounce_originTimestamp(&view), announce.originTimestamp));
+	CHECK(msgViewAnnounce_currentUtcOffset(&view) == announce.currentUtcOffset);
+	CHECK(msgViewAnnounce_grandmasterPriority1(&view) == announce.grandmasterPriority1);
+	CHECK(quality.offsetScaledLogVariance ==
+	    announce.grandmasterClockQuality.offsetScaledLogVariance);
+	CHECK(msgViewAnnounce_grandmasterPriority2(&view) == announce.grandmasterPriority2);
+	CHECK(msgViewAnnounce_stepsRemoved(&view) == announce.stepsRemoved);
+	CHECK(msgViewAnnounce_timeSource(&view) == announce.timeSource);
+	CHECK(!view.error);
+
+	msgViewInit(&view, buf, ANNOUNCE_LENGTH - 1);
+	msgViewAnnounce_timeSource(&view);
+	CHECK(view.error);
+}
+
+/* packed from the same .def as the view, but check it anyway */
+static void
+testManagement(PtpClock *ptpClock)
+{
+	MsgManagement manage;
+	MsgView view;
+
+	memset(&manage, 0, sizeof(manage));
+	manage.header.messageType = MANAGEMENT;
+	manage.header.versionPTP = ptpClock->versionNumber;
+	manage.header.messageLength = MANAGEMENT_LENGTH;
+	manage.header.domainNumber = ptpClock->domainNumber;
+	memcpy(manage.header.sourcePortIdentity.clockIdentity, clockIdentity, CLOCK_IDENTITY_LENGTH);
+	manage.header.sourcePortIdentity.portNumber = ptpClock->portIdentity.portNumber;
+	manage.header.sequenceId = 0x5678;
+	manage.header.controlField = 0x04;
+	manage.header.logMessageInterval = 0x7F;
+	memcpy(manage.targetPortIdentity.clockIdentity, requesterIdentity, CLOCK_IDENTITY_LENGTH);
+	manage.targetPortIdentity.portNumber = 0xffff;
+	manage.startingBoundaryHops = 3;
+	manage.boundaryHops = 2;
+	manage.actionField = RESPONSE;
+
+	memset(buf, 0, sizeof(buf));
+	packMsgManagement(&manage, buf);
+	msgViewInit(&view, buf, MANAGEMENT_LENGTH);
+
+	checkHeader(&view, ptpClock, MANAGEMENT, MANAGEMENT_LENGTH, 0x5678, 0x04, 0x7F);
+	CHECK(portIdentityEqual(msgViewManagement_targetPortIdentity(&view),
+	    requesterIdentity, 0xffff));
+	CHECK(msgViewManagement_startingBoundaryHops(&view) == 3);
+	CHECK(msgViewManagement_boundaryHops(&view) == 2);
+	CHECK(msgViewManagement_actionField(&view) == RESPONSE);
+	CHECK(!view.error);
+
+	msgViewInit(&view, buf, MANAGEMENT_LENGTH - 3);
+	msgViewManagement_actionField(&view);
+	CHECK(view.error);
+}
+
+int
+main(int argc, char **argv)
+{
+	PtpClock *ptpClock;
+
+	rtOpts.logLevel = LOG_ERR;
+	/* the packers only fill in logMessageInterval for multicast */
+	rtOpts.transport = UDP_IPV4;
+	rtOpts.ip_mode = IPMODE_MULTICAST;
+
+	if((ptpClock = malloc(sizeof(PtpClock))) == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return 2;
+	}
+	setupClock(ptpClock);
+
+	testLayouts();
+	testSync(ptpClock);
+	testFollowUp(ptpClock);
+	testDelayResp(ptpClock);
+	testAnnounce(ptpClock);
+	testManagement(ptpClock);
+
+	free(ptpClock);
+
+	if(failures) {
+		printf("FAIL: %d checks failed\n", failures);
+		return 1;
+	}
+
+	printf("PASS\n");
+	return 0;
+}
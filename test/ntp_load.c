@@ -0,0 +1,339 @@
+/*-
+ * Copyright (c) 2014 Wojciech Owczarek,
+ *
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file   ntp_load.c
+ *
+ * @brief  Load test for the built-in NTP server
+ *
+ * Sends NTP client (mode 3) requests to a running ptpd2 at a fixed rate
+ * and checks every reply: mode 4, version echoed, origin timestamp equal
+ * to the request's transmit timestamp, and stratum / reference ID / leap
+ * indicator consistent with each other. Reports the achieved rate, loss
+ * and round trip time percentiles. Exits non-zero on an invalid reply or
+ * when the loss exceeds the allowed limit.
+ *
+ * Standalone - needs only libc, see test/Makefile.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define BATCH		64
+#define DRAIN_TIME	1.0	/* seconds to wait for late replies */
+
+/* same layout as NtpPacket in src/dep/datatypes_dep.h */
+typedef struct {
+	uint8_t livnmode;
+	uint8_t stratum;
+	int8_t poll;
+	int8_t precision;
+	uint32_t rootDelay;
+	uint32_t rootDispersion;
+	uint32_t refId;
+	uint32_t refTimeSec;
+	uint32_t refTimeFrac;
+	uint32_t origTimeSec;
+	uint32_t origTimeFrac;
+	uint32_t rxTimeSec;
+	uint32_t rxTimeFrac;
+	uint32_t txTimeSec;
+	uint32_t txTimeFrac;
+} NtpPacket;
+
+#define LI(x)	((x) >> 6)
+#define VN(x)	(((x) >> 3) & 7)
+#define MODE(x)	((x) & 7)
+
+typedef struct {
+	unsigned long sent;
+	unsigned long received;
+	unsigned long invalid;
+	unsigned long duplicate;
+	unsigned long unsync;
+	double *sendTime;	/* per request, 0 once answered */
+	double *rtt;
+	unsigned long maxRequests;
+} LoadState;
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1E9;
+}
+
+static void
+usage(const char *name)
+{
+	fprintf(stderr,
+	    "usage: %s [-a address] [-p port] [-r rate] [-d seconds] [-v version] [-l maxloss%%]\n"
+	    "  defaults: 127.0.0.1, port 123, 10000 requests/s, 5 s, NTPv4, 1%% loss\n",
+	    name);
+	exit(2);
+}
+
+/* The request index travels in the transmit timestamp, the server echoes it as origin */
+static void
+sendBatch(int sock, LoadState *st, int count, int version)
+{
+	struct mmsghdr msgs[BATCH];
+	struct iovec iov[BATCH];
+	NtpPacket req[BATCH];
+	double t;
+	int i, sent;
+
+	count = (st->sent + count > st->maxRequests) ? (int)(st->maxRequests - st->sent) : count;
+	if(count <= 0)
+		return;
+
+	memset(msgs, 0, sizeof(msgs));
+	memset(req, 0, sizeof(req));
+	for(i = 0; i < count; i++) {
+		req[i].livnmode = (version << 3) | 3;
+		req[i].poll = 6;
+		req[i].txTimeSec = htonl(0x5054500d);
+		req[i].txTimeFrac = htonl((uint32_t)(st->sent + i));
+		iov[i].iov_base = &req[i];
+		iov[i].iov_len = sizeof(NtpPacket);
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	t = now();
+	if((sent = sendmmsg(sock, msgs, count, MSG_DONTWAIT)) < 0)
+		sent = 0;
+	for(i = 0; i < sent; i++)
+		st->sendTime[st->sent + i] = t;
+	st->sent += sent;
+}
+
+static int
+checkReply(const NtpPacket *rep, ssize_t len, int version)
+{
+	if(len < (ssize_t)sizeof(NtpPacket))
+		return 0;
+	if(MODE(rep->livnmode) != 4 || VN(rep->livnmode) != version)
+		return 0;
+	if(ntohl(rep->origTimeSec) != 0x5054500d)
+		return 0;
+	if(rep->stratum == 0 || rep->stratum > 16)
+		return 0;
+	/* unsynchronised: LI 3 and stratum 16 go together */
+	if((LI(rep->livnmode) == 3) != (rep->stratum == 16))
+		return 0;
+	if(rep->stratum < 16 && rep->refId == 0)
+		return 0;
+	if(rep->rxTimeSec == 0 || rep->txTimeSec == 0)
+		return 0;
+	return 1;
+}
+
+static void
+receiveAll(int sock, LoadState *st, int version)
+{
+	struct mmsghdr msgs[BATCH];
+	struct iovec iov[BATCH];
+	NtpPacket rep[BATCH];
+	uint32_t idx;
+	double t;
+	int i, n;
+
+	for(;;) {
+		memset(msgs, 0, sizeof(msgs));
+		for(i = 0; i < BATCH; i++) {
+			iov[i].iov_base = &rep[i];
+			iov[i].iov_len = sizeof(NtpPacket);
+			msgs[i].msg_hdr.msg_iov = &iov[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+		if((n = recvmmsg(sock, msgs, BATCH, MSG_DONTWAIT, NULL)) <= 0)
+			return;
+		t = now();
+		for(i = 0; i < n; i++) {
+			if(!checkReply(&rep[i], msgs[i].msg_len, version)) {
+				st->invalid++;
+				continue;
+			}
+			idx = ntohl(rep[i].origTimeFrac);
+			if(idx >= st->sent) {
+				st->invalid++;
+				continue;
+			}
+			if(st->sendTime[idx] == 0) {
+				st->duplicate++;
+				continue;
+			}
+			if(rep[i].stratum == 16)
+				st->unsync++;
+			st->rtt[st->received++] = t - st->sendTime[idx];
+			st->sendTime[idx] = 0;
+		}
+	}
+}
+
+static int
+compareDouble(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static double
+percentile(const double *sorted, unsigned long count, double p)
+{
+	if(count == 0)
+		return 0;
+	return sorted[(unsigned long)(p / 100.0 * (count - 1))];
+}
+
+int
+main(int argc, char **argv)
+{
+	struct sockaddr_in addr;
+	struct pollfd pfd;
+	LoadState st;
+	const char *host = "127.0.0.1";
+	double rate = 10000, duration = 5, maxLoss = 1.0;
+	double start, elapsed, due, end, loss;
+	int port = 123, version = 4;
+	int sock, c, rcvbuf = 4 * 1024 * 1024;
+
+	while((c = getopt(argc, argv, "a:p:r:d:v:l:h")) != -1) {
+		switch(c) {
+		case 'a': host = optarg; break;
+		case 'p': port = atoi(optarg); break;
+		case 'r': rate = atof(optarg); break;
+		case 'd': duration = atof(optarg); break;
+		case 'v': version = atoi(optarg); break;
+		case 'l': maxLoss = atof(optarg); break;
+		default: usage(argv[0]);
+		}
+	}
+
+	if(rate <= 0 || duration <= 0 || version < 1 || version > 4)
+		usage(argv[0]);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if(inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+		fprintf(stderr, "invalid address: %s\n", host);
+		return 2;
+	}
+
+	if((sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0 ||
+	    connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		perror("socket");
+		return 2;
+	}
+	setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+
+	memset(&st, 0, sizeof(st));
+	st.maxRequests = (unsigned long)(rate * duration);
+	st.sendTime = calloc(st.maxRequests, sizeof(double));
+	st.rtt = calloc(st.maxRequests, sizeof(double));
+	if(st.sendTime == NULL || st.rtt == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return 2;
+	}
+
+	/* pace to the target rate: send whatever is due, then read replies */
+	start = now();
+	while(st.sent < st.maxRequests) {
+		elapsed = now() - start;
+		due = elapsed * rate - st.sent;
+		if(due > 0)
+			sendBatch(sock, &st, due >= BATCH ? BATCH : (int)due + 1, version);
+		receiveAll(sock, &st, version);
+		if(due <= 0) {
+			pfd.fd = sock;
+			pfd.events = POLLIN;
+			poll(&pfd, 1, 1);
+		}
+	}
+	elapsed = now() - start;
+
+	end = now() + DRAIN_TIME;
+	while(st.received < st.sent && now() < end) {
+		pfd.fd = sock;
+		pfd.events = POLLIN;
+		poll(&pfd, 1, 10);
+		receiveAll(sock, &st, version);
+	}
+
+	close(sock);
+
+	qsort(st.rtt, st.received, sizeof(double), compareDouble);
+	loss = st.sent ? 100.0 * (st.sent - st.received) / st.sent : 100.0;
+
+	printf("server           %s:%d, NTPv%d\n", host, port, version);
+	printf("requests sent    %lu in %.3f s (%.0f/s, target %.0f/s)\n",
+	    st.sent, elapsed, st.sent / elapsed, rate);
+	printf("replies          %lu valid, %lu invalid, %lu duplicate, %lu unsynchronised\n",
+	    st.received, st.invalid, st.duplicate, st.unsync);
+	printf("loss             %lu (%.3f%%, limit %.3f%%)\n",
+	    st.sent - st.received, loss, maxLoss);
+	printf("rtt us           min %.1f  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+	    percentile(st.rtt, st.received, 0) * 1E6,
+	    percentile(st.rtt, st.received, 50) * 1E6,
+	    percentile(st.rtt, st.received, 90) * 1E6,
+	    percentile(st.rtt, st.received, 99) * 1E6,
+	    percentile(st.rtt, st.received, 99.9) * 1E6,
+	    percentile(st.rtt, st.received, 100) * 1E6);
+
+	free(st.sendTime);
+	free(st.rtt);
+
+	if(st.invalid > 0 || st.duplicate > 0) {
+		printf("FAIL: invalid replies\n");
+		return 1;
+	}
+	if(loss > maxLoss) {
+		printf("FAIL: loss above limit\n");
+		return 1;
+	}
+	printf("PASS\n");
+	return 0;
+}
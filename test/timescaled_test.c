@@ -0,0 +1,190 @@
+/*-
+ * Copyright (c) 2014 Wojciech Owczarek,
+ *
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file   timescaled_test.c
+ *
+ * @brief  TimeScaled conversion and range tests
+ *
+ * Checks the scaled nanosecond conversions in arith.c: lossless
+ * Integer64 round trips, rounding of scaled_to_internalTime(), and the
+ * range handling of subTimeScaled(). The last one is the regression test
+ * for the overflow where a slave booted at the epoch, synchronising to a
+ * current master, computed an offset of +132656 s instead of -1.79e9 s:
+ * differences beyond TIME_SCALED_MAX_SECONDS must saturate with the
+ * right sign and return FALSE, everything within must be exact.
+ *
+ * Links against the objects of a built tree, see test/Makefile.
+ */
+
+#include "ptpd.h"
+
+/* ptpd.c is not linked in, it owns these */
+RunTimeOpts rtOpts;
+Boolean startupInProgress;
+PtpClock *G_ptpClock = NULL;
+
+#define SCALED_LIMIT	((TimeScaled)TIME_SCALED_MAX_SECONDS * 1000000000 * TIME_SCALED_NS)
+
+static int failures = 0;
+
+#define CHECK(expr, ...) \
+	do { \
+		if(!(expr)) { \
+			fprintf(stderr, "FAIL %s:%d: %s: ", __FILE__, __LINE__, #expr); \
+			fprintf(stderr, __VA_ARGS__); \
+			fprintf(stderr, "\n"); \
+			failures++; \
+		} \
+	} while(0)
+
+static uint32_t rngState = 0x1234567;
+
+static uint32_t
+rng(void)
+{
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 17;
+	rngState ^= rngState << 5;
+	return rngState;
+}
+
+static TimeInternal
+timeInternal(Integer32 seconds, Integer32 nanoseconds)
+{
+	TimeInternal t;
+
+	t.seconds = seconds;
+	t.nanoseconds = nanoseconds;
+	return t;
+}
+
+static void
+testInteger64(void)
+{
+	static const TimeScaled values[] = {
+		0, 1, -1, TIME_SCALED_NS, -TIME_SCALED_NS, 0x7fffffffffffffffLL,
+		-0x7fffffffffffffffLL - 1, 0x00000001ffffffffLL, -0x00000001ffffffffLL
+	};
+	Integer64 bigint;
+	int i;
+
+	for(i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+		scaled_to_integer64(values[i], &bigint);
+		CHECK(integer64_to_scaled(&bigint) == values[i], "value %lld",
+		    (long long)values[i]);
+	}
+}
+
+static void
+testRounding(void)
+{
+	TimeInternal t;
+
+	/* half a nanosecond rounds up, just below rounds down */
+	scaled_to_internalTime(TIME_SCALED_NS / 2, &t);
+	CHECK(t.seconds == 0 && t.nanoseconds == 1, "%d.%09d", t.seconds, t.nanoseconds);
+	scaled_to_internalTime(TIME_SCALED_NS / 2 - 1, &t);
+	CHECK(t.seconds == 0 && t.nanoseconds == 0, "%d.%09d", t.seconds, t.nanoseconds);
+
+	/* negative values: both parts carry the sign */
+	scaled_to_internalTime(-(TimeScaled)1500000000 * TIME_SCALED_NS, &t);
+	CHECK(t.seconds == -1 && t.nanoseconds == -500000000, "%d.%09d",
+	    t.seconds, t.nanoseconds);
+	scaled_to_internalTime(-TIME_SCALED_NS / 2 - 1, &t);
+	CHECK(t.seconds == 0 && t.nanoseconds == -1, "%d.%09d", t.seconds, t.nanoseconds);
+}
+
+static void
+testSubTimeScaled(void)
+{
+	TimeInternal x, y, r, back;
+	TimeScaled scaled;
+	Boolean ret;
+	int i;
+
+	/* the original overflow: slave at the epoch, master in 2026 */
+	x = timeInternal(0, 17);
+	y = timeInternal(1790000000, 0);
+	ret = subTimeScaled(&scaled, &x, &y);
+	CHECK(!ret, "1.79e9 s difference must not fit");
+	CHECK(scaled == -SCALED_LIMIT, "saturated at %lld", (long long)scaled);
+	ret = subTimeScaled(&scaled, &y, &x);
+	CHECK(!ret && scaled == SCALED_LIMIT, "positive saturation %lld", (long long)scaled);
+
+	/* just inside and just outside the limit */
+	x = timeInternal(TIME_SCALED_MAX_SECONDS - 1, 999999999);
+	y = timeInternal(0, 0);
+	ret = subTimeScaled(&scaled, &x, &y);
+	CHECK(ret && scaled == internalTime_to_scaled(&x), "inside the limit");
+	x = timeInternal(TIME_SCALED_MAX_SECONDS, 0);
+	ret = subTimeScaled(&scaled, &x, &y);
+	CHECK(!ret && scaled == SCALED_LIMIT, "at the limit");
+	ret = subTimeScaled(&scaled, &y, &x);
+	CHECK(!ret && scaled == -SCALED_LIMIT, "at the negative limit");
+
+	/* about 39 h apart: wrapped before the fix */
+	x = timeInternal(1790000000 + 140000, 0);
+	y = timeInternal(1790000000, 0);
+	ret = subTimeScaled(&scaled, &x, &y);
+	CHECK(!ret && scaled == SCALED_LIMIT, "39 h apart");
+
+	/* in range: must match subTime() to the nanosecond */
+	for(i = 0; i < 100000; i++) {
+		y = timeInternal(1700000000 + rng() % 100000000, rng() % 1000000000);
+		x = timeInternal(y.seconds + (Integer32)(rng() % (2 * TIME_SCALED_MAX_SECONDS - 2)) -
+		    (TIME_SCALED_MAX_SECONDS - 1), rng() % 1000000000);
+		subTime(&r, &x, &y);
+		ret = subTimeScaled(&scaled, &x, &y);
+		scaled_to_internalTime(scaled, &back);
+		CHECK(ret && back.seconds == r.seconds && back.nanoseconds == r.nanoseconds,
+		    "%d.%09d - %d.%09d: %d.%09d, expected %d.%09d",
+		    x.seconds, x.nanoseconds, y.seconds, y.nanoseconds,
+		    back.seconds, back.nanoseconds, r.seconds, r.nanoseconds);
+		if(failures > 10)
+			break;
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	rtOpts.logLevel = LOG_ERR;
+
+	testInteger64();
+	testRounding();
+	testSubTimeScaled();
+
+	if(failures) {
+		printf("FAIL: %d checks failed\n", failures);
+		return 1;
+	}
+
+	printf("PASS\n");
+	return 0;
+}